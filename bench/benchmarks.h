@@ -0,0 +1,68 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+
+namespace bench
+{
+
+typedef std::chrono::high_resolution_clock clock;
+
+/**
+ *	@brief	Returns the number of seconds elapsed since a given point in time.
+ */
+inline double seconds_since(const clock::time_point& start) {
+	return std::chrono::duration<double>(clock::now() - start).count();
+}
+
+/**
+ *	@brief	Prints the result of a measurement, as a cost per operation.
+ *
+ *	@param	const std::string& name The name of the measurement.
+ *	@param	double seconds The total time spent.
+ *	@param	unsigned int operations The number of operations performed during that time.
+ */
+inline void report_per_operation(const std::string& name, double seconds, unsigned int operations)
+{
+	std::cout << "  " << std::left << std::setw(40) << name << std::right << std::setw(10) << std::fixed
+		<< std::setprecision(1) << (seconds * 1e9 / operations) << " ns/op" << std::endl;
+}
+
+/**
+ *	@brief	Prints the result of a measurement, as a throughput.
+ *
+ *	@param	const std::string& name The name of the measurement.
+ *	@param	double seconds The total time spent.
+ *	@param	unsigned long long bytes The number of bytes processed during that time.
+ */
+inline void report_throughput(const std::string& name, double seconds, unsigned long long bytes)
+{
+	std::cout << "  " << std::left << std::setw(40) << name << std::right << std::setw(10) << std::fixed
+		<< std::setprecision(1) << (bytes / seconds / (1024 * 1024)) << " MB/s" << std::endl;
+}
+
+// Individual benchmarks
+void bench_output_tree();
+void bench_formatters();
+void bench_plugin_loading(const std::string& plugin_directory);
+
+} // !namespace bench
@@ -0,0 +1,148 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchmarks.h"
+
+#include <streambuf>
+
+#include "output_formatter.h"
+
+namespace bench
+{
+
+const unsigned int FILE_COUNT			= 200;
+const unsigned int SECTIONS_PER_FILE	= 40;
+const unsigned int IMPORTS_PER_FILE		= 400;
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	A stream buffer which discards its input, but keeps track of its size.
+ */
+class CountingBuffer : public std::streambuf
+{
+public:
+	CountingBuffer() : _count(0) {
+		setp(_buffer, _buffer + sizeof(_buffer));
+	}
+
+	unsigned long long get_count() {
+		return _count + (pptr() - pbase());
+	}
+
+protected:
+	virtual int_type overflow(int_type c)
+	{
+		_count += pptr() - pbase();
+		setp(_buffer, _buffer + sizeof(_buffer));
+		if (!traits_type::eq_int_type(c, traits_type::eof())) {
+			sputc(traits_type::to_char_type(c));
+		}
+		return traits_type::not_eof(c);
+	}
+
+private:
+	char _buffer[4096];
+	unsigned long long _count;
+};
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Adds the output of a fictional analysis to a formatter. The tree mimics the
+ *			result of "--dump=all", which contains mostly numbers.
+ */
+void add_analysis(io::OutputFormatter& formatter, const std::string& path, unsigned int seed)
+{
+	io::pNode header = io::make_node("PE Header", io::OutputTreeNode::LIST);
+	header->append(io::make_node("Signature", std::string("PE")));
+	header->append(io::make_node("Machine", std::string("IMAGE_FILE_MACHINE_I386")));
+	header->append(io::make_node("TimeDateStamp", io::timestamp_to_string(1400000000 + seed * 3600)));
+	header->append(io::make_node("SizeOfImage", static_cast<boost::uint32_t>(0x1E000 + seed), io::OutputTreeNode::HEX));
+	header->append(io::make_node("ImageBase", static_cast<boost::uint64_t>(0x140000000ULL), io::OutputTreeNode::HEX));
+	header->append(io::make_node("FileVersion", io::uint64_to_version_number(0x000A0000, 0x4A610000 + seed)));
+	formatter.add_data(header, path);
+
+	io::pNode sections = io::make_node("Sections", io::OutputTreeNode::LIST);
+	for (unsigned int i = 0 ; i < SECTIONS_PER_FILE ; ++i)
+	{
+		io::pNode section = io::make_node(".text" + std::to_string(i), io::OutputTreeNode::LIST);
+		section->append(io::make_node("MD5", std::string("8ec1df44bbcb8a2d9e0c5a0e4b3c6d7f")));
+		section->append(io::make_node("Entropy", 6.0 + (seed % 100) / 57.0));
+		section->append(io::make_node("VirtualAddress", static_cast<boost::uint32_t>(0x1000 * (i + 1)), io::OutputTreeNode::HEX));
+		section->append(io::make_node("VirtualSize", static_cast<boost::uint32_t>(0x8A2C + i * seed), io::OutputTreeNode::HEX));
+		section->append(io::make_node("SizeOfRawData", static_cast<boost::uint32_t>(0x8C00 + i), io::OutputTreeNode::HEX));
+		section->append(io::make_node("NumberOfRelocations", static_cast<boost::uint16_t>(i)));
+		io::strings characteristics;
+		characteristics.push_back("IMAGE_SCN_CNT_CODE");
+		characteristics.push_back("IMAGE_SCN_MEM_EXECUTE");
+		characteristics.push_back("IMAGE_SCN_MEM_READ");
+		section->append(io::make_node("Characteristics", characteristics));
+		sections->append(section);
+	}
+	formatter.add_data(sections, path);
+
+	io::strings imports;
+	for (unsigned int i = 0 ; i < IMPORTS_PER_FILE ; ++i) {
+		imports.push_back("GetProcAddress" + std::to_string(i));
+	}
+	io::pNode imports_node = io::make_node("Imports", io::OutputTreeNode::LIST);
+	imports_node->append(io::make_node("KERNEL32.dll", imports));
+	formatter.add_data(imports_node, path);
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Measures the throughput of an output formatter.
+ *
+ *	Only the call to format() is timed: building the trees is measured by bench_output_tree.
+ */
+void measure_formatter(const std::string& name, io::OutputFormatter& formatter)
+{
+	CountingBuffer buffer;
+	std::ostream sink(&buffer);
+	double elapsed = 0;
+
+	for (unsigned int i = 0 ; i < FILE_COUNT ; ++i)
+	{
+		io::NodeArena::Scope arena_scope(new io::NodeArena);
+		add_analysis(formatter, "/tmp/sample" + std::to_string(i) + ".exe", i);
+
+		clock::time_point start = clock::now();
+		formatter.format(sink, i == FILE_COUNT - 1);
+		elapsed += seconds_since(start);
+	}
+
+	report_throughput(name, elapsed, buffer.get_count());
+}
+
+// ----------------------------------------------------------------------------
+
+void bench_formatters()
+{
+	io::RawFormatter raw;
+	measure_formatter("raw", raw);
+	io::JsonFormatter json;
+	measure_formatter("json", json);
+	io::JsonLinesFormatter jsonl;
+	measure_formatter("jsonl", jsonl);
+	io::CborFormatter cbor;
+	measure_formatter("cbor", cbor);
+}
+
+} // !namespace bench
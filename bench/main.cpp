@@ -0,0 +1,35 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchmarks.h"
+
+/**
+ *	@brief	Runs all the benchmarks.
+ *
+ *	Build with -DBenchmarks=ON, preferably in Release mode. The plugins are loaded from the
+ *	directory given as an argument ("bin" by default).
+ */
+int main(int argc, char** argv)
+{
+	std::cout << "Output tree:" << std::endl;
+	bench::bench_output_tree();
+	std::cout << "Output formatters:" << std::endl;
+	bench::bench_formatters();
+	std::cout << "Plugin loading:" << std::endl;
+	bench::bench_plugin_loading(argc > 1 ? argv[1] : "bin");
+	return 0;
+}
@@ -0,0 +1,94 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchmarks.h"
+
+#include "manacommons/output_tree_node.h"
+
+namespace bench
+{
+
+// Shape of the generated trees: roughly what "--dump sections,imports" produces for a large DLL.
+const unsigned int ITERATIONS		= 200;
+const unsigned int LIST_COUNT		= 100;
+const unsigned int FIELDS_PER_LIST	= 10;
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Builds a tree containing LIST_COUNT lists of FIELDS_PER_LIST integers and strings.
+ */
+io::pNode build_tree()
+{
+	io::pNode root = io::make_node("Sections", io::OutputTreeNode::LIST);
+	for (unsigned int i = 0 ; i < LIST_COUNT ; ++i)
+	{
+		io::pNode list = io::make_node(".text", io::OutputTreeNode::LIST);
+		for (unsigned int j = 0 ; j < FIELDS_PER_LIST / 2 ; ++j)
+		{
+			list->append(io::make_node("VirtualAddress", static_cast<boost::uint32_t>(i * j), io::OutputTreeNode::HEX));
+			list->append(io::make_node("Characteristics", std::string("IMAGE_SCN_MEM_READ")));
+		}
+		root->append(list);
+	}
+	return root;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Measures the cost of creating and destroying trees.
+ *
+ *	@param	const std::string& name The name of the configuration.
+ *	@param	bool use_arena Whether a NodeArena should be active while the trees are created.
+ */
+void measure_tree(const std::string& name, bool use_arena)
+{
+	double creation = 0, teardown = 0;
+	unsigned int node_count = ITERATIONS * (1 + LIST_COUNT * (1 + FIELDS_PER_LIST));
+
+	for (unsigned int i = 0 ; i < ITERATIONS ; ++i)
+	{
+		clock::time_point start = clock::now();
+		io::pNode tree;
+		{
+			boost::shared_ptr<io::NodeArena::Scope> scope;
+			if (use_arena) {
+				scope.reset(new io::NodeArena::Scope(new io::NodeArena));
+			}
+			tree = build_tree();
+		}
+		creation += seconds_since(start);
+
+		start = clock::now();
+		tree.reset(); // Destroys the nodes (and the arena, if any).
+		teardown += seconds_since(start);
+	}
+
+	report_per_operation(name + " - creation", creation, node_count);
+	report_per_operation(name + " - teardown", teardown, node_count);
+}
+
+// ----------------------------------------------------------------------------
+
+void bench_output_tree()
+{
+	measure_tree("heap", false);
+	measure_tree("arena", true);
+}
+
+} // !namespace bench
@@ -0,0 +1,116 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "benchmarks.h"
+
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "plugin_framework/plugin_manager.h"
+
+namespace bfs = boost::filesystem;
+
+namespace bench
+{
+
+const unsigned int LOAD_ITERATIONS = 20;
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Copies the plugin libraries of a directory into a new one, with or without their manifests.
+ *
+ *	@return	The number of libraries copied.
+ */
+unsigned int copy_plugins(const bfs::path& source, const bfs::path& destination, bool with_manifests)
+{
+	#ifdef BOOST_WINDOWS_API
+		std::string ext(".dll");
+	#else
+		std::string ext(".so");
+	#endif
+
+	unsigned int count = 0;
+	bfs::create_directories(destination);
+	for (bfs::directory_iterator it(source), end ; it != end ; ++it)
+	{
+		if (it->path().extension() == ext)
+		{
+			bfs::copy_file(it->path(), destination / it->path().filename());
+			++count;
+		}
+		else if (with_manifests && it->path().extension() == ".manifest") {
+			bfs::copy_file(it->path(), destination / it->path().filename());
+		}
+	}
+	return count;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Measures what Manalyze does at startup: registering the plugins, and listing them
+ *			to validate the arguments.
+ *
+ *	@param	const std::string& name The name of the configuration.
+ *	@param	const bfs::path& directory The directory containing the plugins.
+ */
+void measure_loading(const std::string& name, const bfs::path& directory)
+{
+	plugin::PluginManager& pm = plugin::PluginManager::get_instance();
+	double elapsed = 0;
+	for (unsigned int i = 0 ; i < LOAD_ITERATIONS ; ++i)
+	{
+		clock::time_point start = clock::now();
+		pm.load_all(directory.string());
+		pm.get_manifests();
+		elapsed += seconds_since(start);
+		pm.unload_all();
+	}
+	report_per_operation(name + " - load_all", elapsed, LOAD_ITERATIONS);
+}
+
+// ----------------------------------------------------------------------------
+
+void bench_plugin_loading(const std::string& plugin_directory)
+{
+	bfs::path root = bfs::temp_directory_path() / bfs::unique_path("manalyze-bench-%%%%%%%%");
+	unsigned int count = 0;
+	try
+	{
+		count = copy_plugins(plugin_directory, root / "eager", false);
+		copy_plugins(plugin_directory, root / "manifests", true);
+	}
+	catch (const bfs::filesystem_error& e) {
+		std::cout << "  Could not copy the plugins (" << e.what() << ")." << std::endl;
+	}
+
+	if (count == 0) {
+		std::cout << "  No plugin libraries found in " << plugin_directory << "." << std::endl;
+	}
+	else
+	{
+		// The copies without manifests are opened at startup, like the plugins which don't have any.
+		measure_loading("eager dlopen", root / "eager");
+		measure_loading("manifests", root / "manifests");
+	}
+
+	boost::system::error_code ec;
+	bfs::remove_all(root, ec);
+}
+
+} // !namespace bench
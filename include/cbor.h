@@ -0,0 +1,114 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+#include <ostream>
+#include <istream>
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "manacommons/color.h"
+
+namespace io {
+namespace cbor {
+
+/**
+ *	@brief	Builds a CBOR (RFC 7049) data item in a memory buffer.
+ *
+ *	Integers and floating point values are stored natively. When string deduplication is enabled,
+ *	the item is wrapped in a stringref namespace (tag 256, see http://cbor.schmorp.de/stringref):
+ *	strings which were already written are replaced by a reference (tag 25) to their index in a
+ *	table that decoders rebuild on their own while reading the item.
+ */
+class Writer
+{
+public:
+	Writer(bool deduplicate_strings = true);
+
+	void write_map_header(boost::uint64_t size);
+	void write_array_header(boost::uint64_t size);
+	void write_uint(boost::uint64_t value);
+	void write_float(float value);
+	void write_double(double value);
+
+	/**
+	 *	@brief	Writes a string into the buffer.
+	 *
+	 *	Valid UTF-8 strings are written as text strings, and anything else as byte strings, since
+	 *	data extracted from PE files cannot be assumed to respect any encoding.
+	 *
+	 *	@param	const std::string& s The string to write.
+	 */
+	void write_string(const std::string& s);
+
+	const std::string& get_buffer() const { return _buffer; }
+
+private:
+	void _write_header(boost::uint8_t major_type, boost::uint64_t value);
+
+	std::string _buffer;
+	bool _deduplicate_strings;
+	// Strings which can be referenced, prefixed with their major type. Values are their index in the table.
+	boost::unordered_map<std::string, boost::uint64_t> _string_table;
+	boost::uint64_t _string_table_size;
+};
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Writes a length-prefixed record into a stream.
+ *
+ *	Records consist of a 32 bit big-endian length followed by a CBOR data item. Items larger
+ *	than 4 GB cannot be written.
+ *
+ *	@param	std::ostream& sink The stream to write into.
+ *	@param	const std::string& item The encoded CBOR item.
+ */
+void write_record(std::ostream& sink, const std::string& item);
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Reads a length-prefixed record from a stream.
+ *
+ *	@param	std::istream& source The stream to read from.
+ *	@param	std::string& item The destination for the CBOR item contained in the record.
+ *
+ *	@return	Whether a record could be read. False is returned at the end of the stream, and
+ *			for records which are truncated.
+ */
+bool read_record(std::istream& source, std::string& item);
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Converts a stream of CBOR records into a single JSON document.
+ *
+ *	Each record is expected to contain a map (as written by the CborFormatter), whose entries
+ *	are merged into the top-level JSON object.
+ *
+ *	@param	std::istream& source The stream containing the records.
+ *	@param	std::ostream& sink The destination for the JSON document.
+ *
+ *	@return	Whether the conversion was successful.
+ */
+bool records_to_json(std::istream& source, std::ostream& sink);
+
+} // !namespace cbor
+} // !namespace io
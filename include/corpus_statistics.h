@@ -0,0 +1,124 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+#include "manape/pe.h"
+#include "manacommons/output_tree_node.h"
+#include "plugin_framework/analysis_context.h"
+#include "sketches.h"
+
+namespace mana
+{
+
+/**
+ *	@brief	Statistics about a set of samples: machine and subsystem counts, compilation years,
+ *			section entropy, and the most frequent section names and imports.
+ *
+ *	Section names and imports can take millions of distinct values over a large corpus. They are
+ *	counted with FrequencySketches, so that the memory used doesn't depend on the number of samples.
+ *	The other statistics have few possible values and are counted exactly.
+ *
+ *	This class is not thread-safe: each thread should fill its own instance (see
+ *	StatisticsAggregator), and the instances are merged at the end.
+ */
+class CorpusStatistics
+{
+public:
+	/**
+	 *	@param	unsigned int top_keys The number of section names and imports to report.
+	 */
+	CorpusStatistics(unsigned int top_keys = 50);
+
+	/**
+	 *	@brief	Adds a sample to the statistics.
+	 *
+	 *	@param	const mana::PE& pe The sample. Its imports have to be parsed.
+	 *	@param	plugin::IAnalysisContext& context The analysis context of the sample, which provides
+	 *			the entropy of the sections.
+	 */
+	void add(const mana::PE& pe, plugin::IAnalysisContext& context);
+
+	/**
+	 *	@brief	Adds the samples counted by another instance to this one.
+	 */
+	void merge(const CorpusStatistics& other);
+
+	/**
+	 *	@brief	Creates the output nodes describing the statistics, one per category.
+	 */
+	std::vector<io::pNode> to_nodes() const;
+
+	boost::uint64_t get_samples() const {
+		return _samples;
+	}
+
+private:
+	typedef std::map<std::string, boost::uint64_t> counter;
+
+	unsigned int					_top_keys;
+	boost::uint64_t					_samples;
+	counter							_machines;
+	counter							_subsystems;
+	counter							_compilation_years;
+	std::vector<boost::uint64_t>	_section_entropy;	// Histogram with buckets of 0.5 bits.
+	FrequencySketch					_section_names;
+	FrequencySketch					_imports;			// "dll!function", in lowercase.
+};
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Collects statistics from several threads.
+ *
+ *	Each thread fills its own CorpusStatistics, which are only merged once the analysis is over,
+ *	so that the threads never wait for each other.
+ */
+class StatisticsAggregator
+{
+public:
+	StatisticsAggregator(unsigned int top_keys = 50) : _top_keys(top_keys), _current(&StatisticsAggregator::_release) {}
+
+	/**
+	 *	@brief	Returns the statistics of the calling thread.
+	 */
+	CorpusStatistics& get_partial();
+
+	/**
+	 *	@brief	Merges the statistics of all the threads. No thread may be adding samples at the
+	 *			same time.
+	 */
+	CorpusStatistics merge() const;
+
+private:
+	static void _release(CorpusStatistics*) {} // The instances are owned by _partials.
+
+	unsigned int											_top_keys;
+	boost::thread_specific_ptr<CorpusStatistics>			_current;
+	std::vector<boost::shared_ptr<CorpusStatistics> >		_partials;
+	mutable boost::mutex									_mutex;
+};
+
+} // !namespace mana
@@ -19,7 +19,9 @@ along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <set>
 #include <vector>
+#include <string>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/assign/list_of.hpp>
 #include <boost/make_shared.hpp>
 
 #include "output_formatter.h"
@@ -29,6 +31,7 @@ along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
 #include "yara/yara_wrapper.h"
 
 #include "import_hash.h"
+#include "plugin_framework/analysis_context.h"
 
 namespace mana
 {
@@ -45,7 +48,21 @@ void dump_debug_info(const mana::PE& pe, io::OutputFormatter& formatter);
 void dump_tls(const mana::PE& pe, io::OutputFormatter& formatter);
 void dump_config(const mana::PE&pe, io::OutputFormatter& formatter);
 void dump_summary(const mana::PE& pe, io::OutputFormatter& formatter);
-void dump_hashes(const mana::PE& pe, io::OutputFormatter& formatter);
+
+/**
+ *	@brief	Computes the hashes of a PE file.
+ *
+ *	@param	plugin::AnalysisContext& context The context of the PE to hash. The digests are kept
+ *			in it, so that plugins don't compute them again.
+ *	@param	io::OutputFormatter& formatter The object which will receive the output.
+ *	@param	const std::set<std::string>& digests The names of the digests to compute
+ *			(MD5, SHA1, SHA256, SHA3, SSDeep or "Imports Hash"). All of them are
+ *			computed if this set is empty.
+ */
+void dump_hashes(plugin::AnalysisContext& context,
+				 io::OutputFormatter& formatter,
+				 const std::set<std::string>& digests = std::set<std::string>());
+
 void dump_dldt(const mana::PE& pe, io::OutputFormatter& formatter);
 
 /**
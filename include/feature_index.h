@@ -0,0 +1,168 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "manape/pe.h"
+
+namespace mana
+{
+
+/**
+ *	@brief	Lists the features of a PE which are indexed by the FeatureIndex.
+ *
+ *	The features are strings such as "imphash:<md5>", "section:<sha256>", "resource:<sha256>",
+ *	"pdb:<path>" and "pdb_guid:<guid>". Empty sections and resources are ignored.
+ *	The imports, resources and debug information of the PE have to be parsed.
+ *
+ *	@param	const mana::PE& pe The PE whose features should be extracted.
+ *
+ *	@return	The features of the PE, without duplicates.
+ */
+std::vector<std::string> extract_features(const mana::PE& pe);
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	An index which finds the samples sharing an exact feature (an import hash, a section,
+ *			a PDB path...) with a logarithmic number of comparisons.
+ *
+ *	The index is a directory of immutable segment files. Each of them contains sorted, fixed-size
+ *	records made of the MD5 of a feature followed by the SHA256 of a sample. Segments are memory-mapped
+ *	and searched with a binary search.
+ *
+ *	Records are buffered in memory, then written into a new segment with a unique name, which is
+ *	renamed in place once it is complete. Segments are never modified, so several processes can
+ *	write into the same index at the same time without any locking. Segments of a similar size are
+ *	merged together once there are enough of them, so that each record is only rewritten a logarithmic
+ *	number of times as the index grows. Duplicate records are ignored when the index is queried.
+ *
+ *	add() may be called from multiple threads.
+ */
+class FeatureIndex
+{
+public:
+	/**
+	 *	@brief	Opens an index, which is created if it doesn't exist.
+	 *
+	 *	@param	const std::string& directory The directory containing the segments.
+	 */
+	FeatureIndex(const std::string& directory);
+
+	/**
+	 *	@brief	Writes the buffered records.
+	 */
+	~FeatureIndex();
+
+	/**
+	 *	@brief	Whether the directory of the index exists.
+	 */
+	bool is_open() const {
+		return _open;
+	}
+
+	/**
+	 *	@brief	Records the features of a sample.
+	 *
+	 *	The records are written to the disk once enough of them are buffered, or when flush() is called.
+	 *
+	 *	@param	const std::string& sha256 The SHA256 of the sample, in hexadecimal.
+	 *	@param	const std::vector<std::string>& features The features of the sample (see extract_features).
+	 *
+	 *	@return	Whether the records could be written (if they had to).
+	 */
+	bool add(const std::string& sha256, const std::vector<std::string>& features);
+
+	/**
+	 *	@brief	Writes the buffered records into a new segment.
+	 */
+	bool flush();
+
+	/**
+	 *	@brief	Merges all the segments of the index into a single one.
+	 */
+	bool compact();
+
+	/**
+	 *	@brief	Finds the samples which have a given feature.
+	 *
+	 *	The segments are mapped during the first lookup. Records written afterwards, or which
+	 *	are still buffered, are not taken into account.
+	 *
+	 *	@param	const std::string& feature The feature to look for (i.e. "imphash:<md5>").
+	 *
+	 *	@return	The SHA256 of the matching samples, sorted and without duplicates.
+	 */
+	std::vector<std::string> lookup(const std::string& feature);
+
+private:
+	typedef struct record_t
+	{
+		boost::uint8_t feature[16];	// The MD5 of the feature.
+		boost::uint8_t sample[32];	// The SHA256 of the sample.
+	} record;
+
+	typedef boost::shared_ptr<boost::iostreams::mapped_file_source> pSegment;
+
+	/**
+	 *	@brief	Writes sorted records into a new segment.
+	 *
+	 *	@param	The function called to obtain the records, in order. It returns false when
+	 *			there are no more records.
+	 */
+	template<class Source>
+	bool _write_segment(Source next_record);
+
+	/**
+	 *	@brief	Lists and maps the segments currently in the index.
+	 */
+	bool _map_segments(std::vector<std::string>& paths, std::vector<pSegment>& segments) const;
+
+	/**
+	 *	@brief	Writes the buffered records. The caller must hold _mutex.
+	 */
+	bool _flush();
+
+	/**
+	 *	@brief	Merges the segments of a size tier once there are enough of them.
+	 */
+	bool _merge_tiers();
+
+	/**
+	 *	@brief	Merges mapped segments into a new one, then removes them.
+	 *
+	 *	@param	const std::vector<std::string>& paths The paths of the segments.
+	 *	@param	std::vector<pSegment>& segments The mapped segments. They are unmapped by this function.
+	 */
+	bool _merge(const std::vector<std::string>& paths, std::vector<pSegment>& segments);
+
+	std::string				_directory;
+	bool					_open;
+	std::vector<record>		_pending;	// The records which haven't been written yet.
+	std::vector<pSegment>	_segments;	// The segments mapped for the lookups.
+	bool					_mapped;
+	boost::mutex			_mutex;
+};
+
+} // !namespace mana
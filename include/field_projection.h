@@ -0,0 +1,145 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/assign/list_of.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include "manacommons/output_tree_node.h"
+#include "manacommons/color.h"
+
+namespace io
+{
+
+/**
+ *	@brief	Restricts the analysis and its output to a list of fields.
+ *
+ *	Fields are paths into the result schema whose components are separated by slashes,
+ *	such as "Hashes/SHA256", "Summary/Compilation Date" or "Plugins/packer/level". A
+ *	component may be "*" to match every child of a node (i.e. the entropy of all the sections
+ *	is selected with "Sections", "*" and "Entropy"), and a path which stops early selects the
+ *	whole subtree.
+ *
+ *	The projection is planned once before any file is analyzed: it determines which dump
+ *	categories, digests and plugins are required to produce the requested fields, so that
+ *	the rest is never computed. Once a file has been analyzed, the projection is applied
+ *	to its output tree so that only the requested nodes are serialized.
+ */
+class FieldProjection
+{
+public:
+	/**
+	 *	@brief	Plans the analysis for the given fields.
+	 *
+	 *	@param	const std::vector<std::string>& fields The requested paths.
+	 *
+	 *	Use is_valid() to check whether all the fields could be understood.
+	 */
+	FieldProjection(const std::vector<std::string>& fields);
+
+	/**
+	 *	@brief	Whether all the requested fields refer to a known part of the output.
+	 */
+	bool is_valid() const { return _valid; }
+
+	/**
+	 *	@brief	Returns the dump categories (as accepted by the --dump option) needed
+	 *			by the requested fields.
+	 */
+	const std::vector<std::string>& get_categories() const { return _categories; }
+
+	/**
+	 *	@brief	Returns the plugins needed by the requested fields. If all the plugins are
+	 *			needed, the list contains "all".
+	 */
+	const std::vector<std::string>& get_plugins() const { return _plugins; }
+
+	/**
+	 *	@brief	Whether the "Hashes" node of the file is needed.
+	 */
+	bool needs_hashes() const { return _needs_hashes; }
+
+	/**
+	 *	@brief	Returns the names of the digests which are needed in the "Hashes" node.
+	 *			An empty set means that all of them are needed.
+	 */
+	const std::set<std::string>& get_digests() const { return _digests; }
+
+	/**
+	 *	@brief	Whether the hashes of individual sections or resources are needed.
+	 */
+	bool needs_entry_hashes() const { return _needs_entry_hashes; }
+
+	/**
+	 *	@brief	Removes every node which wasn't requested from the output of a file.
+	 *
+	 *	@param	pNode file_node The node containing all the information about a file
+	 *			(see OutputFormatter::get_file_node). It is modified in place.
+	 */
+	void apply(pNode file_node) const;
+
+private:
+	struct Field;
+	typedef boost::shared_ptr<Field> pField;
+	typedef std::map<std::string, pField> fields;
+
+	/**
+	 *	@brief	A node of the tree built from the requested paths.
+	 *
+	 *	A field without children selects the whole subtree of the matching output node.
+	 */
+	struct Field {
+		fields children;
+	};
+
+	/**
+	 *	@brief	Adds a path into the tree of requested fields.
+	 *
+	 *	@return	Whether the path was well-formed.
+	 */
+	bool _add_path(const std::string& path);
+
+	/**
+	 *	@brief	Determines the categories, digests and plugins required by the requested fields.
+	 *
+	 *	@return	Whether all the fields refer to a known part of the output.
+	 */
+	bool _plan();
+
+	/**
+	 *	@brief	Recursively removes the children of a node which don't match the requested fields.
+	 */
+	void _prune(pNode node, const Field& field) const;
+
+	Field						_root;
+	bool						_valid;
+	std::vector<std::string>	_categories;
+	std::vector<std::string>	_plugins;
+	std::set<std::string>		_digests;
+	bool						_needs_hashes;
+	bool						_needs_entry_hashes;
+};
+
+} // !namespace io
@@ -0,0 +1,142 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <string>
+#include <istream>
+
+#include <boost/cstdint.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+namespace mana
+{
+
+/**
+ *	@brief	Builds a set of known good hashes from a list.
+ *
+ *	The first field of each line is read as a MD5, SHA1 or SHA256 hash, which makes NSRL files
+ *	usable directly. The type of hash is determined by the first valid line: lines containing
+ *	hashes of another type, and lines without a hash (i.e. the CSV header), are ignored.
+ *
+ *	@param	std::istream& list The list of hashes.
+ *	@param	const std::string& output The file in which the set will be written.
+ *	@param	boost::uint64_t& count Receives the number of distinct hashes in the set.
+ *
+ *	@return	Whether the set could be written.
+ */
+bool build_known_good_set(std::istream& list, const std::string& output, boost::uint64_t& count);
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	A set of hashes of known good files (i.e. stock Windows binaries), which don't need
+ *			to be analyzed.
+ *
+ *	The set is a file containing sorted hashes, which is memory-mapped and searched with a binary
+ *	search. Unlike a Bloom filter, it never matches a file which isn't in the list.
+ *	The file is only mapped the first time a file is checked. Once it is, the set is only read
+ *	and may be shared between threads: lookups don't take any lock.
+ */
+class KnownGoodSet
+{
+public:
+	/**
+	 *	@param	const std::string& path The file containing the set (see build_known_good_set).
+	 */
+	KnownGoodSet(const std::string& path) : _path(path), _loaded(false), _digest_size(0), _count(0) {}
+
+	/**
+	 *	@brief	Hashes a file and checks whether it is in the set.
+	 *
+	 *	@param	const std::string& path The file to check.
+	 *	@param	std::string& digest Receives the hash of the file, if it could be computed.
+	 *
+	 *	@return	Whether the file is known good. False if the set could not be loaded.
+	 */
+	bool contains_file(const std::string& path, std::string& digest) const;
+
+	/**
+	 *	@brief	Checks whether a hash is in the set.
+	 *
+	 *	@param	const std::string& digest The hash to look for, in hexadecimal.
+	 */
+	bool contains(const std::string& digest) const;
+
+	/**
+	 *	@brief	Returns the name of the hashes contained in the set ("MD5", "SHA1" or "SHA256").
+	 *			Empty if the set could not be loaded.
+	 */
+	std::string get_digest_name() const;
+
+	/**
+	 *	@brief	Returns the number of hashes in the set.
+	 */
+	boost::uint64_t size() const
+	{
+		_load();
+		return _count;
+	}
+
+private:
+	/**
+	 *	@brief	Maps the set the first time it is called.
+	 *
+	 *	@return	Whether the set is loaded.
+	 */
+	bool _load() const;
+
+	/**
+	 *	@brief	Maps the set. Only called once, by _load, with _mutex held.
+	 */
+	void _map() const;
+
+	std::string										_path;
+	mutable boost::mutex							_mutex;			// Only taken until the set is loaded.
+	mutable boost::atomic<bool>						_loaded;
+	mutable boost::iostreams::mapped_file_source	_file;
+	mutable boost::uint32_t							_digest_size;	// 0 if the set could not be loaded.
+	mutable boost::uint64_t							_count;
+};
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Parses a file, unless it is known good. Known good files are hashed, but never parsed.
+ *
+ *	@param	const KnownGoodSet* known_good The set to look the file up in, or NULL to always parse it.
+ *	@param	const std::string& path The file to analyze.
+ *	@param	std::string& digest Receives the hash of the file (see KnownGoodSet::get_digest_name),
+ *			if it was computed.
+ *	@param	Parser parse Called with the path to parse the file (i.e. PE::create).
+ *
+ *	@return	The result of parse, or an empty pointer if the file is known good.
+ */
+template<class Parser>
+auto parse_unless_known_good(const KnownGoodSet* known_good,
+							 const std::string& path,
+							 std::string& digest,
+							 Parser parse) -> decltype(parse(path))
+{
+	if (known_good != nullptr && known_good->contains_file(path, digest)) {
+		return decltype(parse(path))();
+	}
+	return parse(path);
+}
+
+} // !namespace mana
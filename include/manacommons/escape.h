@@ -24,11 +24,97 @@ along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
 #include <boost/shared_ptr.hpp>
 #include <boost/make_shared.hpp>
 
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define ESCAPE_USE_SSE2
+#endif
+
 #include "manacommons/color.h"
 
 namespace io
 {
 
+// ----------------------------------------------------------------------------
+// Detection of the strings which need to be escaped
+// ----------------------------------------------------------------------------
+
+/*
+ *	Running a string through a Karma grammar is costly, and most of the strings Manalyze
+ *	prints don't contain a single character which needs to be escaped. The functions below
+ *	look for such characters (16 bytes at a time when SSE2 is available) so that the grammars
+ *	are only invoked when they would actually modify the input.
+ *	They must be kept in sync with the grammars defined in this file.
+ */
+
+/**
+ *	@brief	Checks whether a string contains characters modified by escaped_string_raw,
+ *			i.e. anything outside of the [0x20-0x7E] range.
+ */
+inline bool _needs_escaping_raw(const std::string& s)
+{
+	const char* data = s.data();
+	size_t size = s.size();
+	size_t i = 0;
+#ifdef ESCAPE_USE_SSE2
+	const __m128i space = _mm_set1_epi8(0x20);
+	const __m128i del = _mm_set1_epi8(0x7F);
+	for ( ; i + 16 <= size ; i += 16)
+	{
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		// Bytes above 0x7F are negative, so the signed comparison catches them too.
+		__m128i special = _mm_or_si128(_mm_cmplt_epi8(chunk, space), _mm_cmpeq_epi8(chunk, del));
+		if (_mm_movemask_epi8(special) != 0) {
+			return true;
+		}
+	}
+#endif
+	for ( ; i < size ; ++i)
+	{
+		unsigned char c = static_cast<unsigned char>(data[i]);
+		if (c < 0x20 || c > 0x7E) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Checks whether a string contains characters modified by escaped_string_json,
+ *			i.e. control characters between \a and \r, backslashes and double quotes.
+ */
+inline bool _needs_escaping_json(const std::string& s)
+{
+	const char* data = s.data();
+	size_t size = s.size();
+	size_t i = 0;
+#ifdef ESCAPE_USE_SSE2
+	// Shifts [\a-\r] to the bottom of the signed range, so that a single comparison detects them.
+	const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80 - '\a'));
+	const __m128i limit = _mm_set1_epi8(static_cast<char>(0x80 + '\r' - '\a' + 1));
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	for ( ; i + 16 <= size ; i += 16)
+	{
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		__m128i special = _mm_or_si128(_mm_cmplt_epi8(_mm_add_epi8(chunk, bias), limit),
+									   _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)));
+		if (_mm_movemask_epi8(special) != 0) {
+			return true;
+		}
+	}
+#endif
+	for ( ; i < size ; ++i)
+	{
+		char c = data[i];
+		if ((c >= '\a' && c <= '\r') || c == '"' || c == '\\') {
+			return true;
+		}
+	}
+	return false;
+}
+
 // ----------------------------------------------------------------------------
 // Grammars used to escape stings
 // ----------------------------------------------------------------------------
@@ -53,6 +139,10 @@ struct escaped_string_raw
 		esc_str = *(boost::spirit::karma::iso8859_1::print | "\\x" << karma::right_align(2, 0)[karma::hex]);
 	}
 
+	static bool needs_escaping(const std::string& s) {
+		return _needs_escaping_raw(s);
+	}
+
 	karma::rule<OutputIterator, std::string()> esc_str;
 	karma::symbols<char, char const*> esc_char;
 };
@@ -87,6 +177,10 @@ struct escaped_string_json
 		esc_str = *(esc_char | boost::spirit::karma::char_);
 	}
 
+	static bool needs_escaping(const std::string& s) {
+		return _needs_escaping_json(s);
+	}
+
 	karma::rule<OutputIterator, std::string()> esc_str;
 	karma::symbols<char, char const*> esc_char;
 };
@@ -115,6 +209,10 @@ pString _do_escape(const std::string& s)
 	BOOST_STATIC_ASSERT(boost::is_base_of<karma::grammar<sink_type, std::string()>, Grammar>::value);
 	typedef std::back_insert_iterator<std::string> sink_type;
 
+	if (!Grammar::needs_escaping(s)) {
+		return boost::make_shared<std::string>(s);
+	}
+
 	std::string generated;
 	sink_type sink(generated);
 
@@ -151,6 +249,43 @@ pString escape(const std::string& s)
 
 // ----------------------------------------------------------------------------
 
+/**
+ *	@brief	Escapes problematic characters from a shared string.
+ *
+ *	Contrary to the overload above, the input pointer itself is returned (without
+ *	any copy) when the string contains nothing to escape.
+ *
+ *	@param const pString& s The string to escape.
+ *
+ *	@returns The escaped string, or a null pointer if an error was encountered.
+ */
+template<typename T>
+pString escape(const pString& s)
+{
+	BOOST_STATIC_ASSERT(boost::is_base_of<OutputFormatter, T>::value);
+	if (s == nullptr || !T::escape_grammar::needs_escaping(*s)) {
+		return s;
+	}
+	return _do_escape<typename T::escape_grammar>(*s);
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Checks whether escape<T> would modify a string.
+ *
+ *	This is much cheaper than escaping it and lets callers use the original string
+ *	directly in the common case.
+ */
+template<typename T>
+bool needs_escaping(const std::string& s)
+{
+	BOOST_STATIC_ASSERT(boost::is_base_of<OutputFormatter, T>::value);
+	return T::escape_grammar::needs_escaping(s);
+}
+
+// ----------------------------------------------------------------------------
+
 /*
  *	@brief	Escapes problematic characters from a string.
  *
@@ -163,4 +298,13 @@ pString escape(const std::string& s)
  */
 DECLSPEC_MANACOMMONS pString escape(const std::string& s);
 
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Checks whether escape would modify a string.
+ */
+inline bool needs_escaping(const std::string& s) {
+	return _needs_escaping_raw(s);
+}
+
 }
@@ -0,0 +1,80 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <boost/cstdint.hpp>
+#include <boost/system/api_config.hpp>
+
+#if defined BOOST_WINDOWS_API && !defined DECLSPEC_MANACOMMONS
+	#ifdef MANALYZE_EXPORT
+		#define DECLSPEC_MANACOMMONS    __declspec(dllexport)
+	#else
+		#define DECLSPEC_MANACOMMONS    __declspec(dllimport)
+	#endif
+#elif !defined BOOST_WINDOWS_API && !defined DECLSPEC_MANACOMMONS
+	#define DECLSPEC_MANACOMMONS
+#endif
+
+/*
+ *	Conversions between bytes and their hexadecimal representation, used for the
+ *	hashes stored in the indexes and for the fields of certificates.
+ */
+
+namespace io
+{
+
+/**
+ *	@brief	Converts bytes to a lowercase hexadecimal string.
+ *
+ *	@param	const boost::uint8_t* bytes The bytes to convert.
+ *	@param	size_t size The number of bytes.
+ *
+ *	@return	A string of 2 * size hexadecimal digits.
+ */
+DECLSPEC_MANACOMMONS std::string to_hex(const boost::uint8_t* bytes, size_t size);
+
+/**
+ *	@brief	Reads the hexadecimal digits (in either case) at the beginning of a string.
+ *
+ *	Reading stops at the first character which isn't a hexadecimal digit, or once size bytes
+ *	have been written.
+ *
+ *	@param	const char* s The string to read.
+ *	@param	size_t length The length of the string.
+ *	@param	boost::uint8_t* out The destination buffer.
+ *	@param	size_t size The size of the destination buffer.
+ *
+ *	@return	The number of digits read. If it is odd, the last byte only contains the high nibble.
+ */
+DECLSPEC_MANACOMMONS size_t read_hex(const char* s, size_t length, boost::uint8_t* out, size_t size);
+
+/**
+ *	@brief	Converts a hexadecimal string into bytes.
+ *
+ *	@param	const std::string& hex The string to convert.
+ *	@param	boost::uint8_t* out The destination buffer.
+ *	@param	size_t size The size of the destination buffer.
+ *
+ *	@return	False if the string isn't exactly size bytes long or contains invalid characters.
+ */
+DECLSPEC_MANACOMMONS bool from_hex(const std::string& hex, boost::uint8_t* out, size_t size);
+
+} // !namespace io
@@ -0,0 +1,208 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+#include <boost/intrusive_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/system/api_config.hpp>
+
+#if defined BOOST_WINDOWS_API && !defined DECLSPEC_MANACOMMONS
+	#ifdef MANALYZE_EXPORT
+		#define DECLSPEC_MANACOMMONS    __declspec(dllexport)
+	#else
+		#define DECLSPEC_MANACOMMONS    __declspec(dllimport)
+	#endif
+#elif !defined BOOST_WINDOWS_API && !defined DECLSPEC_MANACOMMONS
+	#define DECLSPEC_MANACOMMONS
+#endif
+
+namespace io
+{
+
+/**
+ *	@brief	A monotonic memory pool for the output nodes of a single analysis.
+ *
+ *	Memory is obtained from large blocks with a simple pointer bump, and individual allocations
+ *	are never released: all the blocks are freed at once when the arena is destroyed. Objects
+ *	allocated through an ArenaAllocator keep a reference to their arena, so it is destroyed
+ *	when the last node of the analysis goes away (i.e. after the formatter has printed it).
+ *
+ *	Arenas are reference counted intrusively (see pArena), and the counter is not atomic: every
+ *	node copies its allocator several times while it is created, and locked operations on a
+ *	shared counter would cost more than the malloc calls the arena saves. As a consequence,
+ *	an arena and the nodes allocated in it must only be created and released by a single thread.
+ */
+class NodeArena : private boost::noncopyable
+{
+public:
+	static const size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+	/**
+	 *	@param	size_t block_size The size of the blocks requested from the system.
+	 */
+	DECLSPEC_MANACOMMONS NodeArena(size_t block_size = DEFAULT_BLOCK_SIZE);
+	DECLSPEC_MANACOMMONS ~NodeArena();
+
+	/**
+	 *	@brief	Returns a chunk of memory from the arena.
+	 *
+	 *	@param	size_t size The number of bytes requested.
+	 *	@param	size_t alignment The alignment required by the object which will be stored.
+	 *
+	 *	@return	A pointer to the allocated memory. std::bad_alloc is thrown if the system is out
+	 *			of memory, as any allocator would.
+	 */
+	DECLSPEC_MANACOMMONS void* allocate(size_t size, size_t alignment);
+
+	/**
+	 *	@brief	Returns the number of bytes obtained from the system so far.
+	 */
+	DECLSPEC_MANACOMMONS size_t get_reserved_size() const;
+
+	/**
+	 *	@brief	Returns the arena into which nodes created by the current thread should be
+	 *			allocated, or NULL if they should go to the heap.
+	 */
+	DECLSPEC_MANACOMMONS static NodeArena* get_current();
+
+	friend void intrusive_ptr_add_ref(NodeArena* arena) {
+		++arena->_references;
+	}
+
+	friend void intrusive_ptr_release(NodeArena* arena)
+	{
+		if (--arena->_references == 0) {
+			delete arena;
+		}
+	}
+
+	/**
+	 *	@brief	Makes an arena the current one for the lifetime of the object.
+	 *
+	 *	The previous arena (if any) is restored when the Scope is destroyed.
+	 */
+	class Scope : private boost::noncopyable
+	{
+	public:
+		DECLSPEC_MANACOMMONS Scope(boost::intrusive_ptr<NodeArena> arena);
+		DECLSPEC_MANACOMMONS ~Scope();
+
+	private:
+		boost::intrusive_ptr<NodeArena> _arena;
+		NodeArena* _previous;
+	};
+
+private:
+	std::vector<char*>	_blocks;
+	std::vector<size_t>	_block_sizes;
+	char*				_cursor;
+	size_t				_remaining;
+	size_t				_block_size;
+	size_t				_reserved;
+	size_t				_references;
+};
+
+typedef boost::intrusive_ptr<NodeArena> pArena;
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Standard allocator which takes its memory from a NodeArena.
+ *
+ *	Copies of the allocator share ownership of the arena. This is what lets boost::allocate_shared
+ *	keep the arena alive for as long as one of the objects it contains exists.
+ *	An allocator created without an arena uses the heap, so that containers of the same type can
+ *	be used whether an arena is active or not.
+ */
+template<class T>
+class ArenaAllocator
+{
+public:
+	typedef T					value_type;
+	typedef T*					pointer;
+	typedef const T*			const_pointer;
+	typedef T&					reference;
+	typedef const T&			const_reference;
+	typedef std::size_t			size_type;
+	typedef std::ptrdiff_t		difference_type;
+
+	template<class U>
+	struct rebind {
+		typedef ArenaAllocator<U> other;
+	};
+
+	ArenaAllocator(NodeArena* arena) : _arena(arena) {}
+
+	template<class U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : _arena(other.get_arena()) {}
+
+	pointer allocate(size_type n, const void* hint = 0)
+	{
+		if (!_arena) {
+			return static_cast<pointer>(::operator new(n * sizeof(T)));
+		}
+		return static_cast<pointer>(_arena->allocate(n * sizeof(T), boost::alignment_of<T>::value));
+	}
+
+	void deallocate(pointer p, size_type n)
+	{
+		if (!_arena) { // Otherwise, the memory is reclaimed when the arena is destroyed.
+			::operator delete(p);
+		}
+	}
+
+	size_type max_size() const {
+		return static_cast<size_type>(-1) / sizeof(T);
+	}
+
+	pointer address(reference r) const { return &r; }
+	const_pointer address(const_reference r) const { return &r; }
+
+	void construct(pointer p, const T& value) {
+		new (static_cast<void*>(p)) T(value);
+	}
+
+	template<class U, class... Args>
+	void construct(U* p, Args&&... args) {
+		new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+	}
+
+	template<class U>
+	void destroy(U* p) {
+		p->~U();
+	}
+
+	NodeArena* get_arena() const { return _arena.get(); }
+
+	template<class U>
+	bool operator==(const ArenaAllocator<U>& other) const { return _arena == other.get_arena(); }
+
+	template<class U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return _arena != other.get_arena(); }
+
+private:
+	pArena _arena;
+};
+
+} // !namespace io
@@ -0,0 +1,76 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <boost/cstdint.hpp>
+#include <boost/system/api_config.hpp>
+
+#if defined BOOST_WINDOWS_API && !defined DECLSPEC_MANACOMMONS
+	#ifdef MANALYZE_EXPORT
+		#define DECLSPEC_MANACOMMONS    __declspec(dllexport)
+	#else
+		#define DECLSPEC_MANACOMMONS    __declspec(dllimport)
+	#endif
+#elif !defined BOOST_WINDOWS_API && !defined DECLSPEC_MANACOMMONS
+	#define DECLSPEC_MANACOMMONS
+#endif
+
+/*
+ *	Formatting routines used on the output paths instead of std::stringstream.
+ *	They write into a buffer provided by the caller (which must be at least
+ *	NUMBER_BUFFER_SIZE bytes long), don't allocate memory and don't depend on a
+ *	locale. Their output is identical to the one of a default std::ostream.
+ */
+
+namespace io
+{
+
+const size_t NUMBER_BUFFER_SIZE = 32;
+
+/**
+ *	@brief	Writes the decimal representation of an integer.
+ *
+ *	@param	boost::uint64_t value The number to write.
+ *	@param	char* buffer The destination buffer. No null terminator is added.
+ *
+ *	@return	The number of characters written.
+ */
+DECLSPEC_MANACOMMONS size_t format_decimal(boost::uint64_t value, char* buffer);
+
+/**
+ *	@brief	Writes the lowercase hexadecimal representation of an integer, without the "0x" prefix.
+ *
+ *	@param	boost::uint64_t value The number to write.
+ *	@param	char* buffer The destination buffer. No null terminator is added.
+ *
+ *	@return	The number of characters written.
+ */
+DECLSPEC_MANACOMMONS size_t format_hexadecimal(boost::uint64_t value, char* buffer);
+
+/**
+ *	@brief	Writes a floating point number the way std::ostream does by default (i.e. "%g").
+ *
+ *	@param	double value The number to write.
+ *	@param	char* buffer The destination buffer. No null terminator is added.
+ *
+ *	@return	The number of characters written.
+ */
+DECLSPEC_MANACOMMONS size_t format_floating_point(double value, char* buffer);
+
+} // !namespace io
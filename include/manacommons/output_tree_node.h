@@ -24,8 +24,10 @@ along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
 #include <boost/make_shared.hpp>
 #include <boost/cstdint.hpp>
 #include <boost/optional.hpp>
+#include <boost/variant.hpp>
 
 #include "color.h"
+#include "node_arena.h"
 #include "plugin_framework/threat_level.h"
 
 #if defined BOOST_WINDOWS_API && !defined DECLSPEC_MANACOMMONS
@@ -55,15 +57,6 @@ public:
 	typedef boost::shared_ptr<OutputTreeNode> pNode;
 	typedef std::vector<pNode> nodes;
 	typedef boost::shared_ptr<nodes> pNodes;
-	typedef boost::shared_ptr<boost::optional<boost::uint32_t> > shared_opt_uint32;
-	typedef boost::shared_ptr<boost::optional<boost::uint16_t> > shared_opt_uint16;
-	typedef boost::shared_ptr<boost::optional<boost::uint64_t> > shared_opt_uint64;
-	typedef boost::shared_ptr<boost::optional<float> > shared_opt_float;
-	typedef boost::shared_ptr<boost::optional<double> > shared_opt_double;
-	typedef boost::shared_ptr<boost::optional<std::string> > shared_opt_string;
-	typedef boost::shared_ptr<boost::optional<nodes> > shared_opt_nodes;
-	typedef boost::shared_ptr<boost::optional<strings> > shared_opt_strings;
-	typedef boost::shared_ptr<boost::optional<plugin::LEVEL> > shared_opt_level;
 
 	enum node_type { LIST, UINT32, UINT16, UINT64, FLOAT, DOUBLE, STRING, STRINGS, THREAT_LEVEL };
 
@@ -84,45 +77,43 @@ public:
 	// ----------------------------------------------------------------------------
 
 	DECLSPEC_MANACOMMONS OutputTreeNode(const std::string& name, boost::uint32_t i, display_modifier mod = DEC)
-		: _name(new std::string(name)), _type(UINT32), _uint32_data(new boost::optional<boost::uint32_t>(i)), _modifier(mod)
+		: _name(_make_name(name)), _type(UINT32), _modifier(mod), _data(static_cast<boost::uint64_t>(i))
 	{}
 
 	DECLSPEC_MANACOMMONS OutputTreeNode(const std::string& name, boost::uint16_t s, display_modifier mod = DEC)
-		: _name(new std::string(name)), _type(UINT16), _uint16_data(new boost::optional<boost::uint16_t>(s)), _modifier(mod)
+		: _name(_make_name(name)), _type(UINT16), _modifier(mod), _data(static_cast<boost::uint64_t>(s))
 	{}
 
 	DECLSPEC_MANACOMMONS OutputTreeNode(const std::string& name, boost::uint64_t l, display_modifier mod = DEC)
-		: _name(new std::string(name)), _type(UINT64), _uint64_data(new boost::optional<boost::uint64_t>(l)), _modifier(mod)
+		: _name(_make_name(name)), _type(UINT64), _modifier(mod), _data(l)
 	{}
 
 	DECLSPEC_MANACOMMONS OutputTreeNode(const std::string& name, float f, display_modifier mod = NONE)
-		: _name(new std::string(name)), _type(FLOAT), _float_data(new boost::optional<float>(f)), _modifier(mod)
+		: _name(_make_name(name)), _type(FLOAT), _modifier(mod), _data(static_cast<double>(f))
 	{}
 
 	DECLSPEC_MANACOMMONS OutputTreeNode(const std::string& name, double d, display_modifier mod = NONE)
-		: _name(new std::string(name)), _type(DOUBLE), _double_data(new boost::optional<double>(d)), _modifier(mod)
+		: _name(_make_name(name)), _type(DOUBLE), _modifier(mod), _data(d)
 	{}
 
 	DECLSPEC_MANACOMMONS OutputTreeNode(const std::string& name, const std::string& s, display_modifier mod = NONE)
-		: _name(new std::string(name)), _type(STRING), _string_data(new boost::optional<std::string>(s)), _modifier(mod)
+		: _name(_make_name(name)), _type(STRING), _modifier(mod), _data(arena_string(s.begin(), s.end(), _allocator()))
 	{}
 
 	DECLSPEC_MANACOMMONS OutputTreeNode(const std::string& name, const nodes& n, display_modifier mod = NONE)
-		: _name(new std::string(name)), _type(LIST), _list_data(new boost::optional<nodes>(n)), _modifier(mod)
+		: _name(_make_name(name)), _type(LIST), _modifier(mod), _data(arena_nodes(n.begin(), n.end(), _allocator()))
 	{}
 
 	DECLSPEC_MANACOMMONS OutputTreeNode(const std::string& name, const strings& strs, display_modifier mod = NONE)
-		: _name(new std::string(name)), _type(STRINGS), _strings_data(new boost::optional<strings>(strs)), _modifier(mod)
+		: _name(_make_name(name)), _type(STRINGS), _modifier(mod), _data(_make_strings(strs.begin(), strs.end()))
 	{}
 
 	DECLSPEC_MANACOMMONS OutputTreeNode(const std::string& name, const string_set& strs, display_modifier mod = AFTER_NAME)
-		: _name(new std::string(name)), _type(STRINGS), _modifier(mod)
-	{
-		_strings_data = boost::make_shared<boost::optional<strings> >(strings(strs.begin(), strs.end()));
-	}
+		: _name(_make_name(name)), _type(STRINGS), _modifier(mod), _data(_make_strings(strs.begin(), strs.end()))
+	{}
 
 	DECLSPEC_MANACOMMONS OutputTreeNode(const std::string& name, plugin::LEVEL level, display_modifier mod = NONE)
-		: _name(new std::string(name)), _type(THREAT_LEVEL), _level_data(new boost::optional<plugin::LEVEL>(level)), _modifier(mod)
+		: _name(_make_name(name)), _type(THREAT_LEVEL), _modifier(mod), _data(static_cast<boost::uint64_t>(level))
 	{}
 
 	// ----------------------------------------------------------------------------
@@ -174,10 +165,38 @@ public:
 
 	// ----------------------------------------------------------------------------
 
+	/**
+	*	@brief	Writes the string representation of the data contained by the node into a stream.
+	*
+	*	The output is the same as to_string()'s, but numbers are formatted directly into the stream
+	*	without allocating any memory.
+	*
+	*	@param	std::ostream& sink The stream to write to.
+	*/
+	DECLSPEC_MANACOMMONS void write_value(std::ostream& sink) const;
+
+	// ----------------------------------------------------------------------------
+
 	DECLSPEC_MANACOMMONS plugin::LEVEL get_level() const;
 
 	// ----------------------------------------------------------------------------
 
+	/**
+	*	@brief	Returns the data contained by a UINT16, UINT32 or UINT64 node.
+	*
+	*	This allows formatters to handle the number natively instead of parsing to_string()'s output.
+	*/
+	DECLSPEC_MANACOMMONS boost::uint64_t get_integer() const;
+
+	// ----------------------------------------------------------------------------
+
+	/**
+	*	@brief	Returns the data contained by a FLOAT or DOUBLE node.
+	*/
+	DECLSPEC_MANACOMMONS double get_floating_point() const;
+
+	// ----------------------------------------------------------------------------
+
 	DECLSPEC_MANACOMMONS shared_strings get_strings() const;
 
 	// ----------------------------------------------------------------------------
@@ -258,21 +277,57 @@ public:
 	DECLSPEC_MANACOMMONS pNode find_node(const std::string& name) const;
 
 private:
+	/**
+	*	@brief	Creates the shared string holding the name of a node.
+	*
+	*	The string is placed in the current NodeArena, if there is one.
+	*/
+	DECLSPEC_MANACOMMONS static pString _make_name(const std::string& name);
+
+	// The containers of the payload take their memory from the NodeArena which was active when
+	// the node was created (or from the heap if there was none), like the node itself.
+	typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char> > arena_string;
+	typedef std::vector<pNode, ArenaAllocator<pNode> > arena_nodes;
+	typedef std::vector<arena_string, ArenaAllocator<arena_string> > arena_strings;
+
+	/**
+	*	@brief	Returns an allocator for the payload of a new node (see NodeArena::get_current).
+	*/
+	static ArenaAllocator<char> _allocator() {
+		return ArenaAllocator<char>(NodeArena::get_current());
+	}
+
+	/**
+	*	@brief	Copies strings into a container allocated like the node's payload.
+	*/
+	template<class Iterator>
+	static arena_strings _make_strings(Iterator begin, Iterator end)
+	{
+		ArenaAllocator<char> allocator = _allocator();
+		arena_strings res(allocator);
+		for ( ; begin != end ; ++begin) {
+			res.push_back(arena_string(begin->begin(), begin->end(), allocator));
+		}
+		return res;
+	}
+
+	/**
+	*	@brief	Writes the string representation of a node which doesn't contain a STRING.
+	*
+	*	@param	char* buffer The destination buffer, at least NUMBER_BUFFER_SIZE + 2 bytes long.
+	*
+	*	@return	The number of characters written.
+	*/
+	DECLSPEC_MANACOMMONS size_t _format_number(char* buffer) const;
+
 	pString _name;
 	enum node_type _type;
-
-	shared_opt_uint32	_uint32_data;
-	shared_opt_uint16	_uint16_data;
-	shared_opt_uint64	_uint64_data;
-	shared_opt_float	_float_data;
-	shared_opt_double	_double_data;
-	shared_opt_string	_string_data;
-	shared_opt_nodes	_list_data;
-	shared_opt_strings	_strings_data;
-	shared_opt_level	_level_data;
 	display_modifier	_modifier;		// Additional info hinting at how the data should be displayed,
 										// i.e. hexadecimal or decimal for integers.
 
+	// The payload of the node. Its type is determined by _type: all integer types and threat levels
+	// are stored as uint64, FLOAT and DOUBLE as double.
+	boost::variant<boost::uint64_t, double, arena_string, arena_nodes, arena_strings> _data;
 };
 
 typedef boost::shared_ptr<OutputTreeNode> pNode;
@@ -290,4 +345,21 @@ typedef boost::shared_ptr<nodes> pNodes;
 */
 DECLSPEC_MANACOMMONS unsigned int determine_max_width(pNode node);
 
+/**
+*	@brief	Creates a new node, forwarding the arguments to one of OutputTreeNode's constructors.
+*
+*	If a NodeArena is active in the current thread (see NodeArena::Scope), the node is allocated
+*	inside it. Otherwise, this is equivalent to boost::make_shared<OutputTreeNode>.
+*/
+template<class... Args>
+pNode make_node(Args&&... args)
+{
+	NodeArena* arena = NodeArena::get_current();
+	if (arena == nullptr) {
+		return boost::make_shared<OutputTreeNode>(std::forward<Args>(args)...);
+	}
+	return boost::allocate_shared<OutputTreeNode>(ArenaAllocator<OutputTreeNode>(arena),
+												  std::forward<Args>(args)...);
+}
+
 } // !namespace io
@@ -29,6 +29,10 @@
 # include <boost/shared_ptr.hpp>
 # include <boost/make_shared.hpp>
 
+# if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define ESCAPE_USE_SSE2
+# endif
 
 // Escape functions copied from manacommons/escape.h / manacommons/escape.cpp
 // I know that's code duplication / generally not great design. The issue is that
@@ -41,6 +45,38 @@ namespace karma = boost::spirit::karma;
 typedef std::back_insert_iterator<std::string> sink_type;
 typedef boost::shared_ptr<std::string> pString;
 
+/**
+*	@brief	Checks whether a string contains characters modified by escaped_string_raw,
+*			i.e. anything outside of the [0x20-0x7E] range.
+*/
+inline bool _needs_escaping_raw(const std::string& s)
+{
+    const char* data = s.data();
+    size_t size = s.size();
+    size_t i = 0;
+#ifdef ESCAPE_USE_SSE2
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i del = _mm_set1_epi8(0x7F);
+    for ( ; i + 16 <= size ; i += 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        // Bytes above 0x7F are negative, so the signed comparison catches them too.
+        __m128i special = _mm_or_si128(_mm_cmplt_epi8(chunk, space), _mm_cmpeq_epi8(chunk, del));
+        if (_mm_movemask_epi8(special) != 0) {
+            return true;
+        }
+    }
+#endif
+    for ( ; i < size ; ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c < 0x20 || c > 0x7E) {
+            return true;
+        }
+    }
+    return false;
+}
+
 /**
 *	@brief	This grammar is used to escape strings printed to the console.
 *
@@ -57,6 +93,10 @@ struct escaped_string_raw
         esc_str = *(boost::spirit::karma::iso8859_1::print | "\\x" << karma::right_align(2, 0)[karma::hex]);
     }
 
+    static bool needs_escaping(const std::string& s) {
+        return _needs_escaping_raw(s);
+    }
+
     karma::rule<OutputIterator, std::string()> esc_str;
     karma::symbols<char, char const*> esc_char;
 };
@@ -75,6 +115,10 @@ pString _do_escape(const std::string& s)
     BOOST_STATIC_ASSERT(boost::is_base_of<karma::grammar<sink_type, std::string()>, Grammar>::value);
     typedef std::back_insert_iterator<std::string> sink_type;
 
+    if (!Grammar::needs_escaping(s)) {
+        return boost::make_shared<std::string>(s);
+    }
+
     std::string generated;
     sink_type sink(generated);
 
@@ -95,6 +139,12 @@ inline pString escape(const std::string& s) {
     return _do_escape<escaped_string_raw<sink_type> >(s);
 }
 
+// ----------------------------------------------------------------------------
+
+inline bool needs_escaping(const std::string& s) {
+    return _needs_escaping_raw(s);
+}
+
 } // !namespace io
 
 #endif
@@ -21,6 +21,7 @@
 #include <string.h>
 #include <iostream>
 #include <sstream>
+#include <iomanip>
 #include <algorithm>
 #include <string>
 #include <vector>
@@ -77,9 +78,38 @@ class PE
 {
 
 public:
-	DECLSPEC PE(const std::string& path);
+	/**
+	 *	@brief	The parts of a PE which are only parsed if they are needed.
+	 *
+	 *	The headers and the section table are always parsed, because they are required to
+	 *	locate everything else. The components which were not parsed appear to be empty.
+	 *	COMPONENT_IMPORTS covers the delay-loaded imports as well, since they are part of the
+	 *	same list.
+	 */
+	enum PE_COMPONENT {
+		COMPONENT_COFF_SYMBOLS	= 1 << 0,
+		COMPONENT_IMPORTS		= 1 << 1,
+		COMPONENT_EXPORTS		= 1 << 2,
+		COMPONENT_RESOURCES		= 1 << 3,
+		COMPONENT_DEBUG			= 1 << 4,
+		COMPONENT_RELOCATIONS	= 1 << 5,
+		COMPONENT_TLS			= 1 << 6,
+		COMPONENT_CONFIG		= 1 << 7,
+		COMPONENT_CERTIFICATES	= 1 << 8,
+		HEADERS_ONLY			= 0,
+		ALL_COMPONENTS			= (1 << 9) - 1
+	};
+
+	/**
+	 *	@brief	Parses a PE file.
+	 *
+	 *	@param	const std::string& path The path of the file.
+	 *	@param	unsigned int components The components to parse (a combination of PE_COMPONENT
+	 *			values). Everything is parsed by default.
+	 */
+	DECLSPEC PE(const std::string& path, unsigned int components = ALL_COMPONENTS);
 	DECLSPEC virtual ~PE() {}
-	DECLSPEC static boost::shared_ptr<PE> create(const std::string& path);
+	DECLSPEC static boost::shared_ptr<PE> create(const std::string& path, unsigned int components = ALL_COMPONENTS);
 
 	DECLSPEC boost::uint64_t get_filesize() const;
 
@@ -239,6 +269,15 @@ public:
 		return _initialized;
 	}
 
+	/**
+	 *	@brief	Returns the components which were requested when the PE was parsed.
+	 *
+	 *	@return	A combination of PE_COMPONENT values.
+	 */
+	DECLSPEC unsigned int get_parsed_components() const {
+		return _components;
+	}
+
 	/**
 	 *	@brief	The delete operator. "new" had to be re-implemented in order to make it private.
 	 *
@@ -288,7 +327,8 @@ private:
 	bool _parse_section_table();
 
 	/**
-	 *	@brief	Courtesy function used to parse all the PE directories (imports, exports, resources, ...).
+	 *	@brief	Courtesy function used to parse the PE directories (imports, exports, resources, ...)
+	 *			requested in _components.
 	 *	/!\ This relies on the information gathered in _parse_image_optional_header.
 	 */
 	bool _parse_directories();
@@ -430,6 +470,7 @@ private:
 
 	std::string							_path;
     bool								_initialized;
+	unsigned int						_components;	// The PE_COMPONENTs to parse.
 	boost::uint64_t						_file_size;
 	pFile								_file_handle;
 
@@ -336,6 +336,7 @@ typedef struct debug_directory_entry_t
 	boost::uint32_t	AddressOfRawData;
 	boost::uint32_t	PointerToRawData;
 	std::string		Filename; // Non-standard!
+	std::string		PdbGuid;  // Non-standard! Only set for RSDS CodeView entries.
 } debug_directory_entry;
 typedef boost::shared_ptr<debug_directory_entry> pdebug_directory_entry;
 
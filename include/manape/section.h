@@ -21,6 +21,8 @@
 #include <boost/make_shared.hpp>
 #include <boost/cstdint.hpp>
 #include <boost/system/api_config.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
 #include <vector>
 
 #include "manape/pe_structs.h"
@@ -20,21 +20,26 @@ along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
 #include <sstream>
 #include <ostream>
 #include <vector>
+#include <deque>
 #include <tuple>
 #include <string>
 #include <set>
 #include <algorithm>
+#include <cstring>
 
 #include <boost/optional.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
 #include <boost/cstdint.hpp>
 #include <boost/date_time.hpp>
 #include <boost/algorithm/string/trim.hpp>
 
 #include "manacommons/output_tree_node.h"
 #include "manacommons/escape.h" // String escaping functions
+#include "manacommons/number_format.h"
 #include "manacommons/color.h"
 #include "plugin_framework/result.h" // Necessary to hold a threat level in a node.
+#include "cbor.h"
 
 namespace io
 {
@@ -85,7 +90,7 @@ public:
 	 */
 	void add_data(pNode n, const std::string& file_path)
 	{
-		pNode file_node = _root->find_node(file_path);
+		pNode& file_node = _file_nodes[file_path];
 		if (file_node)
 		{
 			if (file_node->find_node(*n->get_name())) {
@@ -95,9 +100,9 @@ public:
 		}
 		else
 		{
-			pNode new_file_node(new OutputTreeNode(file_path, OutputTreeNode::LIST));
-			new_file_node->append(n);
-			_root->append(new_file_node);
+			file_node = make_node(file_path, OutputTreeNode::LIST);
+			file_node->append(n);
+			_root->append(file_node);
 		}
 	}
 
@@ -116,7 +121,7 @@ public:
 	*/
 	pNode find_node(const std::string& name, const std::string file_path)
 	{
-		pNode file_node = _root->find_node(file_path);
+		pNode file_node = get_file_node(file_path);
 		if (!file_node) {
 			return pNode();
 		}
@@ -125,6 +130,25 @@ public:
 
 	// ----------------------------------------------------------------------------
 
+	/**
+	*	@brief	Returns the node containing all the data added for a particular file.
+	*
+	*	@param	const std::string& file_path The file whose analysis should be returned.
+	*
+	*	@return	The corresponding node, or a NULL pointer if no data was added for this file
+	*			since the last time the formatter was flushed.
+	*/
+	pNode get_file_node(const std::string& file_path) const
+	{
+		auto it = _file_nodes.find(file_path);
+		if (it == _file_nodes.end()) {
+			return pNode();
+		}
+		return it->second;
+	}
+
+	// ----------------------------------------------------------------------------
+
 	/**
 	 *	@brief	Dumps the formatted data into target output stream.
 	 *
@@ -138,9 +162,23 @@ public:
 	virtual void format(std::ostream& sink, bool end_stream = true) = 0;
 
 protected:
+	/**
+	 *	@brief	Frees all the nodes that were already printed. Keeps the RAM in check for recursive analyses.
+	 */
+	void _clear_data()
+	{
+		_root->clear();
+		_file_nodes.clear();
+	}
+
 	std::string _header;
 	std::string _footer;
 	boost::shared_ptr<OutputTreeNode> _root; // The analysis data is contained in this field
+
+private:
+	// Index of the children of _root, so that data can be added to a file's node without going
+	// through all the files analyzed since the last flush.
+	boost::unordered_map<std::string, pNode> _file_nodes;
 };
 
 // ----------------------------------------------------------------------------
@@ -152,6 +190,8 @@ class RawFormatter : public OutputFormatter
 {
 
 public:
+	RawFormatter() : _header_printed(false) {}
+
 	virtual void format(std::ostream& sink, bool end_stream = true);
 	typedef escaped_string_raw<sink_type> escape_grammar;
 
@@ -189,32 +229,120 @@ private:
 	*/
 	void _dump_strings_node(std::ostream& sink, pNode node, int max_width = 0, int level = 0);
 
+	bool _header_printed; // Whether the header was written since the beginning of the document.
 };
 
 // ----------------------------------------------------------------------------
 
 /**
 *	@brief	Formatter that prints the analysis result in JSON.
+*
+*	The output is streamed: every call to format() serializes the files analyzed so far and
+*	releases them, while the formatter keeps track of what was already written so that the
+*	concatenation of all the calls remains a single valid JSON document.
 */
 class JsonFormatter : public OutputFormatter
 {
 public:
+	JsonFormatter() : _header_printed(false), _files_written(0), _pretty_print(true) {}
+
 	virtual void format(std::ostream& sink, bool end_stream = true);
 	typedef escaped_string_json<sink_type> escape_grammar;
 
-private:
+protected:
+	/**
+	 *	@brief	Constructor for subclasses which need to control the layout of the output.
+	 *
+	 *	@param	bool pretty_print Whether nodes should be indented and separated by line breaks.
+	 */
+	JsonFormatter(bool pretty_print) : _header_printed(false), _files_written(0), _pretty_print(pretty_print) {}
+
 	/**
 	 *	@brief	Function which dumps the contents of a single node into JSON notation.
 	 *
+	 *	The trailing separator (comma and / or line break) is left to the caller, as only the
+	 *	caller knows whether other elements will follow.
+	 *
 	 *	@param	std::ostream& sink The target output stream.
 	 *	@param	pNode node The node to dump.
 	 *	@param	int level The indentation level.
-	 *	@param	bool append_comma Whether a comma should be appended at the end of the node contents
-				(useful when dumping lists).
 	 *	@param	bool print_name Whether the name of the node should be displayed (useful when printing
 	 *			inside JSON lists).
 	 */
-	void _dump_node(std::ostream& sink, pNode node, int level = 1, bool append_comma = false, bool print_name = true);
+	void _dump_node(std::ostream& sink, pNode node, int level = 1, bool print_name = true);
+
+	/**
+	 *	@brief	Returns the indentation corresponding to a given level (empty if pretty printing is disabled).
+	 *
+	 *	Indentation strings are built once per level and cached, as they are needed for every line.
+	 */
+	const std::string& _indent(int level) const;
+
+	/**
+	 *	@brief	Writes a line break into the sink, unless pretty printing is disabled.
+	 */
+	void _end_line(std::ostream& sink) const;
+
+private:
+	bool			_header_printed;	// Whether the opening brace of the document was written.
+	unsigned int	_files_written;		// Number of file entries already written to the sink.
+	bool			_pretty_print;
+	mutable std::deque<std::string> _indentation; // Indentation strings, indexed by level.
+};
+
+// ----------------------------------------------------------------------------
+
+/**
+*	@brief	Formatter that prints the analysis result as JSON Lines (a.k.a. NDJSON).
+*
+*	Each analyzed file is written as a self-contained JSON object on its own line. Lines are
+*	built in memory and passed to the sink in one call, then flushed, so that the output can be
+*	fed directly into log pipelines.
+*
+*	With --output-file, the sink is an AppendFile: every line reaches the file in a single write()
+*	in append mode, so parallel or resumed runs can append to the same file safely. std::cout
+*	goes through the stdio buffer instead, and splits lines larger than it (usually 4 KiB when
+*	stdout is a pipe or a file).
+*/
+class JsonLinesFormatter : public JsonFormatter
+{
+public:
+	JsonLinesFormatter() : JsonFormatter(false) {}
+
+	virtual void format(std::ostream& sink, bool end_stream = true);
+};
+
+// ----------------------------------------------------------------------------
+
+/**
+*	@brief	Formatter that prints the analysis result as binary CBOR records.
+*
+*	Each analyzed file is written as a length-prefixed record (see cbor::write_record) containing
+*	a map with a single entry, whose key is the path of the file. Numbers are stored natively and
+*	strings repeated inside a record can be replaced by references to their first occurrence.
+*	Records can be converted back to JSON with the cbor2json tool.
+*/
+class CborFormatter : public OutputFormatter
+{
+public:
+	/**
+	 *	@param	bool deduplicate_strings Whether repeated strings (mostly keys) should be
+	 *			replaced by references.
+	 */
+	CborFormatter(bool deduplicate_strings = true) : _deduplicate_strings(deduplicate_strings) {}
+
+	virtual void format(std::ostream& sink, bool end_stream = true);
+
+private:
+	/**
+	 *	@brief	Encodes the contents of a node (but not its name).
+	 *
+	 *	@param	cbor::Writer& writer The object into which the node should be encoded.
+	 *	@param	pNode node The node to encode.
+	 */
+	void _dump_node(cbor::Writer& writer, pNode node);
+
+	bool _deduplicate_strings;
 };
 
 // ----------------------------------------------------------------------------
@@ -0,0 +1,269 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <ostream>
+#include <streambuf>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "manacommons/color.h"
+
+namespace bfs = boost::filesystem;
+
+namespace io
+{
+
+class ChunkWriter; // Defined in output_sink.cpp
+
+/**
+ *	@brief	Writes the output of the program into files instead of stdout, optionally
+ *			compressing it and splitting it into several chunks.
+ *
+ *	Formatters write into get_stream() as they would into std::cout. The data is handed
+ *	over to a background thread in large blocks, and that thread takes care of the
+ *	compression and the disk I/O while the analysis continues.
+ *
+ *	When rotation is enabled, the output is split into numbered files: "out/results.json.gz"
+ *	becomes "out/results.000000.json.gz", "out/results.000001.json.gz", etc.
+ *	Files are written with a ".part" suffix which is removed once they are complete, so
+ *	that other programs can safely pick up finished chunks while the scan is still running.
+ */
+class OutputSink : private boost::noncopyable
+{
+public:
+	enum compression_type { NONE, GZIP, ZSTD };
+
+	/**
+	 *	@brief	Opens the first output file and starts the writer thread.
+	 *
+	 *	@param	const std::string& path The path of the output file.
+	 *	@param	compression_type compression The compression to apply to the output.
+	 *	@param	unsigned int rotate_samples Start a new file after this many samples (0 to disable).
+	 *	@param	boost::uint64_t rotate_bytes Start a new file once this many bytes (before
+	 *			compression) have been written into the current one (0 to disable).
+	 */
+	OutputSink(const std::string& path,
+			   compression_type compression = NONE,
+			   unsigned int rotate_samples = 0,
+			   boost::uint64_t rotate_bytes = 0);
+
+	~OutputSink();
+
+	/**
+	 *	@brief	Whether the output file could be created.
+	 */
+	bool is_open() const;
+
+	/**
+	 *	@brief	Returns the stream formatters should write to.
+	 */
+	std::ostream& get_stream() {
+		return _stream;
+	}
+
+	/**
+	 *	@brief	Signals that the output of a sample has been written into the stream.
+	 *
+	 *	The data is only handed over to the writer thread once a block is full, when the
+	 *	file is rotated or when the sink is closed: flushing the stream doesn't do it.
+	 *
+	 *	@return	Whether the current file is full, in which case the caller should end the
+	 *			document it is writing and call rotate().
+	 */
+	bool end_sample();
+
+	/**
+	 *	@brief	Completes the current file and starts writing into the next one.
+	 */
+	void rotate();
+
+	/**
+	 *	@brief	Writes all the pending data, completes the current file and stops the writer thread.
+	 *
+	 *	This function is called by the destructor if needed.
+	 */
+	void close();
+
+	/**
+	 *	@brief	Whether a compression algorithm is available in this build.
+	 */
+	static bool is_supported(compression_type compression);
+
+private:
+	/**
+	 *	@brief	Stream buffer which accumulates the output and passes it to the OutputSink
+	 *			in large blocks.
+	 */
+	class Buffer : public std::streambuf
+	{
+	public:
+		Buffer(OutputSink& owner);
+
+		/**
+		 *	@brief	Returns the number of bytes written into the buffer since the last call to reset_count().
+		 */
+		boost::uint64_t get_count() const {
+			return _total + (pptr() - pbase()) - _count_start;
+		}
+
+		void reset_count() {
+			_count_start = _total + (pptr() - pbase());
+		}
+
+		/**
+		 *	@brief	Hands the buffered data over to the writer thread.
+		 */
+		void submit();
+
+	protected:
+		virtual int_type overflow(int_type c);
+		virtual int sync();
+
+	private:
+		OutputSink&			_owner;
+		std::vector<char>	_data;
+		boost::uint64_t		_total;			// Number of bytes submitted so far.
+		boost::uint64_t		_count_start;	// Value of the counter during the last call to reset_count().
+	};
+
+	// A unit of work for the writer thread: a block of data, or an instruction.
+	struct Message
+	{
+		enum message_type { DATA, ROTATE, STOP };
+
+		Message(message_type t = DATA) : type(t) {}
+
+		message_type type;
+		std::vector<char> data;
+	};
+
+	/**
+	 *	@brief	Queues a message for the writer thread. Blocks if the writer is lagging behind.
+	 */
+	void _post(Message&& m);
+
+	/**
+	 *	@brief	Main loop of the writer thread.
+	 */
+	void _writer_loop();
+
+	/**
+	 *	@brief	Creates the writer for a given chunk of the output.
+	 */
+	boost::shared_ptr<ChunkWriter> _open_chunk(unsigned int index);
+
+	/**
+	 *	@brief	Completes the current chunk and gives it its final name.
+	 */
+	void _finish_chunk();
+
+	/**
+	 *	@brief	Returns the final path of a given chunk of the output.
+	 */
+	bfs::path _get_chunk_path(unsigned int index) const;
+
+	bfs::path						_path;
+	compression_type				_compression;
+	unsigned int					_rotate_samples;
+	boost::uint64_t					_rotate_bytes;
+	unsigned int					_samples;		// Samples written into the current chunk.
+
+	Buffer							_buffer;
+	std::ostream					_stream;
+
+	boost::shared_ptr<ChunkWriter>	_chunk;			// Only accessed by the writer thread once it is started.
+	unsigned int					_chunk_index;	// Same.
+	std::deque<Message>				_queue;
+	boost::mutex					_queue_mutex;
+	boost::condition_variable		_queue_not_empty;
+	boost::condition_variable		_queue_not_full;
+	boost::thread					_writer;
+	bool							_open;			// Whether the first chunk could be created.
+	bool							_closed;
+};
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Appends records to a file, each of them with a single write() on a descriptor opened
+ *			in append mode.
+ *
+ *	Used for the JSON Lines output. The previous contents of the file are preserved, and since
+ *	the system positions every write at the end of the file, the lines written by several
+ *	processes sharing the file are never interleaved. The stream isn't buffered: each call to
+ *	its write() function reaches the file as is.
+ */
+class AppendFile : private boost::noncopyable
+{
+public:
+	/**
+	 *	@brief	Opens the file, or creates it if it doesn't exist.
+	 *
+	 *	@param	const std::string& path The path of the output file.
+	 */
+	AppendFile(const std::string& path);
+
+	~AppendFile();
+
+	/**
+	 *	@brief	Whether the output file could be opened.
+	 */
+	bool is_open() const {
+		return _fd != -1;
+	}
+
+	/**
+	 *	@brief	Returns the stream formatters should write to.
+	 */
+	std::ostream& get_stream() {
+		return _stream;
+	}
+
+private:
+	/**
+	 *	@brief	Stream buffer which passes every write to the file descriptor.
+	 */
+	class Buffer : public std::streambuf
+	{
+	public:
+		Buffer(int fd) : _fd(fd) {}
+
+	protected:
+		virtual std::streamsize xsputn(const char* s, std::streamsize n);
+		virtual int_type overflow(int_type c);
+
+	private:
+		int _fd;
+	};
+
+	int				_fd;
+	Buffer			_buffer;
+	std::ostream	_stream;
+};
+
+} // !namespace io
@@ -0,0 +1,175 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/assign/list_of.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#include "manape/pe.h"
+#include "yara/yara_wrapper.h"
+
+// TODO: Remove when Yara doesn't mask get_object anymore
+#undef get_object
+
+#include "plugin_framework/result.h"
+
+namespace plugin {
+
+/**
+ *	@brief	Gives plugins access to the sample being analyzed, along with everything
+ *			which was already computed about it.
+ *
+ *	Values are computed the first time they are requested and kept until the analysis of the
+ *	sample is over, so that plugins don't redo the work of the application or of the plugins
+ *	which ran before them.
+ *
+ *	This is only an interface: it is implemented by the application, so that all the computations
+ *	and allocations take place on its side of the shared object boundary.
+ */
+class IAnalysisContext
+{
+public:
+	virtual ~IAnalysisContext() {}
+
+	/**
+	 *	@brief	Returns the PE being analyzed.
+	 */
+	virtual const mana::PE& get_pe() const = 0;
+
+	/**
+	 *	@brief	Returns a digest of the whole file.
+	 *
+	 *	@param	const std::string& name The name of the digest, as it appears in the output:
+	 *			MD5, SHA1, SHA256, SHA3, SSDeep or "Imports Hash".
+	 *
+	 *	@return	The digest, or a NULL pointer if the name is unknown or the file could not be read.
+	 */
+	virtual pString get_digest(const std::string& name) = 0;
+
+	/**
+	 *	@brief	Returns the entropy of one of the PE's sections.
+	 */
+	virtual double get_section_entropy(mana::pSection section) = 0;
+
+	/**
+	 *	@brief	Returns the entropy of one of the PE's resources.
+	 */
+	virtual double get_resource_entropy(mana::pResource resource) = 0;
+
+	/**
+	 *	@brief	Returns a Yara engine in which the requested rules are loaded.
+	 *
+	 *	Rules are only compiled once during the lifetime of the application, and shared
+	 *	between all the samples and plugins which need them. Rules which cannot be loaded
+	 *	are reported the first time they are requested, and never compiled again.
+	 *
+	 *	@param	const std::string& rule_file The path to the rules.
+	 *
+	 *	@return	The Yara engine, or a NULL pointer if the rules could not be loaded.
+	 */
+	virtual yara::pYara get_rules(const std::string& rule_file) = 0;
+
+	/**
+	 *	@brief	Returns the result of a plugin which already analyzed the sample.
+	 *
+	 *	@param	const std::string& plugin_id The ID of the plugin.
+	 *
+	 *	@return	The result of the plugin, or a NULL pointer if it hasn't run (yet).
+	 */
+	virtual pResult get_result(const std::string& plugin_id) const = 0;
+
+	/**
+	 *	@brief	Returns the well-known company named in the RT_VERSION resource of the PE.
+	 *
+	 *	The resource is scanned with yara_rules/company_names.yara the first time the company
+	 *	is requested.
+	 *
+	 *	@return	The name of the company, or a NULL pointer if there is no RT_VERSION resource
+	 *			or if it doesn't name a well-known company.
+	 */
+	virtual pString get_company_name() = 0;
+};
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	The application's implementation of IAnalysisContext.
+ *
+ *	One object is created for each analyzed sample. Since independent plugins run in parallel,
+ *	all the functions of this class are thread-safe.
+ */
+class AnalysisContext : public IAnalysisContext
+{
+public:
+	AnalysisContext(const mana::PE& pe) : _pe(pe), _company_known(false) {}
+	virtual ~AnalysisContext() {}
+
+	const mana::PE& get_pe() const override { return _pe; }
+	pString get_digest(const std::string& name) override;
+	double get_section_entropy(mana::pSection section) override;
+	double get_resource_entropy(mana::pResource resource) override;
+	yara::pYara get_rules(const std::string& rule_file) override;
+	pResult get_result(const std::string& plugin_id) const override;
+	pString get_company_name() override;
+
+	/**
+	 *	@brief	Computes all the requested digests of the file which aren't known yet.
+	 *
+	 *	MD5, SHA1, SHA256 and SHA3 are computed in a single pass over the file.
+	 *
+	 *	@param	const std::vector<std::string>& names The names of the digests (see get_digest).
+	 */
+	void compute_digests(const std::vector<std::string>& names);
+
+	/**
+	 *	@brief	Records a digest of the file which was computed before the analysis (i.e. to look
+	 *			the file up in the known good set), so that it isn't computed again.
+	 *
+	 *	@param	const std::string& name The name of the digest (see get_digest).
+	 *	@param	const std::string& value The digest.
+	 */
+	void set_digest(const std::string& name, const std::string& value);
+
+	/**
+	 *	@brief	Records the result of a plugin, so that the plugins which run after it can use it.
+	 */
+	void add_result(const std::string& plugin_id, pResult result)
+	{
+		boost::lock_guard<boost::mutex> lock(_mutex);
+		_results[plugin_id] = result;
+	}
+
+private:
+	const mana::PE&							_pe;
+	std::map<std::string, pString>			_digests;
+	std::map<const mana::Section*, double>	_section_entropy;
+	std::map<const mana::Resource*, double>	_resource_entropy;
+	std::map<std::string, pResult>			_results;
+	pString									_company_name;
+	bool									_company_known;	// Whether _company_name was looked up.
+	mutable boost::mutex					_mutex;
+};
+
+} // !namespace plugin
@@ -19,11 +19,13 @@
 
 #include <string>
 #include <map>
+#include <vector>
 #include <boost/make_shared.hpp>
 #include <boost/system/api_config.hpp>
 
 #include "manape/pe.h"
 #include "plugin_framework/result.h"
+#include "plugin_framework/analysis_context.h"
 
 #ifdef BOOST_WINDOWS_API
 #	define PLUGIN_API __declspec(dllexport)
@@ -35,6 +37,8 @@ namespace plugin {
 
 typedef std::map<std::string, std::string> string_map;
 typedef boost::shared_ptr<const std::map<std::string, std::string> > shared_string_map;
+typedef boost::shared_ptr<const std::vector<std::string> > shared_strings;
+typedef boost::shared_ptr<std::vector<pResult> > shared_results;
 
 class IPlugin
 {
@@ -43,19 +47,22 @@ public:
 	bool operator==(const std::string& s) const { return s == *get_id(); }
 
 	/**
-	 *	@brief	Performs the analysis of the PE.
+	 *	@brief	Performs the analysis of the PE (version 1 of the API).
+	 *
+	 *	Plugins which target the version 2 of the API should implement analyze_sample instead.
 	 *
 	 *	@param	const sg::PE& pe The PE object to analyze.
 	 *
 	 *	@return	A shared pointer to a result object, representing the information obtained
 	 *			by the plugin.
 	 */
-	virtual pResult analyze(const mana::PE& pe) = 0;
+	virtual pResult analyze(const mana::PE& pe) { return pResult(); }
 
 	/**
 	 *	@brief	Returns the API version for which this plugin was compiled.
 	 *
-	 *	If this value doesn't match PluginManager::API_VERSION, the plugin will not be loaded.
+	 *	If this value is not between PluginManager::MIN_API_VERSION and PluginManager::API_VERSION,
+	 *	the plugin will not be loaded.
 	 *
 	 *	@return	The API version of the plugin.
 	 */
@@ -77,6 +84,140 @@ public:
 	 */
 	virtual boost::shared_ptr<std::string> get_description() const = 0;
 
+	/**
+	 *	@brief	Performs the analysis of the sample (version 2 of the API).
+	 *
+	 *	This function is declared after all the virtual functions of the first version of the API,
+	 *	and doesn't overload analyze(), so that the virtual table of plugins compiled against the
+	 *	first version keeps the same layout. It is never called for those plugins.
+	 *
+	 *	@param	IAnalysisContext& context The sample to analyze, along with the information which
+	 *			was already computed about it by the application and the plugins which ran before.
+	 *
+	 *	@return	A shared pointer to a result object, representing the information obtained
+	 *			by the plugin.
+	 */
+	virtual pResult analyze_sample(IAnalysisContext& context) { return analyze(context.get_pe()); }
+
+	/**
+	 *	@brief	Returns what the plugin needs in order to run (version 2 of the API).
+	 *
+	 *	Each element is either the ID of a plugin or the name of some data provided by other
+	 *	plugins (see get_provided_data). The plugin runs after all the plugins fulfilling its
+	 *	dependencies, and is skipped if one of its dependencies couldn't be obtained. Their
+	 *	results can be accessed through IAnalysisContext::get_result.
+	 *
+	 *	@return	The names of the dependencies of the plugin, as a shared pointer since they may
+	 *			cross shared object boundaries.
+	 */
+	virtual shared_strings get_dependencies() const {
+		return boost::make_shared<std::vector<std::string> >();
+	}
+
+	/**
+	 *	@brief	Returns the names of the data produced by this plugin (version 2 of the API).
+	 *
+	 *	Other plugins may depend on these names instead of the plugin's ID, which is always
+	 *	provided implicitly. The data itself is the result of the plugin.
+	 *
+	 *	@return	The names of the data provided by the plugin, as a shared pointer since they
+	 *			may cross shared object boundaries.
+	 */
+	virtual shared_strings get_provided_data() const {
+		return boost::make_shared<std::vector<std::string> >();
+	}
+
+	/**
+	 *	@brief	Returns the parts of the PE read by the plugin (version 2 of the API).
+	 *
+	 *	Only the components needed by the selected plugins and by the rest of the analysis are
+	 *	parsed. The headers and the section table are always available.
+	 *
+	 *	@return	A combination of mana::PE::PE_COMPONENT values. Everything by default.
+	 */
+	virtual unsigned int get_required_components() const {
+		return mana::PE::ALL_COMPONENTS;
+	}
+
+	/**
+	 *	@brief	Tells whether the plugin should analyze several samples at once (version 2 of
+	 *			the API), i.e. because a single request can cover all of them.
+	 *
+	 *	Such plugins are called through analyze_batch once a batch of samples has been analyzed
+	 *	by the other plugins. For this reason, their results are not available to other plugins.
+	 */
+	virtual bool supports_batch() const {
+		return false;
+	}
+
+	/**
+	 *	@brief	Analyzes several samples at once (version 2 of the API).
+	 *
+	 *	@param	const std::vector<IAnalysisContext*>& samples The samples to analyze.
+	 *
+	 *	@return	One result per sample, in the same order, as a shared pointer since they
+	 *			cross shared object boundaries. NULL results are ignored.
+	 */
+	virtual shared_results analyze_batch(const std::vector<IAnalysisContext*>& samples)
+	{
+		shared_results res = boost::make_shared<std::vector<pResult> >();
+		for (auto it = samples.begin() ; it != samples.end() ; ++it) {
+			res->push_back(analyze_sample(**it));
+		}
+		return res;
+	}
+
+	/**
+	 *	@brief	Called for each sample as soon as the other plugins are done with it, before it is
+	 *			added to a batch (version 2 of the API, plugins which support batches only).
+	 *
+	 *	Plugins can start slow operations here (i.e. network lookups), which proceed while the
+	 *	rest of the batch is analyzed, and collect their outcome in analyze_batch.
+	 *
+	 *	@param	IAnalysisContext& context The sample. It remains valid until analyze_batch returns.
+	 */
+	virtual void prepare_sample(IAnalysisContext& context) {}
+
+	/**
+	 *	@brief	Called once, before the plugin analyzes its first sample (version 2 of the API).
+	 *
+	 *	This is the place for expensive initializations (i.e. compiling rules) which can be
+	 *	reused for every sample of the run. The plugin instance is kept until on_run_end.
+	 *
+	 *	@param	const string_map& config The configuration of the plugin, which is also available
+	 *			through _config.
+	 */
+	virtual void on_load(const string_map& config) {}
+
+	/**
+	 *	@brief	Called by each thread which may run the plugin, before it analyzes its first sample
+	 *			(version 2 of the API). Use it to set up per-thread data, such as scratch buffers.
+	 */
+	virtual void on_thread_start() {}
+
+	/**
+	 *	@brief	Called by each thread which may run the plugin before it exits (version 2 of the API).
+	 */
+	virtual void on_thread_end() {}
+
+	/**
+	 *	@brief	Called once all the samples have been analyzed (version 2 of the API).
+	 */
+	virtual void on_run_end() {}
+
+	/**
+	 *	@brief	Analyzes a sample with the function matching the plugin's API version.
+	 *
+	 *	@param	IAnalysisContext& context The sample to analyze.
+	 */
+	pResult run(IAnalysisContext& context)
+	{
+		if (get_api_version() < 2) {
+			return analyze(context.get_pe());
+		}
+		return analyze_sample(context);
+	}
+
 	void set_config(const string_map& config) {
 		_config = boost::make_shared<string_map>(config);
 	}
@@ -18,9 +18,14 @@
 #pragma once
 
 #include <vector>
+#include <map>
+#include <utility>
 #include <iostream>
+#include <sstream>
+#include <algorithm>
 #include <boost/shared_ptr.hpp>
 #include <boost/bind.hpp>
+#include <boost/function.hpp>
 #include <boost/optional.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/system/api_config.hpp>
@@ -35,25 +40,93 @@ namespace bfs = boost::filesystem;
 
 namespace plugin {
 
+/**
+ *	@brief	Describes a plugin without having to instantiate it.
+ *
+ *	Dynamic plugins may be distributed with a manifest next to their shared library
+ *	(libplugin_x.manifest for libplugin_x.so). It is a text file with the following structure:
+ *	id = x
+ *	description = What the plugin does.
+ *	api_version = 2
+ *	# Optional, comma-separated lists:
+ *	dependencies = a, b
+ *	provides = c
+ *	# Optional, for plugins which support batches:
+ *	batch = yes
+ *
+ *	This allows Manalyze to list these plugins and to resolve their dependencies without
+ *	loading the library, which only happens if the plugin is actually used.
+ */
+struct PluginManifest
+{
+	PluginManifest() : api_version(0), batch(false) {}
+
+	std::string id;
+	std::string description;
+	int api_version;
+	std::vector<std::string> dependencies;
+	std::vector<std::string> provided_data; // The ID of the plugin is included.
+	bool batch;								// Whether the plugin supports batches (see supports_batch).
+};
+typedef boost::shared_ptr<PluginManifest> pPluginManifest;
+
+/**
+ *	@brief	Reads a plugin manifest.
+ *
+ *	@param	const std::string& path The path to the manifest.
+ *
+ *	@return	The parsed manifest, or NULL if the file doesn't exist or is invalid.
+ */
+pPluginManifest read_manifest(const std::string& path);
+
+/**
+ *	@brief	Creates the manifest of an instantiated plugin.
+ */
+pPluginManifest describe_plugin(pIPlugin p);
+
+/**
+ *	@brief	Checks that a plugin is the one described by a manifest.
+ *
+ *	The ID, API version, dependencies, provided data and batch support must be identical (in
+ *	any order), otherwise the plugin would not be scheduled the way its manifest says. A different
+ *	description is only reported.
+ *
+ *	@param	const PluginManifest& manifest The manifest the plugin was registered with.
+ *	@param	pIPlugin p The plugin loaded from the library.
+ *
+ *	@return	Whether the plugin matches the manifest.
+ */
+bool check_manifest(const PluginManifest& manifest, pIPlugin p);
+
 /**
  *	@brief	Represents an entry (a "registered plugin") in the plugin register.
  *
- *	Simply contains a reference to the plugin object, and an optional pointer to the shared
- *	library in the case of dynamic plugins.
+ *	Contains a reference to the plugin object, and an optional pointer to the shared
+ *	library in the case of dynamic plugins. Dynamic plugins which have a manifest are
+ *	only loaded the first time they are requested.
  */
 class RegisterEntry
 {
 public:
-	RegisterEntry(pPlugin p) : _plugin(p), _shared_library() {}
-	RegisterEntry(pPlugin p, pSharedLibrary s) : _plugin(p), _shared_library(s) {}
+	RegisterEntry(pPlugin p) : _plugin(p), _shared_library(), _load_failed(false) {}
+	RegisterEntry(pPlugin p, pSharedLibrary s) : _plugin(p), _shared_library(s), _load_failed(false) {}
+	RegisterEntry(pPluginManifest m, const std::string& path) : _manifest(m), _path(path), _load_failed(false) {}
+
+	/**
+	 *	@brief	Accesses the associated plugin, loading its library if needed.
+	 *
+	 *	@return	The plugin, or NULL if its library could not be loaded or doesn't match its manifest.
+	 */
+	pPlugin get_plugin();
 
 	/**
-	 *	@brief	Accesses the associated plugin.
+	 *	@brief	Describes the associated plugin. Plugins without a manifest are instantiated
+	 *			the first time this function is called.
 	 */
-	pPlugin get_plugin() const { return _plugin; }
+	pPluginManifest get_manifest();
 
 	/**
-	 *	@brief	Accesses the associated shared library, if it exists.
+	 *	@brief	Accesses the associated shared library, if it exists and was loaded.
 	 */
 	pSharedLibrary get_shared_library() const
 	{
@@ -68,6 +141,9 @@ public:
 private:
 	pPlugin _plugin;
 	boost::optional<pSharedLibrary>	_shared_library;
+	pPluginManifest _manifest;
+	std::string _path;		// The library to load, for plugins which aren't loaded yet.
+	bool _load_failed;		// Don't try to load a broken library twice.
 };
 typedef boost::shared_ptr<RegisterEntry> pRegisterEntry;
 
@@ -86,6 +162,7 @@ class PluginManager
 
 public:
 	static int API_VERSION;
+	static int MIN_API_VERSION; // Oldest version of the API which is still supported.
 	typedef std::vector<pRegisterEntry> PluginRegister;
 
 	/**
@@ -102,6 +179,9 @@ public:
 	/**
 	 *	@brief	Loads a dynamic plugin.
 	 *
+	 *	If a manifest is found next to the shared library, the plugin is only registered: its
+	 *	library will be loaded when the plugin is needed.
+	 *
 	 *	@param	const std::string& path The path to the shared library.
 	 */
 	void load(const std::string& path);
@@ -109,6 +189,11 @@ public:
 	/**
 	 *	@brief	Loads all the dynamic plugins located in the specified folder.
 	 *
+	 *	Once they are loaded, the dependencies of all the plugins are verified: plugins
+	 *	involved in circular dependencies, plugins depending on a plugin which supports
+	 *	batches (whose results are never available to other plugins), and the plugins which
+	 *	depend on any of them, are unloaded.
+	 *
 	 *	@param	const std::string& path The folder in which the plugins are located.
 	 */
 	void load_all(const std::string& path);
@@ -135,22 +220,76 @@ public:
 	 *	@brief	Returns a vector containing one of each registered plugins.
 	 *
 	 *	This function goes through the list of registered plugins ("register")
-	 *	and instantiates one of each plugin type for the function caller.
+	 *	and instantiates one of each plugin type for the function caller. All the
+	 *	dynamic plugins are loaded: use get_manifests if you only need to describe them.
 	 *
 	 *	@return	A vector of plugins.
 	 */
-	std::vector<pIPlugin> get_plugins()
-	{
-		std::vector<pIPlugin> res;
+	std::vector<pIPlugin> get_plugins();
 
-		for (PluginRegister::iterator it = _plugins.begin() ; it != _plugins.end() ; ++it)
-		{
-			pIPlugin p = (*it)->get_plugin()->instantiate_plugin();
-			res.push_back(p);
-		}
-		return res;
+	/**
+	 *	@brief	Describes all the registered plugins, without loading the ones which have a manifest.
+	 */
+	std::vector<pPluginManifest> get_manifests();
+
+	/**
+	 *	@brief	Describes a registered plugin.
+	 *
+	 *	@param	const std::string& id The ID of the plugin.
+	 *
+	 *	@return	The plugin's manifest, or NULL if no such plugin is registered.
+	 */
+	pPluginManifest find_manifest(const std::string& id);
+
+	/**
+	 *	@brief	Determines the plugins to run for a set of requested plugins, and in which order.
+	 *
+	 *	The plugins needed by the requested ones are included as well.
+	 *
+	 *	@param	const std::vector<std::string>& selected The IDs of the requested plugins.
+	 *			"all" selects all of them.
+	 *
+	 *	@return	The plugins to run (in their order of registration), each associated with a stage.
+	 *			Plugins only depend on plugins from previous stages, so all the plugins of a
+	 *			stage can run in parallel. Only these plugins are instantiated (and loaded).
+	 */
+	std::vector<std::pair<pIPlugin, unsigned int> > schedule(const std::vector<std::string>& selected);
+
+	/**
+	 *	@brief	Prepares the plugins for the analysis of the input files.
+	 *
+	 *	The requested plugins are scheduled once for the whole run: a single instance of each
+	 *	plugin needed by them is created, receives its configuration and its on_load hook is
+	 *	called. Until end_run is called, get_dispatch_list returns these instances.
+	 *
+	 *	@param	const std::vector<std::string>& selected The IDs of the requested plugins.
+	 *	@param	const std::map<std::string, string_map>& config The configuration of the plugins,
+	 *			by plugin ID.
+	 */
+	void start_run(const std::vector<std::string>& selected, const std::map<std::string, string_map>& config);
+
+	/**
+	 *	@brief	Returns the plugins of the current run, as returned by schedule.
+	 */
+	const std::vector<std::pair<pIPlugin, unsigned int> >& get_dispatch_list() const {
+		return _dispatch_list;
 	}
 
+	/**
+	 *	@brief	Calls the on_thread_start hook of the plugins of the run, from the current thread.
+	 */
+	void start_thread();
+
+	/**
+	 *	@brief	Calls the on_thread_end hook of the plugins of the run, from the current thread.
+	 */
+	void end_thread();
+
+	/**
+	 *	@brief	Calls the on_run_end hook of the plugins of the run, and releases them.
+	 */
+	void end_run();
+
 	virtual ~PluginManager() {}
 
 private:
@@ -158,7 +297,22 @@ private:
 	PluginManager(const PluginManager&);
 	PluginManager& operator=(PluginManager const&);
 
+	typedef std::map<std::string, std::vector<size_t> > provider_map;
+
+	/**
+	 *	@brief	Associates each dependency name (plugin IDs and provided data) with the
+	 *			index of the plugins providing it.
+	 */
+	static provider_map _index_providers(const std::vector<pPluginManifest>& plugins);
+
+	/**
+	 *	@brief	Unregisters the plugins involved in circular dependencies, the ones which
+	 *			depend on a plugin supporting batches, and (transitively) their dependents.
+	 */
+	void _check_dependencies();
+
 	PluginRegister _plugins;
+	std::vector<std::pair<pIPlugin, unsigned int> > _dispatch_list;	// The plugins of the current run.
 
 };
 
@@ -172,4 +326,27 @@ private:
  */
 bool name_matches(const std::string& s, pIPlugin p);
 
+/**
+ *	@brief	Returns the dependencies of a plugin. Plugins using the first version of the API
+ *			don't have any.
+ */
+std::vector<std::string> get_dependencies(pIPlugin p);
+
+/**
+ *	@brief	Returns the names of the data provided by a plugin, its ID included.
+ */
+std::vector<std::string> get_provided_data(pIPlugin p);
+
+/**
+ *	@brief	Returns the PE components (mana::PE::PE_COMPONENT) read by a plugin. Plugins using
+ *			the first version of the API need all of them.
+ */
+unsigned int get_required_components(pIPlugin p);
+
+/**
+ *	@brief	Tells whether a plugin analyzes samples in batches. Plugins using the first version
+ *			of the API don't.
+ */
+bool supports_batch(pIPlugin p);
+
 } // !namespace plugin
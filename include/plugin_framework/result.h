@@ -71,7 +71,7 @@ public:
 	void add_information(T t)
 	{
 		io::pNode output = get_information();
-		output->append(boost::make_shared<io::OutputTreeNode>(_create_node_name(), t, io::OutputTreeNode::HIDE_NAME));
+		output->append(io::make_node(_create_node_name(), t, io::OutputTreeNode::HIDE_NAME));
 	}
 
 	/**
@@ -88,7 +88,7 @@ public:
 	void add_information(const std::string& name, T t)
 	{
 		io::pNode output = get_information();
-		output->append(boost::make_shared<io::OutputTreeNode>(name, t));
+		output->append(io::make_node(name, t));
 	}
 
 	io::pNode get_output() const { return _data; }
@@ -0,0 +1,124 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <set>
+
+#include "plugin_framework/plugin_interface.h"
+#include "plugin_framework/result.h"
+#include "plugin_framework/worker_pool.h"
+
+namespace plugin {
+
+/**
+ *	@brief	Decides when the analysis of a file can stop early.
+ *
+ *	Once a plugin reports a threat level high enough (i.e. ClamAV found a match), the
+ *	verdict is known and running the remaining (expensive) plugins is a waste of time.
+ *	The policy is read from the "plugins" section of the configuration file:
+ *
+ *	plugins.stop_level = malicious				The level from which the verdict is known.
+ *												"none" (the default) disables the policy.
+ *	plugins.skip_on_verdict = strings,findcrypt	The plugins which are skipped once the
+ *												verdict is known. All of them if omitted.
+ *	plugins.cost_order = clamav,imports			The plugins to run first (cheapest first).
+ *												Unlisted plugins which may be skipped only
+ *												start once they are done.
+ */
+class VerdictPolicy
+{
+public:
+	/**
+	 *	@brief	Reads the policy from the configuration.
+	 *
+	 *	@param	const string_map& config The "plugins" section of the configuration file.
+	 */
+	VerdictPolicy(const string_map& config);
+
+	/**
+	 *	@brief	Whether a verdict can stop the analysis at all.
+	 */
+	bool is_enabled() const { return _enabled; }
+
+	/**
+	 *	@brief	Tells whether a result settles the verdict for the file.
+	 *
+	 *	@param	pResult res The result returned by a plugin.
+	 *
+	 *	@return	True if the policy is enabled and the level of the result reaches its threshold.
+	 */
+	bool is_verdict(pResult res) const;
+
+	/**
+	 *	@brief	Tells whether a plugin may be skipped once the verdict is known.
+	 *
+	 *	@param	const std::string& plugin_id The ID of the plugin.
+	 */
+	bool may_skip(const std::string& plugin_id) const;
+
+	/**
+	 *	@brief	Returns the position of a plugin in the cost order. Plugins with a lower rank
+	 *			should run first.
+	 *
+	 *	@param	const std::string& plugin_id The ID of the plugin.
+	 *
+	 *	@return	The index of the plugin in plugins.cost_order, or the size of the list if it
+	 *			isn't in it.
+	 */
+	unsigned int get_rank(const std::string& plugin_id) const;
+
+	/**
+	 *	@brief	Returns the level from which the verdict is known, as written in the configuration.
+	 */
+	const std::string& get_threshold_name() const { return _threshold_name; }
+
+	/**
+	 *	@brief	Runs independent plugins on a sample, and skips the ones made useless by the verdict.
+	 *
+	 *	The plugins of plugins.cost_order run first, along with the ones which can't be skipped.
+	 *	They are queued in rank order, as many at a time as the pool has threads, so that a
+	 *	verdict reached by the cheapest ones skips the others. The remaining plugins are only
+	 *	queued once they are complete, so that the verdict they may reach is known before the
+	 *	expensive plugins start.
+	 *
+	 *	@param	const std::vector<pIPlugin>& plugins The plugins to run.
+	 *	@param	IAnalysisContext& context The sample to analyze.
+	 *	@param	WorkerPool& pool The threads on which the plugins run.
+	 *	@param	std::vector<pResult>& results Receives the result of each plugin (NULL if it was skipped).
+	 *	@param	std::string& verdict The ID of the plugin which settled the verdict, if any. It may
+	 *			already have been reached by plugins which ran before.
+	 *
+	 *	@return	The IDs of the plugins which were skipped.
+	 */
+	std::vector<std::string> run_plugins(const std::vector<pIPlugin>& plugins,
+										 IAnalysisContext& context,
+										 WorkerPool& pool,
+										 std::vector<pResult>& results,
+										 std::string& verdict) const;
+
+private:
+	bool								_enabled;
+	LEVEL								_threshold;
+	std::string							_threshold_name;
+	std::set<std::string>				_skippable;		// Empty means all of them.
+	std::map<std::string, unsigned int>	_ranks;
+};
+
+} // !namespace plugin
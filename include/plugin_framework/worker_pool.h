@@ -0,0 +1,81 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+#include <deque>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+namespace plugin {
+
+/**
+ *	@brief	A fixed set of threads on which the plugins analyze the samples.
+ *
+ *	The threads are created once for the whole run, so plugins can keep per-thread data
+ *	from one sample to the next (see IPlugin::on_thread_start).
+ */
+class WorkerPool : private boost::noncopyable
+{
+public:
+	typedef boost::function<void ()> task;
+
+	/**
+	 *	@param	unsigned int threads The number of threads to create (at least one).
+	 *	@param	task on_start A function called by each thread before it runs any task.
+	 *	@param	task on_end A function called by each thread before it exits.
+	 */
+	WorkerPool(unsigned int threads, task on_start = task(), task on_end = task());
+
+	/**
+	 *	@brief	Waits for the threads to complete the remaining tasks, then stops them.
+	 */
+	~WorkerPool();
+
+	/**
+	 *	@brief	Runs tasks on the pool, in the given order.
+	 *
+	 *	@param	const std::vector<task>& tasks The tasks to run.
+	 *
+	 *	This function returns once all the tasks are complete.
+	 */
+	void run(const std::vector<task>& tasks);
+
+	size_t get_size() const { return _size; }
+
+private:
+	/**
+	 *	@brief	The loop executed by each thread of the pool.
+	 */
+	void _work();
+
+	size_t						_size;
+	task						_on_start;
+	task						_on_end;
+	boost::thread_group			_threads;
+	boost::mutex				_mutex;
+	boost::condition_variable	_task_available;
+	boost::condition_variable	_tasks_done;
+	std::deque<task>			_queue;
+	size_t						_pending;	// Tasks queued or running.
+	bool						_stopping;
+};
+
+} // !namespace plugin
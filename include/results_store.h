@@ -0,0 +1,127 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include <boost/cstdint.hpp>
+
+#include "manape/pe.h"
+#include "plugin_framework/threat_level.h"
+
+namespace mana
+{
+
+/**
+ *	@brief	The information kept about a sample in the results store.
+ */
+typedef struct sample_record_t
+{
+	std::string												sha256;
+	std::string												path;
+	std::vector<std::string>								imports;	// "dll!function", in lowercase.
+	std::vector<std::pair<std::string, std::string> >		sections;	// Name and permissions (i.e. "rwx").
+	std::vector<std::pair<std::string, plugin::LEVEL> >		verdicts;	// Plugin ID and threat level.
+} sample_record;
+
+/**
+ *	@brief	Fills the imports and sections of a sample record.
+ *
+ *	@param	const mana::PE& pe The PE described by the record.
+ *	@param	sample_record& record The record to fill.
+ */
+void describe_pe(const mana::PE& pe, sample_record& record);
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	A directory in which the results of the analyses are kept, so that they can be
+ *			searched without going through the full output.
+ *
+ *	The store contains the following append-only files:
+ *	* samples.tsv, with one "id<TAB>sha256<TAB>path" record per sample;
+ *	* imports.idx, with one "id<TAB>dll!function" line per imported function;
+ *	* sections.idx, with one "id<TAB>name<TAB>permissions" line per section;
+ *	* verdicts.idx, with one "id<TAB>plugin<TAB>level" line per plugin result.
+ *	Only one process may write into a store at a time.
+ */
+class ResultsStore
+{
+public:
+	/**
+	 *	@brief	Opens a store for writing. It is created if it doesn't exist.
+	 *
+	 *	@param	const std::string& directory The directory of the store.
+	 */
+	ResultsStore(const std::string& directory);
+
+	bool is_open() const {
+		return _open;
+	}
+
+	/**
+	 *	@brief	Adds a sample to the store.
+	 *
+	 *	@return	Whether the record could be written.
+	 */
+	bool add(const sample_record& record);
+
+	/**
+	 *	@brief	Writes the buffered index entries.
+	 */
+	void flush();
+
+private:
+	bool			_open;
+	boost::uint64_t	_next_id;
+	std::ofstream	_samples;
+	std::ofstream	_imports;
+	std::ofstream	_sections;
+	std::ofstream	_verdicts;
+};
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Finds the samples of a store matching all the given conditions.
+ *
+ *	Conditions may be:
+ *	* import:<pattern>, which matches the imported functions. The pattern is compared to the
+ *	  DLL name too if it contains a '!' (i.e. "winhttp.dll!*").
+ *	* section:<pattern>, which matches the section names.
+ *	* permissions:<letters>, which matches samples with a section having all these permissions
+ *	  (i.e. "wx" for a section both writable and executable).
+ *	* plugin:<pattern>=<level> or plugin:<pattern>>=<level>, which matches the verdicts of the
+ *	  plugins. Levels are safe, no_opinion, suspicious and malicious.
+ *	Patterns are case-insensitive and may contain '*' and '?' wildcards. Conditions prefixed with
+ *	'!' are negated.
+ *
+ *	Only the indexes needed by the conditions are read.
+ *
+ *	@param	const std::string& directory The directory of the store.
+ *	@param	const std::vector<std::string>& conditions The conditions.
+ *	@param	std::vector<sample_record>& results Receives the SHA256 and path of the matching samples.
+ *
+ *	@return	False if a condition is invalid or the store could not be read.
+ */
+bool query_results_store(const std::string& directory,
+						 const std::vector<std::string>& conditions,
+						 std::vector<sample_record>& results);
+
+} // !namespace mana
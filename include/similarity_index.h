@@ -0,0 +1,136 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+
+namespace mana
+{
+
+/**
+ *	@brief	Compares two ssdeep hashes.
+ *
+ *	This is the algorithm of ssdeep's fuzzy_compare: the chunks computed with compatible block
+ *	sizes are compared with a weighted edit distance, provided they have a substring of 7
+ *	characters in common.
+ *
+ *	@return	A score between 0 (no similarity) and 100 (identical hashes).
+ */
+int compare_ssdeep(const std::string& a, const std::string& b);
+
+// ----------------------------------------------------------------------------
+
+typedef struct similar_file_t
+{
+	std::string	sha256;
+	std::string	path;	// The path of the file when it was indexed.
+	int			score;
+} similar_file;
+
+/**
+ *	@brief	An index of ssdeep hashes, used to find similar files without comparing the hash of
+ *			a file with all the others.
+ *
+ *	Two ssdeep hashes can only be similar if they have a chunk computed with the same block size,
+ *	and if these chunks share a substring of 7 characters. The index therefore keeps, for each
+ *	block size and each 7-gram, the files whose chunks contain it. Identical chunks, which may
+ *	be too short to contain a 7-gram, are indexed as well. Only the files found in the buckets
+ *	of a hash are compared with it.
+ *
+ *	The index is stored in a text file, with one "ssdeep<TAB>sha256<TAB>path" line per file.
+ *	New files are appended to it as they are analyzed.
+ *	This class is not thread-safe.
+ */
+class SimilarityIndex
+{
+public:
+	/**
+	 *	@brief	Loads the index stored in a file, which is created if it doesn't exist.
+	 *
+	 *	@param	const std::string& path The file containing the index.
+	 */
+	SimilarityIndex(const std::string& path);
+
+	/**
+	 *	@brief	Whether the index file could be opened for writing.
+	 */
+	bool is_open() const {
+		return _file.is_open();
+	}
+
+	/**
+	 *	@brief	Adds a file to the index.
+	 *
+	 *	@param	const std::string& ssdeep The ssdeep hash of the file.
+	 *	@param	const std::string& sha256 The SHA256 of the file. Files which are already
+	 *			indexed are ignored.
+	 *	@param	const std::string& path The path of the file.
+	 *
+	 *	@return	Whether the file was added.
+	 */
+	bool add(const std::string& ssdeep, const std::string& sha256, const std::string& path);
+
+	/**
+	 *	@brief	Finds the indexed files similar to a hash.
+	 *
+	 *	@param	const std::string& ssdeep The hash to look for.
+	 *	@param	int threshold The minimum score of the returned files.
+	 *	@param	const std::string& exclude The SHA256 of a file to leave out of the results
+	 *			(i.e. the file being analyzed).
+	 *
+	 *	@return	The similar files, the most similar first.
+	 */
+	std::vector<similar_file> find_similar(const std::string& ssdeep,
+										   int threshold,
+										   const std::string& exclude = "") const;
+
+	size_t size() const {
+		return _entries.size();
+	}
+
+private:
+	typedef struct entry_t
+	{
+		boost::uint32_t block_size;
+		std::string		chunk;			// The chunk computed with block_size.
+		std::string		double_chunk;	// The chunk computed with 2 * block_size.
+		std::string		sha256;
+		std::string		path;
+	} entry;
+
+	/**
+	 *	@brief	Adds an entry to the in-memory index.
+	 */
+	void _insert(const entry& e);
+
+	typedef boost::unordered_map<boost::uint64_t, std::vector<boost::uint32_t> > bucket_map;
+	typedef boost::unordered_map<std::string, std::vector<boost::uint32_t> > exact_bucket_map;
+
+	std::vector<entry>					_entries;
+	bucket_map							_buckets;	// Block size and 7-gram -> indexes in _entries
+	exact_bucket_map					_exact_buckets;	// "block_size:chunk" -> indexes in _entries
+	boost::unordered_set<std::string>	_indexed;	// The SHA256 of the indexed files
+	std::ofstream						_file;
+};
+
+} // !namespace mana
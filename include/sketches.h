@@ -0,0 +1,145 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+
+namespace mana
+{
+
+/**
+ *	@brief	A 64-bit hash of a string, used to index the sketches.
+ *
+ *	Sketches can only be merged if they use the same hash function, which must therefore stay
+ *	the same in every thread.
+ */
+boost::uint64_t hash_key(const std::string& key);
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Estimates the number of occurrences of keys in a fixed amount of memory.
+ *
+ *	Each key increments one counter in each row. The estimate is the smallest of these counters:
+ *	it is never lower than the actual count, and exceeds it by at most 2N / width with a
+ *	probability of 1 - 2^-depth (N being the total of all the counts).
+ */
+class CountMinSketch
+{
+public:
+	/**
+	 *	@param	unsigned int width_bits The number of counters per row, as a power of 2.
+	 *	@param	unsigned int depth The number of rows.
+	 */
+	CountMinSketch(unsigned int width_bits = 14, unsigned int depth = 4);
+
+	void add(boost::uint64_t hash, boost::uint64_t count = 1);
+	boost::uint64_t estimate(boost::uint64_t hash) const;
+
+	/**
+	 *	@brief	Adds the counts of a sketch with the same dimensions to this one.
+	 *
+	 *	@return	False if the dimensions differ.
+	 */
+	bool merge(const CountMinSketch& other);
+
+private:
+	size_t _index(boost::uint64_t hash, unsigned int row) const;
+
+	unsigned int					_width_bits;
+	unsigned int					_depth;
+	std::vector<boost::uint64_t>	_counters;
+};
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Estimates the number of distinct keys in a fixed amount of memory, with a standard
+ *			error of 1.04 / sqrt(2^precision).
+ */
+class HyperLogLog
+{
+public:
+	/**
+	 *	@param	unsigned int precision The number of bits of the hashes used to select a register
+	 *			(between 4 and 18).
+	 */
+	HyperLogLog(unsigned int precision = 14);
+
+	void add(boost::uint64_t hash);
+	boost::uint64_t estimate() const;
+
+	/**
+	 *	@return	False if the precisions differ.
+	 */
+	bool merge(const HyperLogLog& other);
+
+private:
+	unsigned int				_precision;
+	std::vector<boost::uint8_t>	_registers;
+};
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Counts the occurrences of keys with bounded memory: only the most frequent keys are
+ *			kept, and their counts are estimated with a CountMinSketch.
+ *
+ *	The number of distinct keys is estimated with a HyperLogLog.
+ */
+class FrequencySketch
+{
+public:
+	/**
+	 *	@param	unsigned int capacity The number of most frequent keys to keep.
+	 */
+	FrequencySketch(unsigned int capacity = 100);
+
+	void add(const std::string& key);
+
+	/**
+	 *	@brief	Adds the keys counted by another sketch to this one.
+	 */
+	void merge(const FrequencySketch& other);
+
+	/**
+	 *	@brief	Returns the most frequent keys with their estimated counts, the most frequent first.
+	 */
+	std::vector<std::pair<std::string, boost::uint64_t> > get_top_keys() const;
+
+	boost::uint64_t get_distinct_keys() const {
+		return _distinct.estimate();
+	}
+
+private:
+	/**
+	 *	@brief	Makes a key one of the most frequent ones if its count is high enough.
+	 */
+	void _offer(const std::string& key, boost::uint64_t count);
+
+	unsigned int										_capacity;
+	CountMinSketch										_counts;
+	HyperLogLog											_distinct;
+	boost::unordered_map<std::string, boost::uint64_t>	_top;	// The most frequent keys and their estimated counts.
+	boost::uint64_t										_min;	// A lower bound of the smallest count in _top.
+};
+
+} // !namespace mana
@@ -0,0 +1,109 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
+#include "manape/pe.h"
+#include "manacommons/color.h"
+
+namespace bfs = boost::filesystem;
+
+namespace io
+{
+
+/**
+ *	@brief	Exports PE structures as flat tables (one file per table) meant to be loaded
+ *			into a database or a data frame.
+ *
+ *	Rows are generated directly from the parsed mana::PE and written as soon as they are
+ *	produced, without going through the output tree. Every row starts with the SHA-256 of the
+ *	sample it describes, which can be used to join tables together.
+ *
+ *	The following tables are created in the target directory:
+ *	* sections.tsv:  sha256, name, virtual_address, virtual_size, pointer_to_raw_data,
+ *					 size_of_raw_data, characteristics, entropy
+ *	* imports.tsv:   sha256, library, function, ordinal (for imports by ordinal), delay_loaded
+ *	* exports.tsv:   sha256, ordinal, address, name, forward_name
+ *	* resources.tsv: sha256, type, name, language, codepage, size, offset, entropy
+ *	(with the .csv extension when the CSV format is used.)
+ *
+ *	Tables are opened in append mode, so successive runs can target the same directory.
+ */
+class TableExporter
+{
+public:
+	enum table_format { TSV, CSV };
+
+	/**
+	 *	@brief	Creates the tables in the target directory.
+	 *
+	 *	@param	const std::string& directory The directory where the tables should be written.
+	 *			It is created if it doesn't exist.
+	 *	@param	table_format format The format of the tables.
+	 */
+	TableExporter(const std::string& directory, table_format format = TSV);
+
+	/**
+	 *	@brief	Whether all the tables could be opened.
+	 */
+	bool is_open() const;
+
+	/**
+	 *	@brief	Writes the rows describing a PE into the tables.
+	 *
+	 *	@param	const mana::PE& pe The PE to export.
+	 *	@param	const std::string& sha256 The SHA-256 of the file, used as a key in all the tables.
+	 */
+	void export_pe(const mana::PE& pe, const std::string& sha256);
+
+	/**
+	 *	@brief	Escapes a value so that it doesn't break the table's structure.
+	 *
+	 *	TSV values have their tabs, line breaks and backslashes escaped with a backslash.
+	 *	CSV values are quoted as described in RFC 4180 when needed.
+	 *
+	 *	@param	const std::string& value The value of a cell.
+	 *	@param	table_format format The format of the table.
+	 */
+	static std::string escape(const std::string& value, table_format format);
+
+private:
+	/**
+	 *	@brief	Opens a table and writes its header if it is empty.
+	 */
+	void _open_table(std::ofstream& table, const std::string& name, const std::vector<std::string>& columns);
+
+	/**
+	 *	@brief	Writes a row into a table.
+	 */
+	void _write_row(std::ofstream& table, const std::vector<std::string>& cells);
+
+	bfs::path		_directory;
+	table_format	_format;
+	std::ofstream	_sections;
+	std::ofstream	_imports;
+	std::ofstream	_exports;
+	std::ofstream	_resources;
+};
+
+} // !namespace io
@@ -0,0 +1,73 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "manacommons/hex.h"
+
+namespace io
+{
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+// ----------------------------------------------------------------------------
+
+std::string to_hex(const boost::uint8_t* bytes, size_t size)
+{
+	std::string res;
+	res.reserve(2 * size);
+	for (size_t i = 0 ; i < size ; ++i)
+	{
+		res += HEX_DIGITS[bytes[i] >> 4];
+		res += HEX_DIGITS[bytes[i] & 0x0F];
+	}
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+size_t read_hex(const char* s, size_t length, boost::uint8_t* out, size_t size)
+{
+	size_t i = 0;
+	for ( ; i < length && i < 2 * size ; ++i)
+	{
+		char c = s[i];
+		boost::uint8_t nibble;
+		if (c >= '0' && c <= '9') {
+			nibble = c - '0';
+		}
+		else if (c >= 'a' && c <= 'f') {
+			nibble = c - 'a' + 10;
+		}
+		else if (c >= 'A' && c <= 'F') {
+			nibble = c - 'A' + 10;
+		}
+		else {
+			break;
+		}
+		out[i / 2] = (i % 2 == 0) ? (nibble << 4) : (out[i / 2] | nibble);
+	}
+	return i;
+}
+
+// ----------------------------------------------------------------------------
+
+bool from_hex(const std::string& hex, boost::uint8_t* out, size_t size)
+{
+	return hex.size() == 2 * size && read_hex(hex.c_str(), hex.size(), out, size) == hex.size();
+}
+
+} // !namespace io
@@ -0,0 +1,122 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "manacommons/node_arena.h"
+
+#include <cstdlib>
+
+#if defined _MSC_VER && _MSC_VER < 1900
+	#define THREAD_LOCAL __declspec(thread)
+#else
+	#define THREAD_LOCAL thread_local
+#endif
+
+namespace io
+{
+
+// The arena used by the nodes created in the current thread.
+static THREAD_LOCAL NodeArena* current_arena = nullptr;
+
+// Blocks released by the arenas destroyed in the current thread. Since an arena is created for each
+// analyzed file, recycling them avoids returning memory to the system only to fault it back in
+// for the next file.
+const unsigned int MAX_SPARE_BLOCKS = 16;
+static THREAD_LOCAL char* spare_blocks[MAX_SPARE_BLOCKS];
+static THREAD_LOCAL unsigned int spare_block_count = 0;
+
+// ----------------------------------------------------------------------------
+
+NodeArena::NodeArena(size_t block_size)
+	: _cursor(nullptr), _remaining(0), _block_size(block_size), _reserved(0), _references(0)
+{}
+
+// ----------------------------------------------------------------------------
+
+NodeArena::~NodeArena()
+{
+	for (size_t i = 0 ; i < _blocks.size() ; ++i)
+	{
+		if (_block_sizes[i] == DEFAULT_BLOCK_SIZE && spare_block_count < MAX_SPARE_BLOCKS) {
+			spare_blocks[spare_block_count++] = _blocks[i];
+		}
+		else {
+			free(_blocks[i]);
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void* NodeArena::allocate(size_t size, size_t alignment)
+{
+	size_t padding = (alignment - reinterpret_cast<size_t>(_cursor) % alignment) % alignment;
+	if (_cursor == nullptr || padding + size > _remaining)
+	{
+		// Objects bigger than a block get a dedicated one. malloc's alignment is sufficient for any type.
+		size_t new_block_size = size > _block_size ? size : _block_size;
+		char* block;
+		if (new_block_size == DEFAULT_BLOCK_SIZE && spare_block_count > 0) {
+			block = spare_blocks[--spare_block_count];
+		}
+		else if ((block = static_cast<char*>(malloc(new_block_size))) == nullptr) {
+			throw std::bad_alloc();
+		}
+		_blocks.push_back(block);
+		_block_sizes.push_back(new_block_size);
+		_reserved += new_block_size;
+
+		if (size > _block_size) {
+			return block;
+		}
+		_cursor = block;
+		_remaining = new_block_size;
+		padding = 0;
+	}
+
+	void* res = _cursor + padding;
+	_cursor += padding + size;
+	_remaining -= padding + size;
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+size_t NodeArena::get_reserved_size() const {
+	return _reserved;
+}
+
+// ----------------------------------------------------------------------------
+
+NodeArena* NodeArena::get_current() {
+	return current_arena;
+}
+
+// ----------------------------------------------------------------------------
+
+NodeArena::Scope::Scope(boost::intrusive_ptr<NodeArena> arena)
+	: _arena(arena), _previous(current_arena)
+{
+	current_arena = _arena.get();
+}
+
+// ----------------------------------------------------------------------------
+
+NodeArena::Scope::~Scope() {
+	current_arena = _previous;
+}
+
+} // !namespace io
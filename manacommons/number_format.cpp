@@ -0,0 +1,96 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "manacommons/number_format.h"
+
+#include <cstdio>
+#include <cstring>
+
+#if defined _MSC_VER && _MSC_VER < 1900
+	#define snprintf _snprintf
+#endif
+
+namespace io
+{
+
+// Pairs of digits from "00" to "99", so that two digits are produced for each division.
+static const char DIGIT_PAIRS[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+// ----------------------------------------------------------------------------
+
+size_t format_decimal(boost::uint64_t value, char* buffer)
+{
+	// The number is written from the end of a temporary buffer, then moved to the destination.
+	char tmp[20];
+	char* p = tmp + sizeof(tmp);
+	while (value >= 100)
+	{
+		unsigned int pair = static_cast<unsigned int>(value % 100) * 2;
+		value /= 100;
+		*--p = DIGIT_PAIRS[pair + 1];
+		*--p = DIGIT_PAIRS[pair];
+	}
+	if (value >= 10)
+	{
+		unsigned int pair = static_cast<unsigned int>(value) * 2;
+		*--p = DIGIT_PAIRS[pair + 1];
+		*--p = DIGIT_PAIRS[pair];
+	}
+	else {
+		*--p = static_cast<char>('0' + value);
+	}
+
+	size_t length = tmp + sizeof(tmp) - p;
+	memcpy(buffer, p, length);
+	return length;
+}
+
+// ----------------------------------------------------------------------------
+
+size_t format_hexadecimal(boost::uint64_t value, char* buffer)
+{
+	char tmp[16];
+	char* p = tmp + sizeof(tmp);
+	do
+	{
+		*--p = HEX_DIGITS[value & 0xF];
+		value >>= 4;
+	} while (value != 0);
+
+	size_t length = tmp + sizeof(tmp) - p;
+	memcpy(buffer, p, length);
+	return length;
+}
+
+// ----------------------------------------------------------------------------
+
+size_t format_floating_point(double value, char* buffer)
+{
+	// std::ostream relies on printf's "%g" with a precision of 6 in the default case.
+	int length = snprintf(buffer, NUMBER_BUFFER_SIZE, "%g", value);
+	if (length < 0) {
+		return 0;
+	}
+	return static_cast<size_t>(length) < NUMBER_BUFFER_SIZE ? length : NUMBER_BUFFER_SIZE - 1;
+}
+
+} // !namespace io
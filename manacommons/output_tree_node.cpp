@@ -16,6 +16,7 @@ along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "manacommons/output_tree_node.h"
+#include "manacommons/number_format.h"
 
 namespace io
 {
@@ -44,6 +45,17 @@ unsigned int determine_max_width(pNode node)
 
 // ----------------------------------------------------------------------------
 
+pString OutputTreeNode::_make_name(const std::string& name)
+{
+	NodeArena* arena = NodeArena::get_current();
+	if (arena == nullptr) {
+		return boost::make_shared<std::string>(name);
+	}
+	return boost::allocate_shared<std::string>(ArenaAllocator<std::string>(arena), name);
+}
+
+// ----------------------------------------------------------------------------
+
 pNode OutputTreeNode::find_node(const std::string& name) const
 {
 	if (_type != LIST)
@@ -52,24 +64,14 @@ pNode OutputTreeNode::find_node(const std::string& name) const
 		return pNode();
 	}
 
-	if (!_list_data || !*_list_data || (*_list_data)->size() == 0) {
-		return pNode();
-	}
-
-	nodes::const_iterator it;
-	for (it = (*_list_data)->begin(); it != (*_list_data)->end(); ++it)
+	const arena_nodes& children = boost::get<arena_nodes>(_data);
+	for (arena_nodes::const_iterator it = children.begin() ; it != children.end() ; ++it)
 	{
 		if (*(*it)->get_name() == name) {
-			break;
+			return *it;
 		}
 	}
-
-	if (it == (*_list_data)->end()) {
-		return pNode();
-	}
-	else {
-		return *it;
-	}
+	return pNode();
 }
 
 // ----------------------------------------------------------------------------
@@ -77,15 +79,15 @@ pNode OutputTreeNode::find_node(const std::string& name) const
 OutputTreeNode::OutputTreeNode(const std::string& name,
 							   enum node_type type,
 							   enum display_modifier mod)
-	: _name(new std::string(name)), _type(type), _modifier(mod)
+	: _name(_make_name(name)), _type(type), _modifier(mod)
 {
 	switch (type)
 	{
 	case LIST:
-		_list_data = boost::make_shared<boost::optional<nodes> >(nodes());
+		_data = arena_nodes(_allocator());
 		break;
 	case STRINGS:
-		_strings_data = boost::make_shared<boost::optional<strings> >(strings());
+		_data = arena_strings(_allocator());
 		break;
 	default:
 		PRINT_WARNING << "[OutputTreeNode] Please use specialized constructors for types other than LIST or STRINGS!"
@@ -98,37 +100,60 @@ OutputTreeNode::OutputTreeNode(const std::string& name,
 
 pString OutputTreeNode::to_string() const
 {
-	if (_type == STRING) {
-		return boost::make_shared<std::string>(**_string_data);
+	if (_type == STRING)
+	{
+		const arena_string& s = boost::get<arena_string>(_data);
+		return boost::make_shared<std::string>(s.data(), s.size());
 	}
 
-	std::stringstream ss;
-	if (_modifier == HEX) {
-		ss << std::hex << "0x";
+	char buffer[NUMBER_BUFFER_SIZE + 2];
+	return boost::make_shared<std::string>(buffer, _format_number(buffer));
+}
+
+// ----------------------------------------------------------------------------
+
+void OutputTreeNode::write_value(std::ostream& sink) const
+{
+	if (_type == STRING)
+	{
+		const arena_string& s = boost::get<arena_string>(_data);
+		sink.write(s.data(), s.size());
+		return;
 	}
-	else if (_modifier == DEC) {
-		ss << std::dec;
+
+	char buffer[NUMBER_BUFFER_SIZE + 2];
+	sink.write(buffer, _format_number(buffer));
+}
+
+// ----------------------------------------------------------------------------
+
+size_t OutputTreeNode::_format_number(char* buffer) const
+{
+	size_t length = 0;
+	if (_modifier == HEX)
+	{
+		buffer[length++] = '0';
+		buffer[length++] = 'x';
 	}
 
 	switch (_type)
 	{
 	case UINT32:
-		ss << **_uint32_data;
-		break;
 	case UINT16:
-		ss << **_uint16_data;
-		break;
 	case UINT64:
-		ss << **_uint64_data;
+	case THREAT_LEVEL:
+		if (_modifier == HEX) {
+			length += format_hexadecimal(boost::get<boost::uint64_t>(_data), buffer + length);
+		}
+		else {
+			length += format_decimal(boost::get<boost::uint64_t>(_data), buffer + length);
+		}
 		break;
 	case FLOAT:
-		ss << **_float_data;
+		length += format_floating_point(static_cast<float>(boost::get<double>(_data)), buffer + length);
 		break;
 	case DOUBLE:
-		ss << **_double_data;
-		break;
-	case THREAT_LEVEL:
-		ss << **_level_data;
+		length += format_floating_point(boost::get<double>(_data), buffer + length);
 		break;
 	case LIST:
 	case STRINGS:
@@ -137,7 +162,7 @@ pString OutputTreeNode::to_string() const
 	default:
 		PRINT_WARNING << "[OutputTreeNode] No _to_string() implementation for " << _type << "!" << std::endl;
 	}
-	return boost::make_shared<std::string>(ss.str());
+	return length;
 }
 
 // ----------------------------------------------------------------------------
@@ -149,14 +174,39 @@ plugin::LEVEL OutputTreeNode::get_level() const
 		PRINT_WARNING << "[OutputTreeNode] Tried to get a level, but is not a THREAT_LEVEL node!" << DEBUG_INFO << std::endl;
 		return plugin::NO_OPINION;
 	}
+	return static_cast<plugin::LEVEL>(boost::get<boost::uint64_t>(_data));
+}
+
+// ----------------------------------------------------------------------------
 
-	if (!_level_data || !*_level_data)
+boost::uint64_t OutputTreeNode::get_integer() const
+{
+	switch (_type)
 	{
-		PRINT_WARNING << "[OutputTreeNode] A THREAT_LEVEL node's data is empty!" << DEBUG_INFO << std::endl;
-		return plugin::NO_OPINION;
+	case UINT32:
+	case UINT16:
+	case UINT64:
+		return boost::get<boost::uint64_t>(_data);
+	default:
+		PRINT_WARNING << "[OutputTreeNode] Tried to get an integer, but is not an integer node!" << DEBUG_INFO << std::endl;
+		return 0;
 	}
+}
+
+// ----------------------------------------------------------------------------
 
-	return **_level_data;
+double OutputTreeNode::get_floating_point() const
+{
+	switch (_type)
+	{
+	case FLOAT:
+	case DOUBLE:
+		return boost::get<double>(_data);
+	default:
+		PRINT_WARNING << "[OutputTreeNode] Tried to get a floating point value, but is not a FLOAT or DOUBLE node!"
+			<< DEBUG_INFO << std::endl;
+		return 0;
+	}
 }
 
 // ----------------------------------------------------------------------------
@@ -168,14 +218,13 @@ shared_strings OutputTreeNode::get_strings() const
 		PRINT_WARNING << "[OutputTreeNode] Tried to get strings, but is not a STRINGS node!" << DEBUG_INFO << std::endl;
 		return shared_strings();
 	}
-
-	if (!_strings_data || !*_strings_data)
-	{
-		PRINT_WARNING << "[OutputTreeNode] A STRINGS node's data is empty!" << DEBUG_INFO << std::endl;
-		return shared_strings();
+	const arena_strings& data = boost::get<arena_strings>(_data);
+	shared_strings res(new strings);
+	res->reserve(data.size());
+	for (arena_strings::const_iterator it = data.begin() ; it != data.end() ; ++it) {
+		res->push_back(std::string(it->data(), it->size()));
 	}
-
-	return shared_strings(new strings(**_strings_data));
+	return res;
 }
 
 // ----------------------------------------------------------------------------
@@ -187,11 +236,7 @@ void OutputTreeNode::append(pNode node)
 		PRINT_WARNING << "[OutputTreeNode] Tried to append a node, but is not a list of nodes!" << DEBUG_INFO << std::endl;
 		return;
 	}
-
-	if (!_list_data || !*_list_data) {
-		_list_data = boost::make_shared<boost::optional<nodes> >(nodes());
-	}
-	(*_list_data)->push_back(node);
+	boost::get<arena_nodes>(_data).push_back(node);
 }
 
 // ----------------------------------------------------------------------------
@@ -203,13 +248,8 @@ pNodes OutputTreeNode::get_children() const
 		PRINT_WARNING << "[OutputTreeNode] Tried to get the children of a non-LIST node!" << std::endl;
 		return pNodes();
 	}
-	if (!_list_data || !*_list_data)
-	{
-		PRINT_WARNING << "[OutputTreeNode] A LIST node's data is empty!" << std::endl;
-		return pNodes();
-	}
-
-	return boost::make_shared<nodes>(**_list_data);
+	const arena_nodes& children = boost::get<arena_nodes>(_data);
+	return boost::make_shared<nodes>(children.begin(), children.end());
 }
 
 // ----------------------------------------------------------------------------
@@ -221,13 +261,7 @@ unsigned int OutputTreeNode::size() const
 		PRINT_WARNING << "[OutputTreeNode] Tried to get the children of a non-LIST node!" << std::endl;
 		return 0;
 	}
-	if (!_list_data || !*_list_data)
-	{
-		PRINT_WARNING << "[OutputTreeNode] A LIST node's data is empty!" << std::endl;
-		return 0;
-	}
-
-	return (*_list_data)->size();
+	return boost::get<arena_nodes>(_data).size();
 }
 
 // ----------------------------------------------------------------------------
@@ -239,14 +273,7 @@ void OutputTreeNode::clear()
 		PRINT_WARNING << "[OutputTreeNode] Tried to clear a non-LIST node!" << std::endl;
 		return;
 	}
-
-	if (!_list_data || !*_list_data)
-	{
-		PRINT_WARNING << "[OutputTreeNode] A LIST node's data is empty!" << std::endl;
-		return;
-	}
-
-	(*_list_data)->clear();
+	boost::get<arena_nodes>(_data).clear();
 }
 
 // ----------------------------------------------------------------------------
@@ -258,13 +285,7 @@ void OutputTreeNode::update_value(const std::string& s)
 		PRINT_WARNING << "[OutputTreeNode] Tried to set a string in a non-STRING node!" << std::endl;
 		return;
 	}
-	if (!_string_data || !*_string_data)
-	{
-		PRINT_WARNING << "[OutputTreeNode] A STRING node's data is empty!" << std::endl;
-		return;
-	}
-
-	*_string_data = boost::optional<std::string>(s);
+	boost::get<arena_string>(_data).assign(s.begin(), s.end()); // Keeps the string in the node's arena.
 }
 
 // ----------------------------------------------------------------------------
@@ -276,13 +297,7 @@ void OutputTreeNode::update_value(plugin::LEVEL level)
 		PRINT_WARNING << "[OutputTreeNode] Tried to set a LEVEL in a non-THREAT_LEVEL node!" << std::endl;
 		return;
 	}
-	if (!_level_data || !*_level_data)
-	{
-		PRINT_WARNING << "[OutputTreeNode] A LEVEL node's data is empty!" << std::endl;
-		return;
-	}
-
-	*_level_data = boost::optional<plugin::LEVEL>(level);
+	_data = static_cast<boost::uint64_t>(level);
 }
 
 // ----------------------------------------------------------------------------
@@ -294,13 +309,7 @@ shared_strings OutputTreeNode::get_strings()
 		PRINT_WARNING << "[OutputTreeNode] Tried to get the strings of a non-STRING node!" << std::endl;
 		return shared_strings();
 	}
-	if (!_strings_data || !*_strings_data)
-	{
-		PRINT_WARNING << "[OutputTreeNode] A STRINGS node's data is empty!" << std::endl;
-		return shared_strings();
-	}
-
-	return shared_strings(new strings(**_strings_data));
+	return static_cast<const OutputTreeNode&>(*this).get_strings();
 }
 
 // ----------------------------------------------------------------------------
@@ -312,11 +321,8 @@ void OutputTreeNode::append(const std::string& s)
 		PRINT_WARNING << "[OutputTreeNode] Tried to append a string, but is not a list of strings!" << std::endl;
 		return;
 	}
-
-	if (!_strings_data || !*_strings_data) {
-		_strings_data = boost::make_shared<boost::optional<strings> >(strings());
-	}
-	(*_strings_data)->push_back(s);
+	arena_strings& data = boost::get<arena_strings>(_data);
+	data.push_back(arena_string(s.begin(), s.end(), data.get_allocator()));
 }
 
 // ----------------------------------------------------------------------------
@@ -328,12 +334,9 @@ void OutputTreeNode::append(const strings& strs)
 		PRINT_WARNING << "[OutputTreeNode] Tried to append strings, but is not a list of strings!" << std::endl;
 		return;
 	}
-
-	if (!_strings_data || !*_strings_data) {
-		_strings_data = boost::make_shared<boost::optional<strings> >(strings(strs));
-	}
-	else {
-		(*_strings_data)->insert((*_strings_data)->end(), strs.begin(), strs.end());
+	arena_strings& data = boost::get<arena_strings>(_data);
+	for (strings::const_iterator it = strs.begin() ; it != strs.end() ; ++it) {
+		data.push_back(arena_string(it->begin(), it->end(), data.get_allocator()));
 	}
 }
 
@@ -19,8 +19,8 @@
 
 namespace mana {
 
-PE::PE(const std::string& path)
-	: _path(path), _initialized(false)
+PE::PE(const std::string& path, unsigned int components)
+	: _path(path), _initialized(false), _components(components)
 {
 	FILE* f = fopen(_path.c_str(), "rb");
 	if (f == nullptr)
@@ -53,15 +53,17 @@ PE::PE(const std::string& path)
 
 	// Failure is acceptable from here on.
 	_initialized = true;
-	_parse_coff_symbols();
+	if (_components & COMPONENT_COFF_SYMBOLS) {
+		_parse_coff_symbols();
+	}
 	_parse_directories();
 }
 
 
 // ----------------------------------------------------------------------------
 
-boost::shared_ptr<PE> PE::create(const std::string& path) {
-	return boost::make_shared<PE>(path);
+boost::shared_ptr<PE> PE::create(const std::string& path, unsigned int components) {
+	return boost::make_shared<PE>(path, components);
 }
 
 // ----------------------------------------------------------------------------
@@ -407,6 +409,21 @@ bool PE::_parse_debug()
 			pdb.PdbFileName = utils::read_ascii_string(_file_handle.get());	// Not optimal, but it'll help if I decide to
 																			// further parse these debug sub-structures.
 			debug->Filename = pdb.PdbFileName;
+			if (pdb.Signature == 0x53445352) // The GUID matches the one of the PDB file.
+			{
+				// The first three fields of the GUID are little-endian integers.
+				static const int order[16] = { 3, 2, 1, 0, 5, 4, 7, 6, 8, 9, 10, 11, 12, 13, 14, 15 };
+				std::stringstream ss;
+				ss << std::hex << std::uppercase << std::setfill('0');
+				for (int j = 0 ; j < 16 ; ++j)
+				{
+					if (j == 4 || j == 6 || j == 8 || j == 10) {
+						ss << "-";
+					}
+					ss << std::setw(2) << static_cast<unsigned int>(pdb.Guid[order[j]]);
+				}
+				debug->PdbGuid = ss.str();
+			}
 			fseek(_file_handle.get(), saved_offset, SEEK_SET);
 		}
 		else if (debug->Type == nt::DEBUG_TYPES.at("IMAGE_DEBUG_TYPE_MISC"))
@@ -568,15 +585,14 @@ bool PE::_parse_directories()
 		return false;
 	}
 
-	return _parse_imports() &&
-		   _parse_delayed_imports() &&
-		   _parse_exports() &&
-		   _parse_resources() &&
-		   _parse_debug() &&
-		   _parse_relocations() &&
-		   _parse_tls() &&
-		   _parse_config() &&
-		   _parse_certificates();
+	return (!(_components & COMPONENT_IMPORTS) || (_parse_imports() && _parse_delayed_imports())) &&
+		   (!(_components & COMPONENT_EXPORTS) || _parse_exports()) &&
+		   (!(_components & COMPONENT_RESOURCES) || _parse_resources()) &&
+		   (!(_components & COMPONENT_DEBUG) || _parse_debug()) &&
+		   (!(_components & COMPONENT_RELOCATIONS) || _parse_relocations()) &&
+		   (!(_components & COMPONENT_TLS) || _parse_tls()) &&
+		   (!(_components & COMPONENT_CONFIG) || _parse_config()) &&
+		   (!(_components & COMPONENT_CERTIFICATES) || _parse_certificates());
 }
 
 // ----------------------------------------------------------------------------
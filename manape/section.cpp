@@ -20,6 +20,14 @@
 namespace mana
 {
 
+namespace {
+
+// Sections share the file handle of their PE: reading from it must be serialized, since
+// the application may analyze a PE from multiple threads.
+boost::mutex file_handle_mutex;
+
+} // !namespace
+
 Section::Section(const image_section_header& header,
 				 pFile handle,
 				 boost::uint64_t file_size,
@@ -37,9 +45,12 @@ Section::Section(const image_section_header& header,
 		_file_size(file_size)
 {
 	_name = std::string((char*) header.Name);
-	pString escaped = io::escape(_name);
-	if (escaped != nullptr)	{
-		_name = *escaped;
+	if (io::needs_escaping(_name))
+	{
+		pString escaped = io::escape(_name);
+		if (escaped != nullptr)	{
+			_name = *escaped;
+		}
 	}
 
 	if (_name.size() > 0 && _name[0] == '/')
@@ -76,10 +87,6 @@ shared_bytes Section::get_raw_data() const
 		PRINT_WARNING << "Section " << _name << " is larger than the executable!" << DEBUG_INFO << std::endl;
 		return res;
 	}
-	if (fseek(_file_handle.get(), _pointer_to_raw_data, SEEK_SET)) {
-		return res;
-	}
-
 	try {
 		res->resize(_size_of_raw_data);
 	}
@@ -91,6 +98,12 @@ shared_bytes Section::get_raw_data() const
 		return res;
 	}
 
+	boost::lock_guard<boost::mutex> lock(file_handle_mutex);
+	if (fseek(_file_handle.get(), _pointer_to_raw_data, SEEK_SET))
+	{
+		res->resize(0);
+		return res;
+	}
 	if (_size_of_raw_data != fread(&(*res)[0], 1, _size_of_raw_data, _file_handle.get()))
 	{
 		PRINT_WARNING << "Raw bytes from section " << _name << " could not be obtained." << std::endl;
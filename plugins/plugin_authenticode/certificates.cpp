@@ -0,0 +1,283 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "plugins/plugin_authenticode/certificates.h"
+
+#include <boost/make_shared.hpp>
+
+#include "hash-library/sha1.h"
+#include "manacommons/hex.h"
+
+namespace plugin {
+
+namespace {
+
+const std::string OID_SIGNING_TIME("\x2A\x86\x48\x86\xF7\x0D\x01\x09\x05", 9);		// 1.2.840.113549.1.9.5
+const std::string OID_COUNTER_SIGNATURE("\x2A\x86\x48\x86\xF7\x0D\x01\x09\x06", 9);	// 1.2.840.113549.1.9.6
+const std::string OID_RFC3161_TIMESTAMP("\x2B\x06\x01\x04\x01\x82\x37\x03\x03\x01", 10);	// 1.3.6.1.4.1.311.3.3.1
+
+// The deepest nesting of counter-signatures which is looked at. Legitimate signatures nest them
+// once or twice, but crafted ones could otherwise exhaust the stack.
+const unsigned int MAX_COUNTER_SIGNATURE_DEPTH = 8;
+
+/**
+ *	@brief	The fields of a SignerInfo used by the plugin.
+ */
+struct signer_info
+{
+	der::element issuer;
+	der::element serial;
+	der::element authenticated_attributes;		// Empty if absent.
+	der::element unauthenticated_attributes;	// Empty if absent.
+};
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Parses the TBSCertificate of a certificate.
+ */
+bool parse_certificate(const der::element& certificate, certificate_info& info)
+{
+	// Certificate ::= SEQUENCE { tbsCertificate, signatureAlgorithm, signatureValue }
+	// TBSCertificate ::= SEQUENCE { [0] EXPLICIT version OPTIONAL, serialNumber, signature, issuer, validity, subject, ... }
+	der::element tbs, serial, issuer, validity, subject, not_before, not_after;
+	if (!der::Reader(certificate).next(der::SEQUENCE, tbs)) {
+		return false;
+	}
+	der::Reader reader(tbs);
+	reader.skip(der::CONTEXT_0);
+	if (!reader.next(der::INTEGER, serial) ||
+		!reader.skip(der::SEQUENCE) ||
+		!reader.next(der::SEQUENCE, issuer) ||
+		!reader.next(der::SEQUENCE, validity) ||
+		!reader.next(der::SEQUENCE, subject))
+	{
+		return false;
+	}
+	der::Reader dates(validity);
+	if (!dates.next(not_before) || !dates.next(not_after)) {
+		return false;
+	}
+
+	info.serial = io::to_hex(serial.data, serial.size);
+	info.issuer = der::read_name(issuer);
+	info.subject = der::read_name(subject);
+	info.not_before = der::read_time(not_before);
+	info.not_after = der::read_time(not_after);
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Reads a SignerInfo.
+ *
+ *	SignerInfo ::= SEQUENCE { version, issuerAndSerialNumber, digestAlgorithm,
+ *							  [0] IMPLICIT authenticatedAttributes OPTIONAL,
+ *							  digestEncryptionAlgorithm, encryptedDigest,
+ *							  [1] IMPLICIT unauthenticatedAttributes OPTIONAL }
+ */
+bool read_signer_info(const der::element& e, signer_info& info)
+{
+	der::element issuer_and_serial;
+	der::Reader reader(e);
+	if (!reader.skip(der::INTEGER) || !reader.next(der::SEQUENCE, issuer_and_serial)) {
+		return false;
+	}
+	der::Reader id(issuer_and_serial);
+	if (!id.next(der::SEQUENCE, info.issuer) || !id.next(der::INTEGER, info.serial) || !reader.skip(der::SEQUENCE)) {
+		return false;
+	}
+	reader.next(der::CONTEXT_0, info.authenticated_attributes);
+	if (!reader.skip(der::SEQUENCE) || !reader.skip(der::OCTET_STRING)) {
+		return false;
+	}
+	reader.next(der::CONTEXT_1, info.unauthenticated_attributes);
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Reads the generation time of an RFC 3161 timestamp token.
+ */
+std::string read_timestamp_token(const der::element& token)
+{
+	// SignedData ::= SEQUENCE { version, digestAlgorithms, encapContentInfo, ... }
+	// encapContentInfo ::= SEQUENCE { id-ct-TSTInfo, [0] EXPLICIT OCTET STRING }
+	// TSTInfo ::= SEQUENCE { version, policy, messageImprint, serialNumber, genTime, ... }
+	der::element signed_data, content_info, wrapper, octets, tst_info, gen_time;
+	if (!der::read_signed_data(token.header, token.total_size(), signed_data)) {
+		return "";
+	}
+	der::Reader reader(signed_data);
+	if (!reader.skip(der::INTEGER) || !reader.skip(der::SET) || !reader.next(der::SEQUENCE, content_info)) {
+		return "";
+	}
+	der::Reader content(content_info);
+	if (!content.skip(der::OID) || !content.next(der::CONTEXT_0, wrapper) ||
+		!der::Reader(wrapper).next(der::OCTET_STRING, octets) ||
+		!der::Reader(octets).next(der::SEQUENCE, tst_info))
+	{
+		return "";
+	}
+	der::Reader tst(tst_info);
+	if (!tst.skip(der::INTEGER) || !tst.skip(der::OID) || !tst.skip(der::SEQUENCE) || !tst.skip(der::INTEGER) ||
+		!tst.next(der::GENERALIZED_TIME, gen_time))
+	{
+		return "";
+	}
+	return der::read_time(gen_time);
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Looks for the signing time in the attributes of a SignerInfo.
+ *
+ *	The time can be found in a signingTime attribute (usually in the authenticated attributes
+ *	of a counter-signature) or in an RFC 3161 timestamp token.
+ *
+ *	@param	const der::element& attributes The [0] or [1] SET OF Attribute.
+ *	@param	unsigned int depth The number of counter-signatures these attributes are nested in.
+ *			Counter-signatures nested more than MAX_COUNTER_SIGNATURE_DEPTH times are ignored.
+ */
+std::string find_signing_time(const der::element& attributes, unsigned int depth = 0)
+{
+	// Attribute ::= SEQUENCE { type, SET OF values }
+	der::Reader reader(attributes);
+	der::element attribute;
+	while (reader.next(der::SEQUENCE, attribute))
+	{
+		der::element type, values, value;
+		der::Reader fields(attribute);
+		if (!fields.next(der::OID, type) || !fields.next(der::SET, values) || !der::Reader(values).next(value)) {
+			continue;
+		}
+
+		std::string time;
+		if (type.is_oid(OID_SIGNING_TIME)) {
+			time = der::read_time(value);
+		}
+		else if (type.is_oid(OID_COUNTER_SIGNATURE) && depth < MAX_COUNTER_SIGNATURE_DEPTH)
+		{
+			signer_info counter_signer;
+			if (read_signer_info(value, counter_signer) && counter_signer.authenticated_attributes.data) {
+				time = find_signing_time(counter_signer.authenticated_attributes, depth + 1);
+			}
+		}
+		else if (type.is_oid(OID_RFC3161_TIMESTAMP)) {
+			time = read_timestamp_token(value);
+		}
+
+		if (!time.empty()) {
+			return time;
+		}
+	}
+	return "";
+}
+
+} // !anonymous namespace
+
+// ----------------------------------------------------------------------------
+
+pcertificate_info CertificateCache::get(const der::element& certificate)
+{
+	SHA1 sha1;
+	sha1.add(certificate.header, certificate.total_size());
+	std::string thumbprint = sha1.getHash();
+
+	{
+		boost::mutex::scoped_lock lock(_mutex);
+		auto it = _certificates.find(thumbprint);
+		if (it != _certificates.end()) {
+			return it->second;
+		}
+	}
+
+	// Parse the certificate without holding the lock.
+	auto info = boost::make_shared<certificate_info>();
+	if (!parse_certificate(certificate, *info)) {
+		return pcertificate_info();
+	}
+	info->thumbprint = thumbprint;
+
+	boost::mutex::scoped_lock lock(_mutex);
+	if (_certificates.size() < _max_size) {
+		_certificates[thumbprint] = info;
+	}
+	return info;
+}
+
+// ----------------------------------------------------------------------------
+
+bool read_signature(const std::vector<boost::uint8_t>& pkcs7, CertificateCache& cache, signature_info& info)
+{
+	// SignedData ::= SEQUENCE { version, digestAlgorithms, contentInfo,
+	//							 [0] IMPLICIT certificates OPTIONAL, [1] IMPLICIT crls OPTIONAL,
+	//							 signerInfos }
+	der::element signed_data, certificates, signer_infos, first_signer;
+	if (pkcs7.empty() || !der::read_signed_data(&pkcs7[0], pkcs7.size(), signed_data)) {
+		return false;
+	}
+	der::Reader reader(signed_data);
+	if (!reader.skip(der::INTEGER) || !reader.skip(der::SET) || !reader.skip(der::SEQUENCE)) {
+		return false;
+	}
+	if (reader.next(der::CONTEXT_0, certificates))
+	{
+		der::Reader certs(certificates);
+		der::element certificate;
+		while (certs.next(der::SEQUENCE, certificate))
+		{
+			pcertificate_info c = cache.get(certificate);
+			if (c) {
+				info.certificates.push_back(c);
+			}
+		}
+	}
+	reader.skip(der::CONTEXT_1);
+	if (!reader.next(der::SET, signer_infos) || !der::Reader(signer_infos).next(der::SEQUENCE, first_signer)) {
+		return false;
+	}
+
+	signer_info signer;
+	if (!read_signer_info(first_signer, signer)) {
+		return false;
+	}
+
+	// The signer's certificate is identified by its issuer and its serial number.
+	std::string issuer = der::read_name(signer.issuer);
+	std::string serial = io::to_hex(signer.serial.data, signer.serial.size);
+	for (auto it = info.certificates.begin() ; it != info.certificates.end() ; ++it)
+	{
+		if ((*it)->serial == serial && (*it)->issuer == issuer)
+		{
+			info.signer = *it;
+			break;
+		}
+	}
+
+	if (signer.authenticated_attributes.data) {
+		info.signing_time = find_signing_time(signer.authenticated_attributes);
+	}
+	if (info.signing_time.empty() && signer.unauthenticated_attributes.data) {
+		info.signing_time = find_signing_time(signer.unauthenticated_attributes);
+	}
+	return true;
+}
+
+} // !namespace plugin
@@ -0,0 +1,106 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "plugins/plugin_authenticode/der.h"
+
+namespace plugin {
+
+/**
+ *	@brief	The information extracted from an X.509 certificate.
+ */
+typedef struct certificate_info_t
+{
+	std::string thumbprint;		// The SHA1 of the certificate.
+	std::string subject;
+	std::string issuer;
+	std::string serial;			// As a hexadecimal string.
+	std::string not_before;
+	std::string not_after;
+} certificate_info;
+typedef boost::shared_ptr<const certificate_info> pcertificate_info;
+
+/**
+ *	@brief	The information extracted from an Authenticode signature.
+ */
+typedef struct signature_info_t
+{
+	pcertificate_info				signer;			// NULL if the signer's certificate isn't embedded.
+	std::string						signing_time;	// Empty if the signature isn't timestamped.
+	std::vector<pcertificate_info>	certificates;	// All the certificates embedded in the signature.
+} signature_info;
+
+/**
+ *	@brief	Parses X.509 certificates, and keeps the results indexed by thumbprint.
+ *
+ *	The same certificates are found in many binaries: a certificate which was already seen
+ *	only costs its SHA1 and a lookup.
+ *	This class is thread-safe.
+ */
+class CertificateCache
+{
+public:
+	/**
+	 *	@param	size_t max_size The maximum number of certificates kept. Certificates seen
+	 *			after the cache is full are still parsed, but not kept.
+	 */
+	explicit CertificateCache(size_t max_size) : _max_size(max_size) {}
+
+	/**
+	 *	@brief	Returns the information contained in a certificate.
+	 *
+	 *	@param	const der::element& certificate The Certificate SEQUENCE.
+	 *
+	 *	@return	The information about the certificate, or NULL if it is malformed.
+	 */
+	pcertificate_info get(const der::element& certificate);
+
+	size_t size() const
+	{
+		boost::mutex::scoped_lock lock(_mutex);
+		return _certificates.size();
+	}
+
+private:
+	boost::unordered_map<std::string, pcertificate_info>	_certificates;
+	size_t													_max_size;
+	mutable boost::mutex									_mutex;
+};
+
+/**
+ *	@brief	Reads the signer, the certificates and the signing time of an Authenticode signature.
+ *
+ *	Only the first signer is considered. The signature itself is not verified.
+ *
+ *	@param	const std::vector<boost::uint8_t>& pkcs7 The contents of a WIN_CERTIFICATE of type
+ *			WIN_CERT_TYPE_PKCS_SIGNED_DATA.
+ *	@param	CertificateCache& cache The cache used to parse the embedded certificates.
+ *	@param	signature_info& info The structure to fill.
+ *
+ *	@return	Whether the signature could be read.
+ */
+bool read_signature(const std::vector<boost::uint8_t>& pkcs7, CertificateCache& cache, signature_info& info);
+
+} // !namespace plugin
@@ -0,0 +1,309 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "plugins/plugin_authenticode/der.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+namespace plugin {
+namespace der {
+
+namespace {
+
+const std::string OID_SIGNED_DATA("\x2A\x86\x48\x86\xF7\x0D\x01\x07\x02", 9); // 1.2.840.113549.1.7.2
+
+/**
+ *	The attribute types which may be found in a Name, with their usual abbreviation.
+ */
+struct attribute_type
+{
+	const char*		name;
+	std::string		oid;
+};
+
+const attribute_type ATTRIBUTE_TYPES[] = {
+	{ "CN",		std::string("\x55\x04\x03", 3) },								// 2.5.4.3
+	{ "C",		std::string("\x55\x04\x06", 3) },								// 2.5.4.6
+	{ "L",		std::string("\x55\x04\x07", 3) },								// 2.5.4.7
+	{ "ST",		std::string("\x55\x04\x08", 3) },								// 2.5.4.8
+	{ "O",		std::string("\x55\x04\x0A", 3) },								// 2.5.4.10
+	{ "OU",		std::string("\x55\x04\x0B", 3) },								// 2.5.4.11
+	{ "E",		std::string("\x2A\x86\x48\x86\xF7\x0D\x01\x09\x01", 9) },		// 1.2.840.113549.1.9.1
+};
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Appends a Unicode code point to a UTF-8 string.
+ */
+void append_utf8(std::string& out, boost::uint32_t c)
+{
+	if (c < 0x80) {
+		out += static_cast<char>(c);
+	}
+	else if (c < 0x800)
+	{
+		out += static_cast<char>(0xC0 | (c >> 6));
+		out += static_cast<char>(0x80 | (c & 0x3F));
+	}
+	else
+	{
+		out += static_cast<char>(0xE0 | (c >> 12));
+		out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+		out += static_cast<char>(0x80 | (c & 0x3F));
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Reads a number made of ASCII digits.
+ */
+bool read_digits(const boost::uint8_t* p, size_t count, unsigned int& value)
+{
+	value = 0;
+	for (size_t i = 0 ; i < count ; ++i)
+	{
+		if (p[i] < '0' || p[i] > '9') {
+			return false;
+		}
+		value = value * 10 + (p[i] - '0');
+	}
+	return true;
+}
+
+} // !anonymous namespace
+
+// ----------------------------------------------------------------------------
+
+bool element::is_oid(const std::string& oid) const {
+	return tag == OID && size == oid.size() && memcmp(data, oid.data(), size) == 0;
+}
+
+// ----------------------------------------------------------------------------
+
+bool element::operator==(const element& other) const {
+	return total_size() == other.total_size() && memcmp(header, other.header, total_size()) == 0;
+}
+
+// ----------------------------------------------------------------------------
+
+bool Reader::next(element& e)
+{
+	if (_end - _cursor < 2) {
+		return false;
+	}
+	const boost::uint8_t* p = _cursor;
+	boost::uint8_t tag = *p++;
+	if ((tag & 0x1F) == 0x1F) // High tag numbers aren't used by Authenticode.
+	{
+		_cursor = _end;
+		return false;
+	}
+
+	size_t length = *p++;
+	if (length & 0x80) // Long form: the low bits give the number of bytes of the length.
+	{
+		size_t length_size = length & 0x7F;
+		if (length_size == 0 || length_size > sizeof(boost::uint32_t) || static_cast<size_t>(_end - p) < length_size)
+		{
+			_cursor = _end; // Indefinite lengths are forbidden in DER.
+			return false;
+		}
+		length = 0;
+		for (size_t i = 0 ; i < length_size ; ++i) {
+			length = (length << 8) | *p++;
+		}
+	}
+	if (static_cast<size_t>(_end - p) < length)
+	{
+		_cursor = _end;
+		return false;
+	}
+
+	e.tag = tag;
+	e.header = _cursor;
+	e.data = p;
+	e.size = length;
+	_cursor = p + length;
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool Reader::next(boost::uint8_t tag, element& e)
+{
+	if (at_end() || *_cursor != tag) {
+		return false;
+	}
+	return next(e);
+}
+
+// ----------------------------------------------------------------------------
+
+bool read_signed_data(const boost::uint8_t* data, size_t size, element& signed_data)
+{
+	element content_info, type, wrapper;
+	Reader reader(data, size);
+	if (!reader.next(SEQUENCE, content_info)) {
+		return false;
+	}
+	Reader content(content_info);
+	return content.next(OID, type) && type.is_oid(OID_SIGNED_DATA) &&
+		   content.next(CONTEXT_0, wrapper) &&
+		   Reader(wrapper).next(SEQUENCE, signed_data);
+}
+
+// ----------------------------------------------------------------------------
+
+std::string oid_to_string(const element& oid)
+{
+	std::stringstream ss;
+	boost::uint64_t value = 0;
+	bool first = true;
+	for (size_t i = 0 ; i < oid.size ; ++i)
+	{
+		value = (value << 7) | (oid.data[i] & 0x7F);
+		if (oid.data[i] & 0x80) {
+			continue;
+		}
+		if (first)
+		{
+			// The first value encodes the first two arcs.
+			boost::uint64_t root = std::min<boost::uint64_t>(value / 40, 2);
+			ss << root << "." << value - 40 * root;
+			first = false;
+		}
+		else {
+			ss << "." << value;
+		}
+		value = 0;
+	}
+	return ss.str();
+}
+
+// ----------------------------------------------------------------------------
+
+std::string read_string(const element& e)
+{
+	switch (e.tag)
+	{
+		case 0x0C: // UTF8String
+		case 0x13: // PrintableString
+		case 0x16: // IA5String
+			return std::string(reinterpret_cast<const char*>(e.data), e.size);
+		case 0x14: // TeletexString, which is treated as Latin-1 by everyone in practice.
+		{
+			std::string res;
+			for (size_t i = 0 ; i < e.size ; ++i) {
+				append_utf8(res, e.data[i]);
+			}
+			return res;
+		}
+		case 0x1E: // BMPString (UTF-16BE)
+		{
+			std::string res;
+			for (size_t i = 0 ; i + 1 < e.size ; i += 2) {
+				append_utf8(res, (e.data[i] << 8) | e.data[i + 1]);
+			}
+			return res;
+		}
+		default:
+			return "";
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+std::string read_name(const element& name)
+{
+	// Name ::= SEQUENCE OF SET OF AttributeTypeAndValue
+	// The most specific attribute is written first, as in RFC 4514.
+	std::vector<std::string> attributes;
+	Reader rdns(name);
+	element rdn;
+	while (rdns.next(SET, rdn))
+	{
+		Reader atvs(rdn);
+		element atv;
+		while (atvs.next(SEQUENCE, atv))
+		{
+			Reader fields(atv);
+			element type, value;
+			if (!fields.next(OID, type) || !fields.next(value)) {
+				continue;
+			}
+
+			std::string attribute = oid_to_string(type);
+			for (const attribute_type& t : ATTRIBUTE_TYPES)
+			{
+				if (type.is_oid(t.oid))
+				{
+					attribute = t.name;
+					break;
+				}
+			}
+			attributes.push_back(attribute + "=" + read_string(value));
+		}
+	}
+
+	std::stringstream ss;
+	for (auto it = attributes.rbegin() ; it != attributes.rend() ; ++it)
+	{
+		if (it != attributes.rbegin()) {
+			ss << ", ";
+		}
+		ss << *it;
+	}
+	return ss.str();
+}
+
+// ----------------------------------------------------------------------------
+
+std::string read_time(const element& time)
+{
+	// UTCTime: YYMMDDHHMMSSZ. GeneralizedTime: YYYYMMDDHHMMSS[.fff]Z.
+	size_t year_digits = time.tag == UTC_TIME ? 2 : 4;
+	if ((time.tag != UTC_TIME && time.tag != GENERALIZED_TIME) || time.size < year_digits + 10) {
+		return "";
+	}
+
+	unsigned int year, month, day, hour, minute, second;
+	const boost::uint8_t* p = time.data;
+	if (!read_digits(p, year_digits, year) ||
+		!read_digits(p + year_digits, 2, month) ||
+		!read_digits(p + year_digits + 2, 2, day) ||
+		!read_digits(p + year_digits + 4, 2, hour) ||
+		!read_digits(p + year_digits + 6, 2, minute) ||
+		!read_digits(p + year_digits + 8, 2, second))
+	{
+		return "";
+	}
+	if (time.tag == UTC_TIME) { // RFC 5280: years 50 to 99 belong to the 20th century.
+		year += year < 50 ? 2000 : 1900;
+	}
+
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%04u-%02u-%02u %02u:%02u:%02u", year, month, day, hour, minute, second);
+	return buffer;
+}
+
+} // !namespace der
+} // !namespace plugin
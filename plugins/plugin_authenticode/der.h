@@ -0,0 +1,173 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <string>
+
+#include <boost/cstdint.hpp>
+
+namespace plugin {
+namespace der {
+
+/**
+ *	The DER tags found in Authenticode signatures.
+ */
+const boost::uint8_t INTEGER			= 0x02;
+const boost::uint8_t BIT_STRING			= 0x03;
+const boost::uint8_t OCTET_STRING		= 0x04;
+const boost::uint8_t OID				= 0x06;
+const boost::uint8_t UTC_TIME			= 0x17;
+const boost::uint8_t GENERALIZED_TIME	= 0x18;
+const boost::uint8_t SEQUENCE			= 0x30;
+const boost::uint8_t SET				= 0x31;
+const boost::uint8_t CONTEXT_0			= 0xA0; // [0], constructed
+const boost::uint8_t CONTEXT_1			= 0xA1; // [1], constructed
+
+/**
+ *	@brief	A DER element.
+ *
+ *	The element points into the buffer it was read from: nothing is copied, and the buffer must
+ *	outlive it.
+ */
+typedef struct element_t
+{
+	element_t() : tag(0), header(nullptr), data(nullptr), size(0) {}
+
+	boost::uint8_t			tag;
+	const boost::uint8_t*	header;		// The first byte of the element (its tag).
+	const boost::uint8_t*	data;		// The first byte of its contents.
+	size_t					size;		// The size of its contents.
+
+	/**
+	 *	@brief	The size of the whole element, header included.
+	 */
+	size_t total_size() const {
+		return data + size - header;
+	}
+
+	/**
+	 *	@brief	Checks whether the element is an OID with the given contents.
+	 *
+	 *	@param	const std::string& oid The encoded contents of the OID, without its header.
+	 */
+	bool is_oid(const std::string& oid) const;
+
+	/**
+	 *	@brief	Compares the encoding of two elements.
+	 */
+	bool operator==(const element_t& other) const;
+} element;
+
+/**
+ *	@brief	Iterates over a sequence of DER elements without allocating any memory.
+ *
+ *	The reader stops at the first malformed element: every subsequent call to next fails.
+ */
+class Reader
+{
+public:
+	/**
+	 *	@brief	Reads the elements contained in a buffer.
+	 */
+	Reader(const boost::uint8_t* data, size_t size) : _cursor(data), _end(data + size) {}
+
+	/**
+	 *	@brief	Reads the children of a constructed element (SEQUENCE, SET, [0], ...).
+	 */
+	explicit Reader(const element& parent) : _cursor(parent.data), _end(parent.data + parent.size) {}
+
+	/**
+	 *	@brief	Reads the next element.
+	 *
+	 *	@param	element& e The element to fill.
+	 *
+	 *	@return	Whether an element was read.
+	 */
+	bool next(element& e);
+
+	/**
+	 *	@brief	Reads the next element, which must have the given tag.
+	 *
+	 *	The reader doesn't move if the element has another tag, so that optional elements can be
+	 *	tested this way.
+	 *
+	 *	@param	boost::uint8_t tag The expected tag.
+	 *	@param	element& e The element to fill.
+	 *
+	 *	@return	Whether an element with this tag was read.
+	 */
+	bool next(boost::uint8_t tag, element& e);
+
+	/**
+	 *	@brief	Skips the next element, which must have the given tag.
+	 */
+	bool skip(boost::uint8_t tag)
+	{
+		element ignored;
+		return next(tag, ignored);
+	}
+
+	bool at_end() const {
+		return _cursor >= _end;
+	}
+
+private:
+	const boost::uint8_t*	_cursor;
+	const boost::uint8_t*	_end;
+};
+
+/**
+ *	@brief	Reads the SignedData contained in a PKCS#7 ContentInfo.
+ *
+ *	ContentInfo ::= SEQUENCE { contentType (signedData), [0] EXPLICIT SignedData }
+ *
+ *	@param	const boost::uint8_t* data The encoded ContentInfo.
+ *	@param	size_t size The size of the encoded ContentInfo.
+ *	@param	element& signed_data The SignedData SEQUENCE.
+ *
+ *	@return	Whether a SignedData was found.
+ */
+bool read_signed_data(const boost::uint8_t* data, size_t size, element& signed_data);
+
+/**
+ *	@brief	Converts an OID to its dotted notation (i.e. "1.2.840.113549.1.7.2").
+ */
+std::string oid_to_string(const element& oid);
+
+/**
+ *	@brief	Decodes an ASN.1 string (UTF8String, PrintableString, BMPString, ...) to UTF-8.
+ *
+ *	@return	The decoded string, or an empty string if the element isn't a supported string type.
+ */
+std::string read_string(const element& e);
+
+/**
+ *	@brief	Formats an X.501 Name, i.e. "CN=Microsoft Corporation, O=Microsoft Corporation, C=US".
+ *
+ *	Attributes with an unknown type are written with their OID.
+ */
+std::string read_name(const element& name);
+
+/**
+ *	@brief	Formats a UTCTime or a GeneralizedTime as "YYYY-MM-DD HH:MM:SS".
+ *
+ *	@return	The formatted time, or an empty string if the element couldn't be read.
+ */
+std::string read_time(const element& time);
+
+} // !namespace der
+} // !namespace plugin
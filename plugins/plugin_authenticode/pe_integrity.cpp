@@ -0,0 +1,268 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "plugins/plugin_authenticode/pe_integrity.h"
+#include "plugins/plugin_authenticode/der.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <utility>
+
+#include <boost/shared_ptr.hpp>
+
+#include "hash-library/md5.h"
+#include "hash-library/sha1.h"
+#include "hash-library/sha256.h"
+
+#include "manape/nt_values.h"
+#include "manacommons/color.h"
+#include "manacommons/hex.h"
+
+namespace plugin {
+
+namespace {
+
+/**
+ *	The OID of the SpcIndirectDataContent structure, which contains the digest of the file.
+ */
+const std::string OID_SPC_INDIRECT_DATA("\x2B\x06\x01\x04\x01\x82\x37\x02\x01\x04", 10);	// 1.3.6.1.4.1.311.2.1.4
+
+/**
+ *	The digest algorithms an Authenticode signature may use.
+ *	The factory is NULL for the ones hash-library doesn't implement.
+ */
+typedef Hash* (*digest_factory)();
+template<class T> Hash* make_digest() { return new T(); }
+
+struct digest_algorithm
+{
+	const char*		name;
+	std::string		oid;
+	digest_factory	create;
+};
+
+const digest_algorithm DIGEST_ALGORITHMS[] = {
+	{ "MD5",	std::string("\x2A\x86\x48\x86\xF7\x0D\x02\x05", 8),		&make_digest<MD5> },
+	{ "SHA1",	std::string("\x2B\x0E\x03\x02\x1A", 5),						&make_digest<SHA1> },
+	{ "SHA256",	std::string("\x60\x86\x48\x01\x65\x03\x04\x02\x01", 9),	&make_digest<SHA256> },
+	{ "SHA384",	std::string("\x60\x86\x48\x01\x65\x03\x04\x02\x02", 9),	nullptr },
+	{ "SHA512",	std::string("\x60\x86\x48\x01\x65\x03\x04\x02\x03", 9),	nullptr },
+};
+
+// ----------------------------------------------------------------------------
+
+const digest_algorithm* find_algorithm(const std::string& name)
+{
+	for (const digest_algorithm& a : DIGEST_ALGORITHMS)
+	{
+		if (name == a.name) {
+			return &a;
+		}
+	}
+	return nullptr;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Folds the carries of a 16-bit one's complement sum.
+ */
+inline boost::uint64_t fold(boost::uint64_t sum) {
+	return (sum & 0xFFFF) + (sum >> 16);
+}
+
+} // !anonymous namespace
+
+// ----------------------------------------------------------------------------
+
+bool read_signed_digest(const std::vector<boost::uint8_t>& pkcs7, std::string& algorithm, std::string& digest)
+{
+	der::element signed_data;
+	if (pkcs7.empty() || !der::read_signed_data(&pkcs7[0], pkcs7.size(), signed_data)) {
+		return false;
+	}
+
+	// SignedData ::= SEQUENCE { version, digestAlgorithms, contentInfo, ... }
+	// contentInfo ::= SEQUENCE { SPC_INDIRECT_DATA_OBJID, [0] EXPLICIT SpcIndirectDataContent }
+	der::Reader reader(signed_data);
+	der::element content_info, type, wrapper, indirect_data;
+	if (!reader.skip(der::INTEGER) ||
+		!reader.skip(der::SET) ||
+		!reader.next(der::SEQUENCE, content_info))
+	{
+		return false;
+	}
+	der::Reader content(content_info);
+	if (!content.next(der::OID, type) || !type.is_oid(OID_SPC_INDIRECT_DATA) ||
+		!content.next(der::CONTEXT_0, wrapper) ||
+		!der::Reader(wrapper).next(der::SEQUENCE, indirect_data))
+	{
+		return false;
+	}
+
+	// SpcIndirectDataContent ::= SEQUENCE { data, messageDigest }
+	// DigestInfo ::= SEQUENCE { AlgorithmIdentifier, OCTET STRING }
+	der::Reader indirect(indirect_data);
+	der::element digest_info, algorithm_id, oid, value;
+	if (!indirect.skip(der::SEQUENCE) || !indirect.next(der::SEQUENCE, digest_info)) {
+		return false;
+	}
+	der::Reader info(digest_info);
+	if (!info.next(der::SEQUENCE, algorithm_id) ||
+		!der::Reader(algorithm_id).next(der::OID, oid) ||
+		!info.next(der::OCTET_STRING, value))
+	{
+		return false;
+	}
+
+	algorithm = der::oid_to_string(oid);
+	for (const digest_algorithm& a : DIGEST_ALGORITHMS)
+	{
+		if (oid.is_oid(a.oid))
+		{
+			algorithm = a.name;
+			break;
+		}
+	}
+	digest = io::to_hex(value.data, value.size);
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool compute_pe_digest(const mana::PE& pe, Hash* digest, boost::uint32_t& checksum, std::string& result)
+{
+	auto dos = pe.get_dos_header();
+	auto ioh = pe.get_image_optional_header();
+	if (!dos || !ioh) {
+		return false;
+	}
+
+	// Locate the parts of the file which are excluded from the digest.
+	boost::uint64_t ioh_offset = dos->e_lfanew + sizeof(mana::pe_header);
+	boost::uint64_t checksum_offset = ioh_offset + 64;
+	std::vector<std::pair<boost::uint64_t, boost::uint64_t> > excluded;
+	excluded.push_back(std::make_pair(checksum_offset, checksum_offset + sizeof(boost::uint32_t)));
+	if (ioh->NumberOfRvaAndSizes > IMAGE_DIRECTORY_ENTRY_SECURITY)
+	{
+		boost::uint64_t directories_offset = ioh_offset + (ioh->Magic == nt::IMAGE_OPTIONAL_HEADER_MAGIC.at("PE32+") ? 112 : 96);
+		boost::uint64_t entry = directories_offset + IMAGE_DIRECTORY_ENTRY_SECURITY * sizeof(mana::image_data_directory);
+		excluded.push_back(std::make_pair(entry, entry + sizeof(mana::image_data_directory)));
+
+		// For the security directory, VirtualAddress is a file offset.
+		const mana::image_data_directory& security = ioh->directories[IMAGE_DIRECTORY_ENTRY_SECURITY];
+		if (security.VirtualAddress != 0 && security.Size != 0)
+		{
+			boost::uint64_t table = security.VirtualAddress;
+			excluded.push_back(std::make_pair(table, table + security.Size));
+		}
+	}
+	std::sort(excluded.begin(), excluded.end());
+
+	FILE* f = fopen(pe.get_path()->c_str(), "rb");
+	if (f == nullptr)
+	{
+		PRINT_ERROR << "Could not open " << *pe.get_path() << "." << std::endl;
+		return false;
+	}
+	boost::shared_ptr<FILE> file(f, fclose);
+
+	if (digest != nullptr) {
+		digest->reset();
+	}
+
+	// The buffer size must be even, so that the words of the checksum never straddle two reads.
+	std::vector<boost::uint8_t> buffer(0x10000);
+	boost::uint64_t offset = 0;
+	boost::uint64_t sum = 0;
+	size_t read;
+	while ((read = fread(&buffer[0], 1, buffer.size(), file.get())) > 0)
+	{
+		boost::uint64_t chunk_end = offset + read;
+
+		// The CheckSum field counts as zero in the checksum. It isn't part of the digest either.
+		for (boost::uint64_t i = std::max(offset, checksum_offset) ; i < std::min(chunk_end, checksum_offset + 4) ; ++i) {
+			buffer[i - offset] = 0;
+		}
+
+		for (size_t i = 0 ; i + 1 < read ; i += 2) {
+			sum = fold(sum + (buffer[i] | (buffer[i + 1] << 8)));
+		}
+		if (read % 2) { // The last byte of an odd-sized file.
+			sum = fold(sum + buffer[read - 1]);
+		}
+
+		if (digest != nullptr)
+		{
+			boost::uint64_t position = offset;
+			for (auto it = excluded.begin() ; it != excluded.end() ; ++it)
+			{
+				if (it->second <= position || it->first >= chunk_end) {
+					continue;
+				}
+				if (it->first > position) {
+					digest->add(&buffer[position - offset], it->first - position);
+				}
+				position = std::min(it->second, chunk_end);
+			}
+			if (position < chunk_end) {
+				digest->add(&buffer[position - offset], chunk_end - position);
+			}
+		}
+		offset = chunk_end;
+	}
+
+	checksum = static_cast<boost::uint32_t>(fold(sum) + offset);
+	if (digest != nullptr) {
+		result = digest->getHash();
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool check_pe_integrity(const mana::PE& pe, pe_integrity& integrity)
+{
+	auto ioh = pe.get_image_optional_header();
+	if (!ioh) {
+		return false;
+	}
+	integrity.header_checksum = ioh->Checksum;
+
+	// Look for the first Authenticode signature.
+	auto certificates = pe.get_certificates();
+	if (certificates)
+	{
+		int pkcs7_type = nt::WIN_CERTIFICATE_TYPES.at("WIN_CERT_TYPE_PKCS_SIGNED_DATA");
+		for (auto it = certificates->begin() ; it != certificates->end() ; ++it)
+		{
+			if ((*it)->CertificateType == pkcs7_type &&
+				read_signed_digest((*it)->Certificate, integrity.digest_algorithm, integrity.signed_digest))
+			{
+				break;
+			}
+		}
+	}
+
+	boost::shared_ptr<Hash> digest;
+	const digest_algorithm* algorithm = find_algorithm(integrity.digest_algorithm);
+	if (algorithm != nullptr && algorithm->create != nullptr) {
+		digest.reset(algorithm->create());
+	}
+	return compute_pe_digest(pe, digest.get(), integrity.checksum, integrity.digest);
+}
+
+} // !namespace plugin
@@ -0,0 +1,88 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include "manape/pe.h"
+
+class Hash; // Defined in hash-library.
+
+namespace plugin {
+
+/**
+ *	@brief	The integrity data of a PE: its checksum and its Authenticode digest, as found in the
+ *			file and as computed by check_pe_integrity.
+ */
+typedef struct pe_integrity_t
+{
+	pe_integrity_t() : header_checksum(0), checksum(0) {}
+
+	boost::uint32_t	header_checksum;	// The CheckSum field of the optional header.
+	boost::uint32_t	checksum;			// The checksum of the file.
+	std::string		digest_algorithm;	// The algorithm used by the signature. Empty if the PE isn't signed.
+	std::string		signed_digest;		// The digest embedded in the PKCS#7 blob.
+	std::string		digest;				// The Authenticode digest of the file. Empty if the algorithm is unsupported.
+} pe_integrity;
+
+/**
+ *	@brief	Extracts the digest of the file from an Authenticode signature.
+ *
+ *	The digest is located in the SpcIndirectDataContent structure of the PKCS#7 SignedData.
+ *	The signature itself is not verified.
+ *
+ *	@param	const std::vector<boost::uint8_t>& pkcs7 The contents of a WIN_CERTIFICATE of type
+ *			WIN_CERT_TYPE_PKCS_SIGNED_DATA.
+ *	@param	std::string& algorithm The name of the digest algorithm (i.e. "SHA256"), or its OID
+ *			in dotted notation if it is unknown.
+ *	@param	std::string& digest The digest, as a lowercase hexadecimal string.
+ *
+ *	@return	Whether a digest was found.
+ */
+bool read_signed_digest(const std::vector<boost::uint8_t>& pkcs7, std::string& algorithm, std::string& digest);
+
+/**
+ *	@brief	Computes the checksum and the Authenticode digest of a PE in a single pass over the file.
+ *
+ *	The CheckSum field counts as zero in the checksum. The digest covers the whole file except
+ *	the CheckSum field, the security directory entry and the certificate table.
+ *
+ *	@param	const mana::PE& pe The PE to read.
+ *	@param	Hash* digest The digest to compute. May be NULL if only the checksum is needed.
+ *	@param	boost::uint32_t& checksum The computed checksum.
+ *	@param	std::string& result The computed digest.
+ *
+ *	@return	Whether the file could be read.
+ */
+bool compute_pe_digest(const mana::PE& pe, Hash* digest, boost::uint32_t& checksum, std::string& result);
+
+/**
+ *	@brief	Compares the checksum and the Authenticode digest of a PE with the values it contains.
+ *
+ *	Only the first signature of the PE is checked.
+ *
+ *	@param	const mana::PE& pe The PE to check. Its certificates must have been parsed.
+ *	@param	pe_integrity& integrity The structure to fill.
+ *
+ *	@return	Whether the file could be read.
+ */
+bool check_pe_integrity(const mana::PE& pe, pe_integrity& integrity);
+
+} // !namespace plugin
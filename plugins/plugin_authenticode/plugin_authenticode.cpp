@@ -15,18 +15,26 @@
     along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#pragma comment(lib, "wintrust")
-#pragma comment(lib, "crypt32.lib")
+#include <boost/system/api_config.hpp>
+
+#if defined BOOST_WINDOWS_API
+#	pragma comment(lib, "wintrust")
+#	pragma comment(lib, "crypt32.lib")
+#endif
 
 #include <sstream>
 #include <stdlib.h>
-#include <Windows.h> // Windows-only plugin (1)
-#include <Softpub.h>
-#include <WinCrypt.h>
+#if defined BOOST_WINDOWS_API
+#	include <Windows.h> // (1)
+#	include <Softpub.h>
+#	include <WinCrypt.h>
+#endif
 
 #include "manape/utils.h"
 
 #include "plugin_framework/plugin_interface.h"
+#include "plugins/plugin_authenticode/pe_integrity.h"
+#include "plugins/plugin_authenticode/certificates.h"
 #include "yara/yara_wrapper.h"
 
 /*
@@ -35,10 +43,13 @@
  * portable, lightweight cryptography library supporting it. For a while, I considered
  * implementing it on my own, but then I figured that you need to be on Windows to have
  * access to the CAs trusted by the OS anyway.
+ * The checksum and the digest of the file are verified on every platform though: a
+ * modified PE can be detected without trusting any CA.
  */
 
 namespace plugin {
 
+#if defined BOOST_WINDOWS_API
 /**
  *	@brief	Retrieves the information about the publisher / issuer present in the
  *			certificate.
@@ -70,25 +81,50 @@ void make_information(const std::string& type, const std::wstring& data, pResult
 	ss << type << ": " << conv.get();
 	result->add_information(ss.str());
 }
+#endif
+
+/**
+ *	@brief	Compares the checksum and the Authenticode digest of the PE with the values it
+ *			contains, and reports the differences.
+ *
+ *	@param	const pe_integrity& integrity The values computed by check_pe_integrity.
+ *	@param	pResult res The result to update.
+ */
+void report_integrity(const pe_integrity& integrity, pResult res);
+
+/**
+ *	@brief	Reads the signer and the signing time from the PKCS#7 blob of the PE.
+ *
+ *	@param	const mana::PE& pe The PE to analyze.
+ *	@param	CertificateCache& cache The cache used to parse the certificates.
+ *	@param	pResult res The result to update.
+ */
+void report_signature(const mana::PE& pe, CertificateCache& cache, pResult res);
 
 /**
- *	@brief	Looks for well-known company names in the RT_VERSION resource of the PE.
+ *	@brief	Checks whether the RT_VERSION resource of the PE names a well-known company.
  *
  *	The idea behind this check is that if the binary is unsigned but pretends to come from
  *	Microsoft, Adobe, etc. then it is very likely a malware.
  *
- *	@param	const mana::PE& pe The PE to analyze.
+ *	@param	IAnalysisContext& context The sample to analyze.
  *	@param	pResult res The result to update if something is found.
  */
-void check_version_info(const mana::PE& pe, pResult res);
+void check_version_info(IAnalysisContext& context, pResult res);
 
 /**
- *	@brief	This plugin uses the Windows API to verify the digital signature of a PE.
+ *	@brief	This plugin verifies the digital signature of a PE.
+ *
+ *	The Authenticode digest and the checksum are computed on every platform. The certificate
+ *	chain is verified with the Windows API, and is therefore only available on Windows.
  */
 class AuthenticodePlugin : public IPlugin
 {
 public:
-	int get_api_version() const override { return 1; }
+	// The same few thousand certificates sign most of the binaries.
+	AuthenticodePlugin() : _certificates(10000) {}
+
+	int get_api_version() const override { return 2; }
 
 	pString get_id() const override {
 		return boost::make_shared<std::string>("authenticode");
@@ -98,10 +134,21 @@ public:
 		return boost::make_shared<std::string>("Checks if the digital signature of the PE is valid.");
 	}
 
-	pResult analyze(const mana::PE& pe) override
+	unsigned int get_required_components() const override {
+		return mana::PE::COMPONENT_RESOURCES | mana::PE::COMPONENT_CERTIFICATES;
+	}
+
+	pResult analyze_sample(IAnalysisContext& context) override
 	{
 		pResult res = create_result();
+		const mana::PE& pe = context.get_pe();
+
+		pe_integrity integrity;
+		if (check_pe_integrity(pe, integrity)) {
+			report_integrity(integrity, res);
+		}
 
+#if defined BOOST_WINDOWS_API
 		WINTRUST_FILE_INFO file_info;
 		memset(&file_info, 0, sizeof(file_info));
 		file_info.cbStruct = sizeof(WINTRUST_FILE_INFO);
@@ -165,15 +212,26 @@ public:
 			get_certificate_info(wide_path, res);
 		}
 		else { // No certificate: try to determine if the application should be signed.
-			check_version_info(pe, res);
+			check_version_info(context, res);
 		}
 
 		// Close a handle that was opened by the verification
 		data.dwStateAction = WTD_STATEACTION_CLOSE;
 		::WinVerifyTrust(0, &guid_verify, &data);
+#else
+		if (integrity.digest_algorithm.empty()) { // No certificate: try to determine if the application should be signed.
+			check_version_info(context, res);
+		}
+		else {
+			report_signature(pe, _certificates, res);
+		}
+#endif
 
 		return res;
 	}
+
+private:
+	CertificateCache _certificates;
 };
 
 // ----------------------------------------------------------------------------
@@ -186,6 +244,76 @@ extern "C"
 
 // ----------------------------------------------------------------------------
 
+void report_integrity(const pe_integrity& integrity, pResult res)
+{
+	// A null checksum only means that the field is unused. It is only mandatory for drivers.
+	if (integrity.header_checksum != 0 && integrity.header_checksum != integrity.checksum)
+	{
+		std::stringstream ss;
+		ss << "The PE's checksum is invalid (0x" << std::hex << integrity.header_checksum
+		   << " instead of 0x" << integrity.checksum << ").";
+		res->add_information(ss.str());
+	}
+
+	if (integrity.digest_algorithm.empty()) { // Unsigned binary
+		return;
+	}
+	if (integrity.digest.empty())
+	{
+		res->add_information("The signature uses an unsupported digest algorithm (" + integrity.digest_algorithm + ").");
+		return;
+	}
+
+	if (integrity.digest != integrity.signed_digest)
+	{
+		res->raise_level(MALICIOUS);
+		res->set_summary("The PE was modified after it was signed.");
+		res->add_information("Signed digest", integrity.signed_digest);
+		res->add_information("Actual digest", integrity.digest);
+	}
+	else
+	{
+		// On Windows, this summary is replaced with WinVerifyTrust's verdict.
+		res->set_summary("The PE's digest matches its signature (the certificate chain was not verified).");
+		res->add_information(integrity.digest_algorithm + " digest", integrity.digest);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void report_signature(const mana::PE& pe, CertificateCache& cache, pResult res)
+{
+	auto certificates = pe.get_certificates();
+	if (!certificates) {
+		return;
+	}
+
+	int pkcs7_type = nt::WIN_CERTIFICATE_TYPES.at("WIN_CERT_TYPE_PKCS_SIGNED_DATA");
+	for (auto it = certificates->begin() ; it != certificates->end() ; ++it)
+	{
+		signature_info info;
+		if ((*it)->CertificateType != pkcs7_type || !read_signature((*it)->Certificate, cache, info)) {
+			continue;
+		}
+
+		if (info.signer)
+		{
+			res->add_information("Issued to", info.signer->subject);
+			res->add_information("Issued by", info.signer->issuer);
+			res->add_information("Serial number", info.signer->serial);
+			res->add_information("Thumbprint", info.signer->thumbprint);
+		}
+		if (!info.signing_time.empty()) {
+			res->add_information("Signing time", info.signing_time);
+		}
+		return;
+	}
+}
+
+#if defined BOOST_WINDOWS_API
+
+// ----------------------------------------------------------------------------
+
 std::string make_error(const std::string& message)
 {
 	std::stringstream ss;
@@ -552,46 +680,21 @@ void get_certificate_info(const std::wstring& file_path, pResult result)
 	}
 }
 
+#endif // BOOST_WINDOWS_API
+
 // ----------------------------------------------------------------------------
 
-void check_version_info(const mana::PE& pe, pResult res)
+void check_version_info(IAnalysisContext& context, pResult res)
 {
-	// Find the VERSION_INFO resource
-	auto resources = pe.get_resources();
-	mana::pResource version_info;
-	for (auto it = resources->begin() ; it != resources->end() ; ++it)
-	{
-		if (*(*it)->get_type() == "RT_VERSION")
-		{
-			version_info = *it;
-			break;
-		}
-	}
-
-	// No RT_VERSION resource, we're done.
-	if (!version_info) {
+	pString company = context.get_company_name();
+	if (!company) { // No RT_VERSION resource, or no well-known company in it.
 		return;
 	}
 
-	yara::Yara y;
-	if (!y.load_rules("yara_rules/company_names.yara"))
-	{
-		std::cerr << "Could not load company_names.yara!" << std::endl;
-		return;
-	}
-	auto m = y.scan_bytes(*version_info->get_raw_data());
-	if (m && m->size() > 0)
-	{
-		std::stringstream ss;
-		auto found_strings = m->at(0)->get_found_strings();
-		if (found_strings.size() > 0)
-		{
-			ss << "PE pretends to be from " << *(m->at(0)->get_found_strings().begin())
-				<< " but is not signed!";
-			res->set_summary(ss.str());
-			res->raise_level(MALICIOUS);
-		}
-	}
+	std::stringstream ss;
+	ss << "PE pretends to be from " << *company << " but is not signed!";
+	res->set_summary(ss.str());
+	res->raise_level(MALICIOUS);
 }
 
 
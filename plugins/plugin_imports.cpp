@@ -156,7 +156,7 @@ bool check_dlls(const mana::PE& pe,
 class ImportsPlugin : public IPlugin
 {
 public:
-	int get_api_version() const override { return 1; }
+	int get_api_version() const override { return 2; }
 
 	pString get_id() const override {
 		return boost::make_shared<std::string>("imports");
@@ -166,9 +166,14 @@ public:
 		return boost::make_shared<std::string>("Looks for suspicious imports.");
 	}
 
-	pResult analyze(const mana::PE& pe) override
+	unsigned int get_required_components() const override {
+		return mana::PE::COMPONENT_IMPORTS;
+	}
+
+	pResult analyze_sample(IAnalysisContext& context) override
 	{
 		pResult res = create_result();
+		const mana::PE& pe = context.get_pe();
 		check_functions(pe, dynamic_import, NO_OPINION, "[!] The program may be hiding some of its imports", AT_LEAST_TWO, res);
 		check_functions(pe, anti_debug, SUSPICIOUS, "Functions which can be used for anti-debugging purposes", AT_LEAST_ONE, res);
 		check_functions(pe, vanilla_injection, MALICIOUS, "Code injection capabilities", AT_LEAST_THREE, res);
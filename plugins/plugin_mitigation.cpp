@@ -22,7 +22,7 @@ namespace plugin {
 
 class ExploitMitigationsPlugin : public IPlugin
 {
-    int get_api_version() const override { return 1; }
+    int get_api_version() const override { return 2; }
 
     pString get_id() const override {
         return boost::make_shared<std::string>("mitigation");
@@ -32,9 +32,14 @@ class ExploitMitigationsPlugin : public IPlugin
         return boost::make_shared<std::string>("Displays the enabled exploit mitigation techniques (DEP, ASLR, etc.).");
     }
 
-    pResult analyze(const mana::PE& pe) override
+    unsigned int get_required_components() const override {
+        return mana::PE::COMPONENT_CONFIG;
+    }
+
+    pResult analyze_sample(IAnalysisContext& context) override
     {
         pResult res = create_result();
+        const mana::PE& pe = context.get_pe();
         auto ioh = pe.get_image_optional_header();
         if (!ioh) {
             return res;
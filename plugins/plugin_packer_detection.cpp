@@ -52,7 +52,7 @@ const std::map<std::string, std::string> KNOWN_PACKER_SECTIONS =
 class PackerDetectionPlugin : public IPlugin
 {
 public:
-	int get_api_version() const override { return 1; }
+	int get_api_version() const override { return 2; }
 
 	pString get_id() const override {
 		return boost::make_shared<std::string>("packer");
@@ -62,9 +62,14 @@ public:
 		return boost::make_shared<std::string>("Tries to structurally detect packer presence.");
 	}
 
-	pResult analyze(const mana::PE& pe) override
+	unsigned int get_required_components() const override {
+		return mana::PE::COMPONENT_IMPORTS | mana::PE::COMPONENT_RESOURCES;
+	}
+
+	pResult analyze_sample(IAnalysisContext& context) override
 	{
 		pResult res = create_result();
+		const mana::PE& pe = context.get_pe();
 
 		// Analyze sections
 		mana::shared_sections sections = pe.get_sections();
@@ -103,7 +108,7 @@ public:
 				continue;
 			}
 
-			double entropy = (*it)->get_entropy();
+			double entropy = context.get_section_entropy(*it);
 			if (entropy > 7.)
 			{
 				std::stringstream ss;
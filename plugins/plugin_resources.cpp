@@ -31,7 +31,7 @@ namespace plugin {
 class ResourcesPlugin : public IPlugin
 {
 public:
-	int get_api_version() const override { return 1; }
+	int get_api_version() const override { return 2; }
 
 	pString get_id() const override {
 		return boost::make_shared<std::string>("resources");
@@ -41,12 +41,16 @@ public:
 		return boost::make_shared<std::string>("Analyzes the program's resources.");
 	}
 
-	pResult analyze(const mana::PE& pe) override
+	unsigned int get_required_components() const override {
+		return mana::PE::COMPONENT_RESOURCES;
+	}
+
+	pResult analyze_sample(IAnalysisContext& context) override
 	{
 		pResult res = create_result();
-		yara::Yara y;
-
-		if (!y.load_rules("yara_rules/magic.yara")) {
+		const mana::PE& pe = context.get_pe();
+		yara::pYara y = context.get_rules("yara_rules/magic.yara");
+		if (!y) {
 			return res;
 		}
 
@@ -61,7 +65,7 @@ public:
 			if ((*it)->get_size() < pe.get_filesize()) {
 				size += (*it)->get_size();
 			}
-			yara::const_matches matches = y.scan_bytes(*(*it)->get_raw_data());
+			yara::const_matches matches = y->scan_bytes(*(*it)->get_raw_data());
 			if (matches->size() > 0)
 			{
 				for (size_t i = 0 ; i < matches->size() ; ++i)
@@ -88,7 +92,7 @@ public:
 			}
 			else
 			{
-				if ((*it)->get_entropy() > 7.)
+				if (context.get_resource_entropy(*it) > 7.)
 				{
 					std::stringstream ss;
 					ss << "Resource " << *(*it)->get_name() << " is possibly compressed or encrypted.";
@@ -0,0 +1,214 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "plugins/plugin_virustotal/http_client.h"
+
+#include <sstream>
+#include <boost/algorithm/string.hpp>
+
+namespace bai = boost::asio::ip;
+
+namespace plugin {
+
+/**
+ *	@brief	Removes the first bytes of a buffer and returns them.
+ */
+std::string consume(boost::asio::streambuf& buffer, size_t size)
+{
+	std::string res(boost::asio::buffers_begin(buffer.data()), boost::asio::buffers_begin(buffer.data()) + size);
+	buffer.consume(size);
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+HttpClient::HttpClient(const std::string& host, const std::string& port)
+	: _host(host), _port(port), _socket(_io_service), _connection_count(0)
+{}
+
+// ----------------------------------------------------------------------------
+
+bool HttpClient::_connect()
+{
+	boost::system::error_code error;
+	bai::tcp::resolver resolver(_io_service);
+	bai::tcp::resolver::iterator endpoint_iterator = resolver.resolve(bai::tcp::resolver::query(_host, _port), error);
+	bai::tcp::resolver::iterator end;
+	if (error)
+	{
+		PRINT_ERROR << "Could not resolve " << _host << " (" << error.message() << ")." << std::endl;
+		return false;
+	}
+
+	// Try each endpoint until we successfully establish a connection.
+	error = boost::asio::error::host_not_found;
+	while (error && endpoint_iterator != end)
+	{
+		_socket.close();
+		_socket.connect(*endpoint_iterator++, error);
+	}
+	if (error)
+	{
+		PRINT_ERROR << "Could not connect to " << _host << ":" << _port << " (" << error.message() << ")." << std::endl;
+		return false;
+	}
+	_buffer.consume(_buffer.size());
+	++_connection_count;
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool HttpClient::post(const std::string& path, const std::string& body, unsigned int& status, std::string& response)
+{
+	std::stringstream request;
+	request << "POST " << path << " HTTP/1.1\r\n";
+	request << "Host: " << _host << "\r\n";
+	request << "Content-Type: application/x-www-form-urlencoded\r\n";
+	request << "Content-Length: " << body.size() << "\r\n";
+	request << "Connection: keep-alive\r\n\r\n";
+	request << body;
+
+	// The server may have closed a connection which was idle for too long. In that case,
+	// the request is sent again on a new one.
+	for (int attempt = 0 ; attempt < 2 ; ++attempt)
+	{
+		bool reused = _socket.is_open();
+		if (!reused && !_connect()) {
+			return false;
+		}
+
+		try
+		{
+			_exchange(request.str(), status, response);
+			return true;
+		}
+		catch (std::exception& e) // Network errors, or a malformed response.
+		{
+			boost::system::error_code ignored;
+			_socket.close(ignored);
+			if (!reused)
+			{
+				PRINT_ERROR << "Could not query " << _host << " (" << e.what() << ")." << std::endl;
+				return false;
+			}
+		}
+	}
+	return false;
+}
+
+// ----------------------------------------------------------------------------
+
+void HttpClient::_exchange(const std::string& request, unsigned int& status, std::string& response)
+{
+	boost::asio::write(_socket, boost::asio::buffer(request));
+
+	// Read the status line and the headers.
+	size_t header_size = boost::asio::read_until(_socket, _buffer, "\r\n\r\n");
+	std::istringstream headers(consume(_buffer, header_size));
+	std::string http_version;
+	headers >> http_version >> status;
+	if (!headers || http_version.substr(0, 5) != "HTTP/") {
+		throw boost::system::system_error(boost::system::errc::make_error_code(boost::system::errc::protocol_error));
+	}
+
+	long long content_length = -1;
+	bool chunked = false;
+	bool close = http_version == "HTTP/1.0";
+	std::string line;
+	std::getline(headers, line); // End of the status line.
+	while (std::getline(headers, line))
+	{
+		size_t separator = line.find(':');
+		if (separator == std::string::npos) {
+			continue;
+		}
+		std::string name = boost::trim_copy(line.substr(0, separator));
+		std::string value = boost::trim_copy(line.substr(separator + 1));
+		if (boost::iequals(name, "Content-Length")) {
+			content_length = std::stoll(value);
+		}
+		else if (boost::iequals(name, "Transfer-Encoding")) {
+			chunked = boost::icontains(value, "chunked");
+		}
+		else if (boost::iequals(name, "Connection")) {
+			close = boost::iequals(value, "close");
+		}
+	}
+
+	response.clear();
+	if (status == 204 || status == 304 || status / 100 == 1) {
+		// These responses never have a body.
+	}
+	else if (chunked) {
+		_read_chunked(response);
+	}
+	else if (content_length >= 0)
+	{
+		if (_buffer.size() < static_cast<size_t>(content_length)) {
+			boost::asio::read(_socket, _buffer, boost::asio::transfer_exactly(content_length - _buffer.size()));
+		}
+		response = consume(_buffer, content_length);
+	}
+	else // The body ends with the connection.
+	{
+		boost::system::error_code error;
+		while (boost::asio::read(_socket, _buffer, boost::asio::transfer_at_least(1), error));
+		if (error != boost::asio::error::eof) {
+			throw boost::system::system_error(error);
+		}
+		response = consume(_buffer, _buffer.size());
+		close = true;
+	}
+
+	if (close) {
+		_socket.close();
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void HttpClient::_read_chunked(std::string& response)
+{
+	while (true)
+	{
+		size_t line_size = boost::asio::read_until(_socket, _buffer, "\r\n");
+		std::string line = consume(_buffer, line_size);
+		size_t chunk_size = std::stoul(line.substr(0, line.find_first_of(";\r")), nullptr, 16);
+		if (chunk_size == 0) {
+			break;
+		}
+
+		// Read the chunk and the line break which follows it.
+		if (_buffer.size() < chunk_size + 2) {
+			boost::asio::read(_socket, _buffer, boost::asio::transfer_exactly(chunk_size + 2 - _buffer.size()));
+		}
+		response += consume(_buffer, chunk_size);
+		_buffer.consume(2);
+	}
+
+	// Skip the trailers, until the empty line which ends the response.
+	while (true)
+	{
+		size_t line_size = boost::asio::read_until(_socket, _buffer, "\r\n");
+		if (consume(_buffer, line_size) == "\r\n") {
+			break;
+		}
+	}
+}
+
+} // !namespace plugin
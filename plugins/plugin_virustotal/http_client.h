@@ -0,0 +1,90 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "manacommons/color.h"
+
+namespace plugin {
+
+/**
+ *	@brief	A minimal HTTP/1.1 client which keeps its connection to the server open.
+ *
+ *	Subsequent requests reuse the connection, which saves a DNS resolution and a TCP
+ *	handshake per request. If the server closed the connection in the meantime, a new
+ *	one is established transparently.
+ *
+ *	This class is not thread-safe.
+ */
+class HttpClient : private boost::noncopyable
+{
+public:
+	/**
+	 *	@param	const std::string& host The server to connect to.
+	 *	@param	const std::string& port The port (or service name) to connect to.
+	 */
+	HttpClient(const std::string& host, const std::string& port);
+
+	/**
+	 *	@brief	Sends a POST request.
+	 *
+	 *	@param	const std::string& path The requested path (i.e. /vtapi/v2/file/report).
+	 *	@param	const std::string& body The form data to send.
+	 *	@param	unsigned int& status Receives the HTTP status code of the response.
+	 *	@param	std::string& response Receives the body of the response.
+	 *
+	 *	@return	Whether a response was received.
+	 */
+	bool post(const std::string& path, const std::string& body, unsigned int& status, std::string& response);
+
+	/**
+	 *	@brief	Returns the number of connections which were established so far.
+	 */
+	unsigned int get_connection_count() const { return _connection_count; }
+
+private:
+	/**
+	 *	@brief	Connects to the server.
+	 */
+	bool _connect();
+
+	/**
+	 *	@brief	Sends a request on the current connection and reads the response.
+	 *
+	 *	Throws if the connection fails or if the response is malformed.
+	 */
+	void _exchange(const std::string& request, unsigned int& status, std::string& response);
+
+	/**
+	 *	@brief	Reads the body of a response which uses the chunked transfer encoding.
+	 */
+	void _read_chunked(std::string& response);
+
+	std::string						_host;
+	std::string						_port;
+	boost::asio::io_service			_io_service;
+	boost::asio::ip::tcp::socket	_socket;
+	boost::asio::streambuf			_buffer;	// Data received but not consumed yet.
+	unsigned int					_connection_count;
+};
+
+} // !namespace plugin
@@ -22,36 +22,37 @@
 #endif
 
 #include <stdio.h>
-#include <boost/asio.hpp>
+#include <algorithm>
+#include <deque>
+#include <set>
+#include <boost/thread.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/case_conv.hpp>
 
 #include "plugin_framework/plugin_interface.h"
 #include "plugin_framework/auto_register.h"
 
 #include "manacommons/color.h"
-#include "hash-library/hashes.h"
 #include "plugins/plugin_virustotal/json_spirit/json_spirit.h"
+#include "plugins/plugin_virustotal/http_client.h"
+#include "plugins/plugin_virustotal/token_bucket.h"
+#include "plugins/plugin_virustotal/report_cache.h"
 
-namespace bai = boost::asio::ip;
 namespace js = json_spirit;
 
 namespace plugin {
 
-/**
- *	@brief	Queries VirusTotal for a given hash.
- *
- *	@param	const std::string& hash The hash of the program whose AV results we want.
- *	@param	const std::string& api_key The VirusTotal API key used to submit queries.
- *	@param	std::string& destination The string which will recieve the REST JSON response.
- *
- *	@return	Whether the query was completed successfully.
- */
-bool query_virus_total(const std::string& hash, const std::string& api_key, std::string& destination);
-
-
 class VirusTotalPlugin : public IPlugin
 {
 public:
-	int get_api_version() const override { return 1; }
+	VirusTotalPlugin() : _enabled(false), _hashes_per_request(4), _stopping(false) {}
+
+	~VirusTotalPlugin() {
+		_stop();
+	}
+
+	int get_api_version() const override { return 2; }
 
 	pString get_id() const override {
 		return boost::make_shared<std::string>("virustotal");
@@ -61,44 +62,337 @@ public:
 		return boost::make_shared<std::string>("Checks existing AV results on VirusTotal.");
 	}
 
-	pResult analyze(const mana::PE& pe) override
+	unsigned int get_required_components() const override {
+		return mana::PE::HEADERS_ONLY; // Only the hash of the file is needed.
+	}
+
+	// A single request can ask for the reports of several files.
+	bool supports_batch() const override {
+		return true;
+	}
+
+	/**
+	 *	@brief	Reads the configuration and starts the thread which queries VirusTotal.
+	 */
+	void on_load(const string_map& config) override
 	{
-		pResult res = create_result();
+		_stop();
+		_enabled = _check_api_key();
+		if (!_enabled) {
+			return;
+		}
 
+		// The public API accepts up to 4 hashes per request, and 4 requests per minute.
+		_hashes_per_request = std::max(1u, _get_number("hashes_per_request", 4));
+		unsigned int requests_per_minute = _get_number("requests_per_minute", 4);
+		_bucket.reset(new TokenBucket(requests_per_minute / 60., requests_per_minute));
+
+		_client.reset(new HttpClient(config.count("host") ? config.at("host") : "www.virustotal.com",
+									 config.count("port") ? config.at("port") : "http"));
+
+		// Reports are kept for a day by default, so that files seen again don't leave the machine.
+		_cache.reset(new ReportCache(_get_number("cache_ttl", 86400)));
+		_cache_file = config.count("cache_file") ? config.at("cache_file") : "";
+		if (!_cache_file.empty()) {
+			_cache->load(_cache_file);
+		}
+
+		_stopping = false;
+		_worker = boost::thread(&VirusTotalPlugin::_lookup_loop, this);
+	}
+
+	void on_run_end() override {
+		_stop();
+	}
+
+	/**
+	 *	@brief	Starts looking up the file in the background, while the rest of its batch is analyzed.
+	 */
+	void prepare_sample(IAnalysisContext& context) override
+	{
+		if (!_enabled) {
+			return;
+		}
+		pString sha256_hash = context.get_digest("SHA256");
+		if (sha256_hash != nullptr) {
+			_request(*sha256_hash);
+		}
+	}
+
+	shared_results analyze_batch(const std::vector<IAnalysisContext*>& samples) override
+	{
+		shared_results results = boost::make_shared<std::vector<pResult> >();
+		std::vector<std::string> hashes;
+		for (auto it = samples.begin() ; it != samples.end() ; ++it)
+		{
+			results->push_back(create_result());
+			if (!_enabled)
+			{
+				hashes.push_back("");
+				continue;
+			}
+
+			// The hash may already have been computed (i.e. if --hashes was requested).
+			pString sha256_hash = (*it)->get_digest("SHA256");
+			if (sha256_hash == nullptr)
+			{
+				PRINT_ERROR << "Could not compute the SHA256 hash of " << *(*it)->get_pe().get_path() << "!" << std::endl;
+				hashes.push_back("");
+				continue;
+			}
+			hashes.push_back(boost::to_lower_copy(*sha256_hash));
+			_request(hashes.back()); // In case prepare_sample wasn't called for this file.
+		}
+
+		// Wait for the lookups to complete.
+		std::map<std::string, pString> reports;
+		{
+			boost::mutex::scoped_lock lock(_mutex);
+			for (auto it = hashes.begin() ; it != hashes.end() ; ++it)
+			{
+				if (it->empty()) {
+					continue;
+				}
+				while (!_reports.count(*it)) {
+					_lookup_done.wait(lock);
+				}
+				reports[*it] = _reports[*it];
+			}
+			for (auto it = reports.begin() ; it != reports.end() ; ++it) {
+				_reports.erase(it->first);
+			}
+		}
+
+		for (size_t i = 0 ; i < hashes.size() ; ++i)
+		{
+			if (hashes[i].empty() || !reports[hashes[i]]) {
+				continue;
+			}
+			js::Value val;
+			if (!js::read(*reports[hashes[i]], val) || val.type() != js::obj_type)
+			{
+				PRINT_ERROR << "Could not parse JSON retrieved from VirusTotal!" << std::endl;
+				continue;
+			}
+			_parse_report(val.get_obj(), results->at(i));
+		}
+		return results;
+	}
+
+	pResult analyze_sample(IAnalysisContext& context) override
+	{
+		shared_results results = analyze_batch(std::vector<IAnalysisContext*>(1, &context));
+		return results->at(0);
+	}
+
+private:
+	/**
+	 *	@brief	Verifies that an API key was provided in the configuration file.
+	 */
+	bool _check_api_key() const
+	{
 		if (_config == nullptr || !_config->count("api_key")) // No API key provided.
 		{
 			PRINT_WARNING << "The VirusTotal API key was not found in the configuration file." << std::endl;
-			return res;
+			return false;
 		}
 		else if (_config->at("api_key") == "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx")
 		{
 			PRINT_WARNING << "Please edit the configuration file with your VirusTotal API key." << std::endl;
-			return res;
+			return false;
 		}
+		return true;
+	}
 
-		std::string sha256_hash = *hash::hash_file(*hash::ALL_DIGESTS[ALL_DIGESTS_SHA256], *pe.get_path());
-		std::string json;
-
+	/**
+	 *	@brief	Reads a number from the configuration file.
+	 */
+	unsigned int _get_number(const std::string& key, unsigned int default_value) const
+	{
+		if (_config == nullptr || !_config->count(key)) {
+			return default_value;
+		}
 		try {
-			if (!query_virus_total(sha256_hash, _config->at("api_key"), json)) {
-				return res;
+			return std::stoul(_config->at(key));
+		}
+		catch (std::logic_error&) // invalid_argument or out_of_range
+		{
+			PRINT_WARNING << "Could not parse virustotal." << key << " in the configuration file." << std::endl;
+			return default_value;
+		}
+	}
+
+	/**
+	 *	@brief	Stops the thread which queries VirusTotal and saves the cache.
+	 */
+	void _stop()
+	{
+		if (!_enabled) {
+			return;
+		}
+		{
+			boost::mutex::scoped_lock lock(_mutex);
+			_stopping = true;
+		}
+		_queue_changed.notify_all();
+		_worker.join();
+		if (!_cache_file.empty()) {
+			_cache->save(_cache_file);
+		}
+		_enabled = false;
+	}
+
+	/**
+	 *	@brief	Schedules the lookup of a file, unless its report is already known or requested.
+	 *
+	 *	@param	const std::string& sha256 The SHA256 of the file.
+	 */
+	void _request(const std::string& sha256)
+	{
+		std::string hash = boost::to_lower_copy(sha256);
+		boost::mutex::scoped_lock lock(_mutex);
+		if (_reports.count(hash) || _queued.count(hash)) {
+			return;
+		}
+
+		std::string report;
+		if (_cache->get(hash, report))
+		{
+			_reports[hash] = boost::make_shared<std::string>(report);
+			return;
+		}
+		_queue.push_back(hash);
+		_queued.insert(hash);
+		_queue_changed.notify_all();
+	}
+
+	/**
+	 *	@brief	The function run by the thread which queries VirusTotal.
+	 */
+	void _lookup_loop()
+	{
+		while (true)
+		{
+			{
+				boost::mutex::scoped_lock lock(_mutex);
+				while (_queue.empty() && !_stopping) {
+					_queue_changed.wait(lock);
+				}
+				if (_queue.empty()) {
+					return;
+				}
+			}
+
+			// More files may be requested while waiting for the rate limit: they will share the request.
+			_bucket->acquire();
+			std::vector<std::string> hashes;
+			{
+				boost::mutex::scoped_lock lock(_mutex);
+				while (!_queue.empty() && hashes.size() < _hashes_per_request)
+				{
+					hashes.push_back(_queue.front());
+					_queue.pop_front();
+				}
+			}
+
+			std::map<std::string, pString> reports = _lookup(hashes);
+			{
+				boost::mutex::scoped_lock lock(_mutex);
+				for (auto it = hashes.begin() ; it != hashes.end() ; ++it)
+				{
+					_reports[*it] = reports[*it]; // NULL if the lookup failed.
+					_queued.erase(*it);
+				}
 			}
+			_lookup_done.notify_all();
+		}
+	}
+
+	/**
+	 *	@brief	Queries VirusTotal for the reports of several files.
+	 *
+	 *	@param	const std::vector<std::string>& hashes The SHA256 of the files.
+	 *
+	 *	@return	The reports which were obtained, as JSON, indexed by hash. Reports are added to
+	 *			the cache, unless the file is still being scanned.
+	 */
+	std::map<std::string, pString> _lookup(const std::vector<std::string>& hashes)
+	{
+		std::map<std::string, pString> res;
+		std::stringstream ss;
+		ss << "apikey=" << _config->at("api_key") << "&resource=";
+		for (auto it = hashes.begin() ; it != hashes.end() ; ++it) {
+			ss << (it == hashes.begin() ? "" : ",") << *it;
+		}
+
+		unsigned int status_code = 0;
+		std::string json;
+		if (!_client->post("/vtapi/v2/file/report", ss.str(), status_code, json)) {
+			return res;
 		}
-		catch (std::exception& e)
+		if (status_code != 200)
 		{
-			PRINT_ERROR << "Query to VirusTotal failed (" << e.what() << ")." << std::endl;
+			if (status_code == 204)	{
+				PRINT_ERROR << "VirusTotal API request rate limit reached!" << std::endl;
+			}
+			else if (status_code == 403) {
+				PRINT_ERROR << "VirusTotal API access denied. Please verify that your API key is valid." << std::endl;
+			}
+			else {
+				PRINT_ERROR << "VirusTotal query returned with status code " << status_code << "." << std::endl;
+			}
 			return res;
 		}
 
-		// Parse the JSON.
 		js::Value val;
-		if (!js::read(json, val) || val.type() != js::obj_type)
+		if (!js::read(json, val))
 		{
 			PRINT_ERROR << "Could not parse JSON retrieved from VirusTotal!" << std::endl;
 			return res;
 		}
 
-		js::Object root = val.get_obj();
+		// The response is an array if several hashes were requested. Match the reports
+		// with the files through the resource they describe.
+		js::Array reports;
+		if (val.type() == js::array_type) {
+			reports = val.get_array();
+		}
+		else if (val.type() == js::obj_type) {
+			reports.push_back(val);
+		}
+		for (auto report = reports.begin() ; report != reports.end() ; ++report)
+		{
+			if (report->type() != js::obj_type) {
+				continue;
+			}
+			const js::Object& root = report->get_obj();
+			auto resource = std::find_if(root.begin(), root.end(), [](const js::Pair& p) { return p.name_ == "resource"; });
+			auto response_code = std::find_if(root.begin(), root.end(), [](const js::Pair& p) { return p.name_ == "response_code"; });
+			for (auto hash = hashes.begin() ; hash != hashes.end() ; ++hash)
+			{
+				if (hashes.size() == 1 || (resource != root.end() && resource->value_.type() == js::str_type &&
+										   boost::iequals(resource->value_.get_str(), *hash)))
+				{
+					res[*hash] = boost::make_shared<std::string>(js::write(*report));
+					if (response_code == root.end() || response_code->value_.type() != js::int_type ||
+						response_code->value_.get_int() != -2) {
+						_cache->put(*hash, *res[*hash]);
+					}
+					break;
+				}
+			}
+		}
+		return res;
+	}
+
+	/**
+	 *	@brief	Fills a result with the report VirusTotal returned for a file.
+	 *
+	 *	@param	const js::Object& root The report.
+	 *	@param	pResult res The result to fill.
+	 */
+	void _parse_report(const js::Object& root, pResult res) const
+	{
 		unsigned int total = 0, positives = 0;
 		std::string scan_date;
 		for (auto it = root.begin() ; it != root.end() ; ++it)
@@ -109,12 +403,12 @@ public:
 				{
 					res->set_level(SUSPICIOUS); // Because VT knows all the files.
 					res->set_summary("This file has never been scanned on VirusTotal.");
-					return res;
+					return;
 				}
 				else if (it->value_.get_int() == -2) // Response Code = -2: scan queued.
 				{
 					res->set_summary("A scan if the file is currently queued on VirusTotal.");
-					return res;
+					return;
 				}
 			}
 			else if (it->name_ == "total") {
@@ -162,106 +456,24 @@ public:
 		else {
 			res->set_level(MALICIOUS);
 		}
-
-		return res;
-	}
-};
-
-// ----------------------------------------------------------------------------
-
-bool query_virus_total(const std::string& hash, const std::string& api_key, std::string& destination)
-{
-	boost::asio::io_service io_service;
-
-	// Get a list of endpoints corresponding to the server name.
-	bai::tcp::resolver resolver(io_service);
-	bai::tcp::resolver::query query("www.virustotal.com", "http");
-	bai::tcp::resolver::iterator endpoint_iterator = resolver.resolve(query);
-	bai::tcp::resolver::iterator end;
-
-	// Try each endpoint until we successfully establish a connection.
-	bai::tcp::socket socket(io_service);
-	boost::system::error_code error = boost::asio::error::host_not_found;
-	while (error && endpoint_iterator != end)
-	{
-		socket.close();
-		socket.connect(*endpoint_iterator++, error);
-	}
-	if (error)
-	{
-		PRINT_ERROR << "Could not resolve www.virustotal.com (plugin_virustotal)!" << std::endl;
-		return false;
-	}
-
-	// Build the request
-	boost::asio::streambuf request;
-	std::stringstream ss;
-	ss << "apikey=" << api_key << "&resource=" << hash << "\r\n";
-	std::string post_data = ss.str();
-	std::ostream request_stream(&request);
-	request_stream << "POST /vtapi/v2/file/report HTTP/1.1\r\n";
-	request_stream << "Host: www.virustotal.com \r\n";
-	request_stream << "Content-Length: " << post_data.size() << "\r\n";
-	request_stream << "Connection: close\r\n\r\n";
-	request_stream << post_data;
-
-	// Send the request.
-	boost::asio::write(socket, request);
-
-	// Read the response status line.
-	boost::asio::streambuf response;
-	boost::asio::read_until(socket, response, "\r\n");
-
-	// Check that response is OK.
-	std::istream response_stream(&response);
-	std::string http_version;
-	response_stream >> http_version;
-	unsigned int status_code;
-	response_stream >> status_code;
-	std::string status_message;
-	std::getline(response_stream, status_message);
-	if (!response_stream || http_version.substr(0, 5) != "HTTP/")
-	{
-		PRINT_ERROR << "Received a malformed response from the server. (plugin_virustotal)" << std::endl;
-		return false;
-	}
-	if (status_code != 200)
-	{
-		if (status_code == 204)	{
-			PRINT_ERROR << "VirusTotal API request rate limit reached!" << std::endl;
-		}
-		else if (status_code == 403) {
-			PRINT_ERROR << "VirusTotal API access denied. Please verify that your API key is valid." << std::endl;
-		}
-		else {
-			PRINT_ERROR << "VirusTotal query returned with status code " << status_code << "." << std::endl;
-		}
-		return false;
-	}
-
-	// Skip the response headers.
-	std::string header;
-	while (std::getline(response_stream, header) && header != "\r");
-
-	// Write whatever content we already have to output.
-	ss.str("");
-	ss.clear();
-	if (response.size() > 0) {
-		ss << &response;
 	}
 
-	// Read until EOF, writing data to output as we go.
-	while (boost::asio::read(socket, response, boost::asio::transfer_at_least(1), error)) {
-		ss << &response;
-	}
-	if (error != boost::asio::error::eof) {
-		PRINT_ERROR << "Could not read the response (" << error << ")." << std::endl;
-		return false;
-	}
-
-	destination = ss.str();
-	return true;
-}
+	bool									_enabled;				// Whether the lookup thread is running.
+	unsigned int							_hashes_per_request;
+	boost::scoped_ptr<HttpClient>			_client;				// Only used by the lookup thread.
+	boost::scoped_ptr<TokenBucket>			_bucket;
+	boost::scoped_ptr<ReportCache>			_cache;
+	std::string								_cache_file;
+
+	boost::thread							_worker;
+	boost::mutex							_mutex;					// Protects the members below.
+	boost::condition_variable				_queue_changed;
+	boost::condition_variable				_lookup_done;
+	std::deque<std::string>					_queue;					// The files to look up.
+	std::set<std::string>					_queued;				// The files queued or being looked up.
+	std::map<std::string, pString>			_reports;				// Lookups which completed (NULL if they failed).
+	bool									_stopping;
+};
 
 // ----------------------------------------------------------------------------
 
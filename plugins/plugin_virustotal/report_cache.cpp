@@ -0,0 +1,101 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "plugins/plugin_virustotal/report_cache.h"
+
+#include <fstream>
+#include <sstream>
+#include <boost/algorithm/string/case_conv.hpp>
+
+namespace plugin {
+
+bool ReportCache::load(const std::string& path)
+{
+	std::ifstream input(path.c_str());
+	if (!input.is_open()) {
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(input, line))
+	{
+		std::istringstream ss(line);
+		std::string sha256, report;
+		long long timestamp;
+		if (!(ss >> sha256 >> timestamp) || !std::getline(ss >> std::ws, report) || report.empty())
+		{
+			PRINT_WARNING << "Ignoring a malformed line in " << path << "." << std::endl;
+			continue;
+		}
+		if (!_is_expired(static_cast<time_t>(timestamp))) {
+			put(sha256, report, static_cast<time_t>(timestamp));
+		}
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool ReportCache::save(const std::string& path) const
+{
+	std::ofstream output(path.c_str(), std::ios::trunc);
+	if (!output.is_open())
+	{
+		PRINT_WARNING << "Could not write the VirusTotal cache to " << path << "." << std::endl;
+		return false;
+	}
+
+	boost::mutex::scoped_lock lock(_mutex);
+	for (auto it = _reports.begin() ; it != _reports.end() ; ++it)
+	{
+		if (!_is_expired(it->second.first)) {
+			output << it->first << " " << static_cast<long long>(it->second.first) << " " << it->second.second << std::endl;
+		}
+	}
+	return output.good();
+}
+
+// ----------------------------------------------------------------------------
+
+bool ReportCache::get(const std::string& sha256, std::string& report) const
+{
+	boost::mutex::scoped_lock lock(_mutex);
+	auto found = _reports.find(boost::to_lower_copy(sha256));
+	if (found == _reports.end() || _is_expired(found->second.first)) {
+		return false;
+	}
+	report = found->second.second;
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void ReportCache::put(const std::string& sha256, const std::string& report, time_t timestamp)
+{
+	boost::mutex::scoped_lock lock(_mutex);
+	_reports[boost::to_lower_copy(sha256)] = std::make_pair(timestamp, report);
+}
+
+// ----------------------------------------------------------------------------
+
+size_t ReportCache::size() const
+{
+	boost::mutex::scoped_lock lock(_mutex);
+	return _reports.size();
+}
+
+} // !namespace plugin
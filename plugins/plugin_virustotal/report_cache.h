@@ -0,0 +1,97 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <ctime>
+#include <string>
+#include <map>
+#include <utility>
+
+#include <boost/thread/mutex.hpp>
+
+#include "manacommons/color.h"
+
+namespace plugin {
+
+/**
+ *	@brief	Keeps the reports received from VirusTotal for a limited amount of time.
+ *
+ *	Reports are indexed by the SHA256 of the file they describe, so that known files don't
+ *	have to be looked up again. The cache can be saved to a file, one report per line:
+ *	<sha256> <time of the lookup (UNIX timestamp)> <report as JSON>
+ *
+ *	This class is thread-safe.
+ */
+class ReportCache
+{
+public:
+	/**
+	 *	@param	unsigned int ttl The number of seconds during which reports are valid.
+	 */
+	ReportCache(unsigned int ttl) : _ttl(ttl) {}
+
+	/**
+	 *	@brief	Adds the reports contained in a file to the cache. Expired reports are ignored.
+	 *
+	 *	@param	const std::string& path The file to read. It is not an error if it doesn't exist.
+	 *
+	 *	@return	Whether the file could be read.
+	 */
+	bool load(const std::string& path);
+
+	/**
+	 *	@brief	Writes the reports which have not expired into a file.
+	 *
+	 *	@param	const std::string& path The destination file, which is overwritten.
+	 *
+	 *	@return	Whether the file could be written.
+	 */
+	bool save(const std::string& path) const;
+
+	/**
+	 *	@brief	Looks up the report of a file.
+	 *
+	 *	@param	const std::string& sha256 The hash of the file.
+	 *	@param	std::string& report Receives the report, if it was found.
+	 *
+	 *	@return	Whether a report which has not expired was found.
+	 */
+	bool get(const std::string& sha256, std::string& report) const;
+
+	/**
+	 *	@brief	Adds the report of a file to the cache.
+	 *
+	 *	@param	const std::string& sha256 The hash of the file.
+	 *	@param	const std::string& report The report. It must fit on a single line.
+	 *	@param	time_t timestamp When the report was obtained.
+	 */
+	void put(const std::string& sha256, const std::string& report, time_t timestamp = time(nullptr));
+
+	size_t size() const;
+
+private:
+	bool _is_expired(time_t timestamp) const {
+		return time(nullptr) - timestamp >= static_cast<time_t>(_ttl);
+	}
+
+	unsigned int _ttl;
+	std::map<std::string, std::pair<time_t, std::string> > _reports;
+	mutable boost::mutex _mutex;
+};
+
+} // !namespace plugin
@@ -0,0 +1,72 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "plugins/plugin_virustotal/token_bucket.h"
+
+#include <thread>
+#include <algorithm>
+
+namespace plugin {
+
+TokenBucket::TokenBucket(double rate, double capacity)
+	: _rate(rate), _capacity(std::max(1., capacity)), _tokens(_capacity), _last_refill(clock::now())
+{}
+
+// ----------------------------------------------------------------------------
+
+void TokenBucket::_refill()
+{
+	clock::time_point now = clock::now();
+	double elapsed = std::chrono::duration<double>(now - _last_refill).count();
+	_tokens = std::min(_capacity, _tokens + elapsed * _rate);
+	_last_refill = now;
+}
+
+// ----------------------------------------------------------------------------
+
+bool TokenBucket::try_acquire()
+{
+	if (_rate <= 0) {
+		return true;
+	}
+
+	boost::mutex::scoped_lock lock(_mutex);
+	_refill();
+	if (_tokens < 1) {
+		return false;
+	}
+	_tokens -= 1;
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void TokenBucket::acquire()
+{
+	while (!try_acquire())
+	{
+		// Sleep until the next token should be available.
+		double missing;
+		{
+			boost::mutex::scoped_lock lock(_mutex);
+			missing = 1 - _tokens;
+		}
+		std::this_thread::sleep_for(std::chrono::duration<double>(std::max(missing, 0.) / _rate));
+	}
+}
+
+} // !namespace plugin
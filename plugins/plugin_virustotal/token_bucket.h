@@ -0,0 +1,67 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <boost/thread/mutex.hpp>
+
+namespace plugin {
+
+/**
+ *	@brief	Limits the rate of an operation with a token bucket.
+ *
+ *	Each operation consumes a token. Tokens are added at a constant rate, up to the capacity of
+ *	the bucket, so that short bursts are allowed while the average rate stays under the limit.
+ */
+class TokenBucket
+{
+public:
+	/**
+	 *	@param	double rate The number of tokens added per second. 0 disables the limit.
+	 *	@param	double capacity The maximum number of tokens. The bucket starts full.
+	 */
+	TokenBucket(double rate, double capacity);
+
+	/**
+	 *	@brief	Takes a token, waiting until one is available if needed.
+	 */
+	void acquire();
+
+	/**
+	 *	@brief	Takes a token if one is available.
+	 *
+	 *	@return	Whether a token was taken.
+	 */
+	bool try_acquire();
+
+private:
+	typedef std::chrono::steady_clock clock;
+
+	/**
+	 *	@brief	Adds the tokens accumulated since the last refill.
+	 */
+	void _refill();
+
+	double				_rate;
+	double				_capacity;
+	double				_tokens;
+	clock::time_point	_last_refill;
+	boost::mutex		_mutex;
+};
+
+} // !namespace plugin
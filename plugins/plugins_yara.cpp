@@ -15,6 +15,8 @@
     along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <boost/filesystem.hpp>
+
 #include "yara/yara_wrapper.h"
 // The structure used to communicate with the yara ManaPE module.
 #include "yara/modules/manape_data.h"
@@ -52,7 +54,7 @@ public:
 	/**
 	 *	@brief	Helper function designed to generically prepare a result based on a Yara scan.
 	 *
-	 *	@param	const mana::PE& pe The PE to scan.
+	 *	@param	IAnalysisContext& context The context of the PE to scan.
 	 *	const std::string& summary The summary to set if there is a match.
 	 *	Result::LEVEL level The threat level to set if there is a match.
 	 *	const std::string& meta_field_name The meta field name (of the yara rule) to query to
@@ -61,14 +63,16 @@ public:
 	 *
 	 *	@return	A pResult detailing the findings of the scan.
 	 */
-	pResult scan(const mana::PE& pe, const std::string& summary, LEVEL level, const std::string& meta_field_name, bool show_strings = false)
+	pResult scan(IAnalysisContext& context, const std::string& summary, LEVEL level, const std::string& meta_field_name, bool show_strings = false)
 	{
 		pResult res = create_result();
-		if (!_load_rules()) {
+		yara::pYara engine = _load_rules(context);
+		if (!engine) {
 			return res;
 		}
 
-		yara::const_matches m = _engine.scan_file(*pe.get_path(), _create_manape_module_data(pe));
+		const mana::PE& pe = context.get_pe();
+		yara::const_matches m = engine->scan_file(*pe.get_path(), _create_manape_module_data(pe));
 		if (m && m->size() > 0)
 		{
 			res->set_level(level);
@@ -95,20 +99,24 @@ public:
 		return res;
 	}
 
-	int get_api_version() const override { return 1; }
+	int get_api_version() const override { return 2; }
+
+	// The resources are needed to fill the data of the manape Yara module.
+	unsigned int get_required_components() const override {
+		return mana::PE::COMPONENT_RESOURCES;
+	}
 
 protected:
 	std::string _rule_file;
-	yara::Yara _engine;
 
-	virtual bool _load_rules()
-	{
-		if (!_engine.load_rules(_rule_file))
-		{
-			PRINT_ERROR << "Could not load " << _rule_file << "!" << std::endl;
-			return false;
-		}
-		return true;
+	/**
+	 *	@brief	Obtains the plugin's rules from the context, which only compiles them once for
+	 *			the whole run (and reports them once if they could not be loaded).
+	 *
+	 *	@return	The Yara engine containing the rules, or a NULL pointer if they could not be loaded.
+	 */
+	yara::pYara _load_rules(IAnalysisContext& context) {
+		return context.get_rules(_rule_file);
 	}
 
 private:
@@ -176,8 +184,8 @@ class ClamavPlugin : public YaraPlugin
 public:
 	ClamavPlugin() : YaraPlugin("yara_rules/clamav.yara") {}
 
-	pResult analyze(const mana::PE& pe) override {
-		return scan(pe, "Matching ClamAV signature(s):", MALICIOUS, "signature");
+	pResult analyze_sample(IAnalysisContext& context) override {
+		return scan(context, "Matching ClamAV signature(s):", MALICIOUS, "signature");
 	}
 
 	pString get_id() const override {
@@ -188,23 +196,17 @@ public:
 		return boost::make_shared<std::string>("Scans the binary with ClamAV virus definitions.");
 	}
 
-private:
 	/**
-	 *	@brief	This function is overriden only to display an error message specific to ClamAV
-	 *			rules, which need to be generated manually.
-	 *
-	 *	@return	Whether the rules were loaded successfully.
+	 *	@brief	Displays an error message specific to ClamAV rules, which need to be generated manually.
 	 */
-	virtual bool _load_rules() override
+	void on_load(const string_map& config) override
 	{
-		if (!_engine.load_rules(_rule_file))
+		if (!boost::filesystem::exists(_rule_file))
 		{
 			PRINT_ERROR << "ClamAV rules haven't been generated yet!" << std::endl;
 			PRINT_ERROR << "Please run yara_rules/update_clamav_signatures.py to create them, "
 				"and refer to the documentation for additional information." << std::endl;
-			return false;
 		}
-		return true;
 	}
 };
 
@@ -213,8 +215,8 @@ class CompilerDetectionPlugin : public YaraPlugin
 public:
 	CompilerDetectionPlugin() : YaraPlugin("yara_rules/compilers.yara") {}
 
-	pResult analyze(const mana::PE& pe) override {
-		return scan(pe, "Matching compiler(s):", NO_OPINION, "description");
+	pResult analyze_sample(IAnalysisContext& context) override {
+		return scan(context, "Matching compiler(s):", NO_OPINION, "description");
 	}
 
 	pString get_id() const override {
@@ -231,8 +233,8 @@ class PEiDPlugin : public YaraPlugin
 public:
 	PEiDPlugin() : YaraPlugin("yara_rules/peid.yara") {}
 
-	pResult analyze(const mana::PE& pe) override {
-		return scan(pe, "PEiD Signature:", SUSPICIOUS, "packer_name");
+	pResult analyze_sample(IAnalysisContext& context) override {
+		return scan(context, "PEiD Signature:", SUSPICIOUS, "packer_name");
 	}
 
 	boost::shared_ptr<std::string> get_id() const override {
@@ -250,8 +252,8 @@ class SuspiciousStringsPlugin : public YaraPlugin
 public:
 	SuspiciousStringsPlugin() : YaraPlugin("yara_rules/suspicious_strings.yara") {}
 
-	pResult analyze(const mana::PE& pe) override {
-		return scan(pe, "Strings found in the binary may indicate undesirable behavior:", SUSPICIOUS, "description", true);
+	pResult analyze_sample(IAnalysisContext& context) override {
+		return scan(context, "Strings found in the binary may indicate undesirable behavior:", SUSPICIOUS, "description", true);
 	}
 
 	boost::shared_ptr<std::string> get_id() const override {
@@ -268,9 +270,10 @@ class FindCryptPlugin : public YaraPlugin
 public:
 	FindCryptPlugin() : YaraPlugin("yara_rules/findcrypt.yara") {}
 
-	pResult analyze(const mana::PE& pe) override
+	pResult analyze_sample(IAnalysisContext& context) override
 	{
-		pResult res = scan(pe, "Cryptographic algorithms detected in the binary:", NO_OPINION, "description");
+		pResult res = scan(context, "Cryptographic algorithms detected in the binary:", NO_OPINION, "description");
+		const mana::PE& pe = context.get_pe();
 
 		// Look for common cryptography libraries
 		if (pe.find_imports(".*", "libssl(32)?.dll|libcrypto.dll")->size() > 0) {
@@ -301,6 +304,10 @@ public:
 	boost::shared_ptr<std::string> get_description() const override {
 		return boost::make_shared<std::string>("Detects embedded cryptographic constants.");
 	}
+
+	unsigned int get_required_components() const override {
+		return YaraPlugin::get_required_components() | mana::PE::COMPONENT_IMPORTS;
+	}
 };
 
 AutoRegister<ClamavPlugin> auto_register_clamav;
@@ -0,0 +1,771 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cbor.h"
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <limits>
+
+namespace io {
+namespace cbor {
+
+// CBOR major types.
+const boost::uint8_t MT_UNSIGNED	= 0;
+const boost::uint8_t MT_NEGATIVE	= 1;
+const boost::uint8_t MT_BYTES		= 2;
+const boost::uint8_t MT_TEXT		= 3;
+const boost::uint8_t MT_ARRAY		= 4;
+const boost::uint8_t MT_MAP			= 5;
+const boost::uint8_t MT_TAG			= 6;
+const boost::uint8_t MT_SIMPLE		= 7;
+
+// Tags defined by the stringref extension.
+const boost::uint64_t TAG_STRINGREF				= 25;
+const boost::uint64_t TAG_STRINGREF_NAMESPACE	= 256;
+
+// The deepest nesting of items the decoder accepts. The Writer never goes past a few levels,
+// but crafted records could otherwise exhaust the stack.
+const unsigned int MAX_DEPTH = 256;
+
+// Records are read in blocks of this size, so that a forged length does not allocate more
+// memory than the stream actually contains.
+const size_t RECORD_BLOCK_SIZE = 64 * 1024;
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Returns the minimum length a string must have to be added to a stringref table.
+ *
+ *	This rule guarantees that references are never larger than the strings they replace.
+ *	Encoders and decoders must apply it identically, since the table is never transmitted.
+ *
+ *	@param	boost::uint64_t table_size The number of strings already in the table.
+ */
+boost::uint64_t min_reference_length(boost::uint64_t table_size)
+{
+	if (table_size < 24) {
+		return 3;
+	}
+	else if (table_size < 256) {
+		return 4;
+	}
+	else if (table_size < 65536) {
+		return 5;
+	}
+	else if (table_size < 4294967296ULL) {
+		return 7;
+	}
+	return 11;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Checks whether a string contains valid UTF-8.
+ */
+bool is_valid_utf8(const std::string& s)
+{
+	for (size_t i = 0 ; i < s.length() ; ++i)
+	{
+		boost::uint8_t c = static_cast<boost::uint8_t>(s[i]);
+		if (c < 0x80) {
+			continue;
+		}
+
+		unsigned int continuation_bytes;
+		if (c >= 0xC2 && c <= 0xDF) {
+			continuation_bytes = 1;
+		}
+		else if (c >= 0xE0 && c <= 0xEF) {
+			continuation_bytes = 2;
+		}
+		else if (c >= 0xF0 && c <= 0xF4) {
+			continuation_bytes = 3;
+		}
+		else {
+			return false;
+		}
+
+		if (i + continuation_bytes >= s.length()) {
+			return false;
+		}
+		for (unsigned int j = 0 ; j < continuation_bytes ; ++j)
+		{
+			if ((static_cast<boost::uint8_t>(s[++i]) & 0xC0) != 0x80) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+Writer::Writer(bool deduplicate_strings)
+	: _deduplicate_strings(deduplicate_strings), _string_table_size(0)
+{
+	if (_deduplicate_strings) {
+		_write_header(MT_TAG, TAG_STRINGREF_NAMESPACE);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void Writer::_write_header(boost::uint8_t major_type, boost::uint64_t value)
+{
+	boost::uint8_t initial_byte = static_cast<boost::uint8_t>(major_type << 5);
+	unsigned int size;
+	if (value < 24)
+	{
+		_buffer.push_back(static_cast<char>(initial_byte | value));
+		return;
+	}
+	else if (value <= 0xFF)
+	{
+		_buffer.push_back(static_cast<char>(initial_byte | 24));
+		size = 1;
+	}
+	else if (value <= 0xFFFF)
+	{
+		_buffer.push_back(static_cast<char>(initial_byte | 25));
+		size = 2;
+	}
+	else if (value <= 0xFFFFFFFF)
+	{
+		_buffer.push_back(static_cast<char>(initial_byte | 26));
+		size = 4;
+	}
+	else
+	{
+		_buffer.push_back(static_cast<char>(initial_byte | 27));
+		size = 8;
+	}
+
+	// Arguments are stored in network byte order.
+	for (int i = size - 1 ; i >= 0 ; --i) {
+		_buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void Writer::write_map_header(boost::uint64_t size) {
+	_write_header(MT_MAP, size);
+}
+
+// ----------------------------------------------------------------------------
+
+void Writer::write_array_header(boost::uint64_t size) {
+	_write_header(MT_ARRAY, size);
+}
+
+// ----------------------------------------------------------------------------
+
+void Writer::write_uint(boost::uint64_t value) {
+	_write_header(MT_UNSIGNED, value);
+}
+
+// ----------------------------------------------------------------------------
+
+void Writer::write_float(float value)
+{
+	boost::uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	_buffer.push_back(static_cast<char>(0xFA));
+	for (int i = 3 ; i >= 0 ; --i) {
+		_buffer.push_back(static_cast<char>((bits >> (8 * i)) & 0xFF));
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void Writer::write_double(double value)
+{
+	boost::uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	_buffer.push_back(static_cast<char>(0xFB));
+	for (int i = 7 ; i >= 0 ; --i) {
+		_buffer.push_back(static_cast<char>((bits >> (8 * i)) & 0xFF));
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void Writer::write_string(const std::string& s)
+{
+	boost::uint8_t major_type = is_valid_utf8(s) ? MT_TEXT : MT_BYTES;
+
+	if (_deduplicate_strings)
+	{
+		std::string key = static_cast<char>(major_type) + s;
+		auto it = _string_table.find(key);
+		if (it != _string_table.end())
+		{
+			_write_header(MT_TAG, TAG_STRINGREF);
+			_write_header(MT_UNSIGNED, it->second);
+			return;
+		}
+		if (s.length() >= min_reference_length(_string_table_size)) {
+			_string_table[key] = _string_table_size++;
+		}
+	}
+
+	_write_header(major_type, s.length());
+	_buffer.append(s);
+}
+
+// ----------------------------------------------------------------------------
+
+void write_record(std::ostream& sink, const std::string& item)
+{
+	if (item.length() > std::numeric_limits<boost::uint32_t>::max())
+	{
+		PRINT_ERROR << "[CBOR] The item is too large to fit in a record!" << std::endl;
+		return;
+	}
+
+	boost::uint32_t size = static_cast<boost::uint32_t>(item.length());
+	char prefix[4] = { static_cast<char>(size >> 24),
+					   static_cast<char>((size >> 16) & 0xFF),
+					   static_cast<char>((size >> 8) & 0xFF),
+					   static_cast<char>(size & 0xFF) };
+	sink.write(prefix, sizeof(prefix));
+	sink.write(item.c_str(), item.length());
+}
+
+// ----------------------------------------------------------------------------
+
+bool read_record(std::istream& source, std::string& item)
+{
+	boost::uint8_t prefix[4];
+	source.read(reinterpret_cast<char*>(prefix), sizeof(prefix));
+	if (source.gcount() == 0) { // End of the stream.
+		return false;
+	}
+	else if (source.gcount() != sizeof(prefix))
+	{
+		PRINT_ERROR << "[CBOR] Truncated record header!" << std::endl;
+		return false;
+	}
+
+	boost::uint64_t size = 0;
+	for (unsigned int i = 0 ; i < sizeof(prefix) ; ++i) {
+		size = (size << 8) | prefix[i];
+	}
+	if (size > item.max_size())
+	{
+		PRINT_ERROR << "[CBOR] The record is too large!" << std::endl;
+		return false;
+	}
+
+	item.clear();
+	while (item.size() < size)
+	{
+		size_t offset = item.size();
+		size_t block = static_cast<size_t>(std::min<boost::uint64_t>(size - offset, RECORD_BLOCK_SIZE));
+		item.resize(offset + block);
+		source.read(&item[offset], block);
+		if (static_cast<size_t>(source.gcount()) != block)
+		{
+			PRINT_ERROR << "[CBOR] Truncated record!" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Decodes CBOR items into JSON.
+ *
+ *	Only the subset of CBOR produced by the Writer is supported, plus the simple values
+ *	and negative integers. Indefinite-length items are rejected.
+ */
+class Reader
+{
+public:
+	Reader(const std::string& item) : _item(item), _offset(0), _depth(0) {}
+
+	/**
+	 *	@brief	Converts the next data item into JSON.
+	 *
+	 *	@param	std::ostream& sink The destination stream.
+	 *	@param	int level The indentation level.
+	 *
+	 *	@return	Whether the item could be decoded. Items nested more than MAX_DEPTH times
+	 *			are rejected.
+	 */
+	bool dump_value(std::ostream& sink, int level);
+
+	/**
+	 *	@brief	Writes the entries of a map into JSON, without the enclosing braces.
+	 *
+	 *	@param	std::ostream& sink The destination stream.
+	 *	@param	int level The indentation level.
+	 *	@param	unsigned int& entries_written The number of entries written so far in the enclosing
+	 *			object. It is used to separate entries across multiple maps and updated accordingly.
+	 *
+	 *	@return	Whether the map could be decoded.
+	 */
+	bool dump_map_entries(std::ostream& sink, int level, unsigned int& entries_written);
+
+private:
+	bool _read_header(boost::uint8_t& major_type, boost::uint8_t& additional_info, boost::uint64_t& value);
+	bool _read_string(std::string& s, bool& is_text);
+	bool _read_string_data(boost::uint8_t major_type, boost::uint64_t length, std::string& s);
+	bool _dump_map_contents(std::ostream& sink, int level, boost::uint64_t size, unsigned int& entries_written);
+	bool _dump_value(std::ostream& sink, int level);
+
+	const std::string&	_item;
+	size_t				_offset;
+	unsigned int		_depth;	// The number of items being decoded by dump_value.
+	// One table of strings per stringref namespace. The pair contains the string and whether it is text.
+	std::vector<std::vector<std::pair<std::string, bool> > > _namespaces;
+};
+
+// ----------------------------------------------------------------------------
+
+std::string indent(int level) {
+	return std::string(4 * level, ' ');
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Writes a string into a JSON document.
+ *
+ *	@param	std::ostream& sink The destination stream.
+ *	@param	const std::string& s The string to write.
+ *	@param	bool is_text Whether the string contains UTF-8 text. Otherwise, bytes over 0x7F are
+ *			escaped individually.
+ */
+void write_json_string(std::ostream& sink, const std::string& s, bool is_text)
+{
+	static const char* hex_digits = "0123456789abcdef";
+	sink << '"';
+	for (auto it = s.begin() ; it != s.end() ; ++it)
+	{
+		boost::uint8_t c = static_cast<boost::uint8_t>(*it);
+		switch (c)
+		{
+			case '"':	sink << "\\\""; break;
+			case '\\':	sink << "\\\\"; break;
+			case '\b':	sink << "\\b"; break;
+			case '\f':	sink << "\\f"; break;
+			case '\n':	sink << "\\n"; break;
+			case '\r':	sink << "\\r"; break;
+			case '\t':	sink << "\\t"; break;
+			default:
+				if (c < 0x20 || (c >= 0x7F && !is_text)) {
+					sink << "\\u00" << hex_digits[c >> 4] << hex_digits[c & 0xF];
+				}
+				else {
+					sink << *it;
+				}
+		}
+	}
+	sink << '"';
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Writes a floating point number into a JSON document.
+ *
+ *	The shortest representation which reads back as the same value is used, so that no
+ *	precision is lost. JSON has no representation for infinities and NaN: they become null.
+ *
+ *	@param	std::ostream& sink The destination stream.
+ *	@param	double d The number to write.
+ *	@param	bool single_precision Whether the number was encoded as a float, in which case it
+ *			only has to read back as the same float.
+ */
+void write_json_number(std::ostream& sink, double d, bool single_precision)
+{
+	if (std::isnan(d) || std::isinf(d))
+	{
+		sink << "null";
+		return;
+	}
+
+	int max_digits = single_precision ? std::numeric_limits<float>::max_digits10
+									  : std::numeric_limits<double>::max_digits10;
+	char buffer[32];
+	for (int precision = 6 ; precision <= max_digits ; ++precision)
+	{
+		snprintf(buffer, sizeof(buffer), "%.*g", precision, d);
+		double read_back = strtod(buffer, NULL);
+		if (single_precision ? static_cast<float>(read_back) == static_cast<float>(d) : read_back == d) {
+			break;
+		}
+	}
+	sink << buffer;
+}
+
+// ----------------------------------------------------------------------------
+
+bool Reader::_read_header(boost::uint8_t& major_type, boost::uint8_t& additional_info, boost::uint64_t& value)
+{
+	if (_offset >= _item.length()) {
+		return false;
+	}
+	boost::uint8_t initial_byte = static_cast<boost::uint8_t>(_item[_offset++]);
+	major_type = initial_byte >> 5;
+	additional_info = initial_byte & 0x1F;
+
+	unsigned int size;
+	if (additional_info < 24)
+	{
+		value = additional_info;
+		return true;
+	}
+	else if (additional_info == 24) {
+		size = 1;
+	}
+	else if (additional_info == 25) {
+		size = 2;
+	}
+	else if (additional_info == 26) {
+		size = 4;
+	}
+	else if (additional_info == 27) {
+		size = 8;
+	}
+	else
+	{
+		PRINT_ERROR << "[CBOR] Unsupported additional information (" << static_cast<int>(additional_info) << ")!"
+			<< std::endl;
+		return false;
+	}
+
+	if (_offset + size > _item.length()) {
+		return false;
+	}
+	value = 0;
+	for (unsigned int i = 0 ; i < size ; ++i) {
+		value = (value << 8) | static_cast<boost::uint8_t>(_item[_offset++]);
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool Reader::_read_string_data(boost::uint8_t major_type, boost::uint64_t length, std::string& s)
+{
+	if (length > _item.length() - _offset) {
+		return false;
+	}
+	s = _item.substr(_offset, static_cast<size_t>(length));
+	_offset += static_cast<size_t>(length);
+
+	// Mirror the table built by the Writer.
+	if (!_namespaces.empty() && length >= min_reference_length(_namespaces.back().size())) {
+		_namespaces.back().push_back(std::make_pair(s, major_type == MT_TEXT));
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool Reader::_read_string(std::string& s, bool& is_text)
+{
+	boost::uint8_t major_type, additional_info;
+	boost::uint64_t value;
+	if (!_read_header(major_type, additional_info, value)) {
+		return false;
+	}
+
+	if (major_type == MT_TEXT || major_type == MT_BYTES)
+	{
+		is_text = major_type == MT_TEXT;
+		return _read_string_data(major_type, value, s);
+	}
+	else if (major_type == MT_TAG && value == TAG_STRINGREF)
+	{
+		if (!_read_header(major_type, additional_info, value) || major_type != MT_UNSIGNED) {
+			return false;
+		}
+		if (_namespaces.empty() || value >= _namespaces.back().size())
+		{
+			PRINT_ERROR << "[CBOR] Invalid string reference!" << std::endl;
+			return false;
+		}
+		s = _namespaces.back()[static_cast<size_t>(value)].first;
+		is_text = _namespaces.back()[static_cast<size_t>(value)].second;
+		return true;
+	}
+
+	PRINT_ERROR << "[CBOR] Expected a string (major type " << static_cast<int>(major_type) << " found)!" << std::endl;
+	return false;
+}
+
+// ----------------------------------------------------------------------------
+
+bool Reader::_dump_map_contents(std::ostream& sink, int level, boost::uint64_t size, unsigned int& entries_written)
+{
+	for (boost::uint64_t i = 0 ; i < size ; ++i)
+	{
+		std::string key;
+		bool is_text;
+		if (!_read_string(key, is_text)) {
+			return false;
+		}
+		if (entries_written++ > 0) {
+			sink << ",";
+		}
+		sink << std::endl << indent(level);
+		write_json_string(sink, key, is_text);
+		sink << ": ";
+		if (!dump_value(sink, level)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool Reader::dump_map_entries(std::ostream& sink, int level, unsigned int& entries_written)
+{
+	boost::uint8_t major_type, additional_info;
+	boost::uint64_t value;
+	unsigned int opened_namespaces = 0;
+	if (!_read_header(major_type, additional_info, value)) {
+		return false;
+	}
+	while (major_type == MT_TAG)
+	{
+		if (value == TAG_STRINGREF_NAMESPACE)
+		{
+			_namespaces.push_back(std::vector<std::pair<std::string, bool> >());
+			++opened_namespaces;
+		}
+		if (!_read_header(major_type, additional_info, value)) {
+			return false;
+		}
+	}
+	if (major_type != MT_MAP)
+	{
+		PRINT_ERROR << "[CBOR] The record does not contain a map!" << std::endl;
+		return false;
+	}
+
+	bool res = _dump_map_contents(sink, level, value, entries_written);
+	for (unsigned int i = 0 ; i < opened_namespaces ; ++i) {
+		_namespaces.pop_back();
+	}
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+bool Reader::dump_value(std::ostream& sink, int level)
+{
+	if (_depth >= MAX_DEPTH)
+	{
+		PRINT_ERROR << "[CBOR] Items are nested too deeply!" << std::endl;
+		return false;
+	}
+	++_depth;
+	bool res = _dump_value(sink, level);
+	--_depth;
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+bool Reader::_dump_value(std::ostream& sink, int level)
+{
+	boost::uint8_t major_type, additional_info;
+	boost::uint64_t value;
+	size_t item_start = _offset;
+	if (!_read_header(major_type, additional_info, value)) {
+		return false;
+	}
+
+	switch (major_type)
+	{
+		case MT_UNSIGNED:
+			sink << value;
+			return true;
+
+		case MT_NEGATIVE:
+			if (value == std::numeric_limits<boost::uint64_t>::max()) {
+				sink << "-18446744073709551616";
+			}
+			else {
+				sink << "-" << value + 1;
+			}
+			return true;
+
+		case MT_BYTES:
+		case MT_TEXT:
+		{
+			std::string s;
+			if (!_read_string_data(major_type, value, s)) {
+				return false;
+			}
+			write_json_string(sink, s, major_type == MT_TEXT);
+			return true;
+		}
+
+		case MT_ARRAY:
+		{
+			sink << "[";
+			for (boost::uint64_t i = 0 ; i < value ; ++i)
+			{
+				if (i > 0) {
+					sink << ",";
+				}
+				sink << std::endl << indent(level + 1);
+				if (!dump_value(sink, level + 1)) {
+					return false;
+				}
+			}
+			if (value > 0) {
+				sink << std::endl << indent(level);
+			}
+			sink << "]";
+			return true;
+		}
+
+		case MT_MAP:
+		{
+			unsigned int entries_written = 0;
+			sink << "{";
+			if (!_dump_map_contents(sink, level + 1, value, entries_written)) {
+				return false;
+			}
+			if (value > 0) {
+				sink << std::endl << indent(level);
+			}
+			sink << "}";
+			return true;
+		}
+
+		case MT_TAG:
+			if (value == TAG_STRINGREF)
+			{
+				std::string s;
+				bool is_text;
+				_offset = item_start; // Let _read_string resolve the reference.
+				if (!_read_string(s, is_text)) {
+					return false;
+				}
+				write_json_string(sink, s, is_text);
+				return true;
+			}
+			else if (value == TAG_STRINGREF_NAMESPACE)
+			{
+				_namespaces.push_back(std::vector<std::pair<std::string, bool> >());
+				bool res = dump_value(sink, level);
+				_namespaces.pop_back();
+				return res;
+			}
+			return dump_value(sink, level); // Other tags are ignored.
+
+		case MT_SIMPLE:
+			switch (additional_info)
+			{
+				case 20:
+					sink << "false";
+					return true;
+				case 21:
+					sink << "true";
+					return true;
+				case 22:
+				case 23:
+					sink << "null";
+					return true;
+				case 25: // Half-precision float
+				{
+					int exponent = (value >> 10) & 0x1F;
+					double mantissa = static_cast<double>(value & 0x3FF);
+					double d;
+					if (exponent == 0) {
+						d = std::ldexp(mantissa, -24);
+					}
+					else if (exponent != 31) {
+						d = std::ldexp(mantissa + 1024, exponent - 25);
+					}
+					else {
+						d = mantissa == 0 ? std::numeric_limits<double>::infinity() : std::numeric_limits<double>::quiet_NaN();
+					}
+					write_json_number(sink, (value & 0x8000) ? -d : d, true);
+					return true;
+				}
+				case 26:
+				{
+					float f;
+					boost::uint32_t bits = static_cast<boost::uint32_t>(value);
+					memcpy(&f, &bits, sizeof(f));
+					write_json_number(sink, f, true);
+					return true;
+				}
+				case 27:
+				{
+					double d;
+					memcpy(&d, &value, sizeof(d));
+					write_json_number(sink, d, false);
+					return true;
+				}
+				default:
+					PRINT_ERROR << "[CBOR] Unsupported simple value (" << static_cast<int>(additional_info) << ")!" << std::endl;
+					return false;
+			}
+	}
+	return false;
+}
+
+// ----------------------------------------------------------------------------
+
+bool records_to_json(std::istream& source, std::ostream& sink)
+{
+	std::string item;
+	unsigned int entries_written = 0;
+	unsigned int record_count = 0;
+
+	sink << "{";
+	while (source.peek() != std::char_traits<char>::eof())
+	{
+		if (!read_record(source, item)) {
+			return false;
+		}
+		Reader reader(item);
+		if (!reader.dump_map_entries(sink, 1, entries_written))
+		{
+			PRINT_ERROR << "[CBOR] Could not decode record #" << record_count << "!" << std::endl;
+			return false;
+		}
+		++record_count;
+	}
+
+	if (entries_written > 0) {
+		sink << std::endl;
+	}
+	sink << "}" << std::endl;
+	return true;
+}
+
+} // !namespace cbor
+} // !namespace io
@@ -0,0 +1,61 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+
+#include <boost/system/api_config.hpp>
+
+#ifdef BOOST_WINDOWS_API
+# include <io.h>
+# include <fcntl.h>
+#endif
+
+#include "cbor.h"
+
+/**
+ *	@brief	Converts the binary records written by "manalyze -o cbor" back into JSON.
+ *
+ *	Usage: cbor2json [file]
+ *	The records are read from the standard input if no file is given.
+ */
+int main(int argc, char** argv)
+{
+	if (argc > 2 || (argc == 2 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help")))
+	{
+		std::cout << "Usage: " << argv[0] << " [file]" << std::endl;
+		std::cout << "Converts the output of \"manalyze -o cbor\" into JSON. Reads from stdin if no file is given." << std::endl;
+		return argc == 2 ? 0 : -1;
+	}
+
+	if (argc == 2)
+	{
+		std::ifstream input(argv[1], std::ios::binary);
+		if (!input.is_open())
+		{
+			PRINT_ERROR << "Could not open " << argv[1] << "!" << std::endl;
+			return -1;
+		}
+		return io::cbor::records_to_json(input, std::cout) ? 0 : -1;
+	}
+
+	#ifdef BOOST_WINDOWS_API
+		_setmode(_fileno(stdin), _O_BINARY);
+	#endif
+	return io::cbor::records_to_json(std::cin, std::cout) ? 0 : -1;
+}
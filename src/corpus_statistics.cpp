@@ -0,0 +1,198 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "corpus_statistics.h"
+
+#include <iomanip>
+#include <sstream>
+
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+
+namespace mana
+{
+
+namespace {
+
+const unsigned int ENTROPY_BUCKETS = 16; // 0 to 8 bits, in steps of 0.5.
+
+/**
+ *	@brief	Converts a frequency sketch into an output node listing its most frequent keys.
+ *
+ *	@param	unsigned int count The number of keys to list.
+ */
+io::pNode top_keys_node(const std::string& name, const FrequencySketch& sketch, unsigned int count)
+{
+	io::pNode res = io::make_node(name, io::OutputTreeNode::LIST);
+	std::vector<std::pair<std::string, boost::uint64_t> > top = sketch.get_top_keys();
+	for (size_t i = 0 ; i < top.size() && i < count ; ++i) {
+		res->append(io::make_node(top[i].first, top[i].second));
+	}
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+io::pNode counter_node(const std::string& name, const std::map<std::string, boost::uint64_t>& c)
+{
+	io::pNode res = io::make_node(name, io::OutputTreeNode::LIST);
+	for (auto it = c.begin() ; it != c.end() ; ++it) {
+		res->append(io::make_node(it->first, it->second));
+	}
+	return res;
+}
+
+} // !namespace
+
+// ----------------------------------------------------------------------------
+
+CorpusStatistics::CorpusStatistics(unsigned int top_keys)
+	: _top_keys(top_keys),
+	  _samples(0),
+	  _section_entropy(ENTROPY_BUCKETS, 0),
+	  _section_names(2 * top_keys),	// Keep more candidates than reported, so that the top keys
+	  _imports(2 * top_keys)		// are still accurate after merges.
+{}
+
+// ----------------------------------------------------------------------------
+
+void CorpusStatistics::add(const mana::PE& pe, plugin::IAnalysisContext& context)
+{
+	++_samples;
+
+	auto header = pe.get_pe_header();
+	if (header)
+	{
+		++_machines[*nt::translate_to_flag(header->Machine, nt::MACHINE_TYPES)];
+		boost::posix_time::ptime compilation = boost::posix_time::from_time_t(header->TimeDateStamp);
+		++_compilation_years[boost::lexical_cast<std::string>(static_cast<int>(compilation.date().year()))];
+	}
+	auto optional_header = pe.get_image_optional_header();
+	if (optional_header) {
+		++_subsystems[*nt::translate_to_flag(optional_header->Subsystem, nt::SUBSYSTEMS)];
+	}
+
+	auto sections = pe.get_sections();
+	for (auto it = sections->begin() ; it != sections->end() ; ++it)
+	{
+		_section_names.add(*(*it)->get_name());
+		if ((*it)->get_size_of_raw_data() == 0) {
+			continue;
+		}
+		double entropy = context.get_section_entropy(*it);
+		unsigned int bucket = static_cast<unsigned int>(entropy * 2);
+		++_section_entropy[std::min(bucket, ENTROPY_BUCKETS - 1)];
+	}
+
+	auto dlls = pe.get_imported_dlls();
+	for (auto it = dlls->begin() ; it != dlls->end() ; ++it)
+	{
+		std::string dll = boost::to_lower_copy(*it);
+		auto functions = pe.get_imported_functions(*it);
+		if (functions == nullptr) {
+			continue;
+		}
+		for (auto f = functions->begin() ; f != functions->end() ; ++f) {
+			_imports.add(dll + "!" + boost::to_lower_copy(*f));
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void CorpusStatistics::merge(const CorpusStatistics& other)
+{
+	_samples += other._samples;
+	for (auto it = other._machines.begin() ; it != other._machines.end() ; ++it) {
+		_machines[it->first] += it->second;
+	}
+	for (auto it = other._subsystems.begin() ; it != other._subsystems.end() ; ++it) {
+		_subsystems[it->first] += it->second;
+	}
+	for (auto it = other._compilation_years.begin() ; it != other._compilation_years.end() ; ++it) {
+		_compilation_years[it->first] += it->second;
+	}
+	for (unsigned int i = 0 ; i < ENTROPY_BUCKETS ; ++i) {
+		_section_entropy[i] += other._section_entropy[i];
+	}
+	_section_names.merge(other._section_names);
+	_imports.merge(other._imports);
+}
+
+// ----------------------------------------------------------------------------
+
+std::vector<io::pNode> CorpusStatistics::to_nodes() const
+{
+	std::vector<io::pNode> res;
+
+	io::pNode overview = io::make_node("Overview", io::OutputTreeNode::LIST);
+	overview->append(io::make_node("Samples", _samples));
+	overview->append(io::make_node("Distinct section names", _section_names.get_distinct_keys()));
+	overview->append(io::make_node("Distinct imports", _imports.get_distinct_keys()));
+	res.push_back(overview);
+
+	res.push_back(counter_node("Machines", _machines));
+	res.push_back(counter_node("Subsystems", _subsystems));
+	res.push_back(counter_node("Compilation years", _compilation_years));
+
+	io::pNode entropy = io::make_node("Section entropy", io::OutputTreeNode::LIST);
+	for (unsigned int i = 0 ; i < ENTROPY_BUCKETS ; ++i)
+	{
+		std::stringstream ss;
+		ss << std::fixed << std::setprecision(1) << i / 2.0 << " - " << (i + 1) / 2.0;
+		entropy->append(io::make_node(ss.str(), _section_entropy[i]));
+	}
+	res.push_back(entropy);
+
+	// The sketches keep more keys than reported: the extra ones are only candidates.
+	res.push_back(top_keys_node("Section names", _section_names, _top_keys));
+	res.push_back(top_keys_node("Imports", _imports, _top_keys));
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+CorpusStatistics& StatisticsAggregator::get_partial()
+{
+	CorpusStatistics* res = _current.get();
+	if (res == nullptr)
+	{
+		boost::shared_ptr<CorpusStatistics> partial = boost::make_shared<CorpusStatistics>(_top_keys);
+		{
+			boost::lock_guard<boost::mutex> lock(_mutex);
+			_partials.push_back(partial);
+		}
+		res = partial.get();
+		_current.reset(res);
+	}
+	return *res;
+}
+
+// ----------------------------------------------------------------------------
+
+CorpusStatistics StatisticsAggregator::merge() const
+{
+	boost::lock_guard<boost::mutex> lock(_mutex);
+	CorpusStatistics res(_top_keys);
+	for (auto it = _partials.begin() ; it != _partials.end() ; ++it) {
+		res.merge(**it);
+	}
+	return res;
+}
+
+} // !namespace mana
@@ -30,23 +30,23 @@ void dump_dos_header(const mana::PE& pe, io::OutputFormatter& formatter)
 	std::stringstream magic;
 	magic << header.e_magic[0] << header.e_magic[1];
 
-	io::pNode dos_header(new io::OutputTreeNode("DOS Header", io::OutputTreeNode::LIST));
-	dos_header->append(boost::make_shared<io::OutputTreeNode>("e_magic", magic.str()));
-	dos_header->append(boost::make_shared<io::OutputTreeNode>("e_cblp", header.e_cblp, io::OutputTreeNode::HEX));
-	dos_header->append(boost::make_shared<io::OutputTreeNode>("e_cp", header.e_cp, io::OutputTreeNode::HEX));
-	dos_header->append(boost::make_shared<io::OutputTreeNode>("e_crlc", header.e_crlc, io::OutputTreeNode::HEX));
-	dos_header->append(boost::make_shared<io::OutputTreeNode>("e_cparhdr", header.e_cparhdr, io::OutputTreeNode::HEX));
-	dos_header->append(boost::make_shared<io::OutputTreeNode>("e_minalloc", header.e_minalloc, io::OutputTreeNode::HEX));
-	dos_header->append(boost::make_shared<io::OutputTreeNode>("e_maxalloc", header.e_maxalloc, io::OutputTreeNode::HEX));
-	dos_header->append(boost::make_shared<io::OutputTreeNode>("e_ss", header.e_ss, io::OutputTreeNode::HEX));
-	dos_header->append(boost::make_shared<io::OutputTreeNode>("e_sp", header.e_sp, io::OutputTreeNode::HEX));
-	dos_header->append(boost::make_shared<io::OutputTreeNode>("e_csum", header.e_csum, io::OutputTreeNode::HEX));
-	dos_header->append(boost::make_shared<io::OutputTreeNode>("e_ip", header.e_ip, io::OutputTreeNode::HEX));
-	dos_header->append(boost::make_shared<io::OutputTreeNode>("e_cs", header.e_cs, io::OutputTreeNode::HEX));
-	dos_header->append(boost::make_shared<io::OutputTreeNode>("e_ovno", header.e_ovno, io::OutputTreeNode::HEX));
-	dos_header->append(boost::make_shared<io::OutputTreeNode>("e_oemid", header.e_oemid, io::OutputTreeNode::HEX));
-	dos_header->append(boost::make_shared<io::OutputTreeNode>("e_oeminfo", header.e_oeminfo, io::OutputTreeNode::HEX));
-	dos_header->append(boost::make_shared<io::OutputTreeNode>("e_lfanew", header.e_lfanew, io::OutputTreeNode::HEX));
+	io::pNode dos_header = io::make_node("DOS Header", io::OutputTreeNode::LIST);
+	dos_header->append(io::make_node("e_magic", magic.str()));
+	dos_header->append(io::make_node("e_cblp", header.e_cblp, io::OutputTreeNode::HEX));
+	dos_header->append(io::make_node("e_cp", header.e_cp, io::OutputTreeNode::HEX));
+	dos_header->append(io::make_node("e_crlc", header.e_crlc, io::OutputTreeNode::HEX));
+	dos_header->append(io::make_node("e_cparhdr", header.e_cparhdr, io::OutputTreeNode::HEX));
+	dos_header->append(io::make_node("e_minalloc", header.e_minalloc, io::OutputTreeNode::HEX));
+	dos_header->append(io::make_node("e_maxalloc", header.e_maxalloc, io::OutputTreeNode::HEX));
+	dos_header->append(io::make_node("e_ss", header.e_ss, io::OutputTreeNode::HEX));
+	dos_header->append(io::make_node("e_sp", header.e_sp, io::OutputTreeNode::HEX));
+	dos_header->append(io::make_node("e_csum", header.e_csum, io::OutputTreeNode::HEX));
+	dos_header->append(io::make_node("e_ip", header.e_ip, io::OutputTreeNode::HEX));
+	dos_header->append(io::make_node("e_cs", header.e_cs, io::OutputTreeNode::HEX));
+	dos_header->append(io::make_node("e_ovno", header.e_ovno, io::OutputTreeNode::HEX));
+	dos_header->append(io::make_node("e_oemid", header.e_oemid, io::OutputTreeNode::HEX));
+	dos_header->append(io::make_node("e_oeminfo", header.e_oeminfo, io::OutputTreeNode::HEX));
+	dos_header->append(io::make_node("e_lfanew", header.e_lfanew, io::OutputTreeNode::HEX));
 
 	formatter.add_data(dos_header, *pe.get_path());
 }
@@ -59,17 +59,17 @@ void dump_pe_header(const mana::PE& pe, io::OutputFormatter& formatter)
 		return;
 	}
 	mana::pe_header header = *pe.get_pe_header();
-	io::pNode pe_header(new io::OutputTreeNode("PE Header", io::OutputTreeNode::LIST));
+	io::pNode pe_header = io::make_node("PE Header", io::OutputTreeNode::LIST);
 	std::stringstream ss;
 	ss << header.Signature[0] << header.Signature[1];
-	pe_header->append(boost::make_shared<io::OutputTreeNode>("Signature", ss.str()));
-	pe_header->append(boost::make_shared<io::OutputTreeNode>("Machine", *nt::translate_to_flag(header.Machine, nt::MACHINE_TYPES)));
-	pe_header->append(boost::make_shared<io::OutputTreeNode>("NumberofSections", header.NumberofSections));
-	pe_header->append(boost::make_shared<io::OutputTreeNode>("TimeDateStamp", io::timestamp_to_string(header.TimeDateStamp)));
-	pe_header->append(boost::make_shared<io::OutputTreeNode>("PointerToSymbolTable", header.PointerToSymbolTable, io::OutputTreeNode::HEX));
-	pe_header->append(boost::make_shared<io::OutputTreeNode>("NumberOfSymbols", header.NumberOfSymbols));
-	pe_header->append(boost::make_shared<io::OutputTreeNode>("SizeOfOptionalHeader", header.SizeOfOptionalHeader, io::OutputTreeNode::HEX));
-	pe_header->append(boost::make_shared<io::OutputTreeNode>("Characteristics", *nt::translate_to_flags(header.Characteristics, nt::PE_CHARACTERISTICS)));
+	pe_header->append(io::make_node("Signature", ss.str()));
+	pe_header->append(io::make_node("Machine", *nt::translate_to_flag(header.Machine, nt::MACHINE_TYPES)));
+	pe_header->append(io::make_node("NumberofSections", header.NumberofSections));
+	pe_header->append(io::make_node("TimeDateStamp", io::timestamp_to_string(header.TimeDateStamp)));
+	pe_header->append(io::make_node("PointerToSymbolTable", header.PointerToSymbolTable, io::OutputTreeNode::HEX));
+	pe_header->append(io::make_node("NumberOfSymbols", header.NumberOfSymbols));
+	pe_header->append(io::make_node("SizeOfOptionalHeader", header.SizeOfOptionalHeader, io::OutputTreeNode::HEX));
+	pe_header->append(io::make_node("Characteristics", *nt::translate_to_flags(header.Characteristics, nt::PE_CHARACTERISTICS)));
 
 	formatter.add_data(pe_header, *pe.get_path());
 }
@@ -82,15 +82,15 @@ void dump_image_optional_header(const mana::PE& pe, io::OutputFormatter& formatt
 		return;
 	}
 	mana::image_optional_header ioh = *pe.get_image_optional_header();
-	io::pNode ioh_header(new io::OutputTreeNode("Image Optional Header", io::OutputTreeNode::LIST));
+	io::pNode ioh_header = io::make_node("Image Optional Header", io::OutputTreeNode::LIST);
 
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("Magic", *nt::translate_to_flag(ioh.Magic, nt::IMAGE_OPTIONAL_HEADER_MAGIC)));
+	ioh_header->append(io::make_node("Magic", *nt::translate_to_flag(ioh.Magic, nt::IMAGE_OPTIONAL_HEADER_MAGIC)));
 	std::stringstream ss;
 	ss << static_cast<int>(ioh.MajorLinkerVersion) << "." << static_cast<int>(ioh.MinorImageVersion);
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("LinkerVersion", ss.str()));
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("SizeOfCode", ioh.SizeOfCode, io::OutputTreeNode::HEX));
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("SizeOfInitializedData", ioh.SizeOfInitializedData, io::OutputTreeNode::HEX));
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("SizeOfUninitializedData", ioh.SizeOfUninitializedData, io::OutputTreeNode::HEX));
+	ioh_header->append(io::make_node("LinkerVersion", ss.str()));
+	ioh_header->append(io::make_node("SizeOfCode", ioh.SizeOfCode, io::OutputTreeNode::HEX));
+	ioh_header->append(io::make_node("SizeOfInitializedData", ioh.SizeOfInitializedData, io::OutputTreeNode::HEX));
+	ioh_header->append(io::make_node("SizeOfUninitializedData", ioh.SizeOfUninitializedData, io::OutputTreeNode::HEX));
 
 
 	mana::pSection sec = mana::find_section(ioh.AddressOfEntryPoint, *pe.get_sections());
@@ -101,40 +101,40 @@ void dump_image_optional_header(const mana::PE& pe, io::OutputFormatter& formatt
 	else {
 		ss << std::hex << "0x" << ioh.AddressOfEntryPoint << " (Section: ?)";
 	}
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("AddressOfEntryPoint", ss.str()));
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("BaseOfCode", ioh.BaseOfCode, io::OutputTreeNode::HEX));
+	ioh_header->append(io::make_node("AddressOfEntryPoint", ss.str()));
+	ioh_header->append(io::make_node("BaseOfCode", ioh.BaseOfCode, io::OutputTreeNode::HEX));
 
 	// Field absent from PE32+ headers.
 	if (pe.get_architecture() == PE::x86) {
-		ioh_header->append(boost::make_shared<io::OutputTreeNode>("BaseOfData", ioh.BaseOfData, io::OutputTreeNode::HEX));
+		ioh_header->append(io::make_node("BaseOfData", ioh.BaseOfData, io::OutputTreeNode::HEX));
 	}
 
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("ImageBase", ioh.ImageBase, io::OutputTreeNode::HEX));
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("SectionAlignment", ioh.SectionAlignment, io::OutputTreeNode::HEX));
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("FileAlignment", ioh.FileAlignment, io::OutputTreeNode::HEX));
+	ioh_header->append(io::make_node("ImageBase", ioh.ImageBase, io::OutputTreeNode::HEX));
+	ioh_header->append(io::make_node("SectionAlignment", ioh.SectionAlignment, io::OutputTreeNode::HEX));
+	ioh_header->append(io::make_node("FileAlignment", ioh.FileAlignment, io::OutputTreeNode::HEX));
 
 	ss.str(std::string());
 	ss << static_cast<int>(ioh.MajorOperatingSystemVersion) << "." << static_cast<int>(ioh.MinorOperatingSystemVersion);
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("OperatingSystemVersion", ss.str()));
+	ioh_header->append(io::make_node("OperatingSystemVersion", ss.str()));
 	ss.str(std::string());
 	ss << static_cast<int>(ioh.MajorImageVersion) << "." << static_cast<int>(ioh.MinorImageVersion);
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("ImageVersion", ss.str()));
+	ioh_header->append(io::make_node("ImageVersion", ss.str()));
 	ss.str(std::string());
 	ss << static_cast<int>(ioh.MajorSubsystemVersion) << "." << static_cast<int>(ioh.MinorSubsystemVersion);
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("SubsystemVersion", ss.str()));
-
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("Win32VersionValue", ioh.Win32VersionValue));
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("SizeOfImage", ioh.SizeOfImage, io::OutputTreeNode::HEX));
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("SizeOfHeaders", ioh.SizeOfHeaders, io::OutputTreeNode::HEX));
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("Checksum", ioh.Checksum, io::OutputTreeNode::HEX));
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("Subsystem", *nt::translate_to_flag(ioh.Subsystem, nt::SUBSYSTEMS)));
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("DllCharacteristics", *nt::translate_to_flags(ioh.DllCharacteristics, nt::DLL_CHARACTERISTICS)));
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("SizeofStackReserve", ioh.SizeofStackReserve, io::OutputTreeNode::HEX));
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("SizeofStackCommit", ioh.SizeofStackCommit, io::OutputTreeNode::HEX));
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("SizeofHeapReserve", ioh.SizeofHeapReserve, io::OutputTreeNode::HEX));
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("SizeofHeapCommit", ioh.SizeofHeapCommit, io::OutputTreeNode::HEX));
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("LoaderFlags", ioh.LoaderFlags, io::OutputTreeNode::HEX));
-	ioh_header->append(boost::make_shared<io::OutputTreeNode>("NumberOfRvaAndSizes", ioh.NumberOfRvaAndSizes));
+	ioh_header->append(io::make_node("SubsystemVersion", ss.str()));
+
+	ioh_header->append(io::make_node("Win32VersionValue", ioh.Win32VersionValue));
+	ioh_header->append(io::make_node("SizeOfImage", ioh.SizeOfImage, io::OutputTreeNode::HEX));
+	ioh_header->append(io::make_node("SizeOfHeaders", ioh.SizeOfHeaders, io::OutputTreeNode::HEX));
+	ioh_header->append(io::make_node("Checksum", ioh.Checksum, io::OutputTreeNode::HEX));
+	ioh_header->append(io::make_node("Subsystem", *nt::translate_to_flag(ioh.Subsystem, nt::SUBSYSTEMS)));
+	ioh_header->append(io::make_node("DllCharacteristics", *nt::translate_to_flags(ioh.DllCharacteristics, nt::DLL_CHARACTERISTICS)));
+	ioh_header->append(io::make_node("SizeofStackReserve", ioh.SizeofStackReserve, io::OutputTreeNode::HEX));
+	ioh_header->append(io::make_node("SizeofStackCommit", ioh.SizeofStackCommit, io::OutputTreeNode::HEX));
+	ioh_header->append(io::make_node("SizeofHeapReserve", ioh.SizeofHeapReserve, io::OutputTreeNode::HEX));
+	ioh_header->append(io::make_node("SizeofHeapCommit", ioh.SizeofHeapCommit, io::OutputTreeNode::HEX));
+	ioh_header->append(io::make_node("LoaderFlags", ioh.LoaderFlags, io::OutputTreeNode::HEX));
+	ioh_header->append(io::make_node("NumberOfRvaAndSizes", ioh.NumberOfRvaAndSizes));
 
 	formatter.add_data(ioh_header, *pe.get_path());
 }
@@ -148,29 +148,29 @@ void dump_section_table(const mana::PE& pe, io::OutputFormatter& formatter, bool
 		return;
 	}
 
-	io::pNode section_list(new io::OutputTreeNode("Sections", io::OutputTreeNode::LIST));
+	io::pNode section_list = io::make_node("Sections", io::OutputTreeNode::LIST);
 
 	for (auto it = sections->begin(); it != sections->end(); ++it)
 	{
-		io::pNode section_node(new io::OutputTreeNode(*(*it)->get_name(), io::OutputTreeNode::LIST));
+		io::pNode section_node = io::make_node(*(*it)->get_name(), io::OutputTreeNode::LIST);
 		if (compute_hashes)
 		{
 			const_shared_strings hashes = hash::hash_bytes(hash::ALL_DIGESTS, *(*it)->get_raw_data());
-			section_node->append(boost::make_shared<io::OutputTreeNode>("MD5", hashes->at(ALL_DIGESTS_MD5)));
-			section_node->append(boost::make_shared<io::OutputTreeNode>("SHA1", hashes->at(ALL_DIGESTS_SHA1)));
-			section_node->append(boost::make_shared<io::OutputTreeNode>("SHA256", hashes->at(ALL_DIGESTS_SHA256)));
-			section_node->append(boost::make_shared<io::OutputTreeNode>("SHA3", hashes->at(ALL_DIGESTS_SHA3)));
+			section_node->append(io::make_node("MD5", hashes->at(ALL_DIGESTS_MD5)));
+			section_node->append(io::make_node("SHA1", hashes->at(ALL_DIGESTS_SHA1)));
+			section_node->append(io::make_node("SHA256", hashes->at(ALL_DIGESTS_SHA256)));
+			section_node->append(io::make_node("SHA3", hashes->at(ALL_DIGESTS_SHA3)));
 		}
-		section_node->append(boost::make_shared<io::OutputTreeNode>("VirtualSize", (*it)->get_virtual_size(), io::OutputTreeNode::HEX));
-		section_node->append(boost::make_shared<io::OutputTreeNode>("VirtualAddress", (*it)->get_virtual_address(), io::OutputTreeNode::HEX));
-		section_node->append(boost::make_shared<io::OutputTreeNode>("SizeOfRawData", (*it)->get_size_of_raw_data(), io::OutputTreeNode::HEX));
-		section_node->append(boost::make_shared<io::OutputTreeNode>("PointerToRawData", (*it)->get_pointer_to_raw_data(), io::OutputTreeNode::HEX));
-		section_node->append(boost::make_shared<io::OutputTreeNode>("PointerToRelocations", (*it)->get_pointer_to_relocations(), io::OutputTreeNode::HEX));
-		section_node->append(boost::make_shared<io::OutputTreeNode>("PointerToLineNumbers", (*it)->get_pointer_to_line_numbers(), io::OutputTreeNode::HEX));
-		section_node->append(boost::make_shared<io::OutputTreeNode>("NumberOfLineNumbers", (*it)->get_number_of_line_numbers()));
-		section_node->append(boost::make_shared<io::OutputTreeNode>("NumberOfRelocations", (*it)->get_number_of_relocations()));
-		section_node->append(boost::make_shared<io::OutputTreeNode>("Characteristics", *nt::translate_to_flags((*it)->get_characteristics(), nt::SECTION_CHARACTERISTICS)));
-		section_node->append(boost::make_shared<io::OutputTreeNode>("Entropy", (*it)->get_entropy()));
+		section_node->append(io::make_node("VirtualSize", (*it)->get_virtual_size(), io::OutputTreeNode::HEX));
+		section_node->append(io::make_node("VirtualAddress", (*it)->get_virtual_address(), io::OutputTreeNode::HEX));
+		section_node->append(io::make_node("SizeOfRawData", (*it)->get_size_of_raw_data(), io::OutputTreeNode::HEX));
+		section_node->append(io::make_node("PointerToRawData", (*it)->get_pointer_to_raw_data(), io::OutputTreeNode::HEX));
+		section_node->append(io::make_node("PointerToRelocations", (*it)->get_pointer_to_relocations(), io::OutputTreeNode::HEX));
+		section_node->append(io::make_node("PointerToLineNumbers", (*it)->get_pointer_to_line_numbers(), io::OutputTreeNode::HEX));
+		section_node->append(io::make_node("NumberOfLineNumbers", (*it)->get_number_of_line_numbers()));
+		section_node->append(io::make_node("NumberOfRelocations", (*it)->get_number_of_relocations()));
+		section_node->append(io::make_node("Characteristics", *nt::translate_to_flags((*it)->get_characteristics(), nt::SECTION_CHARACTERISTICS)));
+		section_node->append(io::make_node("Entropy", (*it)->get_entropy()));
 
 		section_list->append(section_node);
 	}
@@ -187,7 +187,7 @@ void dump_imports(const mana::PE& pe, io::OutputFormatter& formatter)
 		return;
 	}
 
-	io::pNode imports(new io::OutputTreeNode("Imports", io::OutputTreeNode::LIST));
+	io::pNode imports = io::make_node("Imports", io::OutputTreeNode::LIST);
 	for (auto it = imported_dlls->begin() ; it != imported_dlls->end() ; ++it)
 	{
 		pString name = (*it)->get_name();
@@ -196,7 +196,7 @@ void dump_imports(const mana::PE& pe, io::OutputFormatter& formatter)
 		}
 		const_shared_strings functions = pe.get_imported_functions(*name);
 		std::string display_name = (*it)->get_type() == ImportedLibrary::DELAY_LOADED ? *name + " (delay-loaded)" : *name;
-		io::pNode dll(new io::OutputTreeNode(display_name, *functions));
+		io::pNode dll = io::make_node(display_name, *functions);
 		imports->append(dll);
 	}
 	formatter.add_data(imports, *pe.get_path());
@@ -211,15 +211,15 @@ void dump_exports(const mana::PE& pe, io::OutputFormatter& formatter)
 		return;
 	}
 
-	io::pNode exports_list(new io::OutputTreeNode("Exports", io::OutputTreeNode::LIST));
+	io::pNode exports_list = io::make_node("Exports", io::OutputTreeNode::LIST);
 	for (auto it = exports->begin() ; it != exports->end() ; ++it)
 	{
 		// TODO: Demangle C++ names here
-		io::pNode ex(new io::OutputTreeNode((*it)->Name, io::OutputTreeNode::LIST));
-		ex->append(boost::make_shared<io::OutputTreeNode>("Ordinal", (*it)->Ordinal));
-		ex->append(boost::make_shared<io::OutputTreeNode>("Address", (*it)->Address, io::OutputTreeNode::HEX));
+		io::pNode ex = io::make_node((*it)->Name, io::OutputTreeNode::LIST);
+		ex->append(io::make_node("Ordinal", (*it)->Ordinal));
+		ex->append(io::make_node("Address", (*it)->Address, io::OutputTreeNode::HEX));
 		if ((*it)->ForwardName != "") {
-			ex->append(boost::make_shared<io::OutputTreeNode>("ForwardName", (*it)->ForwardName));
+			ex->append(io::make_node("ForwardName", (*it)->ForwardName));
 		}
 		exports_list->append(ex);
 	}
@@ -236,31 +236,31 @@ void dump_resources(const mana::PE& pe, io::OutputFormatter& formatter, bool com
 		return;
 	}
 
-	io::pNode resource_list(new io::OutputTreeNode("Resources", io::OutputTreeNode::LIST));
+	io::pNode resource_list = io::make_node("Resources", io::OutputTreeNode::LIST);
 	for (auto it = resources->begin() ; it != resources->end() ; ++it)
 	{
-		io::pNode res(new io::OutputTreeNode(*(*it)->get_name(), io::OutputTreeNode::LIST));
-		res->append(boost::make_shared<io::OutputTreeNode>("Type", *(*it)->get_type()));
-		res->append(boost::make_shared<io::OutputTreeNode>("Language", *(*it)->get_language()));
-        res->append(boost::make_shared<io::OutputTreeNode>("Codepage", *nt::translate_to_flag((*it)->get_codepage(), nt::CODEPAGES)));
-		res->append(boost::make_shared<io::OutputTreeNode>("Size", (*it)->get_size(), io::OutputTreeNode::HEX));
-		res->append(boost::make_shared<io::OutputTreeNode>("Entropy", (*it)->get_entropy()));
+		io::pNode res = io::make_node(*(*it)->get_name(), io::OutputTreeNode::LIST);
+		res->append(io::make_node("Type", *(*it)->get_type()));
+		res->append(io::make_node("Language", *(*it)->get_language()));
+        res->append(io::make_node("Codepage", *nt::translate_to_flag((*it)->get_codepage(), nt::CODEPAGES)));
+		res->append(io::make_node("Size", (*it)->get_size(), io::OutputTreeNode::HEX));
+		res->append(io::make_node("Entropy", (*it)->get_entropy()));
 
 		yara::const_matches m = detect_filetype(*it);
 		if (m && m->size() > 0)
 		{
 			for (auto it2 = m->begin() ; it2 != m->end() ; ++it2) {
-				res->append(boost::make_shared<io::OutputTreeNode>("Detected Filetype", (*it2)->operator[]("description")));
+				res->append(io::make_node("Detected Filetype", (*it2)->operator[]("description")));
 			}
 		}
 
 		if (compute_hashes)
 		{
 			const_shared_strings hashes = hash::hash_bytes(hash::ALL_DIGESTS, *(*it)->get_raw_data());
-			res->append(boost::make_shared<io::OutputTreeNode>("MD5", hashes->at(ALL_DIGESTS_MD5)));
-			res->append(boost::make_shared<io::OutputTreeNode>("SHA1", hashes->at(ALL_DIGESTS_SHA1)));
-			res->append(boost::make_shared<io::OutputTreeNode>("SHA256", hashes->at(ALL_DIGESTS_SHA256)));
-			res->append(boost::make_shared<io::OutputTreeNode>("SHA3", hashes->at(ALL_DIGESTS_SHA3)));
+			res->append(io::make_node("MD5", hashes->at(ALL_DIGESTS_MD5)));
+			res->append(io::make_node("SHA1", hashes->at(ALL_DIGESTS_SHA1)));
+			res->append(io::make_node("SHA256", hashes->at(ALL_DIGESTS_SHA256)));
+			res->append(io::make_node("SHA3", hashes->at(ALL_DIGESTS_SHA3)));
 		}
 
 		resource_list->append(res);
@@ -291,28 +291,28 @@ void dump_version_info(const mana::PE& pe, io::OutputFormatter& formatter)
 				version_info_node = existing_node;
 			}
 			else {
-				version_info_node = boost::make_shared<io::OutputTreeNode>("Version Info", io::OutputTreeNode::LIST);
+				version_info_node = io::make_node("Version Info", io::OutputTreeNode::LIST);
 			}
 
-			version_info_node->append(boost::make_shared<io::OutputTreeNode>("Resource LangID", *(*it)->get_language()));
-			io::pNode key_values = boost::make_shared<io::OutputTreeNode>(vi->Header.Key, io::OutputTreeNode::LIST);
-			key_values->append(boost::make_shared<io::OutputTreeNode>("Signature", vi->Value->Signature, io::OutputTreeNode::HEX));
-			key_values->append(boost::make_shared<io::OutputTreeNode>("StructVersion", vi->Value->StructVersion, io::OutputTreeNode::HEX));
-			key_values->append(boost::make_shared<io::OutputTreeNode>("FileVersion", io::uint64_to_version_number(vi->Value->FileVersionMS, vi->Value->FileVersionLS)));
-			key_values->append(boost::make_shared<io::OutputTreeNode>("ProductVersion", io::uint64_to_version_number(vi->Value->ProductVersionMS, vi->Value->ProductVersionLS)));
-			key_values->append(boost::make_shared<io::OutputTreeNode>("FileFlags", *nt::translate_to_flags(vi->Value->FileFlags & vi->Value->FileFlagsMask, nt::FIXEDFILEINFO_FILEFLAGS)));
-			key_values->append(boost::make_shared<io::OutputTreeNode>("FileOs", *nt::translate_to_flags(vi->Value->FileOs, nt::FIXEDFILEINFO_FILEOS)));
-			key_values->append(boost::make_shared<io::OutputTreeNode>("FileType", *nt::translate_to_flag(vi->Value->FileType, nt::FIXEDFILEINFO_FILETYPE)));
+			version_info_node->append(io::make_node("Resource LangID", *(*it)->get_language()));
+			io::pNode key_values = io::make_node(vi->Header.Key, io::OutputTreeNode::LIST);
+			key_values->append(io::make_node("Signature", vi->Value->Signature, io::OutputTreeNode::HEX));
+			key_values->append(io::make_node("StructVersion", vi->Value->StructVersion, io::OutputTreeNode::HEX));
+			key_values->append(io::make_node("FileVersion", io::uint64_to_version_number(vi->Value->FileVersionMS, vi->Value->FileVersionLS)));
+			key_values->append(io::make_node("ProductVersion", io::uint64_to_version_number(vi->Value->ProductVersionMS, vi->Value->ProductVersionLS)));
+			key_values->append(io::make_node("FileFlags", *nt::translate_to_flags(vi->Value->FileFlags & vi->Value->FileFlagsMask, nt::FIXEDFILEINFO_FILEFLAGS)));
+			key_values->append(io::make_node("FileOs", *nt::translate_to_flags(vi->Value->FileOs, nt::FIXEDFILEINFO_FILEOS)));
+			key_values->append(io::make_node("FileType", *nt::translate_to_flag(vi->Value->FileType, nt::FIXEDFILEINFO_FILETYPE)));
 			if (vi->Value->FileType == nt::FIXEDFILEINFO_FILETYPE.at("VFT_DRV")) {
-				key_values->append(boost::make_shared<io::OutputTreeNode>("FileSubtype", *nt::translate_to_flag(vi->Value->FileSubtype, nt::FIXEDFILEINFO_FILESUBTYPE_DRV)));
+				key_values->append(io::make_node("FileSubtype", *nt::translate_to_flag(vi->Value->FileSubtype, nt::FIXEDFILEINFO_FILESUBTYPE_DRV)));
 			}
 			else if (vi->Value->FileType == nt::FIXEDFILEINFO_FILETYPE.at("VFT_FONT")) {
-				key_values->append(boost::make_shared<io::OutputTreeNode>("FileSubtype", *nt::translate_to_flag(vi->Value->FileSubtype, nt::FIXEDFILEINFO_FILESUBTYPE_FONT)));
+				key_values->append(io::make_node("FileSubtype", *nt::translate_to_flag(vi->Value->FileSubtype, nt::FIXEDFILEINFO_FILESUBTYPE_FONT)));
 			}
 
-			key_values->append(boost::make_shared<io::OutputTreeNode>("Language", vi->Language));
+			key_values->append(io::make_node("Language", vi->Language));
 			for (auto it2 = vi->StringTable.begin() ; it2 != vi->StringTable.end() ; ++it2) {
-				key_values->append(boost::make_shared<io::OutputTreeNode>((*it2)->first, (*it2)->second));
+				key_values->append(io::make_node((*it2)->first, (*it2)->second));
 			}
 
 			version_info_node->append(key_values);
@@ -329,20 +329,20 @@ void dump_debug_info(const mana::PE& pe, io::OutputFormatter& formatter)
 	if (di->size() == 0) {
 		return;
 	}
-	io::pNode debug_info_list(new io::OutputTreeNode("Debug Info", io::OutputTreeNode::LIST));
+	io::pNode debug_info_list = io::make_node("Debug Info", io::OutputTreeNode::LIST);
 	for (auto it = di->begin() ; it != di->end() ; ++it)
 	{
-		io::pNode debug_info_node(new io::OutputTreeNode(*nt::translate_to_flag((*it)->Type, nt::DEBUG_TYPES), io::OutputTreeNode::LIST));
-		debug_info_node->append(boost::make_shared<io::OutputTreeNode>("Characteristics", (*it)->Characteristics));
-		debug_info_node->append(boost::make_shared<io::OutputTreeNode>("TimeDateStamp", io::timestamp_to_string((*it)->TimeDateStamp)));
+		io::pNode debug_info_node = io::make_node(*nt::translate_to_flag((*it)->Type, nt::DEBUG_TYPES), io::OutputTreeNode::LIST);
+		debug_info_node->append(io::make_node("Characteristics", (*it)->Characteristics));
+		debug_info_node->append(io::make_node("TimeDateStamp", io::timestamp_to_string((*it)->TimeDateStamp)));
 		std::stringstream ss;
 		ss << (*it)->MajorVersion << "." << (*it)->MinorVersion;
-		debug_info_node->append(boost::make_shared<io::OutputTreeNode>("Version", ss.str()));
-		debug_info_node->append(boost::make_shared<io::OutputTreeNode>("SizeofData", (*it)->SizeofData));
-		debug_info_node->append(boost::make_shared<io::OutputTreeNode>("AddressOfRawData", (*it)->AddressOfRawData, io::OutputTreeNode::HEX));
-		debug_info_node->append(boost::make_shared<io::OutputTreeNode>("PointerToRawData", (*it)->PointerToRawData, io::OutputTreeNode::HEX));
+		debug_info_node->append(io::make_node("Version", ss.str()));
+		debug_info_node->append(io::make_node("SizeofData", (*it)->SizeofData));
+		debug_info_node->append(io::make_node("AddressOfRawData", (*it)->AddressOfRawData, io::OutputTreeNode::HEX));
+		debug_info_node->append(io::make_node("PointerToRawData", (*it)->PointerToRawData, io::OutputTreeNode::HEX));
 		if ((*it)->Filename != "") {
-			debug_info_node->append(boost::make_shared<io::OutputTreeNode>("Referenced File", (*it)->Filename));
+			debug_info_node->append(io::make_node("Referenced File", (*it)->Filename));
 		}
 		debug_info_list->append(debug_info_node);
 	}
@@ -359,14 +359,14 @@ void dump_tls(const mana::PE& pe, io::OutputFormatter& formatter)
 		return;
 	}
 
-	io::pNode tls_node(new io::OutputTreeNode("TLS Callbacks", io::OutputTreeNode::LIST));
-	tls_node->append(boost::make_shared<io::OutputTreeNode>("StartAddressOfRawData", tls->StartAddressOfRawData, io::OutputTreeNode::HEX));
-	tls_node->append(boost::make_shared<io::OutputTreeNode>("EndAddressOfRawData", tls->EndAddressOfRawData, io::OutputTreeNode::HEX));
-	tls_node->append(boost::make_shared<io::OutputTreeNode>("AddressOfIndex", tls->AddressOfIndex, io::OutputTreeNode::HEX));
-	tls_node->append(boost::make_shared<io::OutputTreeNode>("AddressOfCallbacks", tls->AddressOfCallbacks, io::OutputTreeNode::HEX));
-	tls_node->append(boost::make_shared<io::OutputTreeNode>("SizeOfZeroFill", tls->SizeOfZeroFill, io::OutputTreeNode::HEX));
+	io::pNode tls_node = io::make_node("TLS Callbacks", io::OutputTreeNode::LIST);
+	tls_node->append(io::make_node("StartAddressOfRawData", tls->StartAddressOfRawData, io::OutputTreeNode::HEX));
+	tls_node->append(io::make_node("EndAddressOfRawData", tls->EndAddressOfRawData, io::OutputTreeNode::HEX));
+	tls_node->append(io::make_node("AddressOfIndex", tls->AddressOfIndex, io::OutputTreeNode::HEX));
+	tls_node->append(io::make_node("AddressOfCallbacks", tls->AddressOfCallbacks, io::OutputTreeNode::HEX));
+	tls_node->append(io::make_node("SizeOfZeroFill", tls->SizeOfZeroFill, io::OutputTreeNode::HEX));
 	// According to the 9.3 revision of the PE specification, Characteristics is no longer reserved but one of IMAGE_SCN_ALIGN_*.
-	tls_node->append(boost::make_shared<io::OutputTreeNode>("Characteristics", *nt::translate_to_flag(tls->Characteristics, nt::SECTION_CHARACTERISTICS)));
+	tls_node->append(io::make_node("Characteristics", *nt::translate_to_flag(tls->Characteristics, nt::SECTION_CHARACTERISTICS)));
 
 	std::vector<std::string> callbacks;
 	for (auto it = tls->Callbacks.begin() ; it != tls->Callbacks.end() ; ++it)
@@ -375,7 +375,7 @@ void dump_tls(const mana::PE& pe, io::OutputFormatter& formatter)
 		ss << std::hex << "0x" << *it;
 		callbacks.push_back(ss.str());
 	}
-	tls_node->append(boost::make_shared<io::OutputTreeNode>("Callbacks", callbacks));
+	tls_node->append(io::make_node("Callbacks", callbacks));
 	formatter.add_data(tls_node, *pe.get_path());
 }
 
@@ -388,28 +388,28 @@ void dump_config(const mana::PE& pe, io::OutputFormatter& formatter)
 		return;
 	}
 
-	io::pNode config_node(new io::OutputTreeNode("Load Configuration", io::OutputTreeNode::LIST));
-	config_node->append(boost::make_shared<io::OutputTreeNode>("Size", config->Size, io::OutputTreeNode::HEX));
-	config_node->append(boost::make_shared<io::OutputTreeNode>("TimeDateStamp", io::timestamp_to_string(config->TimeDateStamp)));
+	io::pNode config_node = io::make_node("Load Configuration", io::OutputTreeNode::LIST);
+	config_node->append(io::make_node("Size", config->Size, io::OutputTreeNode::HEX));
+	config_node->append(io::make_node("TimeDateStamp", io::timestamp_to_string(config->TimeDateStamp)));
 	std::stringstream ss;
 	ss << config->MajorVersion << "." << config->MinorVersion;
-	config_node->append(boost::make_shared<io::OutputTreeNode>("Version", ss.str()));
-	config_node->append(boost::make_shared<io::OutputTreeNode>("GlobalFlagsClear", *nt::translate_to_flags(config->GlobalFlagsClear, nt::GLOBAL_FLAGS)));
-	config_node->append(boost::make_shared<io::OutputTreeNode>("GlobalFlagsSet", *nt::translate_to_flags(config->GlobalFlagsSet, nt::GLOBAL_FLAGS)));
-	config_node->append(boost::make_shared<io::OutputTreeNode>("CriticalSectionDefaultTimeout", config->CriticalSectionDefaultTimeout));
-	config_node->append(boost::make_shared<io::OutputTreeNode>("DeCommitFreeBlockThreshold", config->DeCommitFreeBlockThreshold, io::OutputTreeNode::HEX));
-	config_node->append(boost::make_shared<io::OutputTreeNode>("DeCommitTotalFreeThreshold", config->DeCommitTotalFreeThreshold, io::OutputTreeNode::HEX));
-	config_node->append(boost::make_shared<io::OutputTreeNode>("LockPrefixTable", config->LockPrefixTable, io::OutputTreeNode::HEX));
-	config_node->append(boost::make_shared<io::OutputTreeNode>("MaximumAllocationSize", config->MaximumAllocationSize, io::OutputTreeNode::HEX));
-	config_node->append(boost::make_shared<io::OutputTreeNode>("VirtualMemoryThreshold", config->VirtualMemoryThreshold, io::OutputTreeNode::HEX));
-	config_node->append(boost::make_shared<io::OutputTreeNode>("ProcessAffinityMask", config->ProcessAffinityMask, io::OutputTreeNode::HEX));
-	config_node->append(boost::make_shared<io::OutputTreeNode>("ProcessHeapFlags", *nt::translate_to_flags(config->GlobalFlagsClear, nt::HEAP_FLAGS)));
-	config_node->append(boost::make_shared<io::OutputTreeNode>("CSDVersion", config->CSDVersion));
-	config_node->append(boost::make_shared<io::OutputTreeNode>("Reserved1", config->Reserved1, io::OutputTreeNode::HEX));
-	config_node->append(boost::make_shared<io::OutputTreeNode>("EditList", config->EditList, io::OutputTreeNode::HEX));
-	config_node->append(boost::make_shared<io::OutputTreeNode>("SecurityCookie", config->SecurityCookie, io::OutputTreeNode::HEX));
-	config_node->append(boost::make_shared<io::OutputTreeNode>("SEHandlerTable", config->SEHandlerTable, io::OutputTreeNode::HEX));
-	config_node->append(boost::make_shared<io::OutputTreeNode>("SEHandlerCount", config->SEHandlerCount));
+	config_node->append(io::make_node("Version", ss.str()));
+	config_node->append(io::make_node("GlobalFlagsClear", *nt::translate_to_flags(config->GlobalFlagsClear, nt::GLOBAL_FLAGS)));
+	config_node->append(io::make_node("GlobalFlagsSet", *nt::translate_to_flags(config->GlobalFlagsSet, nt::GLOBAL_FLAGS)));
+	config_node->append(io::make_node("CriticalSectionDefaultTimeout", config->CriticalSectionDefaultTimeout));
+	config_node->append(io::make_node("DeCommitFreeBlockThreshold", config->DeCommitFreeBlockThreshold, io::OutputTreeNode::HEX));
+	config_node->append(io::make_node("DeCommitTotalFreeThreshold", config->DeCommitTotalFreeThreshold, io::OutputTreeNode::HEX));
+	config_node->append(io::make_node("LockPrefixTable", config->LockPrefixTable, io::OutputTreeNode::HEX));
+	config_node->append(io::make_node("MaximumAllocationSize", config->MaximumAllocationSize, io::OutputTreeNode::HEX));
+	config_node->append(io::make_node("VirtualMemoryThreshold", config->VirtualMemoryThreshold, io::OutputTreeNode::HEX));
+	config_node->append(io::make_node("ProcessAffinityMask", config->ProcessAffinityMask, io::OutputTreeNode::HEX));
+	config_node->append(io::make_node("ProcessHeapFlags", *nt::translate_to_flags(config->GlobalFlagsClear, nt::HEAP_FLAGS)));
+	config_node->append(io::make_node("CSDVersion", config->CSDVersion));
+	config_node->append(io::make_node("Reserved1", config->Reserved1, io::OutputTreeNode::HEX));
+	config_node->append(io::make_node("EditList", config->EditList, io::OutputTreeNode::HEX));
+	config_node->append(io::make_node("SecurityCookie", config->SecurityCookie, io::OutputTreeNode::HEX));
+	config_node->append(io::make_node("SEHandlerTable", config->SEHandlerTable, io::OutputTreeNode::HEX));
+	config_node->append(io::make_node("SEHandlerCount", config->SEHandlerCount));
 	formatter.add_data(config_node, *pe.get_path());
 }
 
@@ -422,15 +422,15 @@ void dump_dldt(const mana::PE& pe, io::OutputFormatter& formatter)
 		return; // No delayed imports.
 	}
 
-	io::pNode dldt_node(new io::OutputTreeNode("Delayed Imports", io::OutputTreeNode::LIST));
-	dldt_node->append(boost::make_shared<io::OutputTreeNode>("Attributes", dldt->Attributes, io::OutputTreeNode::HEX));
-	dldt_node->append(boost::make_shared<io::OutputTreeNode>("Name", dldt->NameStr));
-	dldt_node->append(boost::make_shared<io::OutputTreeNode>("ModuleHandle", dldt->ModuleHandle, io::OutputTreeNode::HEX));
-	dldt_node->append(boost::make_shared<io::OutputTreeNode>("DelayImportAddressTable", dldt->DelayImportAddressTable, io::OutputTreeNode::HEX));
-	dldt_node->append(boost::make_shared<io::OutputTreeNode>("DelayImportNameTable", dldt->DelayImportNameTable, io::OutputTreeNode::HEX));
-	dldt_node->append(boost::make_shared<io::OutputTreeNode>("BoundDelayImportTable", dldt->BoundDelayImportTable, io::OutputTreeNode::HEX));
-	dldt_node->append(boost::make_shared<io::OutputTreeNode>("UnloadDelayImportTable", dldt->UnloadDelayImportTable, io::OutputTreeNode::HEX));
-	dldt_node->append(boost::make_shared<io::OutputTreeNode>("TimeStamp", io::timestamp_to_string(dldt->TimeStamp), io::OutputTreeNode::HEX));
+	io::pNode dldt_node = io::make_node("Delayed Imports", io::OutputTreeNode::LIST);
+	dldt_node->append(io::make_node("Attributes", dldt->Attributes, io::OutputTreeNode::HEX));
+	dldt_node->append(io::make_node("Name", dldt->NameStr));
+	dldt_node->append(io::make_node("ModuleHandle", dldt->ModuleHandle, io::OutputTreeNode::HEX));
+	dldt_node->append(io::make_node("DelayImportAddressTable", dldt->DelayImportAddressTable, io::OutputTreeNode::HEX));
+	dldt_node->append(io::make_node("DelayImportNameTable", dldt->DelayImportNameTable, io::OutputTreeNode::HEX));
+	dldt_node->append(io::make_node("BoundDelayImportTable", dldt->BoundDelayImportTable, io::OutputTreeNode::HEX));
+	dldt_node->append(io::make_node("UnloadDelayImportTable", dldt->UnloadDelayImportTable, io::OutputTreeNode::HEX));
+	dldt_node->append(io::make_node("TimeStamp", io::timestamp_to_string(dldt->TimeStamp), io::OutputTreeNode::HEX));
 
 	formatter.add_data(dldt_node, *pe.get_path());
 }
@@ -443,7 +443,7 @@ void dump_summary(const mana::PE& pe, io::OutputFormatter& formatter)
 		return;
 	}
 
-	io::pNode summary(new io::OutputTreeNode("Summary", io::OutputTreeNode::LIST));
+	io::pNode summary = io::make_node("Summary", io::OutputTreeNode::LIST);
 
 	// Grab all detected languages
 	std::set<std::string> languages;
@@ -483,24 +483,24 @@ void dump_summary(const mana::PE& pe, io::OutputFormatter& formatter)
 		debug_files.insert("Embedded COFF debugging symbols");
 	}
 
-	summary->append(boost::make_shared<io::OutputTreeNode>("Architecture", *nt::translate_to_flag(h.Machine, nt::MACHINE_TYPES)));
+	summary->append(io::make_node("Architecture", *nt::translate_to_flag(h.Machine, nt::MACHINE_TYPES)));
 	mana::image_optional_header ioh = *pe.get_image_optional_header();
-	summary->append(boost::make_shared<io::OutputTreeNode>("Subsystem", *nt::translate_to_flag(ioh.Subsystem, nt::SUBSYSTEMS)));
-	summary->append(boost::make_shared<io::OutputTreeNode>("Compilation Date", io::timestamp_to_string(h.TimeDateStamp)));
+	summary->append(io::make_node("Subsystem", *nt::translate_to_flag(ioh.Subsystem, nt::SUBSYSTEMS)));
+	summary->append(io::make_node("Compilation Date", io::timestamp_to_string(h.TimeDateStamp)));
 
 	if (languages.size() > 0) {
-		summary->append(boost::make_shared<io::OutputTreeNode>("Detected languages", languages));
+		summary->append(io::make_node("Detected languages", languages));
 	}
 
 	if (pe.get_tls() && pe.get_tls()->Callbacks.size() > 0)
 	{
 		std::stringstream ss;
 		ss << pe.get_tls()->Callbacks.size() << " callback(s) detected.";
-		summary->append(boost::make_shared<io::OutputTreeNode>("TLS Callbacks", ss.str()));
+		summary->append(io::make_node("TLS Callbacks", ss.str()));
 	}
 
 	if (debug_files.size() > 0)	{
-		summary->append(boost::make_shared<io::OutputTreeNode>("Debug artifacts", debug_files));
+		summary->append(io::make_node("Debug artifacts", debug_files));
 	}
 
 	if (vi != nullptr)
@@ -508,7 +508,7 @@ void dump_summary(const mana::PE& pe, io::OutputFormatter& formatter)
 		for (auto it = vi->StringTable.begin() ; it != vi->StringTable.end() ; ++it)
         {
             if ((*it)->first != "" || (*it)->second != "") {
-                summary->append(boost::make_shared<io::OutputTreeNode>((*it)->first, (*it)->second));
+                summary->append(io::make_node((*it)->first, (*it)->second));
             }
 		}
 	}
@@ -518,17 +518,30 @@ void dump_summary(const mana::PE& pe, io::OutputFormatter& formatter)
 
 // ----------------------------------------------------------------------------
 
-void dump_hashes(const mana::PE& pe, io::OutputFormatter& formatter)
+void dump_hashes(plugin::AnalysisContext& context, io::OutputFormatter& formatter, const std::set<std::string>& digests)
 {
-	const_shared_strings hashes = hash::hash_file(hash::ALL_DIGESTS, *pe.get_path());
-	io::pNode hashes_node(new io::OutputTreeNode("Hashes", io::OutputTreeNode::LIST));
-	hashes_node->append(boost::make_shared<io::OutputTreeNode>("MD5", hashes->at(ALL_DIGESTS_MD5)));
-	hashes_node->append(boost::make_shared<io::OutputTreeNode>("SHA1", hashes->at(ALL_DIGESTS_SHA1)));
-	hashes_node->append(boost::make_shared<io::OutputTreeNode>("SHA256", hashes->at(ALL_DIGESTS_SHA256)));
-	hashes_node->append(boost::make_shared<io::OutputTreeNode>("SHA3", hashes->at(ALL_DIGESTS_SHA3)));
-	hashes_node->append(boost::make_shared<io::OutputTreeNode>("SSDeep", *ssdeep::hash_file(*pe.get_path())));
-	hashes_node->append(boost::make_shared<io::OutputTreeNode>("Imports Hash", hash::hash_imports(pe)));
-	formatter.add_data(hashes_node, *pe.get_path());
+	static const std::vector<std::string> DIGESTS = boost::assign::list_of
+		("MD5")("SHA1")("SHA256")("SHA3")("SSDeep")("Imports Hash");
+
+	std::vector<std::string> names;
+	for (auto it = DIGESTS.begin() ; it != DIGESTS.end() ; ++it)
+	{
+		if (digests.empty() || digests.count(*it)) {
+			names.push_back(*it);
+		}
+	}
+	// Compute all the file digests at once, so that the file is only read one time.
+	context.compute_digests(names);
+
+	io::pNode hashes_node = io::make_node("Hashes", io::OutputTreeNode::LIST);
+	for (auto it = names.begin() ; it != names.end() ; ++it)
+	{
+		pString digest = context.get_digest(*it);
+		if (digest != nullptr) {
+			hashes_node->append(io::make_node(*it, *digest));
+		}
+	}
+	formatter.add_data(hashes_node, *context.get_pe().get_path());
 }
 
 // ----------------------------------------------------------------------------
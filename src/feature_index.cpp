@@ -0,0 +1,439 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "feature_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <queue>
+#include <set>
+
+#include <boost/filesystem.hpp>
+
+#include "hash-library/md5.h"
+#include "hash-library/sha256.h"
+#include "manacommons/color.h"
+#include "manacommons/hex.h"
+#include "import_hash.h"
+
+namespace bfs = boost::filesystem;
+
+namespace mana
+{
+
+namespace {
+
+const char		SEGMENT_MAGIC[8]	= { 'M', 'A', 'N', 'A', 'F', 'I', 'X', '1' };
+const char*		SEGMENT_EXTENSION	= ".seg";
+const size_t	FLUSH_THRESHOLD		= 1 << 16;	// Buffered records before a segment is written.
+const size_t	MERGE_FACTOR		= 4;		// Segments of the same tier merged together.
+const size_t	RECORD_SIZE			= 48;		// The MD5 of a feature and the SHA256 of a sample.
+
+void hash_feature(const std::string& feature, boost::uint8_t out[16])
+{
+	MD5 md5; // A local instance, since add() may be called from several threads.
+	md5.add(feature.c_str(), feature.size());
+	io::from_hex(md5.getHash(), out, 16);
+}
+
+// ----------------------------------------------------------------------------
+
+std::string sha256_hex(const std::vector<boost::uint8_t>& bytes)
+{
+	SHA256 digest;
+	digest.add(&bytes[0], bytes.size());
+	return digest.getHash();
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Returns the size tier of a segment: segments whose number of records is within
+ *			the same power of MERGE_FACTOR are in the same tier.
+ */
+unsigned int get_tier(size_t segment_size)
+{
+	unsigned int tier = 0;
+	for (size_t records = (segment_size - sizeof(SEGMENT_MAGIC)) / RECORD_SIZE ; records >= MERGE_FACTOR ; records /= MERGE_FACTOR) {
+		++tier;
+	}
+	return tier;
+}
+
+} // !namespace
+
+// ----------------------------------------------------------------------------
+
+std::vector<std::string> extract_features(const mana::PE& pe)
+{
+	std::set<std::string> features;
+
+	auto dlls = pe.get_imported_dlls();
+	if (dlls != nullptr && !dlls->empty())
+	{
+		std::string imphash = hash::hash_imports(pe);
+		if (!imphash.empty()) {
+			features.insert("imphash:" + imphash);
+		}
+	}
+
+	auto sections = pe.get_sections();
+	for (auto it = sections->begin() ; it != sections->end() ; ++it)
+	{
+		if ((*it)->get_size_of_raw_data() == 0) {
+			continue;
+		}
+		shared_bytes data = (*it)->get_raw_data();
+		if (data != nullptr && !data->empty()) {
+			features.insert("section:" + sha256_hex(*data));
+		}
+	}
+
+	auto resources = pe.get_resources();
+	for (auto it = resources->begin() ; it != resources->end() ; ++it)
+	{
+		shared_bytes data = (*it)->get_raw_data();
+		if (data != nullptr && !data->empty()) {
+			features.insert("resource:" + sha256_hex(*data));
+		}
+	}
+
+	auto debug = pe.get_debug_info();
+	for (auto it = debug->begin() ; it != debug->end() ; ++it)
+	{
+		if (!(*it)->Filename.empty()) {
+			features.insert("pdb:" + (*it)->Filename);
+		}
+		if (!(*it)->PdbGuid.empty()) {
+			features.insert("pdb_guid:" + (*it)->PdbGuid);
+		}
+	}
+
+	return std::vector<std::string>(features.begin(), features.end());
+}
+
+// ----------------------------------------------------------------------------
+
+FeatureIndex::FeatureIndex(const std::string& directory)
+	: _directory(directory), _open(false), _mapped(false)
+{
+	static_assert(sizeof(record) == RECORD_SIZE, "Segment records must not be padded.");
+
+	boost::system::error_code ec;
+	bfs::create_directories(_directory, ec);
+	if (!bfs::is_directory(_directory, ec))
+	{
+		PRINT_ERROR << "Could not open the feature index " << _directory << "." << std::endl;
+		return;
+	}
+	_open = true;
+}
+
+// ----------------------------------------------------------------------------
+
+FeatureIndex::~FeatureIndex() {
+	flush();
+}
+
+// ----------------------------------------------------------------------------
+
+bool FeatureIndex::add(const std::string& sha256, const std::vector<std::string>& features)
+{
+	record r;
+	if (!io::from_hex(sha256, r.sample, sizeof(r.sample)))
+	{
+		PRINT_WARNING << "Invalid SHA256 for the feature index: " << sha256 << "." << std::endl;
+		return false;
+	}
+
+	boost::lock_guard<boost::mutex> lock(_mutex);
+	for (auto it = features.begin() ; it != features.end() ; ++it)
+	{
+		hash_feature(*it, r.feature);
+		_pending.push_back(r);
+	}
+	return _pending.size() < FLUSH_THRESHOLD || _flush();
+}
+
+// ----------------------------------------------------------------------------
+
+bool FeatureIndex::flush()
+{
+	boost::lock_guard<boost::mutex> lock(_mutex);
+	return _flush();
+}
+
+// ----------------------------------------------------------------------------
+
+bool FeatureIndex::_flush()
+{
+	if (!_open || _pending.empty()) {
+		return true;
+	}
+
+	std::sort(_pending.begin(), _pending.end(), [](const record& a, const record& b) {
+		return memcmp(&a, &b, sizeof(record)) < 0;
+	});
+	_pending.erase(std::unique(_pending.begin(), _pending.end(), [](const record& a, const record& b) {
+		return memcmp(&a, &b, sizeof(record)) == 0;
+	}), _pending.end());
+
+	auto it = _pending.begin();
+	bool res = _write_segment([&it, this](record& r) -> bool {
+		if (it == _pending.end()) {
+			return false;
+		}
+		r = *it++;
+		return true;
+	});
+	_pending.clear();
+	if (!res) {
+		return false;
+	}
+
+	// Keep the number of segments low, as each of them has to be searched.
+	return _merge_tiers();
+}
+
+// ----------------------------------------------------------------------------
+
+bool FeatureIndex::_merge_tiers()
+{
+	while (true) // A merged segment may complete the next tier.
+	{
+		std::vector<std::string> paths;
+		std::vector<pSegment> segments;
+		if (!_map_segments(paths, segments)) {
+			return false;
+		}
+
+		std::map<unsigned int, std::vector<size_t> > tiers;
+		for (size_t i = 0 ; i < segments.size() ; ++i) {
+			tiers[get_tier(segments[i]->size())].push_back(i);
+		}
+		auto full = std::find_if(tiers.begin(), tiers.end(), [](const std::pair<const unsigned int, std::vector<size_t> >& t) {
+			return t.second.size() >= MERGE_FACTOR;
+		});
+		if (full == tiers.end()) {
+			return true;
+		}
+
+		std::vector<std::string> merged_paths;
+		std::vector<pSegment> merged;
+		for (auto it = full->second.begin() ; it != full->second.end() ; ++it)
+		{
+			merged_paths.push_back(paths[*it]);
+			merged.push_back(segments[*it]);
+		}
+		segments.clear();
+		if (!_merge(merged_paths, merged)) {
+			return false;
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+template<class Source>
+bool FeatureIndex::_write_segment(Source next_record)
+{
+	// The segment is written under a temporary name so that readers never see it incomplete.
+	bfs::path target = bfs::path(_directory) / bfs::unique_path("%%%%%%%%-%%%%%%%%-%%%%%%%%");
+	bfs::path temporary = target;
+	temporary.replace_extension(".tmp");
+	target.replace_extension(SEGMENT_EXTENSION);
+
+	std::ofstream f(temporary.string().c_str(), std::ios::binary);
+	if (!f.is_open())
+	{
+		PRINT_ERROR << "Could not create " << temporary.string() << "." << std::endl;
+		return false;
+	}
+	f.write(SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+	record r;
+	while (next_record(r)) {
+		f.write(reinterpret_cast<const char*>(&r), sizeof(record));
+	}
+	f.close();
+
+	boost::system::error_code ec;
+	if (f.fail() || (bfs::rename(temporary, target, ec), ec))
+	{
+		PRINT_ERROR << "Could not write the feature index segment " << target.string() << "." << std::endl;
+		bfs::remove(temporary, ec);
+		return false;
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool FeatureIndex::_map_segments(std::vector<std::string>& paths, std::vector<pSegment>& segments) const
+{
+	paths.clear();
+	segments.clear();
+	for (bfs::directory_iterator it(_directory), end ; it != end ; ++it)
+	{
+		if (it->path().extension() != SEGMENT_EXTENSION) {
+			continue;
+		}
+		pSegment s = boost::make_shared<boost::iostreams::mapped_file_source>();
+		try {
+			s->open(it->path().string());
+		}
+		catch (std::exception&) // The segment was removed by a concurrent compaction.
+		{
+			if (bfs::exists(it->path())) {
+				PRINT_WARNING << "Could not map " << it->path().string() << "." << std::endl;
+			}
+			return false;
+		}
+		if (s->size() < sizeof(SEGMENT_MAGIC) ||
+			(s->size() - sizeof(SEGMENT_MAGIC)) % sizeof(record) != 0 ||
+			memcmp(s->data(), SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) != 0)
+		{
+			PRINT_WARNING << it->path().string() << " is not a valid feature index segment." << std::endl;
+			continue;
+		}
+		paths.push_back(it->path().string());
+		segments.push_back(s);
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool FeatureIndex::compact()
+{
+	if (!_open) {
+		return false;
+	}
+
+	std::vector<std::string> paths;
+	std::vector<pSegment> segments;
+	if (!_map_segments(paths, segments)) {
+		return false;
+	}
+	return _merge(paths, segments);
+}
+
+// ----------------------------------------------------------------------------
+
+bool FeatureIndex::_merge(const std::vector<std::string>& paths, std::vector<pSegment>& segments)
+{
+	if (segments.size() < 2) {
+		return true;
+	}
+
+	// Merge the sorted segments.
+	typedef std::pair<const record*, const record*> cursor; // Current record and end of a segment.
+	auto greater = [](const cursor& a, const cursor& b) {
+		return memcmp(a.first, b.first, sizeof(record)) > 0;
+	};
+	std::priority_queue<cursor, std::vector<cursor>, decltype(greater)> queue(greater);
+	for (auto it = segments.begin() ; it != segments.end() ; ++it)
+	{
+		const record* begin = reinterpret_cast<const record*>((*it)->data() + sizeof(SEGMENT_MAGIC));
+		const record* end = begin + ((*it)->size() - sizeof(SEGMENT_MAGIC)) / sizeof(record);
+		if (begin != end) {
+			queue.push(cursor(begin, end));
+		}
+	}
+
+	const record* last = nullptr;
+	bool res = _write_segment([&queue, &last](record& r) -> bool {
+		while (!queue.empty())
+		{
+			cursor c = queue.top();
+			queue.pop();
+			const record* current = c.first++;
+			if (c.first != c.second) {
+				queue.push(c);
+			}
+			if (last == nullptr || memcmp(last, current, sizeof(record)) != 0)
+			{
+				last = current;
+				r = *current;
+				return true;
+			}
+		}
+		return false;
+	});
+	segments.clear(); // Unmap the segments before deleting them.
+	if (!res) {
+		return false;
+	}
+
+	// Another process may be merging the same segments: the records may end up in both merged
+	// segments, which is harmless.
+	bool removed = true;
+	for (auto it = paths.begin() ; it != paths.end() ; ++it)
+	{
+		boost::system::error_code ec;
+		bfs::remove(*it, ec); // A segment which is already gone is not an error.
+		if (ec)
+		{
+			PRINT_WARNING << "Could not remove the merged segment " << *it << "." << std::endl;
+			removed = false;
+		}
+	}
+	return removed;
+}
+
+// ----------------------------------------------------------------------------
+
+std::vector<std::string> FeatureIndex::lookup(const std::string& feature)
+{
+	std::vector<std::string> res;
+	if (!_open) {
+		return res;
+	}
+	if (!_mapped)
+	{
+		std::vector<std::string> paths;
+		// Retry if a segment disappears while the index is compacted.
+		for (int attempts = 0 ; attempts < 3 && !_mapped ; ++attempts) {
+			_mapped = _map_segments(paths, _segments);
+		}
+		if (!_mapped) {
+			return res;
+		}
+	}
+
+	record key;
+	hash_feature(feature, key.feature);
+	auto compare = [](const record& a, const record& b) {
+		return memcmp(a.feature, b.feature, sizeof(a.feature)) < 0;
+	};
+
+	for (auto it = _segments.begin() ; it != _segments.end() ; ++it)
+	{
+		const record* begin = reinterpret_cast<const record*>((*it)->data() + sizeof(SEGMENT_MAGIC));
+		const record* end = begin + ((*it)->size() - sizeof(SEGMENT_MAGIC)) / sizeof(record);
+		auto range = std::equal_range(begin, end, key, compare);
+		for (const record* r = range.first ; r != range.second ; ++r) {
+			res.push_back(io::to_hex(r->sample, sizeof(r->sample)));
+		}
+	}
+
+	std::sort(res.begin(), res.end());
+	res.erase(std::unique(res.begin(), res.end()), res.end());
+	return res;
+}
+
+} // !namespace mana
@@ -0,0 +1,220 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "field_projection.h"
+
+namespace io
+{
+
+namespace {
+
+/**
+ *	Maps the top-level nodes created by the dump functions to the category which creates them.
+ */
+const std::map<std::string, std::string> CATEGORIES = boost::assign::map_list_of
+	("Summary", "summary")
+	("DOS Header", "dos")
+	("PE Header", "pe")
+	("Image Optional Header", "opt")
+	("Sections", "sections")
+	("Imports", "imports")
+	("Exports", "exports")
+	("Resources", "resources")
+	("Version Info", "version")
+	("Debug Info", "debug")
+	("TLS Callbacks", "tls")
+	("Load Configuration", "config")
+	("Delayed Imports", "delay");
+
+/**
+ *	The children of the "Hashes" node.
+ */
+const std::set<std::string> DIGESTS = boost::assign::list_of
+	("MD5")("SHA1")("SHA256")("SHA3")("SSDeep")("Imports Hash");
+
+/**
+ *	The digests which may be computed for individual sections and resources.
+ */
+const std::set<std::string> ENTRY_DIGESTS = boost::assign::list_of
+	("MD5")("SHA1")("SHA256")("SHA3")("SSDeep");
+
+} // !namespace
+
+// ----------------------------------------------------------------------------
+
+FieldProjection::FieldProjection(const std::vector<std::string>& fields)
+	: _valid(true), _needs_hashes(false), _needs_entry_hashes(false)
+{
+	for (auto it = fields.begin() ; it != fields.end() ; ++it)
+	{
+		if (!_add_path(*it))
+		{
+			PRINT_ERROR << "Invalid field: \"" << *it << "\"." << std::endl;
+			_valid = false;
+		}
+	}
+	if (_valid) {
+		_valid = _plan();
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+bool FieldProjection::_add_path(const std::string& path)
+{
+	std::vector<std::string> components;
+	boost::split(components, path, boost::is_any_of("/"));
+
+	Field* current = &_root;
+	bool selects_subtree = false;
+	for (auto it = components.begin() ; it != components.end() ; ++it)
+	{
+		if (it->empty()) {
+			return false;
+		}
+
+		pField& child = current->children[*it];
+		if (!child) {
+			child = boost::make_shared<Field>();
+		}
+		// If a shorter path already selected the whole subtree, this one adds nothing.
+		else if (child->children.empty()) {
+			selects_subtree = true;
+			break;
+		}
+		current = child.get();
+	}
+
+	// The path stops here: select everything below the last component.
+	if (!selects_subtree) {
+		current->children.clear();
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool FieldProjection::_plan()
+{
+	bool res = true;
+	for (auto it = _root.children.begin() ; it != _root.children.end() ; ++it)
+	{
+		const Field& field = *it->second;
+		auto category = CATEGORIES.find(it->first);
+		if (category != CATEGORIES.end())
+		{
+			_categories.push_back(category->second);
+
+			// Sections and resources only contain hashes if they were explicitly requested.
+			if (it->first != "Sections" && it->first != "Resources") {
+				continue;
+			}
+			for (auto entry = field.children.begin() ; entry != field.children.end() ; ++entry)
+			{
+				for (auto value = entry->second->children.begin() ; value != entry->second->children.end() ; ++value)
+				{
+					if (ENTRY_DIGESTS.count(value->first)) {
+						_needs_entry_hashes = true;
+					}
+				}
+			}
+		}
+		else if (it->first == "Hashes")
+		{
+			_needs_hashes = true;
+			for (auto digest = field.children.begin() ; digest != field.children.end() ; ++digest)
+			{
+				if (digest->first == "*")
+				{
+					_digests.clear(); // Same as requesting the whole node.
+					break;
+				}
+				if (!DIGESTS.count(digest->first))
+				{
+					PRINT_ERROR << "Unknown digest: \"" << digest->first << "\"." << std::endl;
+					res = false;
+				}
+				_digests.insert(digest->first);
+			}
+		}
+		else if (it->first == "Plugins")
+		{
+			if (field.children.empty() || field.children.count("*"))
+			{
+				_plugins.assign(1, "all");
+				continue;
+			}
+			for (auto plugin = field.children.begin() ; plugin != field.children.end() ; ++plugin) {
+				_plugins.push_back(plugin->first);
+			}
+		}
+		else
+		{
+			PRINT_ERROR << "Unknown field: \"" << it->first << "\"." << std::endl;
+			res = false;
+		}
+	}
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+void FieldProjection::apply(pNode file_node) const
+{
+	if (!file_node || file_node->get_type() != OutputTreeNode::LIST) {
+		return;
+	}
+	_prune(file_node, _root);
+}
+
+// ----------------------------------------------------------------------------
+
+void FieldProjection::_prune(pNode node, const Field& field) const
+{
+	pNodes children = node->get_children();
+	node->clear();
+
+	auto wildcard = field.children.find("*");
+	for (auto it = children->begin() ; it != children->end() ; ++it)
+	{
+		auto match = field.children.find(*(*it)->get_name());
+		if (match == field.children.end()) {
+			match = wildcard;
+		}
+		if (match == field.children.end()) {
+			continue;
+		}
+
+		// The whole subtree was requested.
+		if (match->second->children.empty())
+		{
+			node->append(*it);
+			continue;
+		}
+
+		// Only some descendants were requested, which a leaf cannot provide.
+		if ((*it)->get_type() != OutputTreeNode::LIST) {
+			continue;
+		}
+		_prune(*it, *match->second);
+		if ((*it)->size() > 0) {
+			node->append(*it);
+		}
+	}
+}
+
+} // !namespace io
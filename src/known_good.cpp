@@ -0,0 +1,267 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "known_good.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+#include "hash-library/hashes.h"
+#include "hash-library/md5.h"
+#include "hash-library/sha1.h"
+#include "hash-library/sha256.h"
+#include "manacommons/color.h"
+#include "manacommons/hex.h"
+
+namespace mana
+{
+
+namespace {
+
+const char		SET_MAGIC[8]	= { 'M', 'A', 'N', 'A', 'K', 'G', 'S', '1' };
+const size_t	HEADER_SIZE		= 16;	// Magic, digest size and 4 reserved bytes.
+
+/**
+ *	@brief	Reads the hash at the beginning of a string.
+ *
+ *	@return	The number of bytes written into out, which must be 32 bytes long.
+ *			0 if the string doesn't start with a hash.
+ */
+size_t read_digest(const char* s, size_t length, boost::uint8_t* out)
+{
+	size_t i = io::read_hex(s, length, out, 32);
+	if (i < length && isxdigit(static_cast<unsigned char>(s[i]))) { // More than 64 digits.
+		return 0;
+	}
+	return (i == 32 || i == 40 || i == 64) ? i / 2 : 0;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Creates a digest object computing the hashes of the given size.
+ */
+Hash* create_digest(boost::uint32_t size)
+{
+	switch (size)
+	{
+	case 16:
+		return new MD5();
+	case 20:
+		return new SHA1();
+	case 32:
+		return new SHA256();
+	default:
+		return nullptr;
+	}
+}
+
+} // !namespace
+
+// ----------------------------------------------------------------------------
+
+bool build_known_good_set(std::istream& list, const std::string& output, boost::uint64_t& count)
+{
+	count = 0;
+	boost::uint32_t digest_size = 0;
+	std::vector<boost::uint8_t> hashes;
+	boost::uint8_t buffer[32];
+	std::string line;
+	while (std::getline(list, line))
+	{
+		// Skip the quotes around the first field of CSV files.
+		size_t start = line.find_first_not_of(" \t\"");
+		if (start == std::string::npos) {
+			continue;
+		}
+		size_t size = read_digest(line.c_str() + start, line.size() - start, buffer);
+		if (size == 0) {
+			continue;
+		}
+		if (digest_size == 0) {
+			digest_size = static_cast<boost::uint32_t>(size);
+		}
+		else if (size != digest_size) {
+			continue;
+		}
+		hashes.insert(hashes.end(), buffer, buffer + size);
+	}
+	if (digest_size == 0)
+	{
+		PRINT_ERROR << "No hashes were found in the input." << std::endl;
+		return false;
+	}
+
+	// Sort the hashes through their indexes, since they are stored in a flat buffer.
+	boost::uint64_t total = hashes.size() / digest_size;
+	std::vector<boost::uint64_t> order(total);
+	for (boost::uint64_t i = 0 ; i < total ; ++i) {
+		order[i] = i;
+	}
+	const boost::uint8_t* data = &hashes[0];
+	std::sort(order.begin(), order.end(), [data, digest_size](boost::uint64_t a, boost::uint64_t b) {
+		return memcmp(data + a * digest_size, data + b * digest_size, digest_size) < 0;
+	});
+
+	std::ofstream f(output.c_str(), std::ios::binary);
+	if (!f.is_open())
+	{
+		PRINT_ERROR << "Could not create " << output << "." << std::endl;
+		return false;
+	}
+	char header[HEADER_SIZE] = { 0 };
+	memcpy(header, SET_MAGIC, sizeof(SET_MAGIC));
+	header[8] = static_cast<char>(digest_size); // Little-endian 32-bit integer.
+	f.write(header, HEADER_SIZE);
+
+	const boost::uint8_t* previous = nullptr;
+	for (auto it = order.begin() ; it != order.end() ; ++it)
+	{
+		const boost::uint8_t* current = data + *it * digest_size;
+		if (previous != nullptr && memcmp(previous, current, digest_size) == 0) {
+			continue; // Lists such as NSRL contain the same hash many times.
+		}
+		f.write(reinterpret_cast<const char*>(current), digest_size);
+		previous = current;
+		++count;
+	}
+	f.close();
+	if (f.fail())
+	{
+		PRINT_ERROR << "Could not write " << output << "." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool KnownGoodSet::_load() const
+{
+	// The set never changes once it is mapped: the lookups which follow don't need any lock.
+	if (!_loaded.load(boost::memory_order_acquire))
+	{
+		boost::lock_guard<boost::mutex> lock(_mutex);
+		if (!_loaded.load(boost::memory_order_relaxed))
+		{
+			_map();
+			_loaded.store(true, boost::memory_order_release);
+		}
+	}
+	return _digest_size != 0;
+}
+
+// ----------------------------------------------------------------------------
+
+void KnownGoodSet::_map() const
+{
+	try {
+		_file.open(_path);
+	}
+	catch (std::exception&)
+	{
+		PRINT_ERROR << "Could not open the known good hashes (" << _path << ")." << std::endl;
+		return;
+	}
+
+	boost::uint32_t size = 0;
+	if (_file.size() >= HEADER_SIZE && memcmp(_file.data(), SET_MAGIC, sizeof(SET_MAGIC)) == 0) {
+		size = static_cast<boost::uint8_t>(_file.data()[8]);
+	}
+	if ((size != 16 && size != 20 && size != 32) || (_file.size() - HEADER_SIZE) % size != 0)
+	{
+		PRINT_ERROR << _path << " is not a valid set of known good hashes." << std::endl;
+		_file.close();
+		return;
+	}
+	_count = (_file.size() - HEADER_SIZE) / size;
+	_digest_size = size;
+}
+
+// ----------------------------------------------------------------------------
+
+std::string KnownGoodSet::get_digest_name() const
+{
+	if (!_load()) {
+		return "";
+	}
+	switch (_digest_size)
+	{
+	case 16:
+		return "MD5";
+	case 20:
+		return "SHA1";
+	default:
+		return "SHA256";
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+bool KnownGoodSet::contains(const std::string& digest) const
+{
+	if (!_load()) {
+		return false;
+	}
+	boost::uint8_t key[32];
+	if (read_digest(digest.c_str(), digest.size(), key) != _digest_size || digest.size() != 2 * _digest_size) {
+		return false;
+	}
+
+	// Binary search in the sorted hashes.
+	const char* data = _file.data() + HEADER_SIZE;
+	boost::uint64_t low = 0, high = _count;
+	while (low < high)
+	{
+		boost::uint64_t middle = low + (high - low) / 2;
+		int cmp = memcmp(data + middle * _digest_size, key, _digest_size);
+		if (cmp == 0) {
+			return true;
+		}
+		else if (cmp < 0) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	return false;
+}
+
+// ----------------------------------------------------------------------------
+
+bool KnownGoodSet::contains_file(const std::string& path, std::string& digest) const
+{
+	if (!_load()) {
+		return false;
+	}
+
+	boost::scoped_ptr<Hash> h(create_digest(_digest_size)); // Not shared: workers may hash files concurrently.
+	hash::pString res = hash::hash_file(*h, path);
+	if (res == nullptr) {
+		return false;
+	}
+	digest = *res;
+	return contains(digest);
+}
+
+} // !namespace mana
@@ -0,0 +1,54 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+
+#include "known_good.h"
+#include "manacommons/color.h"
+
+/**
+ *	@brief	Builds the set of known good hashes used by Manalyze (known_good.hash_set in the
+ *			configuration file) from a list of hashes, such as the NSRL.
+ *
+ *	Usage: known_good_builder [list] [output]
+ */
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		std::cout << "Usage: " << argv[0] << " [list] [output]" << std::endl;
+		std::cout << "Builds a set of known good hashes from a list of MD5, SHA1 or SHA256 hashes "
+					 "(one per line, or in the first column of a CSV file such as NSRLFile.txt)." << std::endl;
+		return -1;
+	}
+
+	std::ifstream list(argv[1]);
+	if (!list.is_open())
+	{
+		PRINT_ERROR << "Could not open " << argv[1] << "!" << std::endl;
+		return -1;
+	}
+
+	boost::uint64_t count = 0;
+	if (!mana::build_known_good_set(list, argv[2], count)) {
+		return -1;
+	}
+	std::cout << count << " hashes written to " << argv[2] << "." << std::endl;
+	return 0;
+}
@@ -20,21 +20,30 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <set>
+#include <map>
+#include <chrono>
 
 #include <boost/program_options.hpp>
 #include <boost/tokenizer.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/system/api_config.hpp>
 #include <boost/assign/list_of.hpp>
+#include <boost/thread.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #ifdef BOOST_WINDOWS_API
 # include <direct.h>
+# include <io.h>
+# include <fcntl.h>
 # define chdir _chdir
 #else
 # include <unistd.h>
 #endif
 
 #include "plugin_framework/plugin_manager.h"
+#include "plugin_framework/verdict_policy.h"
+#include "plugin_framework/worker_pool.h"
 
 #include "config_parser.h"
 #include "yara/yara_wrapper.h"
@@ -43,6 +52,14 @@
 #include "manape/resources.h"
 #include "manacommons/color.h"
 #include "output_formatter.h"
+#include "table_export.h"
+#include "output_sink.h"
+#include "field_projection.h"
+#include "similarity_index.h"
+#include "feature_index.h"
+#include "known_good.h"
+#include "results_store.h"
+#include "corpus_statistics.h"
 #include "dump.h"
 
 #define MANALYZE_VERSION "0.9"
@@ -61,13 +78,13 @@ void print_help(po::options_description& desc, const std::string& argv_0)
 	std::cout << desc << std::endl; // Standard usage
 
 	// Plugin description
-	std::vector<plugin::pIPlugin> plugins = plugin::PluginManager::get_instance().get_plugins();
+	std::vector<plugin::pPluginManifest> plugins = plugin::PluginManager::get_instance().get_manifests();
 
 	if (plugins.size() > 0)
 	{
 		std::cout << "Available plugins:" << std::endl;
 		for (auto it = plugins.begin() ; it != plugins.end() ; ++it) {
-			std::cout << "  - " << *(*it)->get_id() << ": " << *(*it)->get_description() << std::endl;
+			std::cout << "  - " << (*it)->id << ": " << (*it)->description << std::endl;
 		}
 		std::cout << "  - all: Run all the available plugins." << std::endl;
 	}
@@ -84,6 +101,10 @@ void print_help(po::options_description& desc, const std::string& argv_0)
 	std::cout << "  " << filename << " -dresources -dexports -x out/ program.exe" << std::endl;
 	std::cout << "  " << filename << " --dump=imports,sections --hashes program.exe" << std::endl;
 	std::cout << "  " << filename << " -r malwares/ --plugins=peid,clamav --dump all" << std::endl;
+	std::cout << "  " << filename << " -r malwares/ -o jsonl --fields \"Hashes/SHA256,Plugins/packer/level\"" << std::endl;
+	std::cout << "  " << filename << " -r malwares/ --feature-index index/ && " << filename << " lookup index/ program.exe" << std::endl;
+	std::cout << "  " << filename << " -r malwares/ -p all --store store/ && " << filename << " query store/ \"import:winhttp*\" permissions:wx" << std::endl;
+	std::cout << "  " << filename << " -r malwares/ --stats -o json" << std::endl;
 }
 
 // ----------------------------------------------------------------------------
@@ -124,6 +145,9 @@ std::vector<std::string> tokenize_args(const std::vector<std::string>& args)
  *	- All the requested plugins exist
  *	- All the input files exist
  *	- The requested output formatter exists
+ *	- The requested table format exists
+ *	- The requested compression is available, and output files are only configured with --output-file
+ *	- The requested fields exist, and are not combined with another selection of the output
  *
  *	If an error is detected, the help message is displayed.
  *
@@ -159,15 +183,13 @@ bool validate_args(po::variables_map& vm, po::options_description& desc, char**
 	if (vm.count("plugins"))
 	{
 		std::vector<std::string> selected_plugins = tokenize_args(vm["plugins"].as<std::vector<std::string> >());
-		std::vector<plugin::pIPlugin> plugins = plugin::PluginManager::get_instance().get_plugins();
 		for (auto it = selected_plugins.begin() ; it != selected_plugins.end() ; ++it)
 		{
 			if (*it == "all") {
 				continue;
 			}
 
-			auto found = std::find_if(plugins.begin(), plugins.end(), boost::bind(&plugin::name_matches, *it, _1));
-			if (found == plugins.end())
+			if (!plugin::PluginManager::get_instance().find_manifest(*it))
 			{
 				print_help(desc, argv[0]);
 				std::cout << std::endl;
@@ -191,7 +213,7 @@ bool validate_args(po::variables_map& vm, po::options_description& desc, char**
 	// Verify that the requested output formatter exists
 	if (vm.count("output"))
 	{
-		auto formatters = boost::assign::list_of("raw")("json");
+		auto formatters = boost::assign::list_of("raw")("json")("jsonl")("cbor");
 		auto found = std::find(formatters.begin(), formatters.end(), vm["output"].as<std::string>());
 		if (found == formatters.end())
 		{
@@ -202,6 +224,80 @@ bool validate_args(po::variables_map& vm, po::options_description& desc, char**
 		}
 	}
 
+	// Verify that the requested table format exists
+	if (vm.count("table-format"))
+	{
+		auto formats = boost::assign::list_of("tsv")("csv");
+		auto found = std::find(formats.begin(), formats.end(), vm["table-format"].as<std::string>());
+		if (found == formats.end())
+		{
+			print_help(desc, argv[0]);
+			std::cout << std::endl;
+			PRINT_ERROR << "table format " << vm["table-format"].as<std::string>() << " does not exist!" << std::endl;
+			return false;
+		}
+	}
+
+	// Verify the options related to output files
+	if (vm.count("compression"))
+	{
+		std::string compression = vm["compression"].as<std::string>();
+		if (compression != "none" && compression != "gzip" && compression != "zstd")
+		{
+			print_help(desc, argv[0]);
+			std::cout << std::endl;
+			PRINT_ERROR << "compression " << compression << " does not exist!" << std::endl;
+			return false;
+		}
+		if (compression == "zstd" && !io::OutputSink::is_supported(io::OutputSink::ZSTD))
+		{
+			PRINT_ERROR << "This version of Manalyze was compiled without zstd support." << std::endl;
+			return false;
+		}
+	}
+	if (!vm.count("output-file") && (vm.count("compression") || vm.count("rotate-samples") || vm.count("rotate-bytes")))
+	{
+		print_help(desc, argv[0]);
+		std::cout << std::endl;
+		PRINT_ERROR << "--compression, --rotate-samples and --rotate-bytes require --output-file." << std::endl;
+		return false;
+	}
+	if (vm.count("similar") && vm["similar"].as<unsigned int>() > 100)
+	{
+		PRINT_ERROR << "The similarity threshold must be between 0 and 100." << std::endl;
+		return false;
+	}
+
+	// Verify the requested fields
+	if (vm.count("fields"))
+	{
+		if (vm.count("dump") || vm.count("hashes") || vm.count("plugins"))
+		{
+			print_help(desc, argv[0]);
+			std::cout << std::endl;
+			PRINT_ERROR << "--fields cannot be combined with --dump, --hashes or --plugins." << std::endl;
+			return false;
+		}
+
+		io::FieldProjection projection(tokenize_args(vm["fields"].as<std::vector<std::string> >()));
+		if (!projection.is_valid()) {
+			return false;
+		}
+
+		const std::vector<std::string>& selected_plugins = projection.get_plugins();
+		for (auto it = selected_plugins.begin() ; it != selected_plugins.end() ; ++it)
+		{
+			if (*it == "all") {
+				continue;
+			}
+			if (!plugin::PluginManager::get_instance().find_manifest(*it))
+			{
+				PRINT_ERROR << "plugin " << *it << " does not exist!" << std::endl;
+				return false;
+			}
+		}
+	}
+
 	return true;
 }
 
@@ -225,7 +321,14 @@ bool parse_args(po::variables_map& vm, int argc, char**argv)
 		("pe", po::value<std::vector<std::string> >(), "The PE to analyze. Also accepted as a positional argument. "
 			"Multiple files may be specified.")
 		("recursive,r", "Scan all files in a directory (subdirectories will be ignored).")
-		("output,o", po::value<std::string>(), "The output format. May be 'raw' (default) or 'json'.")
+		("output,o", po::value<std::string>(), "The output format. May be 'raw' (default), 'json', 'jsonl' (one JSON object per line) "
+			"or 'cbor' (binary records, see cbor2json).")
+		("output-file", po::value<std::string>(), "Write the output into the given file instead of stdout. "
+			"JSON Lines are appended to it, unless the file is compressed or rotated.")
+		("compression", po::value<std::string>(), "Compress the output file. May be 'none' (default), 'gzip' or 'zstd'.")
+		("rotate-samples", po::value<unsigned int>(), "Start a new output file after this many analyzed files.")
+		("rotate-bytes", po::value<boost::uint64_t>(), "Start a new output file after this many bytes "
+			"(before compression) were written.")
 		("dump,d", po::value<std::vector<std::string> >(),
 			"Dump PE information. Available choices are any combination of: "
 			"all, summary, dos (dos header), pe (pe header), opt (pe optional header), sections, "
@@ -233,8 +336,22 @@ bool parse_args(po::variables_map& vm, int argc, char**argv)
 			"delay (delay-load table")
 		("hashes", "Calculate various hashes of the file (may slow down the analysis!)")
 		("extract,x", po::value<std::string>(), "Extract the PE resources to the target directory.")
+		("tables", po::value<std::string>(), "Export the sections, imports, exports and resources of the PE "
+			"as tables in the target directory.")
+		("table-format", po::value<std::string>(), "The format of the exported tables. May be 'tsv' (default) or 'csv'.")
 		("plugins,p", po::value<std::vector<std::string> >(),
-			"Analyze the binary with additional plugins. (may slow down the analysis!)");
+			"Analyze the binary with additional plugins. (may slow down the analysis!)")
+		("fields", po::value<std::vector<std::string> >(),
+			"Only compute and output the given fields, as paths into the results separated by slashes "
+			"(e.g. Hashes/SHA256 or Plugins/packer/level). Replaces --dump, --hashes and --plugins.")
+		("similar", po::value<unsigned int>(), "List the previously analyzed files whose ssdeep hash matches "
+			"the file's with at least this score (0 to 100).")
+		("feature-index", po::value<std::string>(), "Record the import hash, sections, resources and PDB "
+			"information of the files in the given index (see 'manalyze lookup').")
+		("store", po::value<std::string>(), "Record the imports, sections and plugin verdicts of the files "
+			"in the given results store (see 'manalyze query').")
+		("stats", "Compute statistics about all the input files (machines, subsystems, compilation years, "
+			"section entropy, most frequent section names and imports) instead of displaying their summary.");
 
 
 	po::positional_options_description p;
@@ -329,50 +446,313 @@ void handle_dump_option(io::OutputFormatter& formatter, const std::vector<std::s
 
 // ----------------------------------------------------------------------------
 
+/**
+ *	@brief	A file whose analysis is over, except for the plugins which work on batches of samples.
+ */
+struct PendingSample
+{
+	boost::shared_ptr<mana::PE>					pe;
+	boost::shared_ptr<plugin::AnalysisContext>	context;
+	std::string									verdict;	// The plugin which settled the verdict, if any.
+	io::pArena									arena;		// Receives the output nodes of the file.
+};
+typedef boost::shared_ptr<PendingSample> pPendingSample;
+
+// ----------------------------------------------------------------------------
+
 /**
  *	@brief	Analyze the PE with each selected plugin.
  *
+ *	The plugins of the current run (see PluginManager::start_run) run in stages determined by
+ *	their dependencies. The plugins of a stage are independent from each other and run in parallel. Plugins which
+ *	support batches are left out: see run_batch_plugins.
+ *
  *	@param	io::OutputFormatter& formatter The object which will recieve the output.
  *	@param	const std::vector<std::string>& selected The names of the selected plugins.
- *	@param	const config& conf The configuration of the plugins.
- *	@param	const mana::PE& pe The PE to analyze.
+ *	@param	plugin::AnalysisContext& context The sample to analyze. The results of the plugins are
+ *			recorded into it, so that each plugin can access the results of the ones which ran before.
+ *	@param	plugin::WorkerPool& pool The threads on which the plugins run.
+ *	@param	const plugin::VerdictPolicy& policy Decides which plugins can be skipped once the
+ *			verdict for the file is known. The skipped plugins are listed in the output.
+ *
+ *	@return	The ID of the plugin which settled the verdict, or an empty string.
  */
-void handle_plugins_option(io::OutputFormatter& formatter,
-						   const std::vector<std::string>& selected,
-						   const config& conf,
-						   const mana::PE& pe)
+std::string handle_plugins_option(io::OutputFormatter& formatter,
+								  const std::vector<std::string>& selected,
+								  plugin::AnalysisContext& context,
+								  plugin::WorkerPool& pool,
+								  const plugin::VerdictPolicy& policy)
 {
 	bool all_plugins = std::find(selected.begin(), selected.end(), "all") != selected.end();
-	std::vector<plugin::pIPlugin> plugins = plugin::PluginManager::get_instance().get_plugins();
-	io::pNode plugins_node(new io::OutputTreeNode("Plugins", io::OutputTreeNode::LIST));
+	const std::vector<std::pair<plugin::pIPlugin, unsigned int> >& plugins = plugin::PluginManager::get_instance().get_dispatch_list();
+	std::vector<plugin::pResult> results(plugins.size());
+	std::vector<std::string> skipped;		// Why plugins didn't run, if they were skipped because of the policy.
+	std::set<std::string> skipped_data;	// What the skipped plugins would have provided.
+	std::string verdict;					// The plugin which settled the verdict, if any.
+
+	unsigned int stages = 0;
+	for (auto it = plugins.begin() ; it != plugins.end() ; ++it) {
+		stages = std::max(stages, it->second + 1);
+	}
 
-	for (std::vector<plugin::pIPlugin>::iterator it = plugins.begin() ; it != plugins.end() ; ++it)
+	for (unsigned int stage = 0 ; stage < stages ; ++stage)
 	{
-		// Verify that the plugin was selected
-		if (!all_plugins && std::find(selected.begin(), selected.end(), *(*it)->get_id()) == selected.end()) {
-			continue;
+		std::vector<size_t> batch;
+		for (size_t i = 0 ; i < plugins.size() ; ++i)
+		{
+			if (plugins[i].second != stage || plugin::supports_batch(plugins[i].first)) {
+				continue;
+			}
+
+			// Skip the plugins whose dependencies couldn't be obtained.
+			std::vector<std::string> dependencies = plugin::get_dependencies(plugins[i].first);
+			auto missing = std::find_if(dependencies.begin(), dependencies.end(),
+				[&context](const std::string& d) { return !context.get_result(d); });
+			if (missing != dependencies.end())
+			{
+				if (skipped_data.count(*missing))
+				{
+					std::vector<std::string> provided = plugin::get_provided_data(plugins[i].first);
+					skipped_data.insert(provided.begin(), provided.end());
+					skipped.push_back(*plugins[i].first->get_id() + ": depends on " + *missing + ", which was skipped.");
+				}
+				else {
+					PRINT_WARNING << "Plugin " << *plugins[i].first->get_id() << " was skipped because "
+						<< *missing << " is not available." << std::endl;
+				}
+				continue;
+			}
+			batch.push_back(i);
 		}
 
-		// Forward relevant configuration elements to the plugin.
-		if (conf.count(*(*it)->get_id())) {
-			(*it)->set_config(conf.at(*(*it)->get_id()));
+		// The verdict policy decides in which order the plugins of the stage run.
+		std::vector<plugin::pIPlugin> stage_plugins;
+		for (auto it = batch.begin() ; it != batch.end() ; ++it) {
+			stage_plugins.push_back(plugins[*it].first);
+		}
+		std::vector<plugin::pResult> stage_results;
+		std::vector<std::string> skipped_ids = policy.run_plugins(stage_plugins, context, pool, stage_results, verdict);
+		for (size_t j = 0 ; j < batch.size() ; ++j)
+		{
+			results[batch[j]] = stage_results[j];
+			if (std::find(skipped_ids.begin(), skipped_ids.end(), *stage_plugins[j]->get_id()) != skipped_ids.end())
+			{
+				std::vector<std::string> provided = plugin::get_provided_data(stage_plugins[j]);
+				skipped_data.insert(provided.begin(), provided.end());
+			}
+		}
+		for (auto it = skipped_ids.begin() ; it != skipped_ids.end() ; ++it) {
+			skipped.push_back(*it + ": " + policy.get_threshold_name() + " verdict reached by " + verdict + ".");
 		}
 
-		plugin::pResult res = (*it)->analyze(pe);
-		if (!res)
+		// Make the results available to the next stages.
+		for (auto it = batch.begin() ; it != batch.end() ; ++it)
 		{
-			PRINT_WARNING << "Plugin " << *(*it)->get_id() << " returned a NULL result!" << std::endl;
+			if (skipped_data.count(*plugins[*it].first->get_id())) {
+				continue;
+			}
+			if (!results[*it])
+			{
+				PRINT_WARNING << "Plugin " << *plugins[*it].first->get_id() << " returned a NULL result!" << std::endl;
+				continue;
+			}
+			std::vector<std::string> provided = plugin::get_provided_data(plugins[*it].first);
+			for (auto name = provided.begin() ; name != provided.end() ; ++name) {
+				context.add_result(*name, results[*it]);
+			}
+		}
+	}
+
+	// Only display the plugins which were requested (and not the ones they depend on), in
+	// the order in which they were registered.
+	io::pNode plugins_node = io::make_node("Plugins", io::OutputTreeNode::LIST);
+	for (size_t i = 0 ; i < plugins.size() ; ++i)
+	{
+		if (!results[i] ||
+			(!all_plugins && std::find(selected.begin(), selected.end(), *plugins[i].first->get_id()) == selected.end())) {
 			continue;
 		}
 
-		io::pNode output = res->get_output();
-		if (!output || !res->get_information()->size()) {
+		io::pNode output = results[i]->get_output();
+		if (!output || !results[i]->get_information()->size()) {
 			continue;
 		}
 		plugins_node->append(output);
 	}
 
-	formatter.add_data(plugins_node, *pe.get_path());
+	formatter.add_data(plugins_node, *context.get_pe().get_path());
+	if (!skipped.empty()) {
+		formatter.add_data(io::make_node("Skipped plugins", skipped, io::OutputTreeNode::NEW_LINE),
+						   *context.get_pe().get_path());
+	}
+	return verdict;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Tells whether a plugin of the run has to analyze the batches of files.
+ *
+ *	The PluginManager does not load the plugins depending on a plugin which supports batches,
+ *	so only the requested ones have to run.
+ *
+ *	@param	plugin::pIPlugin p The plugin.
+ *	@param	const std::vector<std::string>& selected The names of the selected plugins.
+ */
+bool is_batch_plugin(plugin::pIPlugin p, const std::vector<std::string>& selected)
+{
+	return plugin::supports_batch(p) &&
+		(std::find(selected.begin(), selected.end(), "all") != selected.end() ||
+		 std::find(selected.begin(), selected.end(), *p->get_id()) != selected.end());
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Lets the plugins which support batches start working on a file, while the rest of
+ *			its batch is analyzed.
+ *
+ *	@param	const PendingSample& sample The file, which was analyzed by the other plugins.
+ *	@param	const std::vector<std::string>& selected The names of the selected plugins.
+ *	@param	const plugin::VerdictPolicy& policy Decides which plugins can be skipped once the
+ *			verdict for a file is known.
+ */
+void prepare_batch_plugins(const PendingSample& sample,
+						   const std::vector<std::string>& selected,
+						   const plugin::VerdictPolicy& policy)
+{
+	const std::vector<std::pair<plugin::pIPlugin, unsigned int> >& plugins = plugin::PluginManager::get_instance().get_dispatch_list();
+	for (auto it = plugins.begin() ; it != plugins.end() ; ++it)
+	{
+		if (is_batch_plugin(it->first, selected) &&
+			(sample.verdict.empty() || !policy.may_skip(*it->first->get_id()))) {
+			it->first->prepare_sample(*sample.context);
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Analyzes a batch of files with the selected plugins which support batches.
+ *
+ *	The results are attached to the output of each file, after the ones of the other plugins.
+ *
+ *	@param	io::OutputFormatter& formatter The object which will recieve the output.
+ *	@param	const std::vector<pPendingSample>& samples The files to analyze.
+ *	@param	const std::vector<std::string>& selected The names of the selected plugins.
+ *	@param	const plugin::VerdictPolicy& policy Decides which plugins can be skipped once the
+ *			verdict for a file is known.
+ */
+void run_batch_plugins(io::OutputFormatter& formatter,
+					   const std::vector<pPendingSample>& samples,
+					   const std::vector<std::string>& selected,
+					   const plugin::VerdictPolicy& policy)
+{
+	if (selected.empty() || samples.empty()) {
+		return;
+	}
+
+	const std::vector<std::pair<plugin::pIPlugin, unsigned int> >& plugins = plugin::PluginManager::get_instance().get_dispatch_list();
+	for (auto it = plugins.begin() ; it != plugins.end() ; ++it)
+	{
+		plugin::pIPlugin p = it->first;
+		const std::string& id = *p->get_id();
+		if (!is_batch_plugin(p, selected)) {
+			continue;
+		}
+
+		std::vector<plugin::IAnalysisContext*> contexts;
+		std::vector<pPendingSample> targets;
+		for (auto sample = samples.begin() ; sample != samples.end() ; ++sample)
+		{
+			const std::string& path = *(*sample)->pe->get_path();
+			if (!(*sample)->verdict.empty() && policy.may_skip(id))
+			{
+				io::NodeArena::Scope arena_scope((*sample)->arena);
+				std::string reason = id + ": " + policy.get_threshold_name() + " verdict reached by " + (*sample)->verdict + ".";
+				io::pNode skipped = formatter.find_node("Skipped plugins", path);
+				if (skipped) {
+					skipped->append(reason);
+				}
+				else {
+					formatter.add_data(io::make_node("Skipped plugins", std::vector<std::string>(1, reason),
+													 io::OutputTreeNode::NEW_LINE), path);
+				}
+				continue;
+			}
+			contexts.push_back((*sample)->context.get());
+			targets.push_back(*sample);
+		}
+		if (contexts.empty()) {
+			continue;
+		}
+
+		plugin::shared_results results = p->analyze_batch(contexts);
+		if (!results || results->size() != contexts.size())
+		{
+			PRINT_WARNING << "Plugin " << id << " did not return one result per file!" << std::endl;
+			continue;
+		}
+
+		for (size_t i = 0 ; i < targets.size() ; ++i)
+		{
+			plugin::pResult res = results->at(i);
+			if (!res) {
+				continue;
+			}
+			std::vector<std::string> provided = plugin::get_provided_data(p);
+			for (auto name = provided.begin() ; name != provided.end() ; ++name) {
+				targets[i]->context->add_result(*name, res);
+			}
+
+			io::pNode output = res->get_output();
+			if (!output || !res->get_information()->size()) {
+				continue;
+			}
+			const std::string& path = *targets[i]->pe->get_path();
+			io::pNode plugins_node = formatter.find_node("Plugins", path);
+			if (!plugins_node)
+			{
+				io::NodeArena::Scope arena_scope(targets[i]->arena);
+				plugins_node = io::make_node("Plugins", io::OutputTreeNode::LIST);
+				formatter.add_data(plugins_node, path);
+			}
+			plugins_node->append(output);
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Adds an analyzed file to the results store.
+ *
+ *	@param	const PendingSample& sample The file, whose plugins have all run.
+ *	@param	mana::ResultsStore& store The results store.
+ */
+void store_results(const PendingSample& sample, mana::ResultsStore& store)
+{
+	sample.context->compute_digests(boost::assign::list_of<std::string>("SHA256"));
+	pString sha256 = sample.context->get_digest("SHA256");
+	if (sha256 == nullptr) {
+		return;
+	}
+
+	mana::sample_record record;
+	record.sha256 = *sha256;
+	record.path = *sample.pe->get_path();
+	mana::describe_pe(*sample.pe, record);
+
+	const std::vector<std::pair<plugin::pIPlugin, unsigned int> >& plugins = plugin::PluginManager::get_instance().get_dispatch_list();
+	for (auto it = plugins.begin() ; it != plugins.end() ; ++it)
+	{
+		plugin::pResult res = sample.context->get_result(*it->first->get_id());
+		if (res) {
+			record.verdicts.push_back(std::make_pair(*it->first->get_id(), res->get_level()));
+		}
+	}
+	store.add(record);
 }
 
 // ----------------------------------------------------------------------------
@@ -447,18 +827,164 @@ std::set<std::string> get_input_files(po::variables_map& vm)
 
 // ----------------------------------------------------------------------------
 
+/**
+ *	@brief	Determines which parts of the input files have to be parsed for the requested analysis.
+ *
+ *	@param	po::variables_map& vm The parsed command line arguments.
+ *	@param	const std::vector<std::string>& categories The requested dump categories.
+ *	@param	const std::vector<std::pair<plugin::pIPlugin, unsigned int> >& plugins The plugins which
+ *			will run (see PluginManager::schedule).
+ *	@param	boost::shared_ptr<io::FieldProjection> fields The requested fields, if any.
+ *
+ *	@return	A combination of mana::PE::PE_COMPONENT values.
+ */
+unsigned int plan_parsing(po::variables_map& vm,
+						  const std::vector<std::string>& categories,
+						  const std::vector<std::pair<plugin::pIPlugin, unsigned int> >& plugins,
+						  boost::shared_ptr<io::FieldProjection> fields)
+{
+	typedef mana::PE P;
+	static const std::map<std::string, unsigned int> category_components = boost::assign::map_list_of
+		("summary", P::COMPONENT_RESOURCES | P::COMPONENT_DEBUG | P::COMPONENT_TLS)
+		("imports", P::COMPONENT_IMPORTS)
+		("exports", P::COMPONENT_EXPORTS)
+		("resources", P::COMPONENT_RESOURCES)
+		("version", P::COMPONENT_RESOURCES)
+		("debug", P::COMPONENT_DEBUG)
+		("tls", P::COMPONENT_TLS)
+		("config", P::COMPONENT_CONFIG)
+		("delay", P::COMPONENT_IMPORTS)
+		("all", P::ALL_COMPONENTS);
+
+	unsigned int res = P::HEADERS_ONLY;
+	if (!fields && !vm.count("dump")) { // The summary is displayed by default.
+		res |= category_components.at("summary");
+	}
+	for (auto it = categories.begin() ; it != categories.end() ; ++it)
+	{
+		auto found = category_components.find(*it);
+		if (found != category_components.end()) {
+			res |= found->second;
+		}
+	}
+
+	// The import hash is part of the hashes unless other ones were requested explicitly.
+	if (vm.count("hashes") ||
+		(fields && fields->needs_hashes() && (fields->get_digests().empty() || fields->get_digests().count("Imports Hash")))) {
+		res |= P::COMPONENT_IMPORTS;
+	}
+	if (vm.count("extract")) {
+		res |= P::COMPONENT_RESOURCES;
+	}
+	if (vm.count("tables")) {
+		res |= P::COMPONENT_IMPORTS | P::COMPONENT_EXPORTS | P::COMPONENT_RESOURCES;
+	}
+	if (vm.count("feature-index")) {
+		res |= P::COMPONENT_IMPORTS | P::COMPONENT_RESOURCES | P::COMPONENT_DEBUG;
+	}
+	if (vm.count("store") || vm.count("stats")) {
+		res |= P::COMPONENT_IMPORTS;
+	}
+
+	for (auto it = plugins.begin() ; it != plugins.end() ; ++it) {
+		res |= plugin::get_required_components(it->first);
+	}
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Looks for the files similar to the sample in the similarity index, then adds the
+ *			sample to the index.
+ *
+ *	@param	plugin::AnalysisContext& context The analysis context of the sample.
+ *	@param	io::OutputFormatter& formatter The formatter which receives the similar files.
+ *	@param	mana::SimilarityIndex& index The similarity index.
+ *	@param	int threshold The minimum score of the reported files. If it is negative, the sample
+ *			is only added to the index.
+ */
+void handle_similarity(plugin::AnalysisContext& context,
+					   io::OutputFormatter& formatter,
+					   mana::SimilarityIndex& index,
+					   int threshold)
+{
+	context.compute_digests(boost::assign::list_of<std::string>("SHA256")("SSDeep"));
+	pString sha256 = context.get_digest("SHA256");
+	pString ssdeep = context.get_digest("SSDeep");
+	if (sha256 == nullptr || ssdeep == nullptr) {
+		return;
+	}
+	const std::string& path = *context.get_pe().get_path();
+
+	if (threshold >= 0)
+	{
+		std::vector<mana::similar_file> similar = index.find_similar(*ssdeep, threshold, *sha256);
+		if (!similar.empty())
+		{
+			io::pNode similar_node = io::make_node("Similar files", io::OutputTreeNode::LIST);
+			for (auto it = similar.begin() ; it != similar.end() ; ++it)
+			{
+				io::pNode file = io::make_node(it->sha256, io::OutputTreeNode::LIST);
+				file->append(io::make_node("Score", static_cast<boost::uint32_t>(it->score)));
+				file->append(io::make_node("Path", it->path));
+				similar_node->append(file);
+			}
+			formatter.add_data(similar_node, path);
+		}
+	}
+	index.add(*ssdeep, *sha256, path);
+}
+
+// ----------------------------------------------------------------------------
+
 /**
  *	@brief	Does the actual analysis
+ *
+ *	@return	The analyzed file, which still has to go through the plugins which work on batches.
+ *			NULL if the file could not be parsed or is known good.
  */
-void perform_analysis(const std::string& path,
+pPendingSample perform_analysis(const std::string& path,
 					  po::variables_map& vm,
 					  const std::string& extraction_directory,
 					  const std::vector<std::string> selected_categories,
 					  const std::vector<std::string> selected_plugins,
-					  const config& conf,
-					  boost::shared_ptr<io::OutputFormatter> formatter)
+					  boost::shared_ptr<io::OutputFormatter> formatter,
+					  boost::shared_ptr<io::TableExporter> tables,
+					  boost::shared_ptr<mana::SimilarityIndex> similarity,
+					  boost::shared_ptr<mana::FeatureIndex> feature_index,
+					  boost::shared_ptr<mana::KnownGoodSet> known_good,
+					  boost::shared_ptr<io::FieldProjection> fields,
+					  plugin::WorkerPool& pool,
+					  const plugin::VerdictPolicy& policy,
+					  unsigned int components)
 {
-	mana::PE pe(path);
+	// The output nodes created for this file are allocated in a dedicated arena, which is released
+	// in one go once the formatter has printed them.
+	io::pArena arena(new io::NodeArena);
+	io::NodeArena::Scope arena_scope(arena);
+
+	// Known good files are neither parsed nor analyzed: only their hash is reported.
+	std::string digest;
+	pPendingSample sample = boost::make_shared<PendingSample>();
+	sample->arena = arena; // The batch plugins add their results after the scope has ended.
+	sample->pe = mana::parse_unless_known_good(known_good.get(), path, digest,
+		[components](const std::string& p) { return mana::PE::create(p, components); });
+	if (!sample->pe)
+	{
+		io::pNode known = io::make_node("Known good", io::OutputTreeNode::LIST);
+		known->append(io::make_node(known_good->get_digest_name(), digest));
+		formatter->add_data(known, path);
+		return pPendingSample();
+	}
+	const mana::PE& pe = *sample->pe;
+
+	// Everything computed about the file is shared between the plugins and the rest of the analysis.
+	sample->context = boost::make_shared<plugin::AnalysisContext>(pe);
+	plugin::AnalysisContext& context = *sample->context;
+	if (!digest.empty()) { // Not computed again for --hashes, the tables or the plugins.
+		context.set_digest(known_good->get_digest_name(), digest);
+	}
 
 	// Try to parse the PE
 	if (!pe.is_valid())
@@ -481,13 +1007,16 @@ void perform_analysis(const std::string& path,
 			}
 		}
 		std::cerr << std::endl;
-		return;
+		return pPendingSample();
 	}
 
-	if (vm.count("dump")) {
+	if (fields) { // Only the categories needed by the requested fields.
+		handle_dump_option(*formatter, selected_categories, fields->needs_entry_hashes(), pe);
+	}
+	else if (vm.count("dump")) {
 		handle_dump_option(*formatter, selected_categories, vm.count("hashes") != 0, pe);
 	}
-	else { // No specific info requested. Display the summary of the PE.
+	else if (!vm.count("stats")) { // No specific info requested. Display the summary of the PE.
 		dump_summary(pe, *formatter);
 	}
 
@@ -497,18 +1026,167 @@ void perform_analysis(const std::string& path,
 	}
 
 	if (vm.count("hashes")) {
-		dump_hashes(pe, *formatter);
+		mana::dump_hashes(context, *formatter);
+	}
+	else if (fields && fields->needs_hashes()) {
+		mana::dump_hashes(context, *formatter, fields->get_digests());
 	}
 
-	if (vm.count("plugins")) {
-		handle_plugins_option(*formatter, selected_plugins, conf, pe);
+	if (tables)
+	{
+		pString sha256 = context.get_digest("SHA256");
+		if (sha256 != nullptr) {
+			tables->export_pe(pe, *sha256);
+		}
+	}
+
+	if (similarity) {
+		handle_similarity(context, *formatter, *similarity, vm.count("similar") ? static_cast<int>(vm["similar"].as<unsigned int>()) : -1);
+	}
+
+	if (feature_index)
+	{
+		context.compute_digests(boost::assign::list_of<std::string>("SHA256"));
+		pString sha256 = context.get_digest("SHA256");
+		if (sha256 != nullptr) {
+			feature_index->add(*sha256, mana::extract_features(pe));
+		}
+	}
+
+	if (!selected_plugins.empty()) {
+		sample->verdict = handle_plugins_option(*formatter, selected_plugins, context, pool, policy);
+	}
+	return sample;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Reads a positive number from the configuration.
+ *
+ *	@param	config& conf The configuration.
+ *	@param	const std::string& section The section in which the value is located (i.e. "plugins").
+ *	@param	const std::string& key The name of the value.
+ *	@param	unsigned int default_value The value to return if it is missing or invalid.
+ */
+unsigned int get_config_number(config& conf, const std::string& section, const std::string& key, unsigned int default_value)
+{
+	if (!conf.count(section) || !conf[section].count(key)) {
+		return default_value;
+	}
+
+	try
+	{
+		int value = std::stoi(conf[section][key]);
+		if (value >= 0) {
+			return static_cast<unsigned int>(value);
+		}
+	}
+	catch (std::logic_error&) {} // invalid_argument or out_of_range
+	PRINT_WARNING << "Could not parse " << section << "." << key << " in the configuration file." << std::endl;
+	return default_value;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Implements the "lookup" command, which lists the samples of a feature index sharing
+ *			features with a file or matching the given features.
+ *
+ *	Usage: manalyze lookup <index> <feature or PE>...
+ *	Features are written as in the index (i.e. "imphash:<md5>" or "pdb:<path>"). If a PE is given
+ *	instead, all its features are looked up. Matches are printed as "<feature><TAB><sha256>".
+ *
+ *	@return	The exit code of the program.
+ */
+int lookup_features(int argc, char** argv)
+{
+	if (argc < 4)
+	{
+		std::cerr << "Usage: " << bfs::basename(argv[0]) << " lookup <index> <feature or PE>..." << std::endl;
+		std::cerr << "Features: imphash:<md5>, section:<sha256>, resource:<sha256>, pdb:<path>, pdb_guid:<guid>"
+				  << std::endl;
+		return -1;
+	}
+	if (!bfs::is_directory(argv[2]))
+	{
+		PRINT_ERROR << argv[2] << " is not a feature index." << std::endl;
+		return -1;
+	}
+
+	mana::FeatureIndex index(argv[2]);
+	for (int i = 3 ; i < argc ; ++i)
+	{
+		std::vector<std::string> features;
+		if (bfs::is_regular_file(argv[i]))
+		{
+			boost::shared_ptr<mana::PE> pe = mana::PE::create(argv[i],
+				mana::PE::COMPONENT_IMPORTS | mana::PE::COMPONENT_RESOURCES | mana::PE::COMPONENT_DEBUG);
+			if (!pe->is_valid())
+			{
+				PRINT_ERROR << "Could not parse " << argv[i] << "!" << std::endl;
+				continue;
+			}
+			features = mana::extract_features(*pe);
+		}
+		else {
+			features.push_back(argv[i]);
+		}
+
+		for (auto it = features.begin() ; it != features.end() ; ++it)
+		{
+			std::vector<std::string> samples = index.lookup(*it);
+			for (auto s = samples.begin() ; s != samples.end() ; ++s) {
+				std::cout << *it << "\t" << *s << std::endl;
+			}
+		}
+	}
+	return 0;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Implements the "query" command, which lists the samples of a results store matching
+ *			all the given conditions.
+ *
+ *	Usage: manalyze query <store> <condition>...
+ *	See mana::query_results_store for the syntax of the conditions. Matches are printed as
+ *	"<sha256><TAB><path>".
+ *
+ *	@return	The exit code of the program.
+ */
+int query_store(int argc, char** argv)
+{
+	if (argc < 4)
+	{
+		std::cerr << "Usage: " << bfs::basename(argv[0]) << " query <store> <condition>..." << std::endl;
+		std::cerr << "Conditions: import:<pattern>, section:<pattern>, permissions:<rwx>, plugin:<pattern>=<level>, "
+					 "plugin:<pattern>>=<level>. Prefix a condition with '!' to negate it." << std::endl;
+		return -1;
+	}
+
+	std::vector<mana::sample_record> results;
+	if (!mana::query_results_store(argv[2], std::vector<std::string>(argv + 3, argv + argc), results)) {
+		return -1;
 	}
+	for (auto it = results.begin() ; it != results.end() ; ++it) {
+		std::cout << it->sha256 << "\t" << it->path << std::endl;
+	}
+	return 0;
 }
 
 // ----------------------------------------------------------------------------
 
 int main(int argc, char** argv)
 {
+	if (argc > 1 && std::string(argv[1]) == "lookup") {
+		return lookup_features(argc, argv);
+	}
+	if (argc > 1 && std::string(argv[1]) == "query") {
+		return query_store(argc, argv);
+	}
+
 	po::variables_map vm;
 	std::string extraction_directory;
 	std::vector<std::string> selected_plugins, selected_categories;
@@ -537,37 +1215,278 @@ int main(int argc, char** argv)
 	if (vm.count("dump")) {
 		selected_categories = tokenize_args(vm["dump"].as<std::vector<std::string> >());
 	}
+	// The requested fields determine what is computed.
+	boost::shared_ptr<io::FieldProjection> fields;
+	if (vm.count("fields"))
+	{
+		fields.reset(new io::FieldProjection(tokenize_args(vm["fields"].as<std::vector<std::string> >())));
+		selected_categories = fields->get_categories();
+		selected_plugins = fields->get_plugins();
+	}
 
 	// Instantiate the requested OutputFormatter
 	boost::shared_ptr<io::OutputFormatter> formatter;
 	if (vm.count("output") && vm["output"].as<std::string>() == "json") {
 		formatter.reset(new io::JsonFormatter());
 	}
+	else if (vm.count("output") && vm["output"].as<std::string>() == "jsonl") {
+		formatter.reset(new io::JsonLinesFormatter());
+	}
+	else if (vm.count("output") && vm["output"].as<std::string>() == "cbor")
+	{
+		bool deduplicate_strings = !(conf.count("output") && conf["output"]["cbor_deduplicate_strings"] == "no");
+		formatter.reset(new io::CborFormatter(deduplicate_strings));
+		#ifdef BOOST_WINDOWS_API
+			_setmode(_fileno(stdout), _O_BINARY); // Prevent the CRT from translating line breaks in the records.
+		#endif
+	}
 	else // Default: use the human-readable output.
 	{
 		formatter.reset(new io::RawFormatter());
 		formatter->set_header("* Manalyze " MANALYZE_VERSION " *");
 	}
 
+	// Number of plugins which may run at the same time. 0 lets the program decide.
+	unsigned int plugin_threads = get_config_number(conf, "plugins", "threads", 0);
+	if (plugin_threads == 0) {
+		plugin_threads = std::max(1u, boost::thread::hardware_concurrency());
+	}
+
+	plugin::VerdictPolicy policy(conf.count("plugins") ? conf["plugins"] : plugin::string_map());
+
+	// Create the tables before the working directory changes, since the path may be relative.
+	boost::shared_ptr<io::TableExporter> tables;
+	if (vm.count("tables"))
+	{
+		io::TableExporter::table_format table_format = io::TableExporter::TSV;
+		if (vm.count("table-format") && vm["table-format"].as<std::string>() == "csv") {
+			table_format = io::TableExporter::CSV;
+		}
+		tables.reset(new io::TableExporter(bfs::absolute(vm["tables"].as<std::string>()).string(), table_format));
+		if (!tables->is_open()) {
+			return -1;
+		}
+	}
+
+	// Same for the feature index.
+	boost::shared_ptr<mana::FeatureIndex> feature_index;
+	if (vm.count("feature-index"))
+	{
+		feature_index.reset(new mana::FeatureIndex(bfs::absolute(vm["feature-index"].as<std::string>()).string()));
+		if (!feature_index->is_open()) {
+			return -1;
+		}
+	}
+
+	// And for the results store.
+	boost::shared_ptr<mana::ResultsStore> store;
+	if (vm.count("store"))
+	{
+		store.reset(new mana::ResultsStore(bfs::absolute(vm["store"].as<std::string>()).string()));
+		if (!store->is_open()) {
+			return -1;
+		}
+	}
+
+	// Open the output file before the working directory changes too.
+	// JSON Lines are appended to the file one at a time, so that parallel or resumed runs can
+	// share it. Compressed or rotated outputs are written by the OutputSink instead.
+	boost::shared_ptr<io::OutputSink> output_file;
+	boost::shared_ptr<io::AppendFile> append_file;
+	bool compressed = vm.count("compression") && vm["compression"].as<std::string>() != "none";
+	bool rotated = vm.count("rotate-samples") || vm.count("rotate-bytes");
+	if (vm.count("output-file") && vm.count("output") && vm["output"].as<std::string>() == "jsonl" && !compressed && !rotated)
+	{
+		append_file.reset(new io::AppendFile(bfs::absolute(vm["output-file"].as<std::string>()).string()));
+		if (!append_file->is_open()) {
+			return -1;
+		}
+	}
+	else if (vm.count("output-file"))
+	{
+		io::OutputSink::compression_type compression = io::OutputSink::NONE;
+		if (vm.count("compression") && vm["compression"].as<std::string>() == "gzip") {
+			compression = io::OutputSink::GZIP;
+		}
+		else if (vm.count("compression") && vm["compression"].as<std::string>() == "zstd") {
+			compression = io::OutputSink::ZSTD;
+		}
+		output_file.reset(new io::OutputSink(bfs::absolute(vm["output-file"].as<std::string>()).string(),
+											 compression,
+											 vm.count("rotate-samples") ? vm["rotate-samples"].as<unsigned int>() : 0,
+											 vm.count("rotate-bytes") ? vm["rotate-bytes"].as<boost::uint64_t>() : 0));
+		if (!output_file->is_open()) {
+			return -1;
+		}
+	}
+	std::ostream& out = output_file ? output_file->get_stream() : (append_file ? append_file->get_stream() : std::cout);
+
 	// Set the working directory to Manalyze's folder.
 	chdir(working_dir.string().c_str());
 
+	// The files analyzed are added to the similarity index if one is configured. A relative path
+	// is located in Manalyze's folder.
+	boost::shared_ptr<mana::SimilarityIndex> similarity;
+	std::string index_file = conf.count("similarity") ? conf["similarity"]["index_file"] : "";
+	if (index_file.empty() && vm.count("similar")) {
+		index_file = "similarity_index.txt";
+	}
+	if (!index_file.empty())
+	{
+		similarity.reset(new mana::SimilarityIndex(index_file));
+		if (!similarity->is_open())
+		{
+			PRINT_WARNING << "Continuing the analysis without the similarity index." << std::endl;
+			similarity.reset();
+		}
+	}
+
+	// Files whose hash is in this set are skipped. It is only loaded once a file is checked.
+	boost::shared_ptr<mana::KnownGoodSet> known_good;
+	if (conf.count("known_good") && !conf["known_good"]["hash_set"].empty()) {
+		known_good.reset(new mana::KnownGoodSet(conf["known_good"]["hash_set"]));
+	}
+
+	// Resolve the plugin selection and prepare the plugins once for all the files. Only the
+	// selected plugins are loaded. This happens after the working directory changed, since
+	// they may load resources from Manalyze's folder.
+	plugin::PluginManager& pm = plugin::PluginManager::get_instance();
+	if (!selected_plugins.empty())
+	{
+		pm.start_run(selected_plugins, conf);
+		pm.start_thread(); // The plugins working on batches run on the main thread.
+	}
+
+	// Only the parts of the files needed by the analysis are parsed.
+	unsigned int components = plan_parsing(vm, selected_categories, pm.get_dispatch_list(), fields);
+
+	// Files are kept until the plugins which work on batches have seen enough of them, or until
+	// the first one has waited long enough. Without such plugins, they are written immediately.
+	unsigned int batch_size = 1;
+	const std::vector<std::pair<plugin::pIPlugin, unsigned int> >& scheduled = pm.get_dispatch_list();
+	if (std::any_of(scheduled.begin(), scheduled.end(),
+		[](const std::pair<plugin::pIPlugin, unsigned int>& p) { return plugin::supports_batch(p.first); })) {
+		batch_size = std::max(1u, get_config_number(conf, "plugins", "batch_size", 16));
+	}
+	std::chrono::seconds batch_timeout(get_config_number(conf, "plugins", "batch_timeout", 30));
+
+	// Statistics are computed on the worker threads, each of them filling its own partial statistics.
+	boost::scoped_ptr<mana::StatisticsAggregator> stats;
+	if (vm.count("stats")) {
+		stats.reset(new mana::StatisticsAggregator(get_config_number(conf, "stats", "top_keys", 50)));
+	}
+
+	boost::scoped_ptr<plugin::WorkerPool> pool(new plugin::WorkerPool(selected_plugins.empty() && !stats ? 1 : plugin_threads,
+		[&pm]() { pm.start_thread(); },
+		[&pm]() { pm.end_thread(); }));
+
 	// Do the actual analysis on all the input files
-	unsigned int count = 0;
+	std::vector<pPendingSample> pending;
+	std::vector<pPendingSample> stats_queue; // Files waiting to be added to the statistics.
+	std::chrono::steady_clock::time_point batch_start;
+	unsigned int unwritten = 0; // Files analyzed since the output was last written.
 	for (auto it = targets.begin() ; it != targets.end() ; ++it)
 	{
-		perform_analysis(*it, vm, extraction_directory, selected_categories, selected_plugins, conf, formatter);
-		if (++count % 1000 == 0) {
-			formatter->format(std::cout, false); // Flush the formatter from time to time, to avoid eating up all the RAM when analyzing gigs of files.
+		pPendingSample sample = perform_analysis(*it, vm, extraction_directory, selected_categories, selected_plugins,
+												 formatter, tables, similarity, feature_index, known_good, fields,
+												 *pool, policy, components);
+		++unwritten;
+		if (sample)
+		{
+			if (pending.empty()) {
+				batch_start = std::chrono::steady_clock::now();
+			}
+			prepare_batch_plugins(*sample, selected_plugins, policy);
+			pending.push_back(sample);
+		}
+		if (!pending.empty() && pending.size() < batch_size && std::next(it) != targets.end() &&
+			(batch_timeout.count() == 0 || std::chrono::steady_clock::now() - batch_start < batch_timeout)) {
+			continue;
+		}
+
+		run_batch_plugins(*formatter, pending, selected_plugins, policy);
+
+		// All the plugins have now analyzed the files.
+		if (store)
+		{
+			for (auto p = pending.begin() ; p != pending.end() ; ++p) {
+				store_results(**p, *store);
+			}
+		}
+
+		// Files are added to the statistics once there is one for each thread.
+		if (stats)
+		{
+			stats_queue.insert(stats_queue.end(), pending.begin(), pending.end());
+			if (stats_queue.size() >= pool->get_size() || std::next(it) == targets.end())
+			{
+				std::vector<plugin::WorkerPool::task> tasks;
+				for (auto s = stats_queue.begin() ; s != stats_queue.end() ; ++s)
+				{
+					pPendingSample sample = *s;
+					tasks.push_back([&stats, sample]() { stats->get_partial().add(*sample->pe, *sample->context); });
+				}
+				pool->run(tasks);
+				stats_queue.clear();
+			}
+		}
+
+		// Drop the information which was computed as a by-product of the requested fields.
+		if (fields)
+		{
+			for (auto p = pending.begin() ; p != pending.end() ; ++p) {
+				fields->apply(formatter->get_file_node(*(*p)->pe->get_path()));
+			}
+		}
+		pending.clear();
+
+		// Serialize the results as soon as the batch has been analyzed: only one batch of files
+		// is kept in memory at any given time, regardless of the number of input files.
+		formatter->format(out, false);
+
+		// Complete the current output file if it is full (unless this was the last one anyway).
+		// A batch is never split, so the file may contain a few more samples than requested.
+		bool full = false;
+		for ( ; unwritten > 0 ; --unwritten)
+		{
+			if (output_file && output_file->end_sample()) {
+				full = true;
+			}
+		}
+		if (full && std::next(it) != targets.end())
+		{
+			formatter->format(out);
+			output_file->rotate();
+		}
+	}
+
+	// The partial statistics of the threads are merged into a final record.
+	if (stats)
+	{
+		std::vector<io::pNode> nodes = stats->merge().to_nodes();
+		for (auto it = nodes.begin() ; it != nodes.end() ; ++it) {
+			formatter->add_data(*it, "Corpus statistics");
 		}
 	}
 
-	formatter->format(std::cout);
+	formatter->format(out);
+	if (output_file) {
+		output_file->close();
+	}
+	if (feature_index) {
+		feature_index->flush();
+	}
+	if (store) {
+		store->flush();
+	}
 
-	if (vm.count("plugins"))
+	pool.reset(); // Stops the threads, which call the on_thread_end hooks.
+	if (!selected_plugins.empty())
 	{
+		pm.end_thread();
+		pm.end_run();
 		// Explicitly unload the plugins
-		plugin::PluginManager::get_instance().unload_all();
+		pm.unload_all();
 	}
 
 	return 0;
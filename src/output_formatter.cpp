@@ -21,32 +21,14 @@ namespace io {
 
 // ----------------------------------------------------------------------------
 
-/**
- * @brief	Repeats a string multiple times.
- *
- * @param	const std::string& s The string to repeat.
- * @param	int i The number of times to repeat the string.
- *
- * @returns	A string containing i times the string s.
- */
-std::string repeat(const std::string& s, int i)
-{
-	std::stringstream ss;
-	for (int j = 0 ; j < i ; ++j) {
-		ss << s;
-	}
-	return ss.str();
-}
-
 // ----------------------------------------------------------------------------
 
 void RawFormatter::format(std::ostream& sink, bool end_stream)
 {
-	static bool print_header = true;
-	if (_header != "" && print_header)
+	if (_header != "" && !_header_printed)
 	{
 		sink << _header << std::endl << std::endl;
-		print_header = false;
+		_header_printed = true;
 	}
 
 	pNodes n = _root->get_children();
@@ -55,7 +37,10 @@ void RawFormatter::format(std::ostream& sink, bool end_stream)
 	{
 		_dump_node(sink, *it, determine_max_width(*it));
 	}
-	_root->clear(); // Free all the nodes that were already printed. Keeps the RAM in check for recursive analyses.
+	if (end_stream) { // Print the header again if another document is started.
+		_header_printed = false;
+	}
+	_clear_data();
 }
 
 // ----------------------------------------------------------------------------
@@ -125,11 +110,13 @@ void RawFormatter::_dump_node(std::ostream& sink, pNode node, int max_width, int
 		default:
 			// TODO: Respect the HIDE_NAME modifier
 			if (max_width > 0) {
-				sink << ": " << std::string(max_width - node->get_name()->length(), ' ') << *node->to_string() << std::endl;
+				sink << ": " << std::string(max_width - node->get_name()->length(), ' ');
 			}
 			else {
-				sink << ": " << *node->to_string() << std::endl;
+				sink << ": ";
 			}
+			node->write_value(sink);
+			sink << std::endl;
 			break;
 	}
 }
@@ -270,35 +257,48 @@ void RawFormatter::_dump_strings_node(std::ostream& sink, pNode node, int max_wi
 
 void JsonFormatter::format(std::ostream& sink, bool end_stream)
 {
-	static bool print_header = true;
-	if (print_header)
+	if (!_header_printed)
 	{
 		sink << "{" << std::endl;
-		print_header = false;
+		_header_printed = true;
 	}
 
 	pNodes n = _root->get_children();
 	for (nodes::const_iterator it = n->begin() ; it != n->end() ; ++it) // File level
 	{
+		// The separator is written before each file entry, as the previous one may
+		// have been flushed during an earlier call.
+		if (_files_written++ > 0) {
+			sink << "," << std::endl;
+		}
 		_dump_node(sink, *it);
 	}
 
-	if (end_stream) {
+	if (end_stream)
+	{
+		if (_files_written > 0) {
+			sink << std::endl;
+		}
 		sink << "}" << std::endl;
+
+		// Subsequent calls will start a new document.
+		_header_printed = false;
+		_files_written = 0;
 	}
-	_root->clear(); // Free all the nodes that were already printed. Keeps the RAM in check for recursive analyses.
+	sink.flush();
+	_clear_data();
 }
 
 // ----------------------------------------------------------------------------
 
-void JsonFormatter::_dump_node(std::ostream& sink, pNode node, int level, bool append_comma, bool print_name)
+void JsonFormatter::_dump_node(std::ostream& sink, pNode node, int level, bool print_name)
 {
 	if (node->get_modifier() == OutputTreeNode::HEX) { // Hexadecimal notation is not compatible with this formatter
 		node->set_modifier(OutputTreeNode::NONE);	   // ({ "my_int": 0xABC } isn't valid JSON).
 	}
 
 	std::string data;
-	auto node_name = io::escape<JsonFormatter>(*node->get_name());
+	auto node_name = io::escape<JsonFormatter>(node->get_name());
 	if (node_name == nullptr) {
 		return;
 	}
@@ -308,110 +308,275 @@ void JsonFormatter::_dump_node(std::ostream& sink, pNode node, int level, bool a
 		case OutputTreeNode::STRINGS:
 		{ // Separate scope because variable 'strs' is declared in here.
 			if (print_name) {
-				sink << repeat("    ", level) << "\"" << *node_name << "\": [" << std::endl;
+				sink << _indent(level) << "\"" << *node_name << "\": [";
 			}
 			else {
-				sink << repeat("    ", level) << "[" << std::endl;
+				sink << _indent(level) << "[";
 			}
+			_end_line(sink);
 			shared_strings strs = node->get_strings();
 			for (auto it = strs->begin() ; it != strs->end() ; ++it)
 			{
 				std::string str = *it;
 				boost::trim(str); // Delete unnecessary whitespace
-				pString escaped = io::escape<JsonFormatter>(str);
-				if (escaped != nullptr) {
-					sink << repeat("    ", level + 1) << "\"" << *escaped << "\"";
-				}
-				else {
-					sink << repeat("    ", level + 1) << "\"" << str << "\"";
+				if (io::needs_escaping<JsonFormatter>(str))
+				{
+					pString escaped = io::escape<JsonFormatter>(str);
+					if (escaped != nullptr) {
+						str = *escaped;
+					}
 				}
+				sink << _indent(level + 1) << "\"" << str << "\"";
 				if (it != strs->end() - 1) {
 					sink << ",";
 				}
-				sink << std::endl;
+				_end_line(sink);
 			}
-			sink << repeat("    ", level) << "]";
+			sink << _indent(level) << "]";
 			break;
 		}
 		case OutputTreeNode::LIST:
 		{ // Separate scope because variable 'children' is declared in here.
 
 			if (print_name) {
-				sink << repeat("    ", level) << "\"" << *node_name << "\": {" << std::endl;
+				sink << _indent(level) << "\"" << *node_name << "\": {";
 			}
 			else {
-				sink << repeat("    ", level) << "{" << std::endl;
+				sink << _indent(level) << "{";
 			}
+			_end_line(sink);
 			pNodes children = node->get_children();
-			for (nodes::const_iterator it = children->begin() ; it != children->end() ; ++it)	{
-				_dump_node(sink, *it, level + 1, it != children->end() - 1); // Append a comma for all elements but the last.
+			for (nodes::const_iterator it = children->begin() ; it != children->end() ; ++it)
+			{
+				_dump_node(sink, *it, level + 1);
+				if (it != children->end() - 1) { // Append a comma for all elements but the last.
+					sink << ",";
+				}
+				_end_line(sink);
 			}
-			sink << repeat("    ", level) << "}";
+			sink << _indent(level) << "}";
 			break;
 		}
 		case OutputTreeNode::STRING:
 		{
 			data = *node->to_string();
 			boost::trim(data); // Delete unnecessary whitespace
-			pString escaped = io::escape<JsonFormatter>(data);
-			if (escaped != nullptr) {
-				data = *escaped;
-			}
-			else {
-				data = "";
+			if (io::needs_escaping<JsonFormatter>(data))
+			{
+				pString escaped = io::escape<JsonFormatter>(data);
+				if (escaped != nullptr) {
+					data = *escaped;
+				}
+				else {
+					data = "";
+				}
 			}
 			if (print_name) {
-				sink << repeat("    ", level) << "\"" << *node_name << "\": \"" << data << "\"";
+				sink << _indent(level) << "\"" << *node_name << "\": \"" << data << "\"";
 			}
 			else {
-				sink << repeat("    ", level) << "\"" << data << "\"";
+				sink << _indent(level) << "\"" << data << "\"";
 			}
 			break;
 		}
 		default:
 		{
-			pString escaped = io::escape<JsonFormatter>(*node->to_string());
-			if (escaped != nullptr) {
-				data = *escaped;
-			}
-			else {
-				data = "";
-			}
-			boost::trim(data); // Delete unnecessary whitespace
+			// Numbers and threat levels: their representation never needs to be escaped or trimmed.
 			if (print_name) {
-				sink << repeat("    ", level) << "\"" << *node_name << "\": " << data;
+				sink << _indent(level) << "\"" << *node_name << "\": ";
 			}
 			else {
-				sink << repeat("    ", level) << data;
+				sink << _indent(level);
 			}
+			node->write_value(sink);
 		}
 	}
+}
+
+// ----------------------------------------------------------------------------
+
+const std::string& JsonFormatter::_indent(int level) const
+{
+	static const std::string no_indentation;
+	if (!_pretty_print || level <= 0) {
+		return no_indentation;
+	}
+	// std::deque never moves its elements, so references returned earlier stay valid.
+	while (_indentation.size() <= static_cast<unsigned int>(level)) {
+		_indentation.push_back(std::string(_indentation.size() * 4, ' '));
+	}
+	return _indentation[level];
+}
+
+// ----------------------------------------------------------------------------
+
+void JsonFormatter::_end_line(std::ostream& sink) const
+{
+	if (_pretty_print) {
+		sink << '\n'; // No std::endl: the sink is flushed once per call to format().
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void JsonLinesFormatter::format(std::ostream& sink, bool /* end_stream */)
+{
+	// Every line is a complete document: there is nothing to close at the end of the stream.
+	pNodes n = _root->get_children();
+	for (nodes::const_iterator it = n->begin() ; it != n->end() ; ++it) // File level
+	{
+		// Build the whole line before writing it, so that the stream receives it in a single call.
+		// See the class documentation for the cases in which it reaches the file in a single write.
+		std::stringstream line;
+		line << "{";
+		_dump_node(line, *it, 0);
+		line << "}" << '\n';
+
+		std::string s = line.str();
+		sink.write(s.c_str(), s.length());
+		sink.flush();
+	}
+	_clear_data();
+}
+
+// ----------------------------------------------------------------------------
 
-	if (append_comma) {
-		sink << ",";
+void CborFormatter::format(std::ostream& sink, bool end_stream)
+{
+	pNodes n = _root->get_children();
+	for (nodes::const_iterator it = n->begin() ; it != n->end() ; ++it) // File level
+	{
+		cbor::Writer writer(_deduplicate_strings);
+		writer.write_map_header(1);
+		writer.write_string(*(*it)->get_name());
+		_dump_node(writer, *it);
+		cbor::write_record(sink, writer.get_buffer());
+	}
+	sink.flush();
+	_clear_data();
+}
+
+// ----------------------------------------------------------------------------
+
+void CborFormatter::_dump_node(cbor::Writer& writer, pNode node)
+{
+	switch (node->get_type())
+	{
+		case OutputTreeNode::LIST:
+		{
+			pNodes children = node->get_children();
+			writer.write_map_header(children->size());
+			for (nodes::const_iterator it = children->begin() ; it != children->end() ; ++it)
+			{
+				writer.write_string(*(*it)->get_name());
+				_dump_node(writer, *it);
+			}
+			break;
+		}
+		case OutputTreeNode::STRINGS:
+		{
+			shared_strings strs = node->get_strings();
+			writer.write_array_header(strs->size());
+			for (auto it = strs->begin() ; it != strs->end() ; ++it) {
+				writer.write_string(*it);
+			}
+			break;
+		}
+		case OutputTreeNode::STRING:
+			writer.write_string(*node->to_string());
+			break;
+		case OutputTreeNode::UINT16:
+		case OutputTreeNode::UINT32:
+		case OutputTreeNode::UINT64:
+			writer.write_uint(node->get_integer());
+			break;
+		case OutputTreeNode::FLOAT:
+			writer.write_float(static_cast<float>(node->get_floating_point()));
+			break;
+		case OutputTreeNode::DOUBLE:
+			writer.write_double(node->get_floating_point());
+			break;
+		case OutputTreeNode::THREAT_LEVEL:
+			writer.write_uint(node->get_level());
+			break;
 	}
-	sink << std::endl;
 }
 
 // ----------------------------------------------------------------------------
 
 std::string uint64_to_version_number(boost::uint32_t msbytes, boost::uint32_t lsbytes)
 {
-	std::stringstream ss;
-	ss << ((msbytes >> 16) & 0xFFFF) << "." << (msbytes & 0xFFFF) << ".";
-	ss << ((lsbytes >> 16) & 0xFFFF) << "." << (lsbytes & 0xFFFF);
-	return ss.str();
+	boost::uint32_t parts[] = { (msbytes >> 16) & 0xFFFF, msbytes & 0xFFFF, (lsbytes >> 16) & 0xFFFF, lsbytes & 0xFFFF };
+	char buffer[4 * 6];
+	size_t length = 0;
+	for (int i = 0 ; i < 4 ; ++i)
+	{
+		if (i > 0) {
+			buffer[length++] = '.';
+		}
+		length += format_decimal(parts[i], buffer + length);
+	}
+	return std::string(buffer, length);
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Writes a number on two digits.
+ */
+inline void write_two_digits(unsigned int value, char* buffer)
+{
+	buffer[0] = static_cast<char>('0' + value / 10);
+	buffer[1] = static_cast<char>('0' + value % 10);
 }
 
 // ----------------------------------------------------------------------------
 
 std::string timestamp_to_string(boost::uint64_t epoch_timestamp)
 {
-	static std::locale loc(std::cout.getloc(), new boost::posix_time::time_facet("%Y-%b-%d %H:%M:%S%F %z"));
-	std::stringstream ss;
-	ss.imbue(loc);
-	ss << boost::posix_time::from_time_t(epoch_timestamp);
-	return ss.str();
+	// Timestamps after 9999-Dec-31 23:59:59 are rejected by boost::posix_time, and negative ones
+	// (once cast to time_t) give odd results. Let it handle them so that the behavior stays the same.
+	if (epoch_timestamp > 253402300799ULL)
+	{
+		static std::locale loc(std::cout.getloc(), new boost::posix_time::time_facet("%Y-%b-%d %H:%M:%S%F %z"));
+		std::stringstream ss;
+		ss.imbue(loc);
+		ss << boost::posix_time::from_time_t(epoch_timestamp);
+		return ss.str();
+	}
+
+	static const char* months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+									"Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+	// Conversion from a number of days to a date of the proleptic Gregorian calendar, with years
+	// starting in March so that leap days fall at their end.
+	// See http://howardhinnant.github.io/date_algorithms.html#civil_from_days.
+	boost::uint64_t days = epoch_timestamp / 86400 + 719468; // Days since 0000-Mar-01
+	unsigned int seconds = static_cast<unsigned int>(epoch_timestamp % 86400);
+	unsigned int era = static_cast<unsigned int>(days / 146097);
+	unsigned int day_of_era = static_cast<unsigned int>(days - era * 146097ULL);
+	unsigned int year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+	unsigned int day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+	unsigned int shifted_month = (5 * day_of_year + 2) / 153; // 0 = March
+	unsigned int day = day_of_year - (153 * shifted_month + 2) / 5 + 1;
+	unsigned int month = shifted_month < 10 ? shifted_month + 2 : shifted_month - 10; // 0 = January
+	unsigned int year = year_of_era + era * 400 + (month < 2 ? 1 : 0);
+
+	// YYYY-Mmm-DD HH:MM:SS
+	char buffer[20];
+	write_two_digits(year / 100, buffer);
+	write_two_digits(year % 100, buffer + 2);
+	buffer[4] = '-';
+	memcpy(buffer + 5, months[month], 3);
+	buffer[8] = '-';
+	write_two_digits(day, buffer + 9);
+	buffer[11] = ' ';
+	write_two_digits(seconds / 3600, buffer + 12);
+	buffer[14] = ':';
+	write_two_digits(seconds / 60 % 60, buffer + 15);
+	buffer[17] = ':';
+	write_two_digits(seconds % 60, buffer + 18);
+	return std::string(buffer, sizeof(buffer));
 }
 
 } // !namespace io
@@ -0,0 +1,564 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "output_sink.h"
+
+#include <cstdio>
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <utility>
+
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/device/file.hpp>
+
+#include <boost/system/api_config.hpp>
+
+#ifdef BOOST_WINDOWS_API
+	#include <io.h>
+	#include <sys/stat.h>
+#else
+	#include <unistd.h>
+#endif
+#include <fcntl.h>
+
+#ifdef WITH_ZSTD
+	#include <zstd.h>
+#endif
+
+namespace io
+{
+
+// Size of the blocks handed over to the writer thread.
+const size_t BLOCK_SIZE = 1024 * 1024;
+// Maximum number of blocks waiting to be written before the analysis is paused.
+const size_t MAX_QUEUED_BLOCKS = 16;
+
+// ----------------------------------------------------------------------------
+// Writers for the different kinds of output files
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Writes a single output file. Instances are only used by the writer thread.
+ */
+class ChunkWriter
+{
+public:
+	virtual ~ChunkWriter() {}
+
+	virtual bool is_open() const = 0;
+
+	/**
+	 *	@brief	Writes (and possibly compresses) data into the file.
+	 *
+	 *	@return	Whether the operation succeeded.
+	 */
+	virtual bool write(const char* data, size_t size) = 0;
+
+	/**
+	 *	@brief	Writes any pending data and closes the file.
+	 *
+	 *	@return	Whether the operation succeeded.
+	 */
+	virtual bool finish() = 0;
+};
+
+// ----------------------------------------------------------------------------
+
+class PlainChunkWriter : public ChunkWriter
+{
+public:
+	PlainChunkWriter(const std::string& path) : _file(path.c_str(), std::ios::out | std::ios::trunc | std::ios::binary) {}
+
+	virtual bool is_open() const {
+		return _file.is_open();
+	}
+
+	virtual bool write(const char* data, size_t size) {
+		return _file.write(data, size).good();
+	}
+
+	virtual bool finish()
+	{
+		_file.close();
+		return !_file.fail();
+	}
+
+private:
+	std::ofstream _file;
+};
+
+// ----------------------------------------------------------------------------
+
+class GzipChunkWriter : public ChunkWriter
+{
+public:
+	GzipChunkWriter(const std::string& path)
+	{
+		boost::iostreams::file_sink file(path, std::ios::out | std::ios::trunc | std::ios::binary);
+		if (!file.is_open()) {
+			return;
+		}
+		_stream.push(boost::iostreams::gzip_compressor());
+		_stream.push(file);
+	}
+
+	virtual bool is_open() const {
+		return !_stream.empty();
+	}
+
+	virtual bool write(const char* data, size_t size) {
+		return _stream.write(data, size).good();
+	}
+
+	virtual bool finish()
+	{
+		try
+		{
+			// Popping the device writes the gzip footer and closes the file.
+			_stream.flush();
+			bool success = _stream.good();
+			_stream.reset();
+			return success;
+		}
+		catch (const std::exception& e)
+		{
+			PRINT_ERROR << "Could not complete the compressed output (" << e.what() << ")." << std::endl;
+			return false;
+		}
+	}
+
+private:
+	boost::iostreams::filtering_ostream _stream;
+};
+
+// ----------------------------------------------------------------------------
+
+#ifdef WITH_ZSTD
+class ZstdChunkWriter : public ChunkWriter
+{
+public:
+	ZstdChunkWriter(const std::string& path)
+		: _file(fopen(path.c_str(), "wb")), _context(ZSTD_createCCtx()), _output(ZSTD_CStreamOutSize())
+	{}
+
+	virtual ~ZstdChunkWriter()
+	{
+		if (_file != nullptr) {
+			fclose(_file);
+		}
+		ZSTD_freeCCtx(_context);
+	}
+
+	virtual bool is_open() const {
+		return _file != nullptr && _context != nullptr;
+	}
+
+	virtual bool write(const char* data, size_t size) {
+		return _compress(data, size, ZSTD_e_continue);
+	}
+
+	virtual bool finish()
+	{
+		bool success = _compress(nullptr, 0, ZSTD_e_end);
+		success &= fclose(_file) == 0;
+		_file = nullptr;
+		return success;
+	}
+
+private:
+	/**
+	 *	@brief	Feeds data to the compressor and writes everything it produces into the file.
+	 */
+	bool _compress(const char* data, size_t size, ZSTD_EndDirective mode)
+	{
+		ZSTD_inBuffer input = { data, size, 0 };
+		size_t remaining;
+		do
+		{
+			ZSTD_outBuffer output = { &_output[0], _output.size(), 0 };
+			remaining = ZSTD_compressStream2(_context, &output, &input, mode);
+			if (ZSTD_isError(remaining))
+			{
+				PRINT_ERROR << "zstd compression failed (" << ZSTD_getErrorName(remaining) << ")." << std::endl;
+				return false;
+			}
+			if (fwrite(&_output[0], 1, output.pos, _file) != output.pos) {
+				return false;
+			}
+		} while (mode == ZSTD_e_end ? remaining != 0 : input.pos < input.size);
+		return true;
+	}
+
+	FILE*				_file;
+	ZSTD_CCtx*			_context;
+	std::vector<char>	_output;
+};
+#endif
+
+// ----------------------------------------------------------------------------
+// OutputSink implementation
+// ----------------------------------------------------------------------------
+
+OutputSink::OutputSink(const std::string& path,
+					   compression_type compression,
+					   unsigned int rotate_samples,
+					   boost::uint64_t rotate_bytes)
+	: _path(path),
+	  _compression(compression),
+	  _rotate_samples(rotate_samples),
+	  _rotate_bytes(rotate_bytes),
+	  _samples(0),
+	  _buffer(*this),
+	  _stream(&_buffer),
+	  _chunk_index(0),
+	  _open(false),
+	  _closed(true)
+{
+	if (!is_supported(compression))
+	{
+		PRINT_ERROR << "The requested compression is not supported by this build." << std::endl;
+		return;
+	}
+
+	// The first file is created synchronously, so that errors are reported immediately.
+	_chunk = _open_chunk(_chunk_index);
+	if (!_chunk) {
+		return;
+	}
+	_open = true;
+	_closed = false;
+	_writer = boost::thread(&OutputSink::_writer_loop, this);
+}
+
+// ----------------------------------------------------------------------------
+
+OutputSink::~OutputSink() {
+	close();
+}
+
+// ----------------------------------------------------------------------------
+
+bool OutputSink::is_open() const {
+	return _open;
+}
+
+// ----------------------------------------------------------------------------
+
+bool OutputSink::end_sample()
+{
+	++_samples;
+	return (_rotate_samples != 0 && _samples >= _rotate_samples) ||
+		   (_rotate_bytes != 0 && _buffer.get_count() >= _rotate_bytes);
+}
+
+// ----------------------------------------------------------------------------
+
+void OutputSink::rotate()
+{
+	_buffer.submit();
+	_post(Message(Message::ROTATE));
+	_samples = 0;
+	_buffer.reset_count();
+}
+
+// ----------------------------------------------------------------------------
+
+void OutputSink::close()
+{
+	if (_closed) {
+		return;
+	}
+	_buffer.submit();
+	_post(Message(Message::STOP));
+	_writer.join();
+	_closed = true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool OutputSink::is_supported(compression_type compression)
+{
+	#ifdef WITH_ZSTD
+		return true;
+	#else
+		return compression != ZSTD;
+	#endif
+}
+
+// ----------------------------------------------------------------------------
+
+void OutputSink::_post(Message&& m)
+{
+	if (_closed) {
+		return;
+	}
+	boost::unique_lock<boost::mutex> lock(_queue_mutex);
+	while (_queue.size() >= MAX_QUEUED_BLOCKS) {
+		_queue_not_full.wait(lock);
+	}
+	_queue.push_back(std::move(m));
+	_queue_not_empty.notify_one();
+}
+
+// ----------------------------------------------------------------------------
+
+void OutputSink::_writer_loop()
+{
+	while (true)
+	{
+		Message m;
+		{
+			boost::unique_lock<boost::mutex> lock(_queue_mutex);
+			while (_queue.empty()) {
+				_queue_not_empty.wait(lock);
+			}
+			std::swap(m, _queue.front());
+			_queue.pop_front();
+			_queue_not_full.notify_one();
+		}
+
+		switch (m.type)
+		{
+		case Message::DATA:
+			if (_chunk && !_chunk->write(&m.data[0], m.data.size()))
+			{
+				PRINT_ERROR << "Could not write into " << _get_chunk_path(_chunk_index).string()
+					<< ". The rest of the output will be lost!" << std::endl;
+				_chunk.reset();
+			}
+			break;
+		case Message::ROTATE:
+			_finish_chunk();
+			_chunk = _open_chunk(++_chunk_index);
+			break;
+		case Message::STOP:
+			_finish_chunk();
+			return;
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+boost::shared_ptr<ChunkWriter> OutputSink::_open_chunk(unsigned int index)
+{
+	std::string path = _get_chunk_path(index).string() + ".part";
+	boost::shared_ptr<ChunkWriter> res;
+	switch (_compression)
+	{
+	case GZIP:
+		res.reset(new GzipChunkWriter(path));
+		break;
+	#ifdef WITH_ZSTD
+		case ZSTD:
+			res.reset(new ZstdChunkWriter(path));
+			break;
+	#endif
+	default:
+		res.reset(new PlainChunkWriter(path));
+	}
+
+	if (!res->is_open())
+	{
+		PRINT_ERROR << "Could not open " << path << "!" << std::endl;
+		res.reset();
+	}
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+void OutputSink::_finish_chunk()
+{
+	if (!_chunk) {
+		return;
+	}
+	bfs::path target = _get_chunk_path(_chunk_index);
+	bool success = _chunk->finish();
+	_chunk.reset();
+	if (!success)
+	{
+		PRINT_ERROR << "Could not complete " << target.string() << ".part!" << std::endl;
+		return;
+	}
+
+	boost::system::error_code ec;
+	bfs::rename(target.string() + ".part", target, ec);
+	if (ec) {
+		PRINT_ERROR << "Could not rename " << target.string() << ".part (" << ec.message() << ")." << std::endl;
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+bfs::path OutputSink::_get_chunk_path(unsigned int index) const
+{
+	if (_rotate_samples == 0 && _rotate_bytes == 0) {
+		return _path;
+	}
+
+	// Insert the index before the extension(s): results.json.gz => results.000042.json.gz
+	std::string filename = _path.filename().string();
+	size_t dot = filename.find('.', 1);
+	std::stringstream ss;
+	ss << filename.substr(0, dot) << "." << std::setw(6) << std::setfill('0') << index;
+	if (dot != std::string::npos) {
+		ss << filename.substr(dot);
+	}
+	return _path.parent_path() / ss.str();
+}
+
+// ----------------------------------------------------------------------------
+// OutputSink::Buffer implementation
+// ----------------------------------------------------------------------------
+
+OutputSink::Buffer::Buffer(OutputSink& owner)
+	: _owner(owner), _data(BLOCK_SIZE), _total(0), _count_start(0)
+{
+	setp(&_data[0], &_data[0] + _data.size());
+}
+
+// ----------------------------------------------------------------------------
+
+OutputSink::Buffer::int_type OutputSink::Buffer::overflow(int_type c)
+{
+	submit();
+	if (!traits_type::eq_int_type(c, traits_type::eof()))
+	{
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+	}
+	return traits_type::not_eof(c);
+}
+
+// ----------------------------------------------------------------------------
+
+int OutputSink::Buffer::sync()
+{
+	// Formatters flush the stream after every line (std::endl): submitting a block each time
+	// would defeat the buffering. The data is submitted once a block is full, or by the OutputSink.
+	return 0;
+}
+
+// ----------------------------------------------------------------------------
+
+void OutputSink::Buffer::submit()
+{
+	if (pptr() == pbase()) {
+		return;
+	}
+
+	// The block itself is handed over to the writer thread, and a new one receives the next writes.
+	Message m(Message::DATA);
+	m.data.swap(_data);
+	m.data.resize(pptr() - pbase());
+	_total += m.data.size();
+	_owner._post(std::move(m));
+	_data.resize(BLOCK_SIZE);
+	setp(&_data[0], &_data[0] + _data.size());
+}
+
+// ----------------------------------------------------------------------------
+// AppendFile implementation
+// ----------------------------------------------------------------------------
+
+namespace {
+
+/**
+ *	@brief	Opens a file in append mode, and creates it if needed.
+ *
+ *	@return	The file descriptor, or -1 if the file could not be opened.
+ */
+int open_append(const std::string& path)
+{
+	#ifdef BOOST_WINDOWS_API
+		return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+	#else
+		return ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+	#endif
+}
+
+} // !namespace
+
+// ----------------------------------------------------------------------------
+
+AppendFile::AppendFile(const std::string& path)
+	: _fd(open_append(path)),
+	  _buffer(_fd),
+	  _stream(&_buffer)
+{
+	if (_fd == -1)
+	{
+		PRINT_ERROR << "Could not open " << path << "!" << std::endl;
+		_stream.setstate(std::ios::badbit);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+AppendFile::~AppendFile()
+{
+	if (_fd == -1) {
+		return;
+	}
+	#ifdef BOOST_WINDOWS_API
+		_close(_fd);
+	#else
+		::close(_fd);
+	#endif
+}
+
+// ----------------------------------------------------------------------------
+
+std::streamsize AppendFile::Buffer::xsputn(const char* s, std::streamsize n)
+{
+	std::streamsize written = 0;
+	while (written < n)
+	{
+		// The data is written in one call: it is only split if the disk is full or a signal
+		// interrupts the write.
+		#ifdef BOOST_WINDOWS_API
+			int res = _write(_fd, s + written, static_cast<unsigned int>(n - written));
+		#else
+			ssize_t res = ::write(_fd, s + written, static_cast<size_t>(n - written));
+		#endif
+		if (res < 0 && errno == EINTR) {
+			continue;
+		}
+		if (res <= 0) {
+			break;
+		}
+		written += res;
+	}
+	return written;
+}
+
+// ----------------------------------------------------------------------------
+
+AppendFile::Buffer::int_type AppendFile::Buffer::overflow(int_type c)
+{
+	if (traits_type::eq_int_type(c, traits_type::eof())) {
+		return traits_type::not_eof(c);
+	}
+	char ch = traits_type::to_char_type(c);
+	return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+}
+
+} // !namespace io
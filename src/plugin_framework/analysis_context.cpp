@@ -0,0 +1,205 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "plugin_framework/analysis_context.h"
+
+#include "hash-library/hashes.h"
+#include "hash-library/ssdeep.h"
+#include "import_hash.h"
+
+namespace plugin {
+
+namespace {
+
+/**
+ *	The digests computed with hash::hash_file, with their index in hash::ALL_DIGESTS.
+ */
+const std::map<std::string, int> FILE_DIGESTS = boost::assign::map_list_of
+	("MD5", ALL_DIGESTS_MD5)
+	("SHA1", ALL_DIGESTS_SHA1)
+	("SHA256", ALL_DIGESTS_SHA256)
+	("SHA3", ALL_DIGESTS_SHA3);
+
+} // !namespace
+
+// ----------------------------------------------------------------------------
+
+void AnalysisContext::compute_digests(const std::vector<std::string>& names)
+{
+	// The lock is held during the computation: the digest objects are shared, and two plugins
+	// requesting the same digest at the same time shouldn't compute it twice.
+	boost::lock_guard<boost::mutex> lock(_mutex);
+
+	// Gather all the missing digests which can be computed in a single pass.
+	std::vector<hash::pHash> digests;
+	std::vector<std::string> digest_names;
+	for (auto it = names.begin() ; it != names.end() ; ++it)
+	{
+		if (_digests.count(*it)) {
+			continue;
+		}
+
+		auto digest = FILE_DIGESTS.find(*it);
+		if (digest != FILE_DIGESTS.end())
+		{
+			if (std::find(digest_names.begin(), digest_names.end(), *it) == digest_names.end())
+			{
+				digests.push_back(hash::ALL_DIGESTS[digest->second]);
+				digest_names.push_back(*it);
+			}
+		}
+		else if (*it == "SSDeep") {
+			_digests[*it] = ssdeep::hash_file(*_pe.get_path());
+		}
+		else if (*it == "Imports Hash") {
+			_digests[*it] = boost::make_shared<std::string>(hash::hash_imports(_pe));
+		}
+	}
+
+	if (digests.empty()) {
+		return;
+	}
+	hash::const_shared_strings hashes = hash::hash_file(digests, *_pe.get_path());
+	for (size_t i = 0 ; i < digest_names.size() ; ++i)
+	{
+		// Failures are recorded too, so that the file isn't read again to no avail.
+		_digests[digest_names[i]] = hashes ? boost::make_shared<std::string>(hashes->at(i)) : pString();
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+pString AnalysisContext::get_digest(const std::string& name)
+{
+	compute_digests(std::vector<std::string>(1, name));
+
+	boost::lock_guard<boost::mutex> lock(_mutex);
+	auto it = _digests.find(name);
+	return it != _digests.end() ? it->second : pString();
+}
+
+void AnalysisContext::set_digest(const std::string& name, const std::string& value)
+{
+	boost::lock_guard<boost::mutex> lock(_mutex);
+	_digests[name] = boost::make_shared<std::string>(value);
+}
+
+// ----------------------------------------------------------------------------
+
+double AnalysisContext::get_section_entropy(mana::pSection section)
+{
+	{
+		boost::lock_guard<boost::mutex> lock(_mutex);
+		auto it = _section_entropy.find(section.get());
+		if (it != _section_entropy.end()) {
+			return it->second;
+		}
+	}
+
+	// Computed without holding the lock, so that other plugins aren't blocked meanwhile.
+	double entropy = section->get_entropy();
+	boost::lock_guard<boost::mutex> lock(_mutex);
+	_section_entropy[section.get()] = entropy;
+	return entropy;
+}
+
+// ----------------------------------------------------------------------------
+
+double AnalysisContext::get_resource_entropy(mana::pResource resource)
+{
+	{
+		boost::lock_guard<boost::mutex> lock(_mutex);
+		auto it = _resource_entropy.find(resource.get());
+		if (it != _resource_entropy.end()) {
+			return it->second;
+		}
+	}
+
+	double entropy = resource->get_entropy();
+	boost::lock_guard<boost::mutex> lock(_mutex);
+	_resource_entropy[resource.get()] = entropy;
+	return entropy;
+}
+
+// ----------------------------------------------------------------------------
+
+yara::pYara AnalysisContext::get_rules(const std::string& rule_file)
+{
+	// The rules outlive the samples: they are kept until the application exits. Rules which
+	// could not be loaded are recorded as NULL, so that they are only compiled and reported once.
+	static std::map<std::string, yara::pYara> registry;
+	static boost::mutex registry_mutex;
+	boost::lock_guard<boost::mutex> lock(registry_mutex);
+
+	auto it = registry.find(rule_file);
+	if (it != registry.end()) {
+		return it->second;
+	}
+
+	yara::pYara engine = yara::Yara::create();
+	if (!engine->load_rules(rule_file))
+	{
+		PRINT_ERROR << "Could not load " << rule_file << "!" << std::endl;
+		engine.reset();
+	}
+	registry[rule_file] = engine;
+	return engine;
+}
+
+// ----------------------------------------------------------------------------
+
+pResult AnalysisContext::get_result(const std::string& plugin_id) const
+{
+	boost::lock_guard<boost::mutex> lock(_mutex);
+	auto it = _results.find(plugin_id);
+	if (it == _results.end()) {
+		return pResult();
+	}
+	return it->second;
+}
+
+// ----------------------------------------------------------------------------
+
+pString AnalysisContext::get_company_name()
+{
+	{
+		boost::lock_guard<boost::mutex> lock(_mutex);
+		if (_company_known) {
+			return _company_name;
+		}
+	}
+
+	pString company;
+	mana::shared_resources r = _pe.get_resources();
+	auto version_info = std::find_if(r->begin(), r->end(),
+		[](mana::pResource resource) { return *resource->get_type() == "RT_VERSION"; });
+	yara::pYara y = version_info != r->end() ? get_rules("yara_rules/company_names.yara") : yara::pYara();
+	if (y)
+	{
+		yara::const_matches m = y->scan_bytes(*(*version_info)->get_raw_data());
+		if (m && m->size() > 0 && !m->at(0)->get_found_strings().empty()) {
+			company = boost::make_shared<std::string>(*m->at(0)->get_found_strings().begin());
+		}
+	}
+
+	boost::lock_guard<boost::mutex> lock(_mutex);
+	_company_name = company;
+	_company_known = true;
+	return company;
+}
+
+} // !namespace plugin
@@ -17,15 +17,30 @@
 
 #include "plugin_framework/plugin_manager.h"
 
+#include <fstream>
+#include <set>
+#include <boost/algorithm/string.hpp>
+
 namespace plugin {
 
-int PluginManager::API_VERSION = 1;
+int PluginManager::API_VERSION = 2;
+int PluginManager::MIN_API_VERSION = 1;
 
-void PluginManager::load(const std::string& path)
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Loads a plugin's shared library.
+ *
+ *	@param	const std::string& path The path to the shared library.
+ *	@param	pSharedLibrary& lib Receives the loaded library.
+ *
+ *	@return	The plugin contained in the library, or NULL if it doesn't export a creator and a destroyer.
+ */
+pPlugin open_plugin(const std::string& path, pSharedLibrary& lib)
 {
-	pSharedLibrary lib = SharedLibrary::load(path);
+	lib = SharedLibrary::load(path);
 	if (lib == NULL) {
-		return;
+		return pPlugin();
 	}
 
 	DynamicPlugin::creator c = (DynamicPlugin::creator) lib->resolve_symbol("create");
@@ -37,33 +52,91 @@ void PluginManager::load(const std::string& path)
 		if (libname.find("libplugin_") == 0 || libname.find("plugin_") == 0) {
 			PRINT_ERROR << "Could not resolve " << path << "'s creator or destroyer function!" << std::endl;
 		}
-		return;
+		return pPlugin();
+	}
+	return pPlugin(new DynamicPlugin(c, d));
+}
+
+// ----------------------------------------------------------------------------
+
+pPlugin RegisterEntry::get_plugin()
+{
+	if (_plugin || _load_failed) {
+		return _plugin;
+	}
+
+	// The plugin was registered from its manifest: load it now, and make sure that the
+	// manifest actually describes it.
+	pSharedLibrary lib;
+	pPlugin plugin = open_plugin(_path, lib);
+	if (!plugin)
+	{
+		PRINT_ERROR << "Could not load the plugin " << _manifest->id << " from " << _path << "!" << std::endl;
+		_load_failed = true;
+		return _plugin;
+	}
+	if (!check_manifest(*_manifest, plugin->instantiate_plugin()))
+	{
+		PRINT_ERROR << "The manifest of the plugin " << _manifest->id << " doesn't match " << _path << "!" << std::endl;
+		_load_failed = true;
+		return _plugin;
+	}
+
+	_plugin = plugin;
+	_shared_library = lib;
+	return _plugin;
+}
+
+// ----------------------------------------------------------------------------
+
+pPluginManifest RegisterEntry::get_manifest()
+{
+	if (!_manifest && _plugin) {
+		_manifest = describe_plugin(_plugin->instantiate_plugin());
+	}
+	return _manifest;
+}
+
+// ----------------------------------------------------------------------------
+
+void PluginManager::load(const std::string& path)
+{
+	// If the plugin describes itself in a manifest, its library is only loaded when needed.
+	std::string manifest_path = bfs::path(path).replace_extension(".manifest").string();
+	pPluginManifest manifest;
+	pRegisterEntry entry;
+	if (bfs::exists(manifest_path) && (manifest = read_manifest(manifest_path))) {
+		entry = boost::make_shared<RegisterEntry>(manifest, path);
+	}
+	else
+	{
+		pSharedLibrary lib;
+		pPlugin plugin = open_plugin(path, lib);
+		if (!plugin) {
+			return;
+		}
+		entry = boost::make_shared<RegisterEntry>(plugin, lib);
+		manifest = entry->get_manifest();
 	}
-	pPlugin plugin = pPlugin(new DynamicPlugin(c, d));
 
 	// Check the api version for dynamic plugins. Over time, the API may evolve and old plugins could
 	// become incompatible.
-	pIPlugin test = plugin->instantiate_plugin();
-	if (test->get_api_version() != API_VERSION)
+	if (manifest->api_version < MIN_API_VERSION || manifest->api_version > API_VERSION)
 	{
-		PRINT_ERROR << "The plugin " << *test->get_id() << " is not compatible with this version of the API (expected: "
-			<< API_VERSION << ", found: " << test->get_api_version() << ")!" << std::endl;
+		PRINT_ERROR << "The plugin " << manifest->id << " is not compatible with this version of the API (expected: "
+			<< MIN_API_VERSION << " to " << API_VERSION << ", found: " << manifest->api_version << ")!" << std::endl;
 		return;
 	}
 
 	// Verify that the plugin isn't already loaded (no two plugins can have the same name)
-	std::vector<pIPlugin> loaded_plugins = get_plugins();
-	for (std::vector<pIPlugin>::iterator it = loaded_plugins.begin() ; it != loaded_plugins.end() ; ++it)
+	if (find_manifest(manifest->id))
 	{
-		if (*(*it)->get_id() == *test->get_id())
-		{
-			PRINT_WARNING << "The plugin " << *test->get_id() << " tried to load twice!" << std::endl;
-			return;
-		}
+		PRINT_WARNING << "The plugin " << manifest->id << " tried to load twice!" << std::endl;
+		return;
 	}
 
 	// Everything ok: add register the plugin.
-	_plugins.push_back(pRegisterEntry(new RegisterEntry(plugin, lib)));
+	_plugins.push_back(entry);
 }
 
 // ----------------------------------------------------------------------------
@@ -76,22 +149,334 @@ void PluginManager::load_all(const std::string& path)
 		std::string ext(".so");
 	#endif
 
-	if (!bfs::exists(path)) {
-		return;
+	if (bfs::exists(path))
+	{
+		bfs::directory_iterator end_it;
+		for (bfs::directory_iterator it(path) ; it != end_it ; ++it)
+		{
+			if (it->path().extension() == ext) {
+				load(it->path().string());
+			}
+		}
+	}
+
+	// Static plugins are verified too, even if there are no dynamic ones.
+	_check_dependencies();
+}
+
+// ----------------------------------------------------------------------------
+
+std::vector<pIPlugin> PluginManager::get_plugins()
+{
+	std::vector<pIPlugin> res;
+
+	for (PluginRegister::iterator it = _plugins.begin() ; it != _plugins.end() ; ++it)
+	{
+		pPlugin p = (*it)->get_plugin();
+		if (p) {
+			res.push_back(p->instantiate_plugin());
+		}
+	}
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+std::vector<pPluginManifest> PluginManager::get_manifests()
+{
+	std::vector<pPluginManifest> res;
+	for (PluginRegister::iterator it = _plugins.begin() ; it != _plugins.end() ; ++it) {
+		res.push_back((*it)->get_manifest());
+	}
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+pPluginManifest PluginManager::find_manifest(const std::string& id)
+{
+	for (PluginRegister::iterator it = _plugins.begin() ; it != _plugins.end() ; ++it)
+	{
+		pPluginManifest manifest = (*it)->get_manifest();
+		if (manifest->id == id) {
+			return manifest;
+		}
 	}
+	return pPluginManifest();
+}
+
+// ----------------------------------------------------------------------------
 
-	bfs::directory_iterator end_it;
-	for (bfs::directory_iterator it(path) ; it != end_it ; ++it)
+PluginManager::provider_map PluginManager::_index_providers(const std::vector<pPluginManifest>& plugins)
+{
+	provider_map res;
+	for (size_t i = 0 ; i < plugins.size() ; ++i)
 	{
-		if (it->path().extension() == ext) {
-			load(it->path().string());
+		const std::vector<std::string>& provided = plugins[i]->provided_data;
+		for (auto it = provided.begin() ; it != provided.end() ; ++it) {
+			res[*it].push_back(i);
 		}
 	}
+	return res;
 }
 
 // ----------------------------------------------------------------------------
 
-void PluginManager::unload_all() {
+void PluginManager::_check_dependencies()
+{
+	std::vector<pPluginManifest> plugins = get_manifests();
+	provider_map providers = _index_providers(plugins);
+
+	// Depth-first search of the dependency graph. A plugin reached again while its own
+	// dependencies are still being visited belongs to a cycle.
+	enum { UNVISITED, VISITING, DONE };
+	std::vector<int> state(plugins.size(), UNVISITED);
+	std::vector<bool> rejected(plugins.size(), false);	// Involved in a cycle or depending on a batch plugin.
+	std::vector<size_t> path;
+
+	boost::function<void (size_t)> visit = [&](size_t i)
+	{
+		state[i] = VISITING;
+		path.push_back(i);
+		const std::vector<std::string>& dependencies = plugins[i]->dependencies;
+		for (auto it = dependencies.begin() ; it != dependencies.end() ; ++it)
+		{
+			auto found = providers.find(*it);
+			if (found == providers.end())
+			{
+				PRINT_WARNING << "The plugin " << plugins[i]->id << " depends on " << *it
+					<< ", which is not provided by any plugin." << std::endl;
+				continue;
+			}
+			for (auto j = found->second.begin() ; j != found->second.end() ; ++j)
+			{
+				// Batch plugins run once the whole batch has been analyzed by the others.
+				if (plugins[*j]->batch && !rejected[i])
+				{
+					PRINT_ERROR << "The plugin " << plugins[i]->id << " depends on " << plugins[*j]->id
+						<< ", which analyzes files in batches: its results are not available to other plugins." << std::endl;
+					rejected[i] = true;
+				}
+
+				if (state[*j] == UNVISITED) {
+					visit(*j);
+				}
+				else if (state[*j] == VISITING)
+				{
+					// Every plugin on the path since the dependency's first occurrence is in the cycle.
+					auto start = std::find(path.begin(), path.end(), *j);
+					std::stringstream ss;
+					for (auto k = start ; k != path.end() ; ++k)
+					{
+						rejected[*k] = true;
+						ss << plugins[*k]->id << " -> ";
+					}
+					ss << plugins[*j]->id;
+					PRINT_ERROR << "Circular plugin dependencies detected (" << ss.str() << ")!" << std::endl;
+				}
+			}
+		}
+		path.pop_back();
+		state[i] = DONE;
+	};
+
+	for (size_t i = 0 ; i < plugins.size() ; ++i)
+	{
+		if (state[i] == UNVISITED) {
+			visit(i);
+		}
+	}
+
+	// Plugins depending on a rejected plugin could never run: reject them too, until no new
+	// plugin is found. Each one is reported once, with the first rejected plugin it depends on.
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (size_t i = 0 ; i < plugins.size() ; ++i)
+		{
+			if (rejected[i]) {
+				continue;
+			}
+			const std::vector<std::string>& dependencies = plugins[i]->dependencies;
+			for (auto it = dependencies.begin() ; it != dependencies.end() && !rejected[i] ; ++it)
+			{
+				auto found = providers.find(*it);
+				if (found == providers.end()) {
+					continue;
+				}
+				for (auto j = found->second.begin() ; j != found->second.end() ; ++j)
+				{
+					if (rejected[*j])
+					{
+						PRINT_ERROR << "The plugin " << plugins[i]->id << " depends on " << plugins[*j]->id
+							<< ", which will not be loaded." << std::endl;
+						rejected[i] = true;
+						changed = true;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	// get_manifests returns one manifest per register entry, in the same order.
+	PluginRegister kept;
+	for (size_t i = 0 ; i < _plugins.size() ; ++i)
+	{
+		if (rejected[i]) {
+			PRINT_ERROR << "The plugin " << plugins[i]->id << " will not be loaded." << std::endl;
+		}
+		else {
+			kept.push_back(_plugins[i]);
+		}
+	}
+	_plugins.swap(kept);
+}
+
+// ----------------------------------------------------------------------------
+
+std::vector<std::pair<pIPlugin, unsigned int> > PluginManager::schedule(const std::vector<std::string>& selected)
+{
+	// The selection is resolved on the manifests, so that only the plugins which will run are loaded.
+	std::vector<pPluginManifest> plugins = get_manifests();
+	provider_map providers = _index_providers(plugins);
+	bool all_plugins = std::find(selected.begin(), selected.end(), "all") != selected.end();
+
+	// Select the requested plugins, then everything they depend on.
+	std::vector<bool> needed(plugins.size(), false);
+	std::vector<size_t> to_visit;
+	for (size_t i = 0 ; i < plugins.size() ; ++i)
+	{
+		if (all_plugins || std::find(selected.begin(), selected.end(), plugins[i]->id) != selected.end())
+		{
+			needed[i] = true;
+			to_visit.push_back(i);
+		}
+	}
+	while (!to_visit.empty())
+	{
+		size_t i = to_visit.back();
+		to_visit.pop_back();
+		const std::vector<std::string>& dependencies = plugins[i]->dependencies;
+		for (auto it = dependencies.begin() ; it != dependencies.end() ; ++it)
+		{
+			auto found = providers.find(*it);
+			if (found == providers.end()) {
+				continue;
+			}
+			for (auto j = found->second.begin() ; j != found->second.end() ; ++j)
+			{
+				if (!needed[*j])
+				{
+					needed[*j] = true;
+					to_visit.push_back(*j);
+				}
+			}
+		}
+	}
+
+	// A plugin's stage comes right after the last stage of its dependencies.
+	// Cycles were eliminated when the plugins were loaded.
+	std::vector<int> stages(plugins.size(), -1);
+	boost::function<unsigned int (size_t)> get_stage = [&](size_t i) -> unsigned int
+	{
+		if (stages[i] >= 0) {
+			return stages[i];
+		}
+		stages[i] = 0;
+		unsigned int stage = 0;
+		const std::vector<std::string>& dependencies = plugins[i]->dependencies;
+		for (auto it = dependencies.begin() ; it != dependencies.end() ; ++it)
+		{
+			auto found = providers.find(*it);
+			if (found == providers.end()) {
+				continue;
+			}
+			for (auto j = found->second.begin() ; j != found->second.end() ; ++j) {
+				stage = std::max(stage, get_stage(*j) + 1);
+			}
+		}
+		stages[i] = stage;
+		return stage;
+	};
+
+	std::vector<std::pair<pIPlugin, unsigned int> > res;
+	for (size_t i = 0 ; i < plugins.size() ; ++i)
+	{
+		if (!needed[i]) {
+			continue;
+		}
+		pPlugin p = _plugins[i]->get_plugin();
+		if (p) { // Plugins depending on a plugin which could not be loaded run without its result.
+			res.push_back(std::make_pair(p->instantiate_plugin(), get_stage(i)));
+		}
+	}
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+void PluginManager::start_run(const std::vector<std::string>& selected, const std::map<std::string, string_map>& config)
+{
+	end_run();
+
+	_dispatch_list = schedule(selected);
+	for (auto it = _dispatch_list.begin() ; it != _dispatch_list.end() ; ++it)
+	{
+		// Forward relevant configuration elements to the plugin.
+		const std::string& id = *it->first->get_id();
+		string_map plugin_config = config.count(id) ? config.at(id) : string_map();
+		it->first->set_config(plugin_config);
+		if (it->first->get_api_version() >= 2) { // Not part of the first version of the API.
+			it->first->on_load(plugin_config);
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void PluginManager::start_thread()
+{
+	for (auto it = _dispatch_list.begin() ; it != _dispatch_list.end() ; ++it)
+	{
+		if (it->first->get_api_version() >= 2) {
+			it->first->on_thread_start();
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void PluginManager::end_thread()
+{
+	for (auto it = _dispatch_list.begin() ; it != _dispatch_list.end() ; ++it)
+	{
+		if (it->first->get_api_version() >= 2) {
+			it->first->on_thread_end();
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void PluginManager::end_run()
+{
+	for (auto it = _dispatch_list.begin() ; it != _dispatch_list.end() ; ++it)
+	{
+		if (it->first->get_api_version() >= 2) {
+			it->first->on_run_end();
+		}
+	}
+	_dispatch_list.clear();
+}
+
+// ----------------------------------------------------------------------------
+
+void PluginManager::unload_all()
+{
+	// The instances must be destroyed before the libraries they come from.
+	end_run();
 	_plugins.clear();
 }
 
@@ -101,4 +486,161 @@ bool name_matches(const std::string& s, pIPlugin p) {
 	return *p == s;
 }
 
+// ----------------------------------------------------------------------------
+
+pPluginManifest read_manifest(const std::string& path)
+{
+	std::ifstream input(path.c_str());
+	if (!input.is_open()) {
+		return pPluginManifest();
+	}
+
+	pPluginManifest res = boost::make_shared<PluginManifest>();
+	std::string line;
+	while (std::getline(input, line))
+	{
+		boost::trim(line);
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		size_t separator = line.find('=');
+		if (separator == std::string::npos)
+		{
+			PRINT_WARNING << "Could not parse \"" << line << "\" in " << path << "." << std::endl;
+			continue;
+		}
+		std::string key = boost::trim_copy(line.substr(0, separator));
+		std::string value = boost::trim_copy(line.substr(separator + 1));
+
+		if (key == "id") {
+			res->id = value;
+		}
+		else if (key == "description") {
+			res->description = value;
+		}
+		else if (key == "api_version")
+		{
+			try {
+				res->api_version = std::stoi(value);
+			}
+			catch (std::logic_error&) {} // Reported below.
+		}
+		else if (key == "batch") {
+			res->batch = value == "yes";
+		}
+		else if (key == "dependencies" || key == "provides")
+		{
+			std::vector<std::string>& destination = key == "dependencies" ? res->dependencies : res->provided_data;
+			std::vector<std::string> names;
+			boost::split(names, value, boost::is_any_of(","));
+			for (auto it = names.begin() ; it != names.end() ; ++it)
+			{
+				boost::trim(*it);
+				if (!it->empty()) {
+					destination.push_back(*it);
+				}
+			}
+		}
+	}
+
+	if (res->id.empty() || res->api_version == 0)
+	{
+		PRINT_WARNING << path << " doesn't contain a plugin ID and API version." << std::endl;
+		return pPluginManifest();
+	}
+	res->provided_data.insert(res->provided_data.begin(), res->id);
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+pPluginManifest describe_plugin(pIPlugin p)
+{
+	pPluginManifest res = boost::make_shared<PluginManifest>();
+	res->id = *p->get_id();
+	res->description = *p->get_description();
+	res->api_version = p->get_api_version();
+	res->dependencies = get_dependencies(p);
+	res->provided_data = get_provided_data(p);
+	res->batch = supports_batch(p);
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+bool check_manifest(const PluginManifest& manifest, pIPlugin p)
+{
+	pPluginManifest actual = describe_plugin(p);
+	std::string field;
+	if (actual->id != manifest.id) {
+		field = "id";
+	}
+	else if (actual->api_version != manifest.api_version) {
+		field = "api_version";
+	}
+	else if (std::set<std::string>(actual->dependencies.begin(), actual->dependencies.end()) !=
+			 std::set<std::string>(manifest.dependencies.begin(), manifest.dependencies.end())) {
+		field = "dependencies";
+	}
+	else if (std::set<std::string>(actual->provided_data.begin(), actual->provided_data.end()) !=
+			 std::set<std::string>(manifest.provided_data.begin(), manifest.provided_data.end())) {
+		field = "provides";
+	}
+	else if (actual->batch != manifest.batch) {
+		field = "batch";
+	}
+
+	if (!field.empty())
+	{
+		PRINT_WARNING << "The " << field << " of the plugin " << manifest.id << " differs from its manifest." << std::endl;
+		return false;
+	}
+	if (actual->description != manifest.description) {
+		PRINT_WARNING << "The description of the plugin " << manifest.id << " differs from its manifest." << std::endl;
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+std::vector<std::string> get_dependencies(pIPlugin p)
+{
+	if (p->get_api_version() < 2) { // Not part of the first version of the API.
+		return std::vector<std::string>();
+	}
+	shared_strings dependencies = p->get_dependencies();
+	return dependencies ? *dependencies : std::vector<std::string>();
+}
+
+// ----------------------------------------------------------------------------
+
+std::vector<std::string> get_provided_data(pIPlugin p)
+{
+	std::vector<std::string> res(1, *p->get_id());
+	if (p->get_api_version() < 2) {
+		return res;
+	}
+	shared_strings provided = p->get_provided_data();
+	if (provided) {
+		res.insert(res.end(), provided->begin(), provided->end());
+	}
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+unsigned int get_required_components(pIPlugin p)
+{
+	if (p->get_api_version() < 2) { // Not part of the first version of the API.
+		return mana::PE::ALL_COMPONENTS;
+	}
+	return p->get_required_components();
+}
+
+// ----------------------------------------------------------------------------
+
+bool supports_batch(pIPlugin p) {
+	return p->get_api_version() >= 2 && p->supports_batch();
+}
+
 } // !namespace plugin
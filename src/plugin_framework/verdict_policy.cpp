@@ -0,0 +1,196 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "plugin_framework/verdict_policy.h"
+
+#include <vector>
+#include <algorithm>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+#include "manacommons/color.h"
+
+namespace plugin {
+
+namespace {
+
+/**
+ *	@brief	Splits a comma-separated list of plugin IDs read from the configuration.
+ */
+std::vector<std::string> split_list(const std::string& list)
+{
+	std::vector<std::string> tokens;
+	std::vector<std::string> res;
+	boost::split(tokens, list, boost::is_any_of(","));
+	for (auto it = tokens.begin() ; it != tokens.end() ; ++it)
+	{
+		std::string token = boost::trim_copy(*it);
+		if (!token.empty()) {
+			res.push_back(token);
+		}
+	}
+	return res;
+}
+
+} // !namespace
+
+// ----------------------------------------------------------------------------
+
+VerdictPolicy::VerdictPolicy(const string_map& config)
+	: _enabled(false), _threshold(MALICIOUS), _threshold_name("none")
+{
+	auto it = config.find("stop_level");
+	if (it != config.end())
+	{
+		_threshold_name = boost::to_lower_copy(boost::trim_copy(it->second));
+		if (_threshold_name == "malicious")
+		{
+			_enabled = true;
+			_threshold = MALICIOUS;
+		}
+		else if (_threshold_name == "suspicious")
+		{
+			_enabled = true;
+			_threshold = SUSPICIOUS;
+		}
+		else if (_threshold_name != "none")
+		{
+			PRINT_WARNING << "Could not parse plugins.stop_level in the configuration file." << std::endl;
+			_threshold_name = "none";
+		}
+	}
+
+	it = config.find("skip_on_verdict");
+	if (it != config.end())
+	{
+		std::vector<std::string> ids = split_list(it->second);
+		_skippable.insert(ids.begin(), ids.end());
+	}
+
+	it = config.find("cost_order");
+	if (it != config.end())
+	{
+		std::vector<std::string> ids = split_list(it->second);
+		for (unsigned int i = 0 ; i < ids.size() ; ++i) {
+			_ranks.insert(std::make_pair(ids[i], i)); // The first occurrence wins.
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+bool VerdictPolicy::is_verdict(pResult res) const {
+	return _enabled && res && res->get_level() >= _threshold;
+}
+
+// ----------------------------------------------------------------------------
+
+bool VerdictPolicy::may_skip(const std::string& plugin_id) const {
+	return _skippable.empty() || _skippable.count(plugin_id) != 0;
+}
+
+// ----------------------------------------------------------------------------
+
+unsigned int VerdictPolicy::get_rank(const std::string& plugin_id) const
+{
+	auto it = _ranks.find(plugin_id);
+	if (it == _ranks.end()) {
+		return static_cast<unsigned int>(_ranks.size());
+	}
+	return it->second;
+}
+
+// ----------------------------------------------------------------------------
+
+std::vector<std::string> VerdictPolicy::run_plugins(const std::vector<pIPlugin>& plugins,
+													IAnalysisContext& context,
+													WorkerPool& pool,
+													std::vector<pResult>& results,
+													std::string& verdict) const
+{
+	results.assign(plugins.size(), pResult());
+	std::vector<std::string> skipped;
+
+	// Start with the cheapest plugins: they may settle the verdict before the expensive ones run.
+	std::vector<size_t> order;
+	for (size_t i = 0 ; i < plugins.size() ; ++i) {
+		order.push_back(i);
+	}
+	if (_enabled)
+	{
+		std::stable_sort(order.begin(), order.end(), [&plugins, this](size_t a, size_t b) {
+			return get_rank(*plugins[a]->get_id()) < get_rank(*plugins[b]->get_id());
+		});
+	}
+
+	// The plugins which may be skipped and are not in the cost order are only queued once the
+	// others are complete. Otherwise, the threads of the pool would all start before any verdict
+	// is known. For the same reason, the other plugins are queued in rank order, no more than
+	// the pool can run at once: a verdict reached by the cheap ones cancels the expensive tail.
+	std::vector<size_t> deferred;
+	std::vector<std::vector<size_t> > waves(1);
+	size_t wave_size = _enabled ? std::max<size_t>(pool.get_size(), 1) : plugins.size();
+	for (auto it = order.begin() ; it != order.end() ; ++it)
+	{
+		std::string id = *plugins[*it]->get_id();
+		if (_enabled && may_skip(id) && _ranks.find(id) == _ranks.end()) {
+			deferred.push_back(*it);
+		}
+		else
+		{
+			if (waves.back().size() >= wave_size) {
+				waves.push_back(std::vector<size_t>());
+			}
+			waves.back().push_back(*it);
+		}
+	}
+	waves.push_back(deferred);
+
+	boost::mutex verdict_mutex;
+	for (size_t w = 0 ; w < waves.size() ; ++w)
+	{
+		std::vector<WorkerPool::task> tasks;
+		for (auto it = waves[w].begin() ; it != waves[w].end() ; ++it)
+		{
+			size_t i = *it;
+			tasks.push_back([&, i]()
+			{
+				std::string id = *plugins[i]->get_id();
+				{
+					boost::lock_guard<boost::mutex> lock(verdict_mutex);
+					if (!verdict.empty() && may_skip(id))
+					{
+						skipped.push_back(id);
+						return;
+					}
+				}
+				pResult res = plugins[i]->run(context);
+				boost::lock_guard<boost::mutex> lock(verdict_mutex);
+				results[i] = res;
+				if (verdict.empty() && is_verdict(res)) {
+					verdict = id;
+				}
+			});
+		}
+		pool.run(tasks);
+	}
+	return skipped;
+}
+
+} // !namespace plugin
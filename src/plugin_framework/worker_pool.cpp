@@ -0,0 +1,93 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "plugin_framework/worker_pool.h"
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+namespace plugin {
+
+WorkerPool::WorkerPool(unsigned int threads, task on_start, task on_end)
+	: _size(std::max(1u, threads)), _on_start(on_start), _on_end(on_end), _pending(0), _stopping(false)
+{
+	for (size_t i = 0 ; i < _size ; ++i) {
+		_threads.create_thread(boost::bind(&WorkerPool::_work, this));
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+WorkerPool::~WorkerPool()
+{
+	{
+		boost::lock_guard<boost::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_task_available.notify_all();
+	_threads.join_all();
+}
+
+// ----------------------------------------------------------------------------
+
+void WorkerPool::run(const std::vector<task>& tasks)
+{
+	boost::unique_lock<boost::mutex> lock(_mutex);
+	_queue.insert(_queue.end(), tasks.begin(), tasks.end());
+	_pending += tasks.size();
+	_task_available.notify_all();
+	while (_pending > 0) {
+		_tasks_done.wait(lock);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void WorkerPool::_work()
+{
+	if (_on_start) {
+		_on_start();
+	}
+
+	boost::unique_lock<boost::mutex> lock(_mutex);
+	while (true)
+	{
+		while (_queue.empty() && !_stopping) {
+			_task_available.wait(lock);
+		}
+		if (_queue.empty()) { // The pool is being destroyed.
+			break;
+		}
+
+		task t = _queue.front();
+		_queue.pop_front();
+		lock.unlock();
+		t();
+		lock.lock();
+		if (--_pending == 0) {
+			_tasks_done.notify_all();
+		}
+	}
+	lock.unlock();
+
+	if (_on_end) {
+		_on_end();
+	}
+}
+
+} // !namespace plugin
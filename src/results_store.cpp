@@ -0,0 +1,442 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "results_store.h"
+
+#include <cstdlib>
+#include <map>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/assign/list_of.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/regex.hpp>
+#include <boost/unordered_set.hpp>
+
+#include "manacommons/color.h"
+
+namespace bfs = boost::filesystem;
+
+namespace mana
+{
+
+namespace {
+
+const std::map<std::string, plugin::LEVEL> LEVEL_NAMES = boost::assign::map_list_of
+	("safe", plugin::SAFE)
+	("no_opinion", plugin::NO_OPINION)
+	("suspicious", plugin::SUSPICIOUS)
+	("malicious", plugin::MALICIOUS);
+
+/**
+ *	@brief	Replaces the characters which would break the records (tabulations, line breaks...).
+ */
+std::string sanitize(const std::string& s)
+{
+	std::string res(s);
+	for (auto it = res.begin() ; it != res.end() ; ++it)
+	{
+		if (static_cast<unsigned char>(*it) < 0x20) {
+			*it = '?';
+		}
+	}
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+std::string level_name(plugin::LEVEL level)
+{
+	for (auto it = LEVEL_NAMES.begin() ; it != LEVEL_NAMES.end() ; ++it)
+	{
+		if (it->second == level) {
+			return it->first;
+		}
+	}
+	return "no_opinion";
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Translates a pattern containing '*' and '?' wildcards into a case-insensitive regex.
+ */
+boost::regex wildcard_to_regex(const std::string& pattern)
+{
+	static const std::string special = "\\^$.|+()[]{}";
+	std::string res;
+	for (auto it = pattern.begin() ; it != pattern.end() ; ++it)
+	{
+		if (*it == '*') {
+			res += ".*";
+		}
+		else if (*it == '?') {
+			res += ".";
+		}
+		else
+		{
+			if (special.find(*it) != std::string::npos) {
+				res += '\\';
+			}
+			res += *it;
+		}
+	}
+	return boost::regex(res, boost::regex::icase);
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	A parsed query condition.
+ */
+struct condition
+{
+	enum condition_type { IMPORT, SECTION, PERMISSIONS, PLUGIN };
+
+	condition_type	type;
+	bool			negated;
+	boost::regex	pattern;
+	bool			match_dll;		// Imports: whether the pattern includes the DLL name.
+	std::string		permissions;	// Permissions: the letters the section must have.
+	plugin::LEVEL	level;			// Plugins: the level to compare the verdicts with.
+	bool			at_least;		// Plugins: whether higher levels match too.
+};
+
+// ----------------------------------------------------------------------------
+
+bool parse_condition(const std::string& s, condition& c)
+{
+	c.negated = !s.empty() && s[0] == '!';
+	std::string text = c.negated ? s.substr(1) : s;
+	size_t colon = text.find(':');
+	if (colon == std::string::npos) {
+		return false;
+	}
+	std::string type = boost::to_lower_copy(text.substr(0, colon));
+	std::string value = text.substr(colon + 1);
+
+	if (type == "import")
+	{
+		c.type = condition::IMPORT;
+		c.match_dll = value.find('!') != std::string::npos;
+		c.pattern = wildcard_to_regex(value);
+	}
+	else if (type == "section")
+	{
+		c.type = condition::SECTION;
+		c.pattern = wildcard_to_regex(value);
+	}
+	else if (type == "permissions")
+	{
+		c.type = condition::PERMISSIONS;
+		c.permissions = boost::to_lower_copy(value);
+		if (c.permissions.empty() || c.permissions.find_first_not_of("rwx") != std::string::npos) {
+			return false;
+		}
+	}
+	else if (type == "plugin")
+	{
+		c.type = condition::PLUGIN;
+		size_t equal = value.find('=');
+		if (equal == std::string::npos || equal == 0) {
+			return false;
+		}
+		c.at_least = value[equal - 1] == '>';
+		c.pattern = wildcard_to_regex(value.substr(0, c.at_least ? equal - 1 : equal));
+		auto level = LEVEL_NAMES.find(boost::to_lower_copy(value.substr(equal + 1)));
+		if (level == LEVEL_NAMES.end()) {
+			return false;
+		}
+		c.level = level->second;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Checks whether an index entry satisfies a condition (regardless of its negation).
+ *
+ *	@param	const condition& c The condition.
+ *	@param	const std::vector<std::string>& fields The fields of the entry, after the sample ID.
+ */
+bool matches(const condition& c, const std::vector<std::string>& fields)
+{
+	switch (c.type)
+	{
+	case condition::IMPORT:
+	{
+		if (fields.size() < 1) {
+			return false;
+		}
+		if (c.match_dll) {
+			return boost::regex_match(fields[0], c.pattern);
+		}
+		size_t separator = fields[0].find('!');
+		return boost::regex_match(separator == std::string::npos ? fields[0] : fields[0].substr(separator + 1), c.pattern);
+	}
+	case condition::SECTION:
+		return fields.size() >= 1 && boost::regex_match(fields[0], c.pattern);
+	case condition::PERMISSIONS:
+		if (fields.size() < 2) {
+			return false;
+		}
+		for (auto it = c.permissions.begin() ; it != c.permissions.end() ; ++it)
+		{
+			if (fields[1].find(*it) == std::string::npos) {
+				return false;
+			}
+		}
+		return true;
+	case condition::PLUGIN:
+	{
+		if (fields.size() < 2 || !boost::regex_match(fields[0], c.pattern)) {
+			return false;
+		}
+		auto level = LEVEL_NAMES.find(fields[1]);
+		if (level == LEVEL_NAMES.end()) {
+			return false;
+		}
+		return c.at_least ? level->second >= c.level : level->second == c.level;
+	}
+	}
+	return false;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Splits a line into its sample ID and the following fields.
+ */
+bool split_line(const std::string& line, boost::uint64_t& id, std::vector<std::string>& fields)
+{
+	size_t tab = line.find('\t');
+	if (tab == std::string::npos || tab == 0) {
+		return false;
+	}
+	char* end = nullptr;
+	id = strtoull(line.c_str(), &end, 10);
+	if (end != line.c_str() + tab) {
+		return false;
+	}
+	fields.clear();
+	std::string rest = line.substr(tab + 1);
+	boost::split(fields, rest, boost::is_any_of("\t"));
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Collects the IDs of the samples which have an entry satisfying a condition.
+ *
+ *	@param	const boost::unordered_set<boost::uint64_t>* candidates If not NULL, only these
+ *			samples are considered.
+ */
+void scan_index(const std::string& path,
+				const condition& c,
+				const boost::unordered_set<boost::uint64_t>* candidates,
+				boost::unordered_set<boost::uint64_t>& ids)
+{
+	std::ifstream f(path.c_str(), std::ios::binary);
+	std::string line;
+	std::vector<std::string> fields;
+	boost::uint64_t id;
+	while (std::getline(f, line))
+	{
+		if (!split_line(line, id, fields) || (candidates != nullptr && !candidates->count(id))) {
+			continue;
+		}
+		if (!ids.count(id) && matches(c, fields)) {
+			ids.insert(id);
+		}
+	}
+}
+
+} // !namespace
+
+// ----------------------------------------------------------------------------
+
+void describe_pe(const mana::PE& pe, sample_record& record)
+{
+	auto dlls = pe.get_imported_dlls();
+	for (auto it = dlls->begin() ; it != dlls->end() ; ++it)
+	{
+		std::string dll = boost::to_lower_copy(*it);
+		auto functions = pe.get_imported_functions(*it);
+		if (functions == nullptr) {
+			continue;
+		}
+		for (auto f = functions->begin() ; f != functions->end() ; ++f) {
+			record.imports.push_back(dll + "!" + boost::to_lower_copy(*f));
+		}
+	}
+
+	auto sections = pe.get_sections();
+	for (auto it = sections->begin() ; it != sections->end() ; ++it)
+	{
+		boost::uint32_t characteristics = (*it)->get_characteristics();
+		std::string permissions;
+		if (characteristics & nt::SECTION_CHARACTERISTICS.at("IMAGE_SCN_MEM_READ")) {
+			permissions += "r";
+		}
+		if (characteristics & nt::SECTION_CHARACTERISTICS.at("IMAGE_SCN_MEM_WRITE")) {
+			permissions += "w";
+		}
+		if (characteristics & nt::SECTION_CHARACTERISTICS.at("IMAGE_SCN_MEM_EXECUTE")) {
+			permissions += "x";
+		}
+		record.sections.push_back(std::make_pair(*(*it)->get_name(), permissions.empty() ? "-" : permissions));
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+ResultsStore::ResultsStore(const std::string& directory) : _open(false), _next_id(0)
+{
+	boost::system::error_code ec;
+	bfs::create_directories(directory, ec);
+	bfs::path root(directory);
+
+	// The IDs of the new samples follow the ones already in the store.
+	std::ifstream existing((root / "samples.tsv").string().c_str(), std::ios::binary);
+	std::string line;
+	while (std::getline(existing, line)) {
+		++_next_id;
+	}
+	existing.close();
+
+	_samples.open((root / "samples.tsv").string().c_str(), std::ios::binary | std::ios::app);
+	_imports.open((root / "imports.idx").string().c_str(), std::ios::binary | std::ios::app);
+	_sections.open((root / "sections.idx").string().c_str(), std::ios::binary | std::ios::app);
+	_verdicts.open((root / "verdicts.idx").string().c_str(), std::ios::binary | std::ios::app);
+	if (!_samples.is_open() || !_imports.is_open() || !_sections.is_open() || !_verdicts.is_open())
+	{
+		PRINT_ERROR << "Could not open the results store " << directory << "." << std::endl;
+		return;
+	}
+	_open = true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool ResultsStore::add(const sample_record& record)
+{
+	if (!_open) {
+		return false;
+	}
+	boost::uint64_t id = _next_id++;
+
+	// The sample is written first, so that the IDs of the entries always match the records
+	// even if the program is interrupted.
+	_samples << id << "\t" << record.sha256 << "\t" << sanitize(record.path) << "\n";
+	_samples.flush();
+
+	for (auto it = record.imports.begin() ; it != record.imports.end() ; ++it) {
+		_imports << id << "\t" << sanitize(*it) << "\n";
+	}
+	for (auto it = record.sections.begin() ; it != record.sections.end() ; ++it) {
+		_sections << id << "\t" << sanitize(it->first) << "\t" << it->second << "\n";
+	}
+	for (auto it = record.verdicts.begin() ; it != record.verdicts.end() ; ++it) {
+		_verdicts << id << "\t" << sanitize(it->first) << "\t" << level_name(it->second) << "\n";
+	}
+	return _samples.good() && _imports.good() && _sections.good() && _verdicts.good();
+}
+
+// ----------------------------------------------------------------------------
+
+void ResultsStore::flush()
+{
+	_samples.flush();
+	_imports.flush();
+	_sections.flush();
+	_verdicts.flush();
+}
+
+// ----------------------------------------------------------------------------
+
+bool query_results_store(const std::string& directory,
+						 const std::vector<std::string>& conditions,
+						 std::vector<sample_record>& results)
+{
+	bfs::path root(directory);
+	if (!bfs::exists(root / "samples.tsv"))
+	{
+		PRINT_ERROR << directory << " is not a results store." << std::endl;
+		return false;
+	}
+
+	std::vector<condition> parsed(conditions.size());
+	for (size_t i = 0 ; i < conditions.size() ; ++i)
+	{
+		if (!parse_condition(conditions[i], parsed[i]))
+		{
+			PRINT_ERROR << "Invalid condition: " << conditions[i] << "." << std::endl;
+			return false;
+		}
+	}
+
+	// Each positive condition narrows down the candidates. The samples matching a negated
+	// condition are excluded at the end.
+	static const std::map<condition::condition_type, std::string> INDEXES = boost::assign::map_list_of
+		(condition::IMPORT, "imports.idx")
+		(condition::SECTION, "sections.idx")
+		(condition::PERMISSIONS, "sections.idx")
+		(condition::PLUGIN, "verdicts.idx");
+	boost::unordered_set<boost::uint64_t> candidates, excluded;
+	bool restricted = false;
+	for (auto it = parsed.begin() ; it != parsed.end() ; ++it)
+	{
+		std::string index = (root / INDEXES.at(it->type)).string();
+		if (it->negated) {
+			scan_index(index, *it, nullptr, excluded);
+		}
+		else
+		{
+			boost::unordered_set<boost::uint64_t> found;
+			scan_index(index, *it, restricted ? &candidates : nullptr, found);
+			candidates.swap(found);
+			restricted = true;
+			if (candidates.empty()) { // No need to read the other indexes.
+				return true;
+			}
+		}
+	}
+
+	std::ifstream samples((root / "samples.tsv").string().c_str(), std::ios::binary);
+	boost::unordered_set<std::string> seen; // The same sample may have been stored several times.
+	std::string line;
+	std::vector<std::string> fields;
+	boost::uint64_t id;
+	while (std::getline(samples, line))
+	{
+		if (!split_line(line, id, fields) || fields.size() < 2 ||
+			(restricted && !candidates.count(id)) || excluded.count(id) || seen.count(fields[0])) {
+			continue;
+		}
+		seen.insert(fields[0]);
+		sample_record r;
+		r.sha256 = fields[0];
+		r.path = fields[1];
+		results.push_back(r);
+	}
+	return true;
+}
+
+} // !namespace mana
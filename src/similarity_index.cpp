@@ -0,0 +1,382 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "similarity_index.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "manacommons/color.h"
+
+namespace mana
+{
+
+namespace {
+
+const boost::uint32_t	MIN_BLOCKSIZE	= 3;
+const size_t			ROLLING_WINDOW	= 7;	// The size of the common substring two chunks must share.
+const size_t			SPAMSUM_LENGTH	= 64;	// The maximum length of a chunk.
+
+/**
+ *	@brief	The parts of an ssdeep hash ("block_size:chunk:double_chunk").
+ */
+struct signature
+{
+	boost::uint32_t block_size;
+	std::string		chunk;
+	std::string		double_chunk;
+};
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Removes the characters repeated more than 3 times in a row, which carry little
+ *			information and inflate the similarity scores.
+ */
+std::string eliminate_sequences(const std::string& s)
+{
+	std::string res;
+	res.reserve(s.size());
+	for (size_t i = 0 ; i < s.size() ; ++i)
+	{
+		if (i < 3 || s[i] != s[i - 1] || s[i] != s[i - 2] || s[i] != s[i - 3]) {
+			res += s[i];
+		}
+	}
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Splits an ssdeep hash into its parts. A trailing file name is ignored.
+ */
+bool parse_signature(const std::string& hash, signature& s)
+{
+	size_t first = hash.find(':');
+	size_t second = first == std::string::npos ? std::string::npos : hash.find(':', first + 1);
+	if (second == std::string::npos) {
+		return false;
+	}
+
+	try {
+		s.block_size = static_cast<boost::uint32_t>(std::stoul(hash.substr(0, first)));
+	}
+	catch (std::logic_error&) { // invalid_argument or out_of_range
+		return false;
+	}
+	if (s.block_size < MIN_BLOCKSIZE) {
+		return false;
+	}
+
+	s.chunk = eliminate_sequences(hash.substr(first + 1, second - first - 1));
+	s.double_chunk = eliminate_sequences(hash.substr(second + 1, hash.find(',', second) - second - 1));
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	A Levenshtein distance where substitutions cost as much as a deletion and an insertion.
+ */
+size_t edit_distance(const std::string& a, const std::string& b)
+{
+	std::vector<size_t> previous(b.size() + 1), current(b.size() + 1);
+	for (size_t j = 0 ; j <= b.size() ; ++j) {
+		previous[j] = j;
+	}
+	for (size_t i = 0 ; i < a.size() ; ++i)
+	{
+		current[0] = i + 1;
+		for (size_t j = 0 ; j < b.size() ; ++j)
+		{
+			current[j + 1] = std::min(std::min(previous[j + 1] + 1, current[j] + 1),
+									  previous[j] + (a[i] == b[j] ? 0 : 2));
+		}
+		previous.swap(current);
+	}
+	return previous[b.size()];
+}
+
+// ----------------------------------------------------------------------------
+
+bool has_common_substring(const std::string& a, const std::string& b)
+{
+	if (a.size() < ROLLING_WINDOW || b.size() < ROLLING_WINDOW) {
+		return false;
+	}
+	for (size_t i = 0 ; i + ROLLING_WINDOW <= a.size() ; ++i)
+	{
+		if (b.find(a.c_str() + i, 0, ROLLING_WINDOW) != std::string::npos) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Compares two chunks computed with the same block size.
+ */
+int score_strings(const std::string& a, const std::string& b, boost::uint32_t block_size)
+{
+	if (a.size() > SPAMSUM_LENGTH || b.size() > SPAMSUM_LENGTH || !has_common_substring(a, b)) {
+		return 0;
+	}
+
+	// Scale the distance to the length of the chunks, then turn it into a score out of 100.
+	size_t score = edit_distance(a, b) * SPAMSUM_LENGTH / (a.size() + b.size());
+	score = 100 * score / SPAMSUM_LENGTH;
+	if (score >= 100) {
+		return 0;
+	}
+	score = 100 - score;
+
+	// Short chunks computed with small block sizes would match too easily: cap their score.
+	if (block_size >= (99 + ROLLING_WINDOW) / ROLLING_WINDOW * MIN_BLOCKSIZE) {
+		return static_cast<int>(score);
+	}
+	size_t cap = block_size / MIN_BLOCKSIZE * std::min(a.size(), b.size());
+	return static_cast<int>(std::min(score, cap));
+}
+
+// ----------------------------------------------------------------------------
+
+int compare(const signature& a, const signature& b)
+{
+	if (a.block_size == b.block_size)
+	{
+		if (a.chunk == b.chunk) {
+			return 100;
+		}
+		return std::max(score_strings(a.chunk, b.chunk, a.block_size),
+						score_strings(a.double_chunk, b.double_chunk, 2 * a.block_size));
+	}
+	else if (static_cast<boost::uint64_t>(a.block_size) * 2 == b.block_size) {
+		return score_strings(a.double_chunk, b.chunk, b.block_size);
+	}
+	else if (static_cast<boost::uint64_t>(b.block_size) * 2 == a.block_size) {
+		return score_strings(a.chunk, b.double_chunk, a.block_size);
+	}
+	return 0; // Incompatible block sizes.
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Computes the keys of the buckets in which a chunk belongs.
+ *
+ *	Each key combines the block size with one of the 7-grams of the chunk. Block sizes are
+ *	always 3 * 2^n, so that n fits in the bits left by the 7-gram (7 * 6 bits).
+ *
+ *	@return	The keys of the chunk, without duplicates.
+ */
+std::vector<boost::uint64_t> get_keys(const std::string& chunk, boost::uint64_t block_size)
+{
+	static const std::string BASE64("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/");
+
+	boost::uint64_t exponent = 0;
+	while ((MIN_BLOCKSIZE * (static_cast<boost::uint64_t>(1) << exponent)) < block_size && exponent < 63) {
+		++exponent;
+	}
+
+	std::vector<boost::uint64_t> keys;
+	for (size_t i = 0 ; i + ROLLING_WINDOW <= chunk.size() ; ++i)
+	{
+		boost::uint64_t key = exponent;
+		size_t j = 0;
+		for ( ; j < ROLLING_WINDOW ; ++j)
+		{
+			size_t value = BASE64.find(chunk[i + j]);
+			if (value == std::string::npos) {
+				break;
+			}
+			key = (key << 6) | value;
+		}
+		if (j == ROLLING_WINDOW) {
+			keys.push_back(key);
+		}
+	}
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	return keys;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Computes the key under which identical chunks are found.
+ *
+ *	Chunks shorter than 7 characters have no 7-gram, but identical hashes still get a score
+ *	of 100 (see compare).
+ */
+std::string get_exact_key(const std::string& chunk, boost::uint32_t block_size)
+{
+	std::stringstream ss;
+	ss << block_size << ":" << chunk;
+	return ss.str();
+}
+
+} // !anonymous namespace
+
+// ----------------------------------------------------------------------------
+
+int compare_ssdeep(const std::string& a, const std::string& b)
+{
+	signature sa, sb;
+	if (!parse_signature(a, sa) || !parse_signature(b, sb)) {
+		return 0;
+	}
+	return compare(sa, sb);
+}
+
+// ----------------------------------------------------------------------------
+
+SimilarityIndex::SimilarityIndex(const std::string& path)
+{
+	std::ifstream input(path.c_str());
+	std::string line;
+	while (std::getline(input, line))
+	{
+		std::stringstream ss(line);
+		std::string hash;
+		entry e;
+		signature s;
+		if (!std::getline(ss, hash, '\t') || !std::getline(ss, e.sha256, '\t') ||
+			!std::getline(ss, e.path) || !parse_signature(hash, s) || _indexed.count(e.sha256))
+		{
+			continue;
+		}
+		e.block_size = s.block_size;
+		e.chunk = s.chunk;
+		e.double_chunk = s.double_chunk;
+		_insert(e);
+	}
+	input.close();
+
+	_file.open(path.c_str(), std::ios::app);
+	if (!_file.is_open()) {
+		PRINT_ERROR << "Could not open the similarity index " << path << "." << std::endl;
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void SimilarityIndex::_insert(const entry& e)
+{
+	boost::uint32_t id = static_cast<boost::uint32_t>(_entries.size());
+	_entries.push_back(e);
+	_indexed.insert(e.sha256);
+
+	std::vector<boost::uint64_t> keys = get_keys(e.chunk, e.block_size);
+	std::vector<boost::uint64_t> double_keys = get_keys(e.double_chunk, 2 * static_cast<boost::uint64_t>(e.block_size));
+	keys.insert(keys.end(), double_keys.begin(), double_keys.end());
+	for (auto it = keys.begin() ; it != keys.end() ; ++it)
+	{
+		std::vector<boost::uint32_t>& bucket = _buckets[*it];
+		if (bucket.empty() || bucket.back() != id) {
+			bucket.push_back(id);
+		}
+	}
+	_exact_buckets[get_exact_key(e.chunk, e.block_size)].push_back(id);
+}
+
+// ----------------------------------------------------------------------------
+
+bool SimilarityIndex::add(const std::string& ssdeep, const std::string& sha256, const std::string& path)
+{
+	signature s;
+	if (_indexed.count(sha256) || !parse_signature(ssdeep, s)) {
+		return false;
+	}
+
+	entry e;
+	e.block_size = s.block_size;
+	e.chunk = s.chunk;
+	e.double_chunk = s.double_chunk;
+	e.sha256 = sha256;
+	e.path = path;
+	_insert(e);
+
+	if (_file.is_open())
+	{
+		_file << ssdeep << "\t" << sha256 << "\t" << path << std::endl;
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+std::vector<similar_file> SimilarityIndex::find_similar(const std::string& ssdeep,
+														int threshold,
+														const std::string& exclude) const
+{
+	std::vector<similar_file> res;
+	signature s;
+	if (!parse_signature(ssdeep, s)) {
+		return res;
+	}
+
+	// Gather the files sharing at least one 7-gram with a chunk of the same block size, or
+	// the same chunk.
+	std::vector<boost::uint64_t> keys = get_keys(s.chunk, s.block_size);
+	std::vector<boost::uint64_t> double_keys = get_keys(s.double_chunk, 2 * static_cast<boost::uint64_t>(s.block_size));
+	keys.insert(keys.end(), double_keys.begin(), double_keys.end());
+	std::vector<boost::uint32_t> candidates;
+	for (auto it = keys.begin() ; it != keys.end() ; ++it)
+	{
+		auto bucket = _buckets.find(*it);
+		if (bucket != _buckets.end()) {
+			candidates.insert(candidates.end(), bucket->second.begin(), bucket->second.end());
+		}
+	}
+	auto exact = _exact_buckets.find(get_exact_key(s.chunk, s.block_size));
+	if (exact != _exact_buckets.end()) {
+		candidates.insert(candidates.end(), exact->second.begin(), exact->second.end());
+	}
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+	// Only the candidates are actually compared.
+	for (auto it = candidates.begin() ; it != candidates.end() ; ++it)
+	{
+		const entry& e = _entries[*it];
+		if (e.sha256 == exclude) {
+			continue;
+		}
+		signature candidate;
+		candidate.block_size = e.block_size;
+		candidate.chunk = e.chunk;
+		candidate.double_chunk = e.double_chunk;
+
+		similar_file f;
+		f.score = compare(s, candidate);
+		if (f.score > 0 && f.score >= threshold)
+		{
+			f.sha256 = e.sha256;
+			f.path = e.path;
+			res.push_back(f);
+		}
+	}
+
+	std::stable_sort(res.begin(), res.end(), [](const similar_file& a, const similar_file& b) {
+		return a.score > b.score;
+	});
+	return res;
+}
+
+} // !namespace mana
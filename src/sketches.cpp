@@ -0,0 +1,243 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "sketches.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace mana
+{
+
+boost::uint64_t hash_key(const std::string& key)
+{
+	// FNV-1a, followed by the finalizer of splitmix64 so that all the bits are well distributed.
+	boost::uint64_t h = 0xcbf29ce484222325ULL;
+	for (auto it = key.begin() ; it != key.end() ; ++it)
+	{
+		h ^= static_cast<boost::uint8_t>(*it);
+		h *= 0x100000001b3ULL;
+	}
+	h ^= h >> 30;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	h ^= h >> 27;
+	h *= 0x94d049bb133111ebULL;
+	h ^= h >> 31;
+	return h;
+}
+
+// ----------------------------------------------------------------------------
+
+CountMinSketch::CountMinSketch(unsigned int width_bits, unsigned int depth)
+	: _width_bits(width_bits), _depth(depth), _counters(static_cast<size_t>(depth) << width_bits, 0)
+{}
+
+// ----------------------------------------------------------------------------
+
+size_t CountMinSketch::_index(boost::uint64_t hash, unsigned int row) const
+{
+	// The rows use the hash functions h1 + row * h2 (Kirsch and Mitzenmacher).
+	boost::uint32_t h1 = static_cast<boost::uint32_t>(hash);
+	boost::uint32_t h2 = static_cast<boost::uint32_t>(hash >> 32) | 1;
+	boost::uint32_t column = (h1 + row * h2) & ((1U << _width_bits) - 1);
+	return (static_cast<size_t>(row) << _width_bits) + column;
+}
+
+// ----------------------------------------------------------------------------
+
+void CountMinSketch::add(boost::uint64_t hash, boost::uint64_t count)
+{
+	for (unsigned int row = 0 ; row < _depth ; ++row) {
+		_counters[_index(hash, row)] += count;
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+boost::uint64_t CountMinSketch::estimate(boost::uint64_t hash) const
+{
+	boost::uint64_t res = std::numeric_limits<boost::uint64_t>::max();
+	for (unsigned int row = 0 ; row < _depth ; ++row) {
+		res = std::min(res, _counters[_index(hash, row)]);
+	}
+	return _depth == 0 ? 0 : res;
+}
+
+// ----------------------------------------------------------------------------
+
+bool CountMinSketch::merge(const CountMinSketch& other)
+{
+	if (other._width_bits != _width_bits || other._depth != _depth) {
+		return false;
+	}
+	for (size_t i = 0 ; i < _counters.size() ; ++i) {
+		_counters[i] += other._counters[i];
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+HyperLogLog::HyperLogLog(unsigned int precision)
+	: _precision(std::min(18U, std::max(4U, precision))), _registers(static_cast<size_t>(1) << _precision, 0)
+{}
+
+// ----------------------------------------------------------------------------
+
+void HyperLogLog::add(boost::uint64_t hash)
+{
+	size_t index = static_cast<size_t>(hash >> (64 - _precision));
+	boost::uint64_t rest = (hash << _precision) | (1ULL << (_precision - 1)); // Bounds the rank.
+	boost::uint8_t rank = 1;
+	while (!(rest & 0x8000000000000000ULL))
+	{
+		++rank;
+		rest <<= 1;
+	}
+	_registers[index] = std::max(_registers[index], rank);
+}
+
+// ----------------------------------------------------------------------------
+
+boost::uint64_t HyperLogLog::estimate() const
+{
+	double m = static_cast<double>(_registers.size());
+	double sum = 0;
+	unsigned int zeros = 0;
+	for (auto it = _registers.begin() ; it != _registers.end() ; ++it)
+	{
+		sum += std::ldexp(1.0, -static_cast<int>(*it));
+		if (*it == 0) {
+			++zeros;
+		}
+	}
+
+	double alpha = 0.7213 / (1 + 1.079 / m);
+	double estimate = alpha * m * m / sum;
+	if (estimate <= 2.5 * m && zeros != 0) { // Small cardinalities: use linear counting.
+		estimate = m * std::log(m / zeros);
+	}
+	return static_cast<boost::uint64_t>(estimate + 0.5);
+}
+
+// ----------------------------------------------------------------------------
+
+bool HyperLogLog::merge(const HyperLogLog& other)
+{
+	if (other._precision != _precision) {
+		return false;
+	}
+	for (size_t i = 0 ; i < _registers.size() ; ++i) {
+		_registers[i] = std::max(_registers[i], other._registers[i]);
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+FrequencySketch::FrequencySketch(unsigned int capacity) : _capacity(std::max(1U, capacity)), _min(0)
+{}
+
+// ----------------------------------------------------------------------------
+
+void FrequencySketch::add(const std::string& key)
+{
+	boost::uint64_t h = hash_key(key);
+	_counts.add(h);
+	_distinct.add(h);
+	_offer(key, _counts.estimate(h));
+}
+
+// ----------------------------------------------------------------------------
+
+void FrequencySketch::_offer(const std::string& key, boost::uint64_t count)
+{
+	auto found = _top.find(key);
+	if (found != _top.end())
+	{
+		found->second = count;
+		return;
+	}
+	if (_top.size() < _capacity)
+	{
+		_top[key] = count;
+		_min = _top.size() == 1 ? count : std::min(_min, count);
+		return;
+	}
+	if (count <= _min) { // The common case, which doesn't require looking through the top keys.
+		return;
+	}
+
+	// Replace the least frequent key, then update the minimum.
+	auto smallest = _top.begin();
+	for (auto it = _top.begin() ; it != _top.end() ; ++it)
+	{
+		if (it->second < smallest->second) {
+			smallest = it;
+		}
+	}
+	if (smallest->second >= count)
+	{
+		_min = smallest->second;
+		return;
+	}
+	_top.erase(smallest);
+	_top[key] = count;
+	_min = count;
+	for (auto it = _top.begin() ; it != _top.end() ; ++it) {
+		_min = std::min(_min, it->second);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void FrequencySketch::merge(const FrequencySketch& other)
+{
+	_counts.merge(other._counts);
+	_distinct.merge(other._distinct);
+
+	// The candidates of both sketches are estimated again with the merged counts.
+	std::vector<std::string> candidates;
+	for (auto it = _top.begin() ; it != _top.end() ; ++it) {
+		candidates.push_back(it->first);
+	}
+	for (auto it = other._top.begin() ; it != other._top.end() ; ++it)
+	{
+		if (!_top.count(it->first)) {
+			candidates.push_back(it->first);
+		}
+	}
+	_top.clear();
+	_min = 0;
+	for (auto it = candidates.begin() ; it != candidates.end() ; ++it) {
+		_offer(*it, _counts.estimate(hash_key(*it)));
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+std::vector<std::pair<std::string, boost::uint64_t> > FrequencySketch::get_top_keys() const
+{
+	std::vector<std::pair<std::string, boost::uint64_t> > res(_top.begin(), _top.end());
+	std::sort(res.begin(), res.end(), [](const std::pair<std::string, boost::uint64_t>& a,
+										 const std::pair<std::string, boost::uint64_t>& b) {
+		return a.second != b.second ? a.second > b.second : a.first < b.first;
+	});
+	return res;
+}
+
+} // !namespace mana
@@ -0,0 +1,195 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "table_export.h"
+
+#include <boost/assign/list_of.hpp>
+
+namespace io
+{
+
+TableExporter::TableExporter(const std::string& directory, table_format format)
+	: _directory(directory), _format(format)
+{
+	boost::system::error_code ec;
+	if (!bfs::exists(_directory))
+	{
+		bfs::create_directories(_directory, ec);
+		if (ec)
+		{
+			PRINT_ERROR << "Could not create directory " << _directory.string() << " (" << ec.message() << ")." << std::endl;
+			return;
+		}
+	}
+
+	_open_table(_sections, "sections", boost::assign::list_of("sha256")("name")("virtual_address")("virtual_size")
+		("pointer_to_raw_data")("size_of_raw_data")("characteristics")("entropy"));
+	_open_table(_imports, "imports", boost::assign::list_of("sha256")("library")("function")("ordinal")("delay_loaded"));
+	_open_table(_exports, "exports", boost::assign::list_of("sha256")("ordinal")("address")("name")("forward_name"));
+	_open_table(_resources, "resources", boost::assign::list_of("sha256")("type")("name")("language")("codepage")
+		("size")("offset")("entropy"));
+}
+
+// ----------------------------------------------------------------------------
+
+bool TableExporter::is_open() const {
+	return _sections.is_open() && _imports.is_open() && _exports.is_open() && _resources.is_open();
+}
+
+// ----------------------------------------------------------------------------
+
+void TableExporter::_open_table(std::ofstream& table, const std::string& name, const std::vector<std::string>& columns)
+{
+	bfs::path table_path = _directory / (name + (_format == CSV ? ".csv" : ".tsv"));
+	bool write_header = !bfs::exists(table_path) || bfs::file_size(table_path) == 0;
+
+	table.open(table_path.string().c_str(), std::ios::out | std::ios::app | std::ios::binary);
+	if (!table.is_open())
+	{
+		PRINT_ERROR << "Could not open " << table_path.string() << "!" << std::endl;
+		return;
+	}
+	if (write_header) {
+		_write_row(table, columns);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+std::string TableExporter::escape(const std::string& value, table_format format)
+{
+	std::string res;
+	if (format == TSV)
+	{
+		if (value.find_first_of("\t\r\n\\") == std::string::npos) {
+			return value;
+		}
+		res.reserve(value.size() + 2);
+		for (auto it = value.begin() ; it != value.end() ; ++it)
+		{
+			switch (*it)
+			{
+				case '\t':	res += "\\t"; break;
+				case '\r':	res += "\\r"; break;
+				case '\n':	res += "\\n"; break;
+				case '\\':	res += "\\\\"; break;
+				default:	res += *it;
+			}
+		}
+	}
+	else
+	{
+		if (value.find_first_of(",\"\r\n") == std::string::npos) {
+			return value;
+		}
+		res.reserve(value.size() + 4);
+		res += '"';
+		for (auto it = value.begin() ; it != value.end() ; ++it)
+		{
+			if (*it == '"') { // Quotes are escaped by doubling them.
+				res += '"';
+			}
+			res += *it;
+		}
+		res += '"';
+	}
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+void TableExporter::_write_row(std::ofstream& table, const std::vector<std::string>& cells)
+{
+	char separator = _format == CSV ? ',' : '\t';
+	for (auto it = cells.begin() ; it != cells.end() ; ++it)
+	{
+		if (it != cells.begin()) {
+			table << separator;
+		}
+		table << escape(*it, _format);
+	}
+	table << '\n';
+}
+
+// ----------------------------------------------------------------------------
+
+void TableExporter::export_pe(const mana::PE& pe, const std::string& sha256)
+{
+	mana::shared_sections sections = pe.get_sections();
+	for (auto it = sections->begin() ; it != sections->end() ; ++it)
+	{
+		_write_row(_sections, boost::assign::list_of(sha256)
+			(*(*it)->get_name())
+			(std::to_string((*it)->get_virtual_address()))
+			(std::to_string((*it)->get_virtual_size()))
+			(std::to_string((*it)->get_pointer_to_raw_data()))
+			(std::to_string((*it)->get_size_of_raw_data()))
+			(std::to_string((*it)->get_characteristics()))
+			(std::to_string((*it)->get_entropy())));
+	}
+
+	mana::shared_imports imports = pe.get_imports();
+	for (auto it = imports->begin() ; it != imports->end() ; ++it)
+	{
+		pString library = (*it)->get_name();
+		if (library == nullptr) {
+			continue;
+		}
+		std::string delay_loaded = (*it)->get_type() == mana::ImportedLibrary::DELAY_LOADED ? "1" : "0";
+
+		// The functions are read from the library itself, and not looked up by its name: a DLL may
+		// be both imported and delay-loaded.
+		mana::pImports functions = (*it)->get_imports();
+		for (auto it2 = functions->begin() ; it2 != functions->end() ; ++it2)
+		{
+			// Functions imported by ordinal have no name.
+			std::string ordinal = (*it2)->Name.empty() ? std::to_string((*it2)->AddressOfData & 0xFFFF) : "";
+			_write_row(_imports, boost::assign::list_of(sha256)(*library)((*it2)->Name)(ordinal)(delay_loaded));
+		}
+	}
+
+	mana::shared_exports exports = pe.get_exports();
+	for (auto it = exports->begin() ; it != exports->end() ; ++it)
+	{
+		_write_row(_exports, boost::assign::list_of(sha256)
+			(std::to_string((*it)->Ordinal))
+			(std::to_string((*it)->Address))
+			((*it)->Name)
+			((*it)->ForwardName));
+	}
+
+	mana::shared_resources resources = pe.get_resources();
+	for (auto it = resources->begin() ; it != resources->end() ; ++it)
+	{
+		_write_row(_resources, boost::assign::list_of(sha256)
+			(*(*it)->get_type())
+			(*(*it)->get_name())
+			(*(*it)->get_language())
+			(std::to_string((*it)->get_codepage()))
+			(std::to_string((*it)->get_size()))
+			(std::to_string((*it)->get_offset()))
+			(std::to_string((*it)->get_entropy())));
+	}
+
+	// Keep the tables consistent with each other if the analysis is interrupted.
+	_sections.flush();
+	_imports.flush();
+	_exports.flush();
+	_resources.flush();
+}
+
+} // !namespace io
@@ -0,0 +1,162 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/assign/list_of.hpp>
+
+#include "plugin_framework/analysis_context.h"
+#include "plugin_framework/plugin_interface.h"
+#include "hash-library/hashes.h"
+#include "fixtures.h"
+
+BOOST_FIXTURE_TEST_SUITE(analysis_context, SetWorkingDirectory)
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(context_digests)
+{
+	mana::PE pe("testfiles/manatest.exe");
+	plugin::AnalysisContext context(pe);
+
+	pString sha256 = context.get_digest("SHA256");
+	BOOST_ASSERT(sha256);
+	BOOST_CHECK_EQUAL(*sha256, *hash::hash_file(*hash::ALL_DIGESTS.at(ALL_DIGESTS_SHA256), "testfiles/manatest.exe"));
+	BOOST_CHECK(context.get_digest("SHA256") == sha256); // The digest is only computed once.
+
+	context.compute_digests(boost::assign::list_of("MD5")("SHA256")("Imports Hash"));
+	BOOST_CHECK(context.get_digest("SHA256") == sha256);
+	pString md5 = context.get_digest("MD5");
+	BOOST_ASSERT(md5);
+	BOOST_CHECK_EQUAL(*md5, *hash::hash_file(*hash::ALL_DIGESTS.at(ALL_DIGESTS_MD5), "testfiles/manatest.exe"));
+	BOOST_CHECK(context.get_digest("Imports Hash"));
+
+	BOOST_CHECK(!context.get_digest("CRC32"));
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(context_known_digest)
+{
+	mana::PE pe("testfiles/manatest.exe");
+	plugin::AnalysisContext context(pe);
+
+	// A digest computed before the analysis is returned as is, and not computed again.
+	context.set_digest("SHA1", "4c3ef55f7b20598a396d8aacde610ef83295bb5c");
+	context.compute_digests(boost::assign::list_of("MD5")("SHA1"));
+	pString sha1 = context.get_digest("SHA1");
+	BOOST_ASSERT(sha1);
+	BOOST_CHECK_EQUAL(*sha1, "4c3ef55f7b20598a396d8aacde610ef83295bb5c");
+	BOOST_CHECK(context.get_digest("MD5"));
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(context_entropy)
+{
+	mana::PE pe("testfiles/manatest.exe");
+	plugin::AnalysisContext context(pe);
+
+	mana::shared_sections sections = pe.get_sections();
+	BOOST_ASSERT(sections->size() > 0);
+	for (auto it = sections->begin() ; it != sections->end() ; ++it)
+	{
+		BOOST_CHECK_EQUAL(context.get_section_entropy(*it), (*it)->get_entropy());
+		BOOST_CHECK_EQUAL(context.get_section_entropy(*it), (*it)->get_entropy());
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(context_results)
+{
+	mana::PE pe("testfiles/manatest.exe");
+	plugin::AnalysisContext context(pe);
+	BOOST_CHECK(!context.get_result("packer"));
+
+	// Results can only be created by plugins.
+	class DummyPlugin : public plugin::IPlugin
+	{
+	public:
+		int get_api_version() const override { return 2; }
+		pString get_id() const override { return boost::make_shared<std::string>("dummy"); }
+		pString get_description() const override { return boost::make_shared<std::string>("Dummy plugin."); }
+	};
+	DummyPlugin p;
+	plugin::pResult res = p.create_result();
+	res->set_level(plugin::SUSPICIOUS);
+	context.add_result("dummy", res);
+
+	BOOST_ASSERT(context.get_result("dummy"));
+	BOOST_CHECK_EQUAL(context.get_result("dummy")->get_level(), plugin::SUSPICIOUS);
+}
+
+// ----------------------------------------------------------------------------
+
+class V1Plugin : public plugin::IPlugin
+{
+public:
+	int get_api_version() const override { return 1; }
+	pString get_id() const override { return boost::make_shared<std::string>("v1"); }
+	pString get_description() const override { return boost::make_shared<std::string>("Version 1 plugin."); }
+	plugin::pResult analyze(const mana::PE& pe) override
+	{
+		plugin::pResult res = create_result();
+		res->set_summary(*pe.get_path());
+		return res;
+	}
+};
+
+class V2Plugin : public plugin::IPlugin
+{
+public:
+	int get_api_version() const override { return 2; }
+	pString get_id() const override { return boost::make_shared<std::string>("v2"); }
+	pString get_description() const override { return boost::make_shared<std::string>("Version 2 plugin."); }
+	plugin::pResult analyze_sample(plugin::IAnalysisContext& context) override
+	{
+		plugin::pResult res = create_result();
+		plugin::pResult previous = context.get_result("v1");
+		if (previous) {
+			res->set_summary(*previous->get_summary());
+		}
+		return res;
+	}
+};
+
+BOOST_AUTO_TEST_CASE(plugin_api_versions)
+{
+	mana::PE pe("testfiles/manatest.exe");
+	plugin::AnalysisContext context(pe);
+	V1Plugin v1;
+	V2Plugin v2;
+
+	plugin::pResult res = v1.run(context);
+	BOOST_ASSERT(res && res->get_summary());
+	BOOST_CHECK_EQUAL(*res->get_summary(), "testfiles/manatest.exe");
+	context.add_result("v1", res);
+
+	res = v2.run(context);
+	BOOST_ASSERT(res && res->get_summary());
+	BOOST_CHECK_EQUAL(*res->get_summary(), "testfiles/manatest.exe");
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,283 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+
+#include <boost/test/unit_test.hpp>
+
+#include "hash-library/sha256.h"
+#include "manape/pe.h"
+#include "plugins/plugin_authenticode/pe_integrity.h"
+#include "plugins/plugin_authenticode/certificates.h"
+#include "plugins/plugin_authenticode/der.h"
+#include "fixtures.h"
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Writes binary data to a file (create_file opens it in text mode).
+ */
+void write_binary_file(const std::string& path, const std::string& contents)
+{
+	std::ofstream f(path.c_str(), std::ios::binary);
+	f << contents;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Encodes a DER element.
+ */
+std::string der_encode(unsigned char tag, const std::string& content)
+{
+	std::string res(1, static_cast<char>(tag));
+	if (content.size() < 0x80) {
+		res += static_cast<char>(content.size());
+	}
+	else
+	{
+		res += '\x84';
+		for (int shift = 24 ; shift >= 0 ; shift -= 8) {
+			res += static_cast<char>((content.size() >> shift) & 0xFF);
+		}
+	}
+	return res + content;
+}
+
+/**
+ *	@brief	Builds an Authenticode signature whose signing time is nested in counter-signatures.
+ *
+ *	@param	unsigned int depth The number of counter-signatures around the signingTime attribute.
+ */
+std::vector<boost::uint8_t> nested_signature(unsigned int depth)
+{
+	const std::string empty_sequence = der_encode(0x30, "");
+	const std::string version = der_encode(0x02, "\x01");
+	std::string attribute = der_encode(0x30,
+		der_encode(0x06, "\x2A\x86\x48\x86\xF7\x0D\x01\x09\x05") +	// signingTime
+		der_encode(0x31, der_encode(0x17, "170824163433Z")));
+	std::string signer;
+	for (unsigned int i = 0 ; i <= depth ; ++i)
+	{
+		// SignerInfo ::= SEQUENCE { version, issuerAndSerialNumber, digestAlgorithm, [0] attributes,
+		//							 digestEncryptionAlgorithm, encryptedDigest }
+		signer = der_encode(0x30, version + der_encode(0x30, empty_sequence + version) + empty_sequence +
+			der_encode(0xA0, attribute) + empty_sequence + der_encode(0x04, ""));
+		attribute = der_encode(0x30,
+			der_encode(0x06, "\x2A\x86\x48\x86\xF7\x0D\x01\x09\x06") +	// counterSignature
+			der_encode(0x31, signer));
+	}
+	std::string signed_data = der_encode(0x30, version + der_encode(0x31, "") + empty_sequence + der_encode(0x31, signer));
+	std::string content_info = der_encode(0x30,
+		der_encode(0x06, "\x2A\x86\x48\x86\xF7\x0D\x01\x07\x02") +	// signedData
+		der_encode(0xA0, signed_data));
+	return std::vector<boost::uint8_t>(content_info.begin(), content_info.end());
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_SUITE(authenticode, SetWorkingDirectory)
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(pe_checksum)
+{
+	mana::PE pe("testfiles/manatest.exe");
+	boost::uint32_t checksum = 0;
+	std::string digest;
+	BOOST_REQUIRE(plugin::compute_pe_digest(pe, nullptr, checksum, digest));
+	BOOST_CHECK_EQUAL(checksum, 0x965E);
+	BOOST_CHECK_EQUAL(checksum, pe.get_image_optional_header()->Checksum);
+
+	// The CheckSum field of this one is empty.
+	mana::PE pe3("testfiles/manatest3.exe");
+	BOOST_REQUIRE(plugin::compute_pe_digest(pe3, nullptr, checksum, digest));
+	BOOST_CHECK_EQUAL(checksum, 0x7804);
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(authenticode_digest)
+{
+	mana::PE pe("testfiles/manatest.exe");
+	SHA256 sha256;
+	boost::uint32_t checksum = 0;
+	std::string digest;
+	BOOST_REQUIRE(plugin::compute_pe_digest(pe, &sha256, checksum, digest));
+	BOOST_CHECK_EQUAL(digest, "e1faaac62cc8dbba0b37122cde631e812a6d8436474f03170be4c509d5b583b7");
+
+	auto certificates = pe.get_certificates();
+	BOOST_ASSERT(certificates && certificates->size() == 1);
+	std::string algorithm;
+	BOOST_CHECK(plugin::read_signed_digest(certificates->at(0)->Certificate, algorithm, digest));
+	BOOST_CHECK_EQUAL(algorithm, "SHA512");
+	BOOST_CHECK_EQUAL(digest, "892fbb6648d63436de2861c264e324a7496f944b7df78ea1874f2c14e44710ee"
+							  "b0ea331ea076db3bdf68966824ee2051c77099bcb36087f24d9e7792035668ae");
+
+	// hash-library doesn't implement SHA512: only the checksum is verified.
+	plugin::pe_integrity integrity;
+	BOOST_REQUIRE(plugin::check_pe_integrity(pe, integrity));
+	BOOST_CHECK_EQUAL(integrity.checksum, integrity.header_checksum);
+	BOOST_CHECK_EQUAL(integrity.digest_algorithm, "SHA512");
+	BOOST_CHECK_EQUAL(integrity.signed_digest, digest);
+	BOOST_CHECK(integrity.digest.empty());
+
+	BOOST_CHECK(!plugin::read_signed_digest(std::vector<boost::uint8_t>(), algorithm, digest));
+	std::vector<boost::uint8_t> truncated(certificates->at(0)->Certificate.begin(),
+										  certificates->at(0)->Certificate.begin() + 64);
+	BOOST_CHECK(!plugin::read_signed_digest(truncated, algorithm, digest));
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(modified_pe)
+{
+	std::ifstream input("testfiles/manatest.exe", std::ios::binary);
+	std::string contents((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+	input.close();
+
+	// Modify a byte in the first section: both the checksum and the digest change.
+	contents[0x400] ^= 0xFF;
+	write_binary_file("modified.exe", contents);
+	{
+		mana::PE pe("modified.exe");
+		SHA256 sha256;
+		boost::uint32_t checksum = 0;
+		std::string digest;
+		BOOST_REQUIRE(plugin::compute_pe_digest(pe, &sha256, checksum, digest));
+		BOOST_CHECK_NE(checksum, pe.get_image_optional_header()->Checksum);
+		BOOST_CHECK_NE(digest, "e1faaac62cc8dbba0b37122cde631e812a6d8436474f03170be4c509d5b583b7");
+	}
+
+	// Modifying the CheckSum field doesn't affect either of them.
+	contents[0x400] ^= 0xFF;
+	auto e_lfanew = *reinterpret_cast<const boost::uint32_t*>(&contents[0x3C]);
+	contents[e_lfanew + 24 + 64] ^= 0xFF;
+	write_binary_file("modified.exe", contents);
+	{
+		mana::PE pe("modified.exe");
+		SHA256 sha256;
+		boost::uint32_t checksum = 0;
+		std::string digest;
+		BOOST_REQUIRE(plugin::compute_pe_digest(pe, &sha256, checksum, digest));
+		BOOST_CHECK_EQUAL(checksum, 0x965E);
+		BOOST_CHECK_EQUAL(digest, "e1faaac62cc8dbba0b37122cde631e812a6d8436474f03170be4c509d5b583b7");
+	}
+	fs::remove("modified.exe");
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(der_walker)
+{
+	// SEQUENCE { UTCTime, GeneralizedTime, BMPString }
+	const std::string encoded("\x30\x26"
+							  "\x17\x0D" "170824163433Z"
+							  "\x18\x0F" "19990101000000Z"
+							  "\x1E\x04" "\x00\xE9\x00\x74", 40);
+	const boost::uint8_t* data = reinterpret_cast<const boost::uint8_t*>(encoded.data());
+	plugin::der::Reader reader(data, encoded.size());
+	plugin::der::element sequence, e;
+	BOOST_REQUIRE(reader.next(plugin::der::SEQUENCE, sequence));
+	BOOST_CHECK(reader.at_end());
+	BOOST_CHECK_EQUAL(sequence.total_size(), encoded.size());
+
+	plugin::der::Reader children(sequence);
+	BOOST_CHECK(!children.next(plugin::der::GENERALIZED_TIME, e)); // Wrong tag: the reader doesn't move.
+	BOOST_REQUIRE(children.next(plugin::der::UTC_TIME, e));
+	BOOST_CHECK_EQUAL(plugin::der::read_time(e), "2017-08-24 16:34:33");
+	BOOST_REQUIRE(children.next(e));
+	BOOST_CHECK_EQUAL(plugin::der::read_time(e), "1999-01-01 00:00:00");
+	BOOST_REQUIRE(children.next(e));
+	BOOST_CHECK_EQUAL(plugin::der::read_string(e), "\xC3\xA9t");
+	BOOST_CHECK(!children.next(e));
+
+	// TeletexStrings are read as Latin-1.
+	const std::string teletex("\x14\x02" "\xE9t", 4);
+	plugin::der::Reader teletex_reader(reinterpret_cast<const boost::uint8_t*>(teletex.data()), teletex.size());
+	BOOST_REQUIRE(teletex_reader.next(e));
+	BOOST_CHECK_EQUAL(plugin::der::read_string(e), "\xC3\xA9t");
+
+	// Truncated elements are rejected.
+	plugin::der::Reader truncated(data, 10);
+	BOOST_CHECK(!truncated.next(e));
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(certificate_cache)
+{
+	mana::PE pe("testfiles/manatest.exe");
+	auto certificates = pe.get_certificates();
+	BOOST_ASSERT(certificates && certificates->size() == 1);
+
+	plugin::CertificateCache cache(10);
+	plugin::signature_info info;
+	BOOST_REQUIRE(plugin::read_signature(certificates->at(0)->Certificate, cache, info));
+	BOOST_CHECK_EQUAL(info.certificates.size(), 2);
+	BOOST_CHECK_EQUAL(cache.size(), 2);
+	BOOST_ASSERT(info.signer);
+	BOOST_CHECK_EQUAL(info.signer->subject, "E=ivan@kwiatkowski.fr, CN=Ivan Kwiatkowski, L=Boulogne-Billancourt, "
+											"ST=Ile-de-France, C=FR");
+	BOOST_CHECK_EQUAL(info.signer->issuer, "CN=StartCom Class 2 Primary Intermediate Object CA, "
+										   "OU=Secure Digital Certificate Signing, O=StartCom Ltd., C=IL");
+	BOOST_CHECK_EQUAL(info.signer->serial, "12a24c22763396");
+	BOOST_CHECK_EQUAL(info.signer->thumbprint, "26fc24c12b2d84f77615cf6299e3e4ca4f3878fc");
+	BOOST_CHECK_EQUAL(info.signer->not_before, "2015-08-17 04:32:24");
+	BOOST_CHECK_EQUAL(info.signer->not_after, "2017-08-17 16:34:33");
+	BOOST_CHECK(info.signing_time.empty()); // This binary isn't timestamped.
+
+	// The second time, the certificates come from the cache.
+	plugin::signature_info again;
+	BOOST_REQUIRE(plugin::read_signature(certificates->at(0)->Certificate, cache, again));
+	BOOST_CHECK_EQUAL(again.signer.get(), info.signer.get());
+	BOOST_CHECK_EQUAL(cache.size(), 2);
+
+	// Certificates are still parsed once the cache is full.
+	plugin::CertificateCache small_cache(1);
+	plugin::signature_info uncached;
+	BOOST_REQUIRE(plugin::read_signature(certificates->at(0)->Certificate, small_cache, uncached));
+	BOOST_CHECK_EQUAL(small_cache.size(), 1);
+	BOOST_ASSERT(uncached.signer);
+	BOOST_CHECK_EQUAL(uncached.signer->thumbprint, info.signer->thumbprint);
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(nested_counter_signatures)
+{
+	plugin::CertificateCache cache(10);
+	plugin::signature_info info;
+	BOOST_REQUIRE(plugin::read_signature(nested_signature(0), cache, info));
+	BOOST_CHECK_EQUAL(info.signing_time, "2017-08-24 16:34:33");
+	BOOST_CHECK(!info.signer);
+
+	plugin::signature_info counter_signed;
+	BOOST_REQUIRE(plugin::read_signature(nested_signature(2), cache, counter_signed));
+	BOOST_CHECK_EQUAL(counter_signed.signing_time, "2017-08-24 16:34:33");
+
+	// Counter-signatures nested too deeply are ignored instead of being walked recursively.
+	plugin::signature_info crafted;
+	BOOST_REQUIRE(plugin::read_signature(nested_signature(2000), cache, crafted));
+	BOOST_CHECK(crafted.signing_time.empty());
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,211 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <sstream>
+#include <limits>
+
+#include <boost/test/unit_test.hpp>
+
+#include "cbor.h"
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Converts a string of bytes into its hexadecimal representation.
+ */
+std::string to_hex(const std::string& bytes)
+{
+	static const char* hex_digits = "0123456789abcdef";
+	std::string res;
+	for (auto it = bytes.begin() ; it != bytes.end() ; ++it)
+	{
+		res += hex_digits[(static_cast<unsigned char>(*it) >> 4) & 0xF];
+		res += hex_digits[static_cast<unsigned char>(*it) & 0xF];
+	}
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Converts a single CBOR item into JSON by wrapping it in a record.
+ */
+std::string item_to_json(const std::string& item)
+{
+	std::stringstream records, json;
+	io::cbor::write_record(records, item);
+	BOOST_CHECK(io::cbor::records_to_json(records, json));
+	return json.str();
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_cbor_integers)
+{
+	// Test vectors from RFC 7049, appendix A.
+	io::cbor::Writer w(false);
+	w.write_uint(0);
+	w.write_uint(23);
+	w.write_uint(24);
+	w.write_uint(1000);
+	w.write_uint(1000000);
+	w.write_uint(1000000000000ULL);
+	BOOST_CHECK_EQUAL(to_hex(w.get_buffer()), "00171818" "1903e8" "1a000f4240" "1b000000e8d4a51000");
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_cbor_floats)
+{
+	io::cbor::Writer w(false);
+	w.write_float(100000.0f);
+	w.write_double(1.1);
+	BOOST_CHECK_EQUAL(to_hex(w.get_buffer()), "fa47c35000" "fb3ff199999999999a");
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_cbor_strings)
+{
+	io::cbor::Writer w(false);
+	w.write_string("");
+	w.write_string("IETF");
+	w.write_string("\xff\xfe"); // Not valid UTF-8: written as a byte string.
+	BOOST_CHECK_EQUAL(to_hex(w.get_buffer()), "60" "6449455446" "42fffe");
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_cbor_string_references)
+{
+	io::cbor::Writer w(true);
+	w.write_array_header(4);
+	w.write_string("aaa");
+	w.write_string("bb"); // Too short to be added to the table.
+	w.write_string("aaa");
+	w.write_string("bb");
+	// Namespace tag, array, "aaa", "bb", reference to index 0, "bb".
+	BOOST_CHECK_EQUAL(to_hex(w.get_buffer()), "d90100" "84" "63616161" "626262" "d81900" "626262");
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_cbor_to_json)
+{
+	io::cbor::Writer w(true);
+	w.write_map_header(1);
+	w.write_string("file.exe");
+	w.write_map_header(3);
+	w.write_string("Name");
+	w.write_string("file.exe");
+	w.write_string("Size");
+	w.write_uint(1024);
+	w.write_string("Strings");
+	w.write_array_header(2);
+	w.write_string("\"quoted\"");
+	w.write_string("\xe9");
+	BOOST_CHECK_EQUAL(item_to_json(w.get_buffer()),
+		"{\n"
+		"    \"file.exe\": {\n"
+		"        \"Name\": \"file.exe\",\n"
+		"        \"Size\": 1024,\n"
+		"        \"Strings\": [\n"
+		"            \"\\\"quoted\\\"\",\n"
+		"            \"\\u00e9\"\n"
+		"        ]\n"
+		"    }\n"
+		"}\n");
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_cbor_truncated_record)
+{
+	std::stringstream records, json;
+	io::cbor::write_record(records, "\x61");
+	BOOST_CHECK(!io::cbor::records_to_json(records, json));
+
+	std::stringstream truncated(std::string("\x00\x00\x00\x05\xa1", 5)), json2;
+	BOOST_CHECK(!io::cbor::records_to_json(truncated, json2));
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_cbor_floats_to_json)
+{
+	// Floating point values keep their full precision.
+	io::cbor::Writer w(false);
+	w.write_map_header(4);
+	w.write_string("Double");
+	w.write_double(0.1 + 0.2);
+	w.write_string("Short");
+	w.write_double(1.1);
+	w.write_string("Float");
+	w.write_float(7.9876543f);
+	w.write_string("Infinity");
+	w.write_double(std::numeric_limits<double>::infinity());
+	BOOST_CHECK_EQUAL(item_to_json(w.get_buffer()),
+		"{\n"
+		"    \"Double\": 0.30000000000000004,\n"
+		"    \"Short\": 1.1,\n"
+		"    \"Float\": 7.987654,\n"
+		"    \"Infinity\": null\n"
+		"}\n");
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_cbor_forged_length)
+{
+	// The length is over 2 GB: it is neither sign-extended nor allocated before being read.
+	std::stringstream records(std::string("\xff\xff\xff\xf0\xa0", 5)), json;
+	BOOST_CHECK(!io::cbor::records_to_json(records, json));
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_cbor_max_depth)
+{
+	// A map containing nested arrays.
+	io::cbor::Writer w(false);
+	w.write_map_header(1);
+	w.write_string("a");
+	for (int i = 0 ; i < 100 ; ++i) {
+		w.write_array_header(1);
+	}
+	w.write_uint(0);
+	std::stringstream records, json;
+	io::cbor::write_record(records, w.get_buffer());
+	BOOST_CHECK(io::cbor::records_to_json(records, json));
+
+	// Crafted items can't nest deeper than the decoder allows.
+	std::string item("\xa1\x61" "a", 3);
+	item += std::string(100000, '\x81');
+	item += '\x00';
+	std::stringstream deep_records, deep_json;
+	io::cbor::write_record(deep_records, item);
+	BOOST_CHECK(!io::cbor::records_to_json(deep_records, deep_json));
+
+	// Chains of tags as well.
+	item = std::string("\xa1\x61" "a", 3);
+	item += std::string(100000, '\xc1');
+	item += '\x00';
+	std::stringstream tag_records, tag_json;
+	io::cbor::write_record(tag_records, item);
+	BOOST_CHECK(!io::cbor::records_to_json(tag_records, tag_json));
+}
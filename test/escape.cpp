@@ -88,4 +88,44 @@ BOOST_AUTO_TEST_CASE(test_string_escape_json)
 	check_string_escaping_json("\\\\", "\\\\\\\\");
 	check_string_escaping_json("\x01", "\x01");
 	check_string_escaping_json("\r\n", "\\r\\n");
-}
\ No newline at end of file
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_needs_escaping)
+{
+	// Try every byte value at every position of a string long enough to be scanned in
+	// several blocks, and make sure the fast path agrees with the grammars.
+	for (unsigned int c = 0 ; c < 256 ; ++c)
+	{
+		bool expected_raw = c < 0x20 || c > 0x7E;
+		bool expected_json = (c >= '\a' && c <= '\r') || c == '"' || c == '\\';
+		for (unsigned int position = 0 ; position < 40 ; ++position)
+		{
+			std::string s(40, 'A');
+			s[position] = static_cast<char>(c);
+			BOOST_CHECK_EQUAL(io::needs_escaping(s), expected_raw);
+			BOOST_CHECK_EQUAL(io::needs_escaping<JsonFormatterPlaceholder>(s), expected_json);
+			BOOST_CHECK_EQUAL(*io::escape(s) != s, expected_raw);
+			BOOST_CHECK_EQUAL(*io::escape<JsonFormatterPlaceholder>(s) != s, expected_json);
+		}
+	}
+	BOOST_CHECK(!io::needs_escaping(""));
+	BOOST_CHECK(!io::needs_escaping<JsonFormatterPlaceholder>(""));
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_escape_shared_string)
+{
+	// Strings which don't need to be escaped are returned as-is, without a copy.
+	pString plain = boost::make_shared<std::string>("All characters are printable.");
+	BOOST_CHECK(io::escape<JsonFormatterPlaceholder>(plain) == plain);
+
+	pString dirty = boost::make_shared<std::string>("C:\\Windows\\");
+	pString escaped = io::escape<JsonFormatterPlaceholder>(dirty);
+	BOOST_ASSERT(escaped != nullptr);
+	BOOST_CHECK(escaped != dirty);
+	BOOST_CHECK_EQUAL(*escaped, "C:\\\\Windows\\\\");
+	BOOST_CHECK(io::escape<JsonFormatterPlaceholder>(pString()) == nullptr);
+}
@@ -0,0 +1,167 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+#include "feature_index.h"
+#include "fixtures.h"
+
+namespace {
+
+const std::string SAMPLE_A = std::string(64, 'a');
+const std::string SAMPLE_B = std::string(64, 'b');
+const std::string SAMPLE_C = std::string(64, 'c');
+
+/**
+ *	@brief	Counts the segments of a feature index.
+ */
+unsigned int count_segments(const std::string& directory)
+{
+	unsigned int res = 0;
+	for (fs::directory_iterator it(directory), end ; it != end ; ++it)
+	{
+		if (it->path().extension() == ".seg") {
+			++res;
+		}
+	}
+	return res;
+}
+
+} // !anonymous namespace
+
+// ----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_SUITE(feature_index, SetWorkingDirectory)
+
+BOOST_AUTO_TEST_CASE(extract_features)
+{
+	mana::PE pe("testfiles/manatest.exe");
+	std::vector<std::string> features = mana::extract_features(pe);
+	BOOST_CHECK(std::find(features.begin(), features.end(), "imphash:924ac5aa343a9f838d5c16a5d77de2ec") != features.end());
+	BOOST_CHECK(std::find(features.begin(), features.end(), "pdb:E:\\Developpement\\CSandbox\\Release\\CSandbox.pdb") != features.end());
+	BOOST_CHECK(std::find(features.begin(), features.end(), "pdb_guid:EF2C74CA-738C-4A32-8F99-C51D0D7E6D18") != features.end());
+	BOOST_CHECK_EQUAL(std::count_if(features.begin(), features.end(), [](const std::string& f) {
+		return f.find("section:") == 0;
+	}), 6);
+	BOOST_CHECK(std::count_if(features.begin(), features.end(), [](const std::string& f) {
+		return f.find("resource:") == 0;
+	}) > 0);
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(lookup)
+{
+	const std::string directory = "feature_index.test";
+	fs::remove_all(directory);
+	{
+		mana::FeatureIndex index(directory);
+		BOOST_ASSERT(index.is_open());
+		BOOST_CHECK(index.add(SAMPLE_A, { "imphash:1234", "pdb:a.pdb" }));
+		BOOST_CHECK(index.add(SAMPLE_B, { "imphash:1234", "section:5678" }));
+		BOOST_CHECK(!index.add("not a hash", { "imphash:1234" }));
+		BOOST_CHECK(index.flush());
+		BOOST_CHECK_EQUAL(count_segments(directory), 1);
+
+		// The same records, written by another writer.
+		mana::FeatureIndex other(directory);
+		BOOST_CHECK(other.add(SAMPLE_B, { "imphash:1234" }));
+		BOOST_CHECK(other.add(SAMPLE_C, { "section:5678" }));
+	}
+	BOOST_CHECK_EQUAL(count_segments(directory), 2);
+
+	mana::FeatureIndex index(directory);
+	std::vector<std::string> samples = index.lookup("imphash:1234");
+	BOOST_ASSERT(samples.size() == 2);
+	BOOST_CHECK_EQUAL(samples[0], SAMPLE_A);
+	BOOST_CHECK_EQUAL(samples[1], SAMPLE_B);
+	samples = index.lookup("section:5678");
+	BOOST_ASSERT(samples.size() == 2);
+	BOOST_CHECK_EQUAL(samples[0], SAMPLE_B);
+	BOOST_CHECK_EQUAL(samples[1], SAMPLE_C);
+	BOOST_CHECK_EQUAL(index.lookup("pdb:a.pdb").size(), 1);
+	BOOST_CHECK(index.lookup("pdb:b.pdb").empty());
+
+	// Merging the segments doesn't change the results.
+	BOOST_CHECK(index.compact());
+	BOOST_CHECK_EQUAL(count_segments(directory), 1);
+	mana::FeatureIndex compacted(directory);
+	BOOST_CHECK_EQUAL(compacted.lookup("imphash:1234").size(), 2);
+	BOOST_CHECK_EQUAL(compacted.lookup("section:5678").size(), 2);
+	BOOST_CHECK_EQUAL(compacted.lookup("pdb:a.pdb").size(), 1);
+	fs::remove_all(directory);
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(size_tiered_merges)
+{
+	const std::string directory = "feature_index_tiers.test";
+	fs::remove_all(directory);
+	mana::FeatureIndex index(directory);
+	for (int i = 0 ; i < 100 ; ++i)
+	{
+		std::string sample(64, '0');
+		sample[0] = "0123456789abcdef"[i / 16];
+		sample[1] = "0123456789abcdef"[i % 16];
+		index.add(sample, { "imphash:shared" });
+		BOOST_CHECK(index.flush());
+	}
+
+	// Segments of 64, 16, 16 and 4 records are left: 100 = 1 * 4^3 + 2 * 4^2 + 1 * 4^1.
+	BOOST_CHECK_EQUAL(count_segments(directory), 4);
+	BOOST_CHECK_EQUAL(index.lookup("imphash:shared").size(), 100);
+	fs::remove_all(directory);
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(concurrent_writers)
+{
+	const std::string directory = "feature_index_concurrent.test";
+	fs::remove_all(directory);
+	{
+		// Writers flushing concurrently, with enough segments to trigger compactions.
+		boost::thread_group threads;
+		for (int t = 0 ; t < 4 ; ++t)
+		{
+			threads.create_thread([t, &directory]() {
+				mana::FeatureIndex index(directory);
+				for (int i = 0 ; i < 20 ; ++i)
+				{
+					std::string sample(64, '0');
+					sample[0] = "0123456789abcdef"[t];
+					sample[1] = "0123456789abcdef"[i / 16];
+					sample[2] = "0123456789abcdef"[i % 16];
+					index.add(sample, { "imphash:shared", "section:" + sample });
+					index.flush();
+				}
+			});
+		}
+		threads.join_all();
+	}
+
+	mana::FeatureIndex index(directory);
+	BOOST_CHECK_EQUAL(index.lookup("imphash:shared").size(), 80);
+	BOOST_CHECK_EQUAL(index.lookup("section:20a" + std::string(61, '0')).size(), 1);
+	BOOST_CHECK(count_segments(directory) < 80); // The segments were merged.
+	fs::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
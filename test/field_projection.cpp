@@ -0,0 +1,121 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/assign/list_of.hpp>
+
+#include "field_projection.h"
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_projection_plan)
+{
+	std::vector<std::string> fields = boost::assign::list_of
+		("Hashes/SHA256")("Hashes/Imports Hash")("Summary/Compilation Date")("Plugins/packer/level")("Plugins/clamav");
+	io::FieldProjection projection(fields);
+	BOOST_ASSERT(projection.is_valid());
+
+	BOOST_CHECK_EQUAL(projection.get_categories().size(), 1);
+	BOOST_CHECK_EQUAL(projection.get_categories().at(0), "summary");
+	BOOST_CHECK(projection.needs_hashes());
+	BOOST_CHECK(!projection.needs_entry_hashes());
+	BOOST_CHECK_EQUAL(projection.get_digests().size(), 2);
+	BOOST_CHECK(projection.get_digests().count("SHA256"));
+	BOOST_CHECK(projection.get_digests().count("Imports Hash"));
+
+	std::vector<std::string> plugins = projection.get_plugins();
+	std::vector<std::string> expected = boost::assign::list_of("clamav")("packer");
+	BOOST_CHECK_EQUAL_COLLECTIONS(plugins.begin(), plugins.end(), expected.begin(), expected.end());
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_projection_plan_whole_nodes)
+{
+	std::vector<std::string> fields = boost::assign::list_of("Hashes/MD5")("Hashes")("Plugins")("Sections/*/SHA1");
+	io::FieldProjection projection(fields);
+	BOOST_ASSERT(projection.is_valid());
+
+	BOOST_CHECK(projection.needs_hashes());
+	BOOST_CHECK(projection.get_digests().empty()); // "Hashes" requests all of them.
+	BOOST_CHECK(projection.needs_entry_hashes());
+	BOOST_CHECK_EQUAL(projection.get_plugins().size(), 1);
+	BOOST_CHECK_EQUAL(projection.get_plugins().at(0), "all");
+	BOOST_CHECK_EQUAL(projection.get_categories().size(), 1);
+	BOOST_CHECK_EQUAL(projection.get_categories().at(0), "sections");
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_projection_invalid)
+{
+	BOOST_CHECK(!io::FieldProjection(boost::assign::list_of("Unknown/Field")).is_valid());
+	BOOST_CHECK(!io::FieldProjection(boost::assign::list_of("Hashes/CRC32")).is_valid());
+	BOOST_CHECK(!io::FieldProjection(boost::assign::list_of("Summary//Architecture")).is_valid());
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_projection_apply)
+{
+	io::pNode file_node = io::make_node("file.exe", io::OutputTreeNode::LIST);
+
+	io::pNode summary = io::make_node("Summary", io::OutputTreeNode::LIST);
+	summary->append(io::make_node("Architecture", std::string("IMAGE_FILE_MACHINE_I386")));
+	summary->append(io::make_node("Compilation Date", std::string("2016-Jan-01 00:00:00")));
+	file_node->append(summary);
+
+	io::pNode sections = io::make_node("Sections", io::OutputTreeNode::LIST);
+	io::pNode text = io::make_node(".text", io::OutputTreeNode::LIST);
+	text->append(io::make_node("VirtualSize", static_cast<boost::uint32_t>(0x1000)));
+	text->append(io::make_node("Entropy", 6.5));
+	sections->append(text);
+	io::pNode data = io::make_node(".data", io::OutputTreeNode::LIST);
+	data->append(io::make_node("VirtualSize", static_cast<boost::uint32_t>(0x200)));
+	data->append(io::make_node("Entropy", 1.5));
+	sections->append(data);
+	file_node->append(sections);
+
+	io::pNode hashes = io::make_node("Hashes", io::OutputTreeNode::LIST);
+	hashes->append(io::make_node("MD5", std::string("d41d8cd98f00b204e9800998ecf8427e")));
+	file_node->append(hashes);
+
+	std::vector<std::string> fields = boost::assign::list_of
+		("Summary/Compilation Date")("Sections/*/Entropy")("Hashes/SHA256")("Summary/Architecture/Unknown");
+	io::FieldProjection projection(fields);
+	BOOST_ASSERT(projection.is_valid());
+	projection.apply(file_node);
+
+	// The Hashes node doesn't contain any requested field and is removed altogether.
+	BOOST_ASSERT(file_node->size() == 2);
+	io::pNode s = file_node->find_node("Summary");
+	BOOST_ASSERT(s);
+	BOOST_CHECK_EQUAL(s->size(), 1);
+	BOOST_CHECK(s->find_node("Compilation Date"));
+	BOOST_CHECK(!s->find_node("Architecture"));
+
+	io::pNode sec = file_node->find_node("Sections");
+	BOOST_ASSERT(sec);
+	BOOST_ASSERT(sec->size() == 2);
+	BOOST_CHECK_EQUAL(sec->find_node(".text")->size(), 1);
+	BOOST_CHECK(sec->find_node(".text")->find_node("Entropy"));
+	BOOST_CHECK_EQUAL(sec->find_node(".data")->size(), 1);
+	BOOST_CHECK(!file_node->find_node("Hashes"));
+}
@@ -0,0 +1,113 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <sstream>
+
+#include <boost/test/unit_test.hpp>
+
+#include "known_good.h"
+#include "manape/pe.h"
+#include "fixtures.h"
+
+BOOST_FIXTURE_TEST_SUITE(known_good, SetWorkingDirectory)
+
+BOOST_AUTO_TEST_CASE(build_known_good_set)
+{
+	const std::string set_file = "known_good.test";
+	std::stringstream nsrl;
+	nsrl << "\"SHA-1\",\"MD5\",\"CRC32\",\"FileName\",\"FileSize\",\"ProductCode\",\"OpSystemCode\",\"SpecialCode\"\n"
+		 << "\"4C3EF55F7B20598A396D8AACDE610EF83295BB5C\",\"D41D8CD98F00B204E9800998ECF8427E\",\"00000000\",\"manatest.exe\",10,1,\"358\",\"\"\n"
+		 << "\"0000000000000000000000000000000000000001\",\"D41D8CD98F00B204E9800998ECF8427E\",\"00000000\",\"a.exe\",0,1,\"358\",\"\"\n"
+		 << "\"4C3EF55F7B20598A396D8AACDE610EF83295BB5C\",\"D41D8CD98F00B204E9800998ECF8427E\",\"00000000\",\"copy.exe\",10,2,\"358\",\"\"\n"
+		 << "d41d8cd98f00b204e9800998ecf8427e\n"	// Not a SHA1.
+		 << "ffffffffffffffffffffffffffffffffffffffff\n";
+
+	boost::uint64_t count = 0;
+	BOOST_REQUIRE(mana::build_known_good_set(nsrl, set_file, count));
+	BOOST_CHECK_EQUAL(count, 3);
+
+	mana::KnownGoodSet set(set_file);
+	BOOST_CHECK_EQUAL(set.size(), 3);
+	BOOST_CHECK_EQUAL(set.get_digest_name(), "SHA1");
+	BOOST_CHECK(set.contains("4c3ef55f7b20598a396d8aacde610ef83295bb5c"));
+	BOOST_CHECK(set.contains("0000000000000000000000000000000000000001"));
+	BOOST_CHECK(set.contains("FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF"));
+	BOOST_CHECK(!set.contains("0000000000000000000000000000000000000002"));
+	BOOST_CHECK(!set.contains("d41d8cd98f00b204e9800998ecf8427e"));
+	BOOST_CHECK(!set.contains("4c3ef55f7b20598a396d8aacde610ef83295bb5c00"));
+
+	std::string digest;
+	BOOST_CHECK(set.contains_file("testfiles/manatest.exe", digest));
+	BOOST_CHECK_EQUAL(digest, "4c3ef55f7b20598a396d8aacde610ef83295bb5c");
+	BOOST_CHECK(!set.contains_file("testfiles/manatest2.exe", digest));
+	BOOST_CHECK_EQUAL(digest, "bca828f9d0832df23efc278a0bcaf102f5d79208");
+	fs::remove(set_file);
+
+	std::stringstream empty("\"SHA-1\",\"MD5\"\n");
+	BOOST_CHECK(!mana::build_known_good_set(empty, set_file, count));
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(known_good_not_parsed)
+{
+	const std::string set_file = "known_good.test";
+	std::stringstream list("4c3ef55f7b20598a396d8aacde610ef83295bb5c\n");
+	boost::uint64_t count = 0;
+	BOOST_REQUIRE(mana::build_known_good_set(list, set_file, count));
+	mana::KnownGoodSet set(set_file);
+
+	int parsed = 0;
+	auto parse = [&parsed](const std::string& path) -> boost::shared_ptr<mana::PE>
+	{
+		++parsed;
+		return mana::PE::create(path);
+	};
+
+	// A known good file is hashed, but the PE is never constructed.
+	std::string digest;
+	BOOST_CHECK(!mana::parse_unless_known_good(&set, "testfiles/manatest.exe", digest, parse));
+	BOOST_CHECK_EQUAL(parsed, 0);
+	BOOST_CHECK_EQUAL(digest, "4c3ef55f7b20598a396d8aacde610ef83295bb5c");
+
+	boost::shared_ptr<mana::PE> pe = mana::parse_unless_known_good(&set, "testfiles/manatest2.exe", digest, parse);
+	BOOST_CHECK(pe && pe->is_valid());
+	BOOST_CHECK_EQUAL(parsed, 1);
+	BOOST_CHECK_EQUAL(digest, "bca828f9d0832df23efc278a0bcaf102f5d79208");
+
+	// Without a set, the file is parsed and not hashed.
+	digest.clear();
+	BOOST_CHECK(mana::parse_unless_known_good(nullptr, "testfiles/manatest.exe", digest, parse));
+	BOOST_CHECK_EQUAL(parsed, 2);
+	BOOST_CHECK(digest.empty());
+	fs::remove(set_file);
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(invalid_known_good_set)
+{
+	mana::KnownGoodSet missing("nonexistent_file.bin");
+	BOOST_CHECK(!missing.contains("4c3ef55f7b20598a396d8aacde610ef83295bb5c"));
+	BOOST_CHECK_EQUAL(missing.get_digest_name(), "");
+	BOOST_CHECK_EQUAL(missing.size(), 0);
+
+	mana::KnownGoodSet invalid("testfiles/manatest.exe");
+	std::string digest;
+	BOOST_CHECK(!invalid.contains_file("testfiles/manatest.exe", digest));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
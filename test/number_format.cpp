@@ -0,0 +1,136 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <limits>
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/date_time.hpp>
+
+#include "manacommons/number_format.h"
+#include "manacommons/hex.h"
+#include "manacommons/output_tree_node.h"
+#include "output_formatter.h"
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Formats a number with a std::ostream, which is what the output functions used to do.
+ */
+template<class T>
+std::string reference_format(T value, bool hex = false)
+{
+	std::stringstream ss;
+	if (hex) {
+		ss << std::hex;
+	}
+	ss << value;
+	return ss.str();
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_format_integers)
+{
+	char buffer[io::NUMBER_BUFFER_SIZE];
+	boost::uint64_t values[] = { 0, 1, 9, 10, 99, 100, 101, 0xABCDEF, 4294967295ULL, 4294967296ULL,
+								 10000000000000000000ULL, std::numeric_limits<boost::uint64_t>::max() };
+	for (unsigned int i = 0 ; i < sizeof(values) / sizeof(values[0]) ; ++i)
+	{
+		BOOST_CHECK_EQUAL(std::string(buffer, io::format_decimal(values[i], buffer)), reference_format(values[i]));
+		BOOST_CHECK_EQUAL(std::string(buffer, io::format_hexadecimal(values[i], buffer)), reference_format(values[i], true));
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_format_floating_point)
+{
+	char buffer[io::NUMBER_BUFFER_SIZE];
+	double values[] = { 0., -0., 1., 0.5, 1. / 3, 7.99987, 123456789., 1e-5, -1e300, 5e-324,
+						std::numeric_limits<double>::max(), std::numeric_limits<double>::infinity() };
+	for (unsigned int i = 0 ; i < sizeof(values) / sizeof(values[0]) ; ++i) {
+		BOOST_CHECK_EQUAL(std::string(buffer, io::format_floating_point(values[i], buffer)), reference_format(values[i]));
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_node_to_string)
+{
+	BOOST_CHECK_EQUAL(*io::make_node("n", static_cast<boost::uint32_t>(0x1000), io::OutputTreeNode::HEX)->to_string(), "0x1000");
+	BOOST_CHECK_EQUAL(*io::make_node("n", static_cast<boost::uint16_t>(443))->to_string(), "443");
+	BOOST_CHECK_EQUAL(*io::make_node("n", 6.57891234)->to_string(), "6.57891");
+	BOOST_CHECK_EQUAL(*io::make_node("n", 2.5f)->to_string(), "2.5");
+
+	std::stringstream ss;
+	io::make_node("n", static_cast<boost::uint64_t>(0x140000000ULL), io::OutputTreeNode::HEX)->write_value(ss);
+	io::make_node("n", std::string(" string ("))->write_value(ss);
+	BOOST_CHECK_EQUAL(ss.str(), "0x140000000 string (");
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_timestamp_to_string)
+{
+	std::locale loc(std::cout.getloc(), new boost::posix_time::time_facet("%Y-%b-%d %H:%M:%S%F %z"));
+	// Check every day from 1970 to 2400 (at different times), then the last representable second.
+	for (boost::uint64_t t = 0 ; t < 13569465600ULL ; t += 86400 + 3607)
+	{
+		std::stringstream ss;
+		ss.imbue(loc);
+		ss << boost::posix_time::from_time_t(t);
+		BOOST_CHECK_EQUAL(io::timestamp_to_string(t), ss.str());
+	}
+	BOOST_CHECK_EQUAL(io::timestamp_to_string(0), "1970-Jan-01 00:00:00");
+	BOOST_CHECK_EQUAL(io::timestamp_to_string(951868799), "2000-Feb-29 23:59:59");
+	BOOST_CHECK_EQUAL(io::timestamp_to_string(253402300799ULL), "9999-Dec-31 23:59:59");
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_version_number)
+{
+	BOOST_CHECK_EQUAL(io::uint64_to_version_number(0x000A0000, 0x4A610001), "10.0.19041.1");
+	BOOST_CHECK_EQUAL(io::uint64_to_version_number(0, 0), "0.0.0.0");
+	BOOST_CHECK_EQUAL(io::uint64_to_version_number(0xFFFFFFFF, 0xFFFFFFFF), "65535.65535.65535.65535");
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_hex)
+{
+	const boost::uint8_t bytes[] = { 0x00, 0x1F, 0xA0, 0xFF };
+	BOOST_CHECK_EQUAL(io::to_hex(bytes, sizeof(bytes)), "001fa0ff");
+	BOOST_CHECK_EQUAL(io::to_hex(bytes, 0), "");
+
+	boost::uint8_t out[4] = { 0 };
+	BOOST_CHECK(io::from_hex("001FA0ff", out, sizeof(out)));
+	BOOST_CHECK(std::equal(out, out + sizeof(out), bytes));
+	BOOST_CHECK(!io::from_hex("001fa0", out, sizeof(out)));		// Too short.
+	BOOST_CHECK(!io::from_hex("001fa0ff00", out, sizeof(out)));	// Too long.
+	BOOST_CHECK(!io::from_hex("001fa0fg", out, sizeof(out)));		// Not hexadecimal.
+
+	// Reading stops at the first character which isn't a digit, or when the buffer is full.
+	std::string s = "1fa0 trailing";
+	BOOST_CHECK_EQUAL(io::read_hex(s.c_str(), s.size(), out, sizeof(out)), 4U);
+	BOOST_CHECK_EQUAL(io::read_hex("001fa0ff00", 10, out, 2), 4U);
+}
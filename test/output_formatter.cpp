@@ -0,0 +1,131 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <sstream>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include "output_formatter.h"
+#include "plugins/plugin_virustotal/json_spirit/json_spirit_reader.h"
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	Creates the node a plugin would add to the analysis of a file.
+ */
+io::pNode make_summary(const std::string& value)
+{
+	io::pNode summary = io::make_node("Summary", io::OutputTreeNode::LIST);
+	summary->append(io::make_node("Name", value));
+	return summary;
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_json_streaming)
+{
+	// Files flushed in several calls make up a single document.
+	io::JsonFormatter formatter;
+	std::stringstream out;
+	formatter.add_data(make_summary("a.exe"), "a.exe");
+	formatter.add_data(make_summary("b.exe"), "b.exe");
+	formatter.format(out, false);
+	formatter.format(out, false); // Nothing to write.
+	formatter.add_data(make_summary("c.exe"), "c.exe");
+	formatter.format(out, false);
+	formatter.format(out);
+
+	json_spirit::Value v;
+	BOOST_REQUIRE(json_spirit::read(out.str(), v));
+	BOOST_REQUIRE(v.type() == json_spirit::obj_type);
+	const json_spirit::Object& files = v.get_obj();
+	BOOST_REQUIRE_EQUAL(files.size(), 3);
+	BOOST_CHECK_EQUAL(files[0].name_, "a.exe");
+	BOOST_CHECK_EQUAL(files[1].name_, "b.exe");
+	BOOST_CHECK_EQUAL(files[2].name_, "c.exe");
+
+	// The next call starts a new document.
+	std::stringstream out2;
+	formatter.format(out2);
+	BOOST_REQUIRE(json_spirit::read(out2.str(), v));
+	BOOST_REQUIRE(v.type() == json_spirit::obj_type);
+	BOOST_CHECK(v.get_obj().empty());
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(test_json_streaming_releases_nodes)
+{
+	io::JsonFormatter formatter;
+	std::stringstream out;
+	io::pNode summary = make_summary("a.exe");
+	boost::weak_ptr<io::OutputTreeNode> released(summary);
+	formatter.add_data(summary, "a.exe");
+	summary.reset();
+	BOOST_CHECK(formatter.get_file_node("a.exe"));
+	BOOST_CHECK(!released.expired());
+
+	// Once written, the file's subtree is not kept by the formatter anymore.
+	formatter.format(out, false);
+	BOOST_CHECK(released.expired());
+	BOOST_CHECK(!formatter.get_file_node("a.exe"));
+	BOOST_CHECK(!formatter.find_node("Summary", "a.exe"));
+	formatter.format(out);
+}
+
+// ----------------------------------------------------------------------------
+
+// Gives access to the formatter's cleanup without writing anything.
+class ClearableFormatter : public io::JsonFormatter
+{
+public:
+	void clear_data() { _clear_data(); }
+};
+
+BOOST_AUTO_TEST_CASE(test_file_nodes_index)
+{
+	ClearableFormatter formatter;
+	formatter.add_data(make_summary("a.exe"), "a.exe");
+	io::pNode file_node = formatter.get_file_node("a.exe");
+	BOOST_REQUIRE(file_node);
+	BOOST_CHECK(!formatter.get_file_node("b.exe"));
+
+	// Data added for the same file goes into the same node.
+	formatter.add_data(io::make_node("Hashes", io::OutputTreeNode::LIST), "a.exe");
+	BOOST_CHECK(formatter.get_file_node("a.exe") == file_node);
+	BOOST_CHECK_EQUAL(file_node->get_children()->size(), 2);
+	BOOST_CHECK(formatter.find_node("Hashes", "a.exe"));
+	formatter.add_data(make_summary("b.exe"), "b.exe");
+	BOOST_CHECK(formatter.get_file_node("b.exe") != file_node);
+
+	// Clearing the data resets the index: the file gets a new node.
+	formatter.clear_data();
+	BOOST_CHECK(!formatter.get_file_node("a.exe"));
+	BOOST_CHECK(!formatter.get_file_node("b.exe"));
+	formatter.add_data(io::make_node("Hashes", io::OutputTreeNode::LIST), "a.exe");
+	BOOST_REQUIRE(formatter.get_file_node("a.exe"));
+	BOOST_CHECK(formatter.get_file_node("a.exe") != file_node);
+	BOOST_CHECK_EQUAL(formatter.get_file_node("a.exe")->get_children()->size(), 1);
+	BOOST_CHECK(!formatter.find_node("Summary", "a.exe"));
+
+	// So does format().
+	std::stringstream out;
+	formatter.format(out);
+	BOOST_CHECK(!formatter.get_file_node("a.exe"));
+}
@@ -0,0 +1,207 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/copy.hpp>
+
+#include "output_sink.h"
+#include "output_formatter.h"
+#include "plugins/plugin_virustotal/json_spirit/json_spirit_reader.h"
+#include "fixtures.h"
+
+namespace {
+
+/**
+ *	@brief	Reads a whole file, and decompresses it if it is a gzip archive.
+ */
+std::string read_output(const std::string& path, bool gzip = false)
+{
+	std::ifstream f(path.c_str(), std::ios::binary);
+	std::stringstream ss;
+	if (gzip)
+	{
+		boost::iostreams::filtering_istream in;
+		in.push(boost::iostreams::gzip_decompressor());
+		in.push(f);
+		boost::iostreams::copy(in, ss);
+	}
+	else {
+		ss << f.rdbuf();
+	}
+	return ss.str();
+}
+
+/**
+ *	@brief	Writes numbered lines into a stream, flushing it after each of them like the formatters do.
+ *
+ *	@return	The expected contents of the output.
+ */
+std::string write_lines(std::ostream& out, unsigned int first, unsigned int count)
+{
+	std::stringstream expected;
+	for (unsigned int i = first ; i < first + count ; ++i)
+	{
+		out << "Line " << i << std::endl;
+		expected << "Line " << i << std::endl;
+	}
+	return expected.str();
+}
+
+} // !namespace
+
+BOOST_FIXTURE_TEST_SUITE(output_sink, SetWorkingDirectory)
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(sink_ordering)
+{
+	const std::string path = "output_sink.test";
+	std::string expected;
+	{
+		io::OutputSink sink(path);
+		BOOST_REQUIRE(sink.is_open());
+		// Several blocks, which have to be written in order.
+		expected = write_lines(sink.get_stream(), 0, 500000);
+		sink.close();
+		sink.close(); // Closing twice is harmless.
+	}
+	BOOST_CHECK(read_output(path) == expected);
+	BOOST_CHECK(!fs::exists(path + ".part"));
+	fs::remove(path);
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(sink_compression)
+{
+	const std::string path = "output_sink.test.gz";
+	std::string expected;
+	{
+		io::OutputSink sink(path, io::OutputSink::GZIP);
+		BOOST_REQUIRE(sink.is_open());
+		expected = write_lines(sink.get_stream(), 0, 200000);
+	} // The destructor completes the file.
+	BOOST_CHECK(fs::file_size(path) < expected.size());
+	BOOST_CHECK(read_output(path, true) == expected);
+	fs::remove(path);
+
+	#ifndef WITH_ZSTD
+		BOOST_CHECK(!io::OutputSink::is_supported(io::OutputSink::ZSTD));
+		io::OutputSink unsupported(path, io::OutputSink::ZSTD);
+		BOOST_CHECK(!unsupported.is_open());
+	#endif
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(sink_rotation)
+{
+	const std::string directory = "output_sink_rotation.test";
+	fs::remove_all(directory);
+	fs::create_directory(directory);
+	std::string expected[3];
+	{
+		// A new file every two samples.
+		io::OutputSink sink(directory + "/results.txt", io::OutputSink::NONE, 2);
+		BOOST_REQUIRE(sink.is_open());
+		for (unsigned int sample = 0 ; sample < 5 ; ++sample)
+		{
+			expected[sample / 2] += write_lines(sink.get_stream(), 10 * sample, 10);
+			if (sink.end_sample()) {
+				sink.rotate();
+			}
+		}
+	}
+	BOOST_CHECK(read_output(directory + "/results.000000.txt") == expected[0]);
+	BOOST_CHECK(read_output(directory + "/results.000001.txt") == expected[1]);
+	BOOST_CHECK(read_output(directory + "/results.000002.txt") == expected[2]);
+	BOOST_CHECK(!fs::exists(directory + "/results.000003.txt"));
+	BOOST_CHECK(!fs::exists(directory + "/results.000002.txt.part"));
+
+	// Rotation based on the size of the output.
+	{
+		io::OutputSink sink(directory + "/bytes.txt", io::OutputSink::NONE, 0, 100);
+		BOOST_REQUIRE(sink.is_open());
+		write_lines(sink.get_stream(), 0, 5); // 35 bytes.
+		BOOST_CHECK(!sink.end_sample());
+		write_lines(sink.get_stream(), 5, 20);
+		BOOST_CHECK(sink.end_sample());
+		sink.rotate();
+		write_lines(sink.get_stream(), 0, 1);
+		BOOST_CHECK(!sink.end_sample());
+	}
+	BOOST_CHECK_EQUAL(fs::file_size(directory + "/bytes.000000.txt"), 35 + 155);
+	BOOST_CHECK_EQUAL(fs::file_size(directory + "/bytes.000001.txt"), 7);
+	fs::remove_all(directory);
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(jsonl_append)
+{
+	const std::string path = "output_sink.jsonl";
+	fs::remove(path);
+
+	// Two runs writing into the same file, the second one with several flushes.
+	for (int run = 0 ; run < 2 ; ++run)
+	{
+		io::AppendFile file(path);
+		BOOST_REQUIRE(file.is_open());
+		io::JsonLinesFormatter formatter;
+		for (int i = 0 ; i < 2 ; ++i)
+		{
+			std::stringstream name;
+			name << "sample_" << run << "_" << i << ".exe";
+			io::pNode summary = io::make_node("Summary", io::OutputTreeNode::LIST);
+			summary->append(io::make_node("Size", std::string(5000, 'a'))); // Larger than the stdio buffer.
+			formatter.add_data(summary, name.str());
+			if (run == 1) {
+				formatter.format(file.get_stream(), false);
+			}
+		}
+		formatter.format(file.get_stream());
+	}
+
+	// One complete JSON object per line, and the first run's lines are still there.
+	std::stringstream lines(read_output(path));
+	std::string line;
+	std::vector<std::string> files;
+	while (std::getline(lines, line))
+	{
+		json_spirit::Value v;
+		BOOST_REQUIRE(json_spirit::read(line, v));
+		BOOST_REQUIRE(v.type() == json_spirit::obj_type);
+		BOOST_REQUIRE_EQUAL(v.get_obj().size(), 1);
+		files.push_back(v.get_obj()[0].name_);
+	}
+	BOOST_REQUIRE_EQUAL(files.size(), 4);
+	BOOST_CHECK_EQUAL(files[0], "sample_0_0.exe");
+	BOOST_CHECK_EQUAL(files[1], "sample_0_1.exe");
+	BOOST_CHECK_EQUAL(files[2], "sample_1_0.exe");
+	BOOST_CHECK_EQUAL(files[3], "sample_1_1.exe");
+	fs::remove(path);
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -254,6 +254,9 @@ BOOST_AUTO_TEST_CASE(parse_debug_info)
 	check_debug_directory_entry(*debug[1], "IMAGE_DEBUG_TYPE_VC_FEATURE", 20, 0x32c8, 0x18c8);
 	check_debug_directory_entry(*debug[2], "IMAGE_DEBUG_TYPE_POGO", 632, 0x32dc, 0x18dc);
 	check_debug_directory_entry(*debug[3], "IMAGE_DEBUG_TYPE_ILTCG", 0, 0, 0);
+	BOOST_CHECK_EQUAL(debug[0]->Filename, "E:\\Developpement\\CSandbox\\Release\\CSandbox.pdb");
+	BOOST_CHECK_EQUAL(debug[0]->PdbGuid, "EF2C74CA-738C-4A32-8F99-C51D0D7E6D18");
+	BOOST_CHECK_EQUAL(debug[1]->PdbGuid, "");
 }
 
 // ----------------------------------------------------------------------------
@@ -361,6 +364,26 @@ BOOST_AUTO_TEST_CASE(parse_delayed_imports)
 	BOOST_CHECK_EQUAL(lib->get_imports()->size(), 1);
 }
 
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(parse_selected_components)
+{
+	mana::PE full("testfiles/manatest.exe");
+	mana::PE headers("testfiles/manatest.exe", mana::PE::HEADERS_ONLY);
+	BOOST_ASSERT(headers.is_valid());
+	BOOST_CHECK_EQUAL(headers.get_parsed_components(), mana::PE::HEADERS_ONLY);
+	BOOST_CHECK_EQUAL(headers.get_sections()->size(), full.get_sections()->size());
+	BOOST_CHECK(headers.get_imports()->empty());
+	BOOST_CHECK(headers.get_resources()->empty());
+	BOOST_CHECK(!headers.get_config());
+
+	mana::PE imports("testfiles/manatest.exe", mana::PE::COMPONENT_IMPORTS);
+	BOOST_ASSERT(imports.is_valid());
+	BOOST_CHECK_EQUAL(imports.get_imports()->size(), full.get_imports()->size());
+	BOOST_CHECK_EQUAL(mana::PE("testfiles/manatest3.exe", mana::PE::COMPONENT_IMPORTS).find_imports("CryptAcquireContextW")->size(), 1); // Delay-loaded imports are included.
+	BOOST_CHECK(imports.get_resources()->empty());
+}
+
 // ----------------------------------------------------------------------------
 BOOST_AUTO_TEST_SUITE_END()
 // ----------------------------------------------------------------------------
@@ -0,0 +1,338 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/assign/list_of.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/bind.hpp>
+
+#include "plugin_framework/plugin_manager.h"
+#include "plugin_framework/plugin_interface.h"
+#include "plugin_framework/plugin.h"
+#include "plugin_framework/analysis_context.h"
+#include "plugin_framework/worker_pool.h"
+#include "fixtures.h"
+
+const char* const NAMES[] = { "a", "b", "c", "d" };
+
+/**
+ *	@brief	A plugin which does nothing, with configurable dependencies.
+ *
+ *	The template parameters are indices into NAMES: they give the ID of the plugin and
+ *	the IDs of the plugins it depends on (-1 for none).
+ */
+template<int ID, int DEP1 = -1, int DEP2 = -1>
+class DependentPlugin : public plugin::IPlugin
+{
+public:
+	int get_api_version() const override { return 2; }
+	pString get_id() const override { return boost::make_shared<std::string>(NAMES[ID]); }
+	pString get_description() const override { return boost::make_shared<std::string>("Test plugin."); }
+	plugin::shared_strings get_dependencies() const override
+	{
+		auto res = boost::make_shared<std::vector<std::string> >();
+		if (DEP1 >= 0) {
+			res->push_back(NAMES[DEP1]);
+		}
+		if (DEP2 >= 0) {
+			res->push_back(NAMES[DEP2]);
+		}
+		return res;
+	}
+};
+
+template<class T>
+void register_test_plugin() {
+	plugin::PluginManager::get_instance().register_plugin(boost::make_shared<plugin::StaticPlugin<T> >());
+}
+
+BOOST_FIXTURE_TEST_SUITE(plugin_scheduling, SetWorkingDirectory)
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(schedule_stages)
+{
+	plugin::PluginManager& pm = plugin::PluginManager::get_instance();
+	pm.unload_all();
+	register_test_plugin<DependentPlugin<0, 1, 2> >();	// a depends on b and c
+	register_test_plugin<DependentPlugin<1, 2> >();		// b depends on c
+	register_test_plugin<DependentPlugin<2> >();
+	register_test_plugin<DependentPlugin<3> >();
+
+	auto plan = pm.schedule(boost::assign::list_of("all"));
+	BOOST_ASSERT(plan.size() == 4);
+	BOOST_CHECK_EQUAL(*plan[0].first->get_id(), "a");
+	BOOST_CHECK_EQUAL(plan[0].second, 2);
+	BOOST_CHECK_EQUAL(plan[1].second, 1);
+	BOOST_CHECK_EQUAL(plan[2].second, 0);
+	BOOST_CHECK_EQUAL(plan[3].second, 0);
+
+	// Dependencies are included even if they were not requested.
+	plan = pm.schedule(boost::assign::list_of("b"));
+	BOOST_ASSERT(plan.size() == 2);
+	BOOST_CHECK_EQUAL(*plan[0].first->get_id(), "b");
+	BOOST_CHECK_EQUAL(*plan[1].first->get_id(), "c");
+	pm.unload_all();
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(circular_dependencies)
+{
+	plugin::PluginManager& pm = plugin::PluginManager::get_instance();
+	pm.unload_all();
+	register_test_plugin<DependentPlugin<0, 1> >();		// a depends on b
+	register_test_plugin<DependentPlugin<1, 0> >();		// b depends on a
+	register_test_plugin<DependentPlugin<2, 1> >();		// c depends on b
+	register_test_plugin<DependentPlugin<3> >();
+
+	// The plugins of the cycle are unloaded, along with the ones depending on them.
+	pm.load_all("nonexistent_folder");
+	std::vector<plugin::pIPlugin> plugins = pm.get_plugins();
+	BOOST_ASSERT(plugins.size() == 1);
+	BOOST_CHECK_EQUAL(*plugins[0]->get_id(), "d");
+	pm.unload_all();
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(provided_data)
+{
+	plugin::pIPlugin p(new DependentPlugin<2>());
+	std::vector<std::string> provided = plugin::get_provided_data(p);
+	BOOST_ASSERT(provided.size() == 1);
+	BOOST_CHECK_EQUAL(provided[0], "c");
+	BOOST_CHECK(plugin::get_dependencies(p).empty());
+}
+
+// ----------------------------------------------------------------------------
+
+class PathPlugin : public plugin::IPlugin
+{
+public:
+	int get_api_version() const override { return 2; }
+	pString get_id() const override { return boost::make_shared<std::string>("path"); }
+	pString get_description() const override { return boost::make_shared<std::string>("Test plugin."); }
+	bool supports_batch() const override { return true; }
+	plugin::pResult analyze_sample(plugin::IAnalysisContext& context) override
+	{
+		plugin::pResult res = create_result();
+		res->set_summary(*context.get_pe().get_path());
+		return res;
+	}
+};
+
+BOOST_AUTO_TEST_CASE(analyze_batch)
+{
+	mana::PE pe("testfiles/manatest.exe");
+	mana::PE pe2("testfiles/manatest2.exe");
+	plugin::AnalysisContext context(pe);
+	plugin::AnalysisContext context2(pe2);
+	std::vector<plugin::IAnalysisContext*> samples = boost::assign::list_of(&context)(&context2);
+
+	plugin::pIPlugin p(new PathPlugin());
+	BOOST_CHECK(plugin::supports_batch(p));
+	BOOST_CHECK(!plugin::supports_batch(plugin::pIPlugin(new DependentPlugin<0>())));
+
+	// By default, each sample is analyzed separately.
+	plugin::shared_results results = p->analyze_batch(samples);
+	BOOST_ASSERT(results && results->size() == 2);
+	BOOST_CHECK_EQUAL(*results->at(0)->get_summary(), "testfiles/manatest.exe");
+	BOOST_CHECK_EQUAL(*results->at(1)->get_summary(), "testfiles/manatest2.exe");
+}
+
+// ----------------------------------------------------------------------------
+
+class PathDependentPlugin : public DependentPlugin<0>
+{
+public:
+	plugin::shared_strings get_dependencies() const override {
+		return boost::make_shared<std::vector<std::string> >(1, "path");
+	}
+};
+
+BOOST_AUTO_TEST_CASE(batch_dependencies)
+{
+	plugin::PluginManager& pm = plugin::PluginManager::get_instance();
+	pm.unload_all();
+	register_test_plugin<PathPlugin>();
+	register_test_plugin<PathDependentPlugin>();	// a depends on path
+	register_test_plugin<DependentPlugin<1> >();
+	register_test_plugin<DependentPlugin<2, 0> >();	// c depends on a
+
+	// The results of batch plugins are not available to other plugins: their dependents are unloaded.
+	pm.load_all("nonexistent_folder");
+	std::vector<plugin::pIPlugin> plugins = pm.get_plugins();
+	BOOST_ASSERT(plugins.size() == 2);
+	BOOST_CHECK_EQUAL(*plugins[0]->get_id(), "path");
+	BOOST_CHECK_EQUAL(*plugins[1]->get_id(), "b");
+
+	// Manifests have to declare the support of batches.
+	plugin::PluginManifest expected = *plugin::describe_plugin(plugins[0]);
+	BOOST_CHECK(expected.batch);
+	BOOST_CHECK(plugin::check_manifest(expected, plugins[0]));
+	expected.batch = false;
+	BOOST_CHECK(!plugin::check_manifest(expected, plugins[0]));
+	pm.unload_all();
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(lazy_loading)
+{
+	plugin::PluginManager& pm = plugin::PluginManager::get_instance();
+	pm.unload_all();
+	register_test_plugin<DependentPlugin<3> >();
+
+	// The library is not a valid shared object: it can only be listed thanks to its manifest.
+	#ifdef BOOST_WINDOWS_API
+		std::string library("lazy_plugins/plugin_lazy.dll");
+	#else
+		std::string library("lazy_plugins/libplugin_lazy.so");
+	#endif
+	fs::create_directory("lazy_plugins");
+	create_file(library, "Not a library");
+	create_file("lazy_plugins/" + fs::path(library).stem().string() + ".manifest",
+		"# Test manifest\nid = lazy\ndescription = Loaded on demand.\napi_version = 2\ndependencies = d, \n");
+	pm.load_all("lazy_plugins");
+
+	BOOST_CHECK_EQUAL(pm.get_manifests().size(), 2);
+	plugin::pPluginManifest manifest = pm.find_manifest("lazy");
+	BOOST_ASSERT(manifest);
+	BOOST_CHECK_EQUAL(manifest->description, "Loaded on demand.");
+	BOOST_CHECK_EQUAL(manifest->api_version, 2);
+	BOOST_ASSERT(manifest->dependencies.size() == 1);
+	BOOST_CHECK_EQUAL(manifest->dependencies[0], "d");
+	BOOST_ASSERT(manifest->provided_data.size() == 1);
+	BOOST_CHECK_EQUAL(manifest->provided_data[0], "lazy");
+	BOOST_CHECK(!manifest->batch);
+
+	// The library is only loaded if the plugin is selected. Since it can't be, only its
+	// dependency is scheduled.
+	BOOST_CHECK_EQUAL(pm.schedule(boost::assign::list_of("d")).size(), 1);
+	auto plan = pm.schedule(boost::assign::list_of("lazy"));
+	BOOST_ASSERT(plan.size() == 1);
+	BOOST_CHECK_EQUAL(*plan[0].first->get_id(), "d");
+
+	// Libraries which don't match their manifest are not used.
+	plugin::pIPlugin d = boost::make_shared<DependentPlugin<3> >();
+	plugin::PluginManifest expected = *plugin::describe_plugin(d);
+	BOOST_CHECK(plugin::check_manifest(expected, d));
+	expected.description = "Outdated description.";
+	BOOST_CHECK(plugin::check_manifest(expected, d));
+	expected.dependencies.push_back("a");
+	BOOST_CHECK(!plugin::check_manifest(expected, d));
+	expected.dependencies.clear();
+	expected.provided_data.push_back("extra");
+	BOOST_CHECK(!plugin::check_manifest(expected, d));
+	plugin::pIPlugin c = boost::make_shared<DependentPlugin<2, 0, 1> >();
+	expected = *plugin::describe_plugin(c);
+	std::reverse(expected.dependencies.begin(), expected.dependencies.end());
+	BOOST_CHECK(plugin::check_manifest(expected, c));
+
+	// Manifests without an ID are rejected.
+	create_file("lazy_plugins/invalid.manifest", "description = No ID.\napi_version = 2\n");
+	BOOST_CHECK(!plugin::read_manifest("lazy_plugins/invalid.manifest"));
+	BOOST_CHECK(!plugin::read_manifest("lazy_plugins/nonexistent.manifest"));
+
+	pm.unload_all();
+	fs::remove_all("lazy_plugins");
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ *	@brief	A plugin which counts how many times its lifecycle hooks are called.
+ */
+class LifecyclePlugin : public plugin::IPlugin
+{
+public:
+	int get_api_version() const override { return 2; }
+	pString get_id() const override { return boost::make_shared<std::string>("lifecycle"); }
+	pString get_description() const override { return boost::make_shared<std::string>("Test plugin."); }
+
+	void on_load(const plugin::string_map& config) override
+	{
+		++loads;
+		message = config.count("message") ? config.at("message") : "";
+	}
+	void on_thread_start() override { boost::mutex::scoped_lock lock(mutex); ++thread_starts; }
+	void on_thread_end() override { boost::mutex::scoped_lock lock(mutex); ++thread_ends; }
+	void on_run_end() override { ++run_ends; }
+
+	static int loads, thread_starts, thread_ends, run_ends;
+	static std::string message;
+	static boost::mutex mutex;
+};
+
+int LifecyclePlugin::loads = 0;
+int LifecyclePlugin::thread_starts = 0;
+int LifecyclePlugin::thread_ends = 0;
+int LifecyclePlugin::run_ends = 0;
+std::string LifecyclePlugin::message;
+boost::mutex LifecyclePlugin::mutex;
+
+BOOST_AUTO_TEST_CASE(lifecycle_hooks)
+{
+	plugin::PluginManager& pm = plugin::PluginManager::get_instance();
+	pm.unload_all();
+	register_test_plugin<LifecyclePlugin>();
+	register_test_plugin<DependentPlugin<0> >();
+
+	std::map<std::string, plugin::string_map> config;
+	config["lifecycle"]["message"] = "hello";
+	pm.start_run(boost::assign::list_of("all"), config);
+	BOOST_CHECK_EQUAL(LifecyclePlugin::loads, 1);
+	BOOST_CHECK_EQUAL(LifecyclePlugin::message, "hello");
+
+	int tasks_run = 0;
+	{
+		plugin::WorkerPool pool(3,
+			boost::bind(&plugin::PluginManager::start_thread, &pm),
+			boost::bind(&plugin::PluginManager::end_thread, &pm));
+		BOOST_CHECK_EQUAL(pool.get_size(), 3);
+
+		std::vector<plugin::WorkerPool::task> tasks;
+		boost::mutex m;
+		for (int i = 0 ; i < 10 ; ++i)
+		{
+			tasks.push_back([&]() {
+				boost::mutex::scoped_lock lock(m);
+				++tasks_run;
+			});
+		}
+		pool.run(tasks); // Blocks until the tasks are done.
+		BOOST_CHECK_EQUAL(tasks_run, 10);
+		pool.run(tasks); // The pool can be reused.
+		BOOST_CHECK_EQUAL(tasks_run, 20);
+	}
+	BOOST_CHECK_EQUAL(LifecyclePlugin::thread_starts, 3);
+	BOOST_CHECK_EQUAL(LifecyclePlugin::thread_ends, 3);
+
+	// The plugins are only loaded once per run, and unloading them ends the run.
+	pm.unload_all();
+	BOOST_CHECK_EQUAL(LifecyclePlugin::loads, 1);
+	BOOST_CHECK_EQUAL(LifecyclePlugin::run_ends, 1);
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,149 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+
+#include "results_store.h"
+#include "fixtures.h"
+
+namespace {
+
+/**
+ *	@brief	Runs a query and returns the SHA256 of the matching samples.
+ */
+std::vector<std::string> query(const std::string& store, const std::vector<std::string>& conditions)
+{
+	std::vector<mana::sample_record> results;
+	BOOST_CHECK(mana::query_results_store(store, conditions, results));
+	std::vector<std::string> res;
+	for (auto it = results.begin() ; it != results.end() ; ++it) {
+		res.push_back(it->sha256);
+	}
+	return res;
+}
+
+} // !anonymous namespace
+
+// ----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_SUITE(results_store, SetWorkingDirectory)
+
+BOOST_AUTO_TEST_CASE(describe_pe)
+{
+	mana::PE pe("testfiles/manatest.exe");
+	mana::sample_record record;
+	mana::describe_pe(pe, record);
+
+	BOOST_CHECK(std::find(record.imports.begin(), record.imports.end(), "kernel32.dll!writeprocessmemory") != record.imports.end());
+	BOOST_ASSERT(record.sections.size() == 6);
+	BOOST_CHECK_EQUAL(record.sections[0].first, ".text");
+	BOOST_CHECK_EQUAL(record.sections[0].second, "rx");
+	BOOST_CHECK_EQUAL(record.sections[2].first, ".data");
+	BOOST_CHECK_EQUAL(record.sections[2].second, "rw");
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(query_store)
+{
+	const std::string directory = "results_store.test";
+	fs::remove_all(directory);
+	{
+		mana::ResultsStore store(directory);
+		BOOST_ASSERT(store.is_open());
+
+		mana::sample_record a;
+		a.sha256 = "aaaa";
+		a.path = "a.exe";
+		a.imports = { "winhttp.dll!winhttpopen", "kernel32.dll!createfilew" };
+		a.sections = { std::make_pair(".text", "rx"), std::make_pair("UPX0", "rwx") };
+		a.verdicts = { std::make_pair("packer", plugin::SUSPICIOUS), std::make_pair("imports", plugin::MALICIOUS) };
+		BOOST_CHECK(store.add(a));
+
+		mana::sample_record b;
+		b.sha256 = "bbbb";
+		b.path = "b.exe";
+		b.imports = { "winhttp.dll!winhttpconnect" };
+		b.sections = { std::make_pair(".text", "rx"), std::make_pair(".data", "rw") };
+		b.verdicts = { std::make_pair("packer", plugin::NO_OPINION) };
+		BOOST_CHECK(store.add(b));
+	}
+	{
+		// Samples are appended to the existing store.
+		mana::ResultsStore store(directory);
+		mana::sample_record c;
+		c.sha256 = "cccc";
+		c.path = "c\texe";
+		c.imports = { "ws2_32.dll!#23" };
+		c.sections = { std::make_pair(".text", "rwx") };
+		BOOST_CHECK(store.add(c));
+	}
+
+	std::vector<std::string> res = query(directory, { "import:WinHttp*" });
+	BOOST_ASSERT(res.size() == 2);
+	BOOST_CHECK_EQUAL(res[0], "aaaa");
+	BOOST_CHECK_EQUAL(res[1], "bbbb");
+
+	res = query(directory, { "import:winhttp*", "permissions:wx" });
+	BOOST_ASSERT(res.size() == 1);
+	BOOST_CHECK_EQUAL(res[0], "aaaa");
+
+	res = query(directory, { "permissions:xw" });
+	BOOST_ASSERT(res.size() == 2);
+	BOOST_CHECK_EQUAL(res[1], "cccc");
+
+	res = query(directory, { "import:ws2_32.dll!*" });
+	BOOST_ASSERT(res.size() == 1);
+	BOOST_CHECK_EQUAL(res[0], "cccc");
+	BOOST_CHECK(query(directory, { "import:ws2_32*" }).empty()); // Without a '!', only functions are matched.
+
+	res = query(directory, { "section:.data" });
+	BOOST_ASSERT(res.size() == 1);
+	BOOST_CHECK_EQUAL(res[0], "bbbb");
+	BOOST_CHECK_EQUAL(query(directory, { "section:.t?xt" }).size(), 3);
+
+	res = query(directory, { "plugin:*>=suspicious" });
+	BOOST_ASSERT(res.size() == 1);
+	BOOST_CHECK_EQUAL(res[0], "aaaa");
+	BOOST_CHECK_EQUAL(query(directory, { "plugin:packer=no_opinion" }).size(), 1);
+	BOOST_CHECK(query(directory, { "plugin:packer=malicious" }).empty());
+
+	// Negated conditions.
+	res = query(directory, { "!import:winhttpopen" });
+	BOOST_ASSERT(res.size() == 2);
+	BOOST_CHECK_EQUAL(res[0], "bbbb");
+	BOOST_CHECK_EQUAL(res[1], "cccc");
+	res = query(directory, { "section:.text", "!plugin:packer>=no_opinion" });
+	BOOST_ASSERT(res.size() == 1);
+	BOOST_CHECK_EQUAL(res[0], "cccc");
+
+	// The path was sanitized.
+	std::vector<mana::sample_record> records;
+	BOOST_CHECK(mana::query_results_store(directory, { "import:#23" }, records));
+	BOOST_ASSERT(records.size() == 1);
+	BOOST_CHECK_EQUAL(records[0].path, "c?exe");
+
+	// Invalid conditions.
+	BOOST_CHECK(!mana::query_results_store(directory, { "imports" }, records));
+	BOOST_CHECK(!mana::query_results_store(directory, { "permissions:z" }, records));
+	BOOST_CHECK(!mana::query_results_store(directory, { "plugin:packer=bad" }, records));
+	BOOST_CHECK(!mana::query_results_store("nonexistent_store", { "section:.text" }, records));
+	fs::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,114 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <boost/test/unit_test.hpp>
+
+#include "similarity_index.h"
+#include "fixtures.h"
+
+namespace {
+
+const std::string HASH_A = "96:KQhaGCVZGhr83h3bc0ok3892m12wzgnH5w2pw+sxNEI58:FIVkH4x73h39LH+2w+sxaD";
+const std::string HASH_B = "96:KQhaGCVZGhr83h3bc0ok3892m12wzgnH5w2pw+sxNEI59:FIVkH4x73h39LH+2w+sxaE";
+const std::string HASH_C = "96:Pq7Rt9Lm3Nx5Vb1Jk8Hg2Df4Sa6Qw0Ez:Ty6Ui8Op0As2Dd";
+const std::string HASH_D = "192:FIVkH4x73h39LH+2w+sxaD:Mn3Bv5Cx7Za";
+
+} // !anonymous namespace
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(ssdeep_compare)
+{
+	BOOST_CHECK_EQUAL(mana::compare_ssdeep(HASH_A, HASH_A), 100);
+	BOOST_CHECK_EQUAL(mana::compare_ssdeep(HASH_A, HASH_B), 99);
+	BOOST_CHECK_EQUAL(mana::compare_ssdeep(HASH_B, HASH_A), 99);
+	BOOST_CHECK_EQUAL(mana::compare_ssdeep(HASH_A, HASH_C), 0);	// No common substring.
+	BOOST_CHECK_EQUAL(mana::compare_ssdeep(HASH_A, HASH_D), 100);	// The chunks computed with 192 are identical.
+	BOOST_CHECK_EQUAL(mana::compare_ssdeep(HASH_D, HASH_A), 100);
+	BOOST_CHECK_EQUAL(mana::compare_ssdeep(HASH_B, "384:FIVkH4x73h39LH+2w+sxaD:x"), 0); // Incompatible block sizes.
+
+	// Scores are capped for small block sizes.
+	BOOST_CHECK_EQUAL(mana::compare_ssdeep("3:abcdefgh:", "3:abcdefgi:"), 8);
+
+	// Long runs of the same character are shortened before the comparison.
+	BOOST_CHECK_EQUAL(mana::compare_ssdeep("96:KQhaGCVZGhr83hhhhhhhhhh:x", "96:KQhaGCVZGhr83hhh:y"), 100);
+
+	BOOST_CHECK_EQUAL(mana::compare_ssdeep("not a hash", HASH_A), 0);
+	BOOST_CHECK_EQUAL(mana::compare_ssdeep("96:KQhaGCVZGhr83h3bc0ok3892m12wzgnH5w2pw+sxNEI58:FIVkH4x73h39LH+2w+sxaD,\"file.exe\"", HASH_A), 100);
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(similarity_index)
+{
+	const std::string index_file = "similarity_index.test";
+	fs::remove(index_file);
+	{
+		mana::SimilarityIndex index(index_file);
+		BOOST_ASSERT(index.is_open());
+		BOOST_CHECK(index.add(HASH_A, "aaaa", "a.exe"));
+		BOOST_CHECK(index.add(HASH_C, "cccc", "c.exe"));
+		BOOST_CHECK(index.add(HASH_D, "dddd", "d.exe"));
+		BOOST_CHECK(!index.add(HASH_A, "aaaa", "a.exe")); // Already indexed.
+		BOOST_CHECK(!index.add("garbage", "eeee", "e.exe"));
+		BOOST_CHECK_EQUAL(index.size(), 3);
+
+		std::vector<mana::similar_file> similar = index.find_similar(HASH_B, 50);
+		BOOST_ASSERT(similar.size() == 2);
+		BOOST_CHECK_EQUAL(similar[0].sha256, "aaaa");
+		BOOST_CHECK_EQUAL(similar[0].path, "a.exe");
+		BOOST_CHECK_EQUAL(similar[0].score, 99);
+		BOOST_CHECK_EQUAL(similar[1].sha256, "dddd");
+
+		// The file itself can be left out of the results.
+		similar = index.find_similar(HASH_A, 100, "aaaa");
+		BOOST_ASSERT(similar.size() == 1);
+		BOOST_CHECK_EQUAL(similar[0].sha256, "dddd");
+	}
+
+	// The index is read back from the file.
+	{
+		mana::SimilarityIndex index(index_file);
+		BOOST_CHECK_EQUAL(index.size(), 3);
+		std::vector<mana::similar_file> similar = index.find_similar(HASH_C, 1);
+		BOOST_ASSERT(similar.size() == 1);
+		BOOST_CHECK_EQUAL(similar[0].sha256, "cccc");
+		BOOST_CHECK_EQUAL(similar[0].path, "c.exe");
+	}
+	fs::remove(index_file);
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(similarity_index_short_chunks)
+{
+	const std::string index_file = "similarity_index.test";
+	fs::remove(index_file);
+	{
+		// Tiny files have chunks shorter than 7 characters, which have no 7-gram in common.
+		mana::SimilarityIndex index(index_file);
+		BOOST_CHECK_EQUAL(mana::compare_ssdeep("3:Ln:Ln", "3:Ln:Ln"), 100);
+		BOOST_CHECK(index.add("3:Ln:Ln", "aaaa", "a.exe"));
+		BOOST_CHECK(index.add("3:Lo:Lo", "bbbb", "b.exe"));
+
+		std::vector<mana::similar_file> similar = index.find_similar("3:Ln:Ln,\"copy.exe\"", 100);
+		BOOST_ASSERT(similar.size() == 1);
+		BOOST_CHECK_EQUAL(similar[0].sha256, "aaaa");
+		BOOST_CHECK_EQUAL(similar[0].score, 100);
+		BOOST_CHECK(index.find_similar("6:Ln:Ln", 1).empty()); // Different block size.
+	}
+	fs::remove(index_file);
+}
@@ -0,0 +1,154 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <boost/test/unit_test.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+
+#include "corpus_statistics.h"
+#include "fixtures.h"
+
+BOOST_AUTO_TEST_CASE(count_min_sketch)
+{
+	mana::CountMinSketch sketch(10, 4);
+	for (int i = 0 ; i < 5000 ; ++i) {
+		sketch.add(mana::hash_key("key" + boost::lexical_cast<std::string>(i)));
+	}
+	sketch.add(mana::hash_key("frequent"), 1000);
+
+	// Estimates are never lower than the actual counts.
+	BOOST_CHECK(sketch.estimate(mana::hash_key("frequent")) >= 1000);
+	BOOST_CHECK(sketch.estimate(mana::hash_key("frequent")) < 1000 + 2 * 6000 / 1024);
+	BOOST_CHECK(sketch.estimate(mana::hash_key("key42")) >= 1);
+
+	mana::CountMinSketch other(10, 4);
+	other.add(mana::hash_key("frequent"), 500);
+	BOOST_CHECK(sketch.merge(other));
+	BOOST_CHECK(sketch.estimate(mana::hash_key("frequent")) >= 1500);
+	BOOST_CHECK(!sketch.merge(mana::CountMinSketch(11, 4)));
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(hyperloglog)
+{
+	mana::HyperLogLog small, large;
+	BOOST_CHECK_EQUAL(small.estimate(), 0);
+	for (int i = 0 ; i < 100 ; ++i)
+	{
+		small.add(mana::hash_key("key" + boost::lexical_cast<std::string>(i)));
+		small.add(mana::hash_key("key" + boost::lexical_cast<std::string>(i))); // Duplicates don't count.
+	}
+	BOOST_CHECK(small.estimate() >= 98 && small.estimate() <= 102);
+
+	for (int i = 0 ; i < 200000 ; ++i) {
+		large.add(mana::hash_key("key" + boost::lexical_cast<std::string>(i)));
+	}
+	BOOST_CHECK_CLOSE(static_cast<double>(large.estimate()), 200000., 3); // 1% standard error with 2^14 registers.
+
+	BOOST_CHECK(large.merge(small));
+	BOOST_CHECK_CLOSE(static_cast<double>(large.estimate()), 200000., 3);
+	BOOST_CHECK(!large.merge(mana::HyperLogLog(12)));
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(frequency_sketch)
+{
+	mana::FrequencySketch a(3), b(3);
+	for (int i = 0 ; i < 1000 ; ++i) {
+		a.add("rare" + boost::lexical_cast<std::string>(i));
+	}
+	for (int i = 0 ; i < 50 ; ++i)
+	{
+		a.add(".text");
+		b.add(".text");
+	}
+	for (int i = 0 ; i < 30 ; ++i) {
+		a.add(".data");
+	}
+	for (int i = 0 ; i < 40 ; ++i) {
+		b.add("UPX0");
+	}
+
+	auto top = a.get_top_keys();
+	BOOST_ASSERT(top.size() == 3);
+	BOOST_CHECK_EQUAL(top[0].first, ".text");
+	BOOST_CHECK_EQUAL(top[0].second, 50);
+	BOOST_CHECK_EQUAL(top[1].first, ".data");
+
+	a.merge(b);
+	top = a.get_top_keys();
+	BOOST_ASSERT(top.size() == 3);
+	BOOST_CHECK_EQUAL(top[0].first, ".text");
+	BOOST_CHECK_EQUAL(top[0].second, 100);
+	BOOST_CHECK_EQUAL(top[1].first, "UPX0");
+	BOOST_CHECK_EQUAL(top[2].first, ".data");
+	BOOST_CHECK(a.get_distinct_keys() >= 990 && a.get_distinct_keys() <= 1020);
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_SUITE(corpus_statistics, SetWorkingDirectory)
+
+/**
+ *	@brief	Finds a value in the output of the statistics.
+ */
+boost::uint64_t get_statistic(const std::vector<io::pNode>& nodes, const std::string& category, const std::string& name)
+{
+	for (auto it = nodes.begin() ; it != nodes.end() ; ++it)
+	{
+		if (*(*it)->get_name() != category) {
+			continue;
+		}
+		io::pNode n = (*it)->find_node(name);
+		return n ? n->get_integer() : 0;
+	}
+	return 0;
+}
+
+BOOST_AUTO_TEST_CASE(aggregate_statistics)
+{
+	mana::PE pe("testfiles/manatest.exe");
+	mana::PE pe2("testfiles/manatest2.exe");
+	mana::StatisticsAggregator aggregator(200); // Enough to list all the imports.
+
+	// Each thread adds the samples to its own statistics.
+	boost::thread_group threads;
+	for (int t = 0 ; t < 4 ; ++t)
+	{
+		threads.create_thread([&aggregator, &pe, &pe2]() {
+			plugin::AnalysisContext context(pe), context2(pe2);
+			for (int i = 0 ; i < 5 ; ++i)
+			{
+				aggregator.get_partial().add(pe, context);
+				aggregator.get_partial().add(pe2, context2);
+			}
+		});
+	}
+	threads.join_all();
+
+	mana::CorpusStatistics stats = aggregator.merge();
+	BOOST_CHECK_EQUAL(stats.get_samples(), 40);
+	std::vector<io::pNode> nodes = stats.to_nodes();
+	BOOST_CHECK_EQUAL(get_statistic(nodes, "Overview", "Samples"), 40);
+	BOOST_CHECK_EQUAL(get_statistic(nodes, "Machines", "IMAGE_FILE_MACHINE_I386"), 40);
+	BOOST_CHECK_EQUAL(get_statistic(nodes, "Compilation years", "2016"), 40);
+	BOOST_CHECK_EQUAL(get_statistic(nodes, "Section names", ".text"), 40);
+	BOOST_CHECK_EQUAL(get_statistic(nodes, "Imports", "kernel32.dll!writeprocessmemory"), 20);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
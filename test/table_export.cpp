@@ -0,0 +1,228 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include "table_export.h"
+#include "fixtures.h"
+
+namespace {
+
+const std::string SHA256_A = "9e1a1b4bc2a4db50efb12d7ae0cda3da2ad2ab4f8f27d8b6b17b9a1cb5d10bda";
+const std::string SHA256_B = "1d3f0f1da4b7d7e8a6f2e9c0b3a5c7d9e1f3a5b7c9d1e3f5a7b9c1d3e5f7a9b1";
+
+/**
+ *	@brief	Reads the lines of a table.
+ */
+std::vector<std::string> read_lines(const fs::path& path)
+{
+	std::vector<std::string> res;
+	std::ifstream f(path.string().c_str(), std::ios::binary);
+	std::string line;
+	while (std::getline(f, line)) {
+		res.push_back(line);
+	}
+	return res;
+}
+
+/**
+ *	@brief	Splits a TSV row into its cells.
+ */
+std::vector<std::string> split_row(const std::string& row)
+{
+	std::vector<std::string> res;
+	boost::split(res, row, boost::is_any_of("\t"));
+	return res;
+}
+
+/**
+ *	@brief	Counts the entries of the import lookup tables of a PE.
+ */
+size_t count_imports(const mana::PE& pe)
+{
+	size_t res = 0;
+	mana::shared_imports imports = pe.get_imports();
+	for (auto it = imports->begin() ; it != imports->end() ; ++it) {
+		res += (*it)->get_imports()->size();
+	}
+	return res;
+}
+
+} // !namespace
+
+BOOST_FIXTURE_TEST_SUITE(table_export, SetWorkingDirectory)
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(table_rows)
+{
+	const fs::path directory = "table_export.test";
+	fs::remove_all(directory);
+	{
+		io::TableExporter exporter(directory.string());
+		BOOST_REQUIRE(exporter.is_open());
+		exporter.export_pe(mana::PE("testfiles/manatest.exe"), SHA256_A);
+		exporter.export_pe(mana::PE("testfiles/manatest2.exe"), SHA256_B);
+	}
+	mana::PE pe("testfiles/manatest.exe");
+
+	std::vector<std::string> sections = read_lines(directory / "sections.tsv");
+	BOOST_REQUIRE(sections.size() > pe.get_sections()->size());
+	BOOST_CHECK_EQUAL(sections[0], "sha256\tname\tvirtual_address\tvirtual_size\tpointer_to_raw_data\t"
+									"size_of_raw_data\tcharacteristics\tentropy");
+	std::vector<std::string> cells = split_row(sections[1]);
+	BOOST_REQUIRE_EQUAL(cells.size(), 8);
+	BOOST_CHECK_EQUAL(cells[0], SHA256_A);
+	BOOST_CHECK_EQUAL(cells[1], *pe.get_sections()->at(0)->get_name());
+	BOOST_CHECK_EQUAL(cells[2], std::to_string(pe.get_sections()->at(0)->get_virtual_address()));
+
+	// One row per imported function.
+	std::vector<std::string> imports = read_lines(directory / "imports.tsv");
+	BOOST_CHECK_EQUAL(imports[0], "sha256\tlibrary\tfunction\tordinal\tdelay_loaded");
+	BOOST_CHECK(std::find(imports.begin(), imports.end(),
+		SHA256_A + "\tKERNEL32.dll\tWriteProcessMemory\t\t0") != imports.end());
+	BOOST_CHECK_EQUAL(std::count_if(imports.begin(), imports.end(), [](const std::string& row) {
+		return row.find(SHA256_A) == 0;
+	}), count_imports(pe));
+
+	std::vector<std::string> exports = read_lines(directory / "exports.tsv");
+	BOOST_REQUIRE_EQUAL(exports.size(), 2);
+	BOOST_CHECK_EQUAL(exports[0], "sha256\tordinal\taddress\tname\tforward_name");
+	BOOST_CHECK_EQUAL(exports[1], SHA256_B + "\t1\t4096\texported\t");
+
+	std::vector<std::string> resources = read_lines(directory / "resources.tsv");
+	BOOST_CHECK_EQUAL(resources[0], "sha256\ttype\tname\tlanguage\tcodepage\tsize\toffset\tentropy");
+	BOOST_CHECK_EQUAL(std::count_if(resources.begin(), resources.end(), [](const std::string& row) {
+		return row.find(SHA256_A) == 0;
+	}), pe.get_resources()->size());
+	cells = split_row(resources[1]);
+	BOOST_REQUIRE_EQUAL(cells.size(), 8);
+	BOOST_CHECK_EQUAL(cells[1], *pe.get_resources()->at(0)->get_type());
+	fs::remove_all(directory);
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(table_delay_loaded_imports)
+{
+	const fs::path directory = "table_export_delay.test";
+	fs::remove_all(directory);
+	mana::PE pe("testfiles/manatest3.exe");
+	{
+		io::TableExporter exporter(directory.string());
+		BOOST_REQUIRE(exporter.is_open());
+		exporter.export_pe(pe, SHA256_A);
+	}
+
+	std::vector<std::string> imports = read_lines(directory / "imports.tsv");
+	BOOST_CHECK_EQUAL(imports.size(), count_imports(pe) + 1);
+	BOOST_CHECK_EQUAL(std::count(imports.begin(), imports.end(),
+		SHA256_A + "\tADVAPI32.dll\tCryptAcquireContextW\t\t1"), 1);
+	BOOST_CHECK_EQUAL(std::count(imports.begin(), imports.end(),
+		SHA256_A + "\tKERNEL32.dll\tGetLastError\t\t0"), 1);
+	fs::remove_all(directory);
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(table_ordinal_imports)
+{
+	const fs::path directory = "table_export_ordinal.test";
+	const fs::path sample = "table_export_ordinal.exe";
+	fs::remove_all(directory);
+	fs::remove(sample);
+
+	// Turn the first import of manatest2.exe (VCRUNTIME140.dll!memset) into an import by ordinal,
+	// by patching its entry in the import lookup table.
+	fs::copy_file("testfiles/manatest2.exe", sample);
+	{
+		std::fstream f(sample.string().c_str(), std::ios::in | std::ios::out | std::ios::binary);
+		const char ordinal[] = { 0x10, 0x00, 0x00, static_cast<char>(0x80) }; // 0x80000010: ordinal 16.
+		f.seekp(0x161C);
+		f.write(ordinal, sizeof(ordinal));
+	}
+
+	size_t functions = 0;
+	{
+		mana::PE pe(sample.string());
+		functions = count_imports(pe);
+		io::TableExporter exporter(directory.string());
+		BOOST_REQUIRE(exporter.is_open());
+		exporter.export_pe(pe, SHA256_B);
+	}
+
+	std::vector<std::string> imports = read_lines(directory / "imports.tsv");
+	BOOST_CHECK_EQUAL(imports.size(), functions + 1);
+	BOOST_CHECK(std::find(imports.begin(), imports.end(),
+		SHA256_B + "\tVCRUNTIME140.dll\t\t16\t0") != imports.end());
+	BOOST_CHECK(std::find(imports.begin(), imports.end(),
+		SHA256_B + "\tVCRUNTIME140.dll\tmemset\t\t0") == imports.end());
+	fs::remove_all(directory);
+	fs::remove(sample);
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(table_escaping)
+{
+	BOOST_CHECK_EQUAL(io::TableExporter::escape("plain value", io::TableExporter::TSV), "plain value");
+	BOOST_CHECK_EQUAL(io::TableExporter::escape("a\tb", io::TableExporter::TSV), "a\\tb");
+	BOOST_CHECK_EQUAL(io::TableExporter::escape("line\r\nbreak", io::TableExporter::TSV), "line\\r\\nbreak");
+	BOOST_CHECK_EQUAL(io::TableExporter::escape("C:\\path", io::TableExporter::TSV), "C:\\\\path");
+	BOOST_CHECK_EQUAL(io::TableExporter::escape("\"a,b\"", io::TableExporter::TSV), "\"a,b\"");
+
+	BOOST_CHECK_EQUAL(io::TableExporter::escape("plain value", io::TableExporter::CSV), "plain value");
+	BOOST_CHECK_EQUAL(io::TableExporter::escape("a,b", io::TableExporter::CSV), "\"a,b\"");
+	BOOST_CHECK_EQUAL(io::TableExporter::escape("say \"hi\"", io::TableExporter::CSV), "\"say \"\"hi\"\"\"");
+	BOOST_CHECK_EQUAL(io::TableExporter::escape("line\nbreak", io::TableExporter::CSV), "\"line\nbreak\"");
+	BOOST_CHECK_EQUAL(io::TableExporter::escape("a\tb\\c", io::TableExporter::CSV), "a\tb\\c");
+	BOOST_CHECK_EQUAL(io::TableExporter::escape("", io::TableExporter::CSV), "");
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(table_append)
+{
+	const fs::path directory = "table_export_append.test";
+	fs::remove_all(directory);
+	for (int run = 0 ; run < 2 ; ++run)
+	{
+		io::TableExporter exporter(directory.string(), io::TableExporter::CSV);
+		BOOST_REQUIRE(exporter.is_open());
+		exporter.export_pe(mana::PE("testfiles/manatest2.exe"), SHA256_B);
+	}
+	BOOST_CHECK(!fs::exists(directory / "exports.tsv"));
+
+	// The header is only written into empty tables.
+	std::vector<std::string> exports = read_lines(directory / "exports.csv");
+	BOOST_REQUIRE_EQUAL(exports.size(), 3);
+	BOOST_CHECK_EQUAL(exports[0], "sha256,ordinal,address,name,forward_name");
+	BOOST_CHECK_EQUAL(exports[1], SHA256_B + ",1,4096,exported,");
+	BOOST_CHECK_EQUAL(exports[2], exports[1]);
+	std::vector<std::string> sections = read_lines(directory / "sections.csv");
+	BOOST_CHECK_EQUAL(std::count(sections.begin(), sections.end(), sections[0]), 1);
+	fs::remove_all(directory);
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE_END()
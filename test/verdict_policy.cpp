@@ -0,0 +1,215 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/assign/list_of.hpp>
+#include <boost/make_shared.hpp>
+
+#include "plugin_framework/verdict_policy.h"
+#include "plugin_framework/analysis_context.h"
+#include "plugin_framework/worker_pool.h"
+#include "fixtures.h"
+
+BOOST_FIXTURE_TEST_SUITE(verdict_policy, SetWorkingDirectory)
+
+// ----------------------------------------------------------------------------
+
+// Results can only be created by plugins.
+class DummyPlugin : public plugin::IPlugin
+{
+public:
+	int get_api_version() const override { return 2; }
+	pString get_id() const override { return boost::make_shared<std::string>("dummy"); }
+	pString get_description() const override { return boost::make_shared<std::string>("Dummy plugin."); }
+};
+
+plugin::pResult make_result(plugin::LEVEL level)
+{
+	DummyPlugin p;
+	plugin::pResult res = p.create_result();
+	res->set_level(level);
+	return res;
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(policy_disabled)
+{
+	plugin::VerdictPolicy policy = plugin::VerdictPolicy(plugin::string_map());
+	BOOST_CHECK(!policy.is_enabled());
+	BOOST_CHECK(!policy.is_verdict(make_result(plugin::MALICIOUS)));
+	BOOST_CHECK_EQUAL(policy.get_rank("clamav"), 0);
+	BOOST_CHECK_EQUAL(policy.get_rank("strings"), 0);
+
+	policy = plugin::VerdictPolicy(boost::assign::map_list_of("stop_level", "whenever"));
+	BOOST_CHECK(!policy.is_enabled());
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(policy_threshold)
+{
+	plugin::VerdictPolicy policy = plugin::VerdictPolicy(boost::assign::map_list_of("stop_level", " Suspicious"));
+	BOOST_CHECK(policy.is_enabled());
+	BOOST_CHECK(policy.is_verdict(make_result(plugin::MALICIOUS)));
+	BOOST_CHECK(policy.is_verdict(make_result(plugin::SUSPICIOUS)));
+	BOOST_CHECK(!policy.is_verdict(make_result(plugin::NO_OPINION)));
+	BOOST_CHECK(!policy.is_verdict(plugin::pResult()));
+
+	policy = plugin::VerdictPolicy(boost::assign::map_list_of("stop_level", "malicious"));
+	BOOST_CHECK(policy.is_verdict(make_result(plugin::MALICIOUS)));
+	BOOST_CHECK(!policy.is_verdict(make_result(plugin::SUSPICIOUS)));
+	BOOST_CHECK(policy.may_skip("strings")); // All plugins may be skipped by default.
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(policy_lists)
+{
+	plugin::VerdictPolicy policy = plugin::VerdictPolicy(boost::assign::map_list_of
+		("stop_level", "malicious")
+		("skip_on_verdict", "strings, findcrypt,,")
+		("cost_order", "clamav,imports,clamav"));
+	BOOST_CHECK(policy.may_skip("strings"));
+	BOOST_CHECK(policy.may_skip("findcrypt"));
+	BOOST_CHECK(!policy.may_skip("clamav"));
+	BOOST_CHECK_EQUAL(policy.get_rank("clamav"), 0);
+	BOOST_CHECK_EQUAL(policy.get_rank("imports"), 1);
+	BOOST_CHECK_EQUAL(policy.get_rank("strings"), 2);
+}
+
+// ----------------------------------------------------------------------------
+
+// A cheap plugin which always finds the sample malicious.
+class CheapPlugin : public plugin::IPlugin
+{
+public:
+	int get_api_version() const override { return 2; }
+	pString get_id() const override { return boost::make_shared<std::string>("clamav"); }
+	pString get_description() const override { return boost::make_shared<std::string>("Cheap plugin."); }
+	plugin::pResult analyze_sample(plugin::IAnalysisContext& context) override
+	{
+		plugin::pResult res = create_result();
+		res->set_level(plugin::MALICIOUS);
+		return res;
+	}
+};
+
+// An expensive plugin which counts how many times it ran.
+class ExpensivePlugin : public plugin::IPlugin
+{
+public:
+	int get_api_version() const override { return 2; }
+	pString get_id() const override { return boost::make_shared<std::string>("strings"); }
+	pString get_description() const override { return boost::make_shared<std::string>("Expensive plugin."); }
+	plugin::pResult analyze_sample(plugin::IAnalysisContext& context) override
+	{
+		++runs;
+		return create_result();
+	}
+
+	static int runs; // Only one instance runs at a time.
+};
+int ExpensivePlugin::runs = 0;
+
+BOOST_AUTO_TEST_CASE(verdict_skips_plugins)
+{
+	mana::PE pe("testfiles/manatest.exe");
+	plugin::AnalysisContext context(pe);
+	plugin::WorkerPool pool(4); // Enough threads to start both plugins at once.
+	std::vector<plugin::pIPlugin> plugins = boost::assign::list_of<plugin::pIPlugin>
+		(boost::make_shared<ExpensivePlugin>())
+		(boost::make_shared<CheapPlugin>());
+	std::vector<plugin::pResult> results;
+	std::string verdict;
+
+	plugin::VerdictPolicy policy = plugin::VerdictPolicy(boost::assign::map_list_of
+		("stop_level", "malicious")
+		("cost_order", "clamav"));
+	std::vector<std::string> skipped = policy.run_plugins(plugins, context, pool, results, verdict);
+	BOOST_CHECK_EQUAL(verdict, "clamav");
+	BOOST_CHECK_EQUAL(ExpensivePlugin::runs, 0);
+	BOOST_REQUIRE_EQUAL(skipped.size(), 1);
+	BOOST_CHECK_EQUAL(skipped[0], "strings");
+	BOOST_REQUIRE_EQUAL(results.size(), 2);
+	BOOST_CHECK(!results[0]);
+	BOOST_CHECK(results[1]);
+
+	// A verdict reached by a previous stage skips the plugins, even the ones in the cost order.
+	verdict = "yara";
+	skipped = policy.run_plugins(plugins, context, pool, results, verdict);
+	BOOST_CHECK_EQUAL(verdict, "yara");
+	BOOST_CHECK_EQUAL(skipped.size(), 2);
+	BOOST_CHECK_EQUAL(ExpensivePlugin::runs, 0);
+
+	// Without a policy, all the plugins run.
+	verdict.clear();
+	policy = plugin::VerdictPolicy(plugin::string_map());
+	skipped = policy.run_plugins(plugins, context, pool, results, verdict);
+	BOOST_CHECK(verdict.empty());
+	BOOST_CHECK(skipped.empty());
+	BOOST_CHECK_EQUAL(ExpensivePlugin::runs, 1);
+	BOOST_CHECK(results[0] && results[1]);
+}
+
+// ----------------------------------------------------------------------------
+
+// A plugin which never settles the verdict.
+class NeutralPlugin : public plugin::IPlugin
+{
+public:
+	int get_api_version() const override { return 2; }
+	pString get_id() const override { return boost::make_shared<std::string>("imports"); }
+	pString get_description() const override { return boost::make_shared<std::string>("Neutral plugin."); }
+	plugin::pResult analyze_sample(plugin::IAnalysisContext& context) override {
+		return create_result();
+	}
+};
+
+BOOST_AUTO_TEST_CASE(verdict_cost_order)
+{
+	mana::PE pe("testfiles/manatest.exe");
+	plugin::AnalysisContext context(pe);
+	plugin::WorkerPool pool(2);
+	std::vector<plugin::pIPlugin> plugins = boost::assign::list_of<plugin::pIPlugin>
+		(boost::make_shared<ExpensivePlugin>())
+		(boost::make_shared<NeutralPlugin>())
+		(boost::make_shared<CheapPlugin>());
+	std::vector<plugin::pResult> results;
+	std::string verdict;
+	ExpensivePlugin::runs = 0;
+
+	// The pool only starts the two cheapest plugins: the verdict they reach skips the last one.
+	plugin::VerdictPolicy policy = plugin::VerdictPolicy(boost::assign::map_list_of
+		("stop_level", "malicious")
+		("skip_on_verdict", "strings")
+		("cost_order", "clamav,imports,strings"));
+	std::vector<std::string> skipped = policy.run_plugins(plugins, context, pool, results, verdict);
+	BOOST_CHECK_EQUAL(verdict, "clamav");
+	BOOST_CHECK_EQUAL(ExpensivePlugin::runs, 0);
+	BOOST_REQUIRE_EQUAL(skipped.size(), 1);
+	BOOST_CHECK_EQUAL(skipped[0], "strings");
+	BOOST_REQUIRE_EQUAL(results.size(), 3);
+	BOOST_CHECK(!results[0]);
+	BOOST_CHECK(results[1] && results[2]);
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE_END()
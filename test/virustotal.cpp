@@ -0,0 +1,259 @@
+/*
+    This file is part of Manalyze.
+
+    Manalyze is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Manalyze is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Manalyze.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <vector>
+#include <sstream>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include "plugin_framework/plugin_interface.h"
+#include "plugin_framework/analysis_context.h"
+#include "plugins/plugin_virustotal/http_client.h"
+#include "plugins/plugin_virustotal/token_bucket.h"
+#include "plugins/plugin_virustotal/report_cache.h"
+#include "fixtures.h"
+
+namespace bai = boost::asio::ip;
+
+namespace plugin {
+	extern "C" IPlugin* create();
+	extern "C" void destroy(IPlugin* p);
+}
+
+/**
+ *	@brief	A local stand-in for the VirusTotal API.
+ *
+ *	Every file is reported as known and undetected. Connections are kept alive.
+ */
+class StandInServer
+{
+public:
+	StandInServer(bool chunked = false)
+		: _acceptor(_io_service, bai::tcp::endpoint(bai::address_v4::loopback(), 0)),
+		  _chunked(chunked), _connections(0), _requests(0), _stopping(false)
+	{
+		_thread = boost::thread(&StandInServer::_serve, this);
+	}
+
+	~StandInServer()
+	{
+		_stopping = true;
+		boost::system::error_code ignored;
+		bai::tcp::socket wake_up(_io_service); // Unblocks accept().
+		wake_up.connect(_acceptor.local_endpoint(), ignored);
+		_thread.join();
+	}
+
+	std::string get_port() const { return std::to_string(_acceptor.local_endpoint().port()); }
+	unsigned int get_connections() const { return _connections; }
+	unsigned int get_requests() const { return _requests; }
+
+private:
+	void _serve()
+	{
+		while (!_stopping)
+		{
+			bai::tcp::socket socket(_io_service);
+			boost::system::error_code error;
+			_acceptor.accept(socket, error);
+			if (error || _stopping) {
+				return;
+			}
+			++_connections;
+
+			// Answer requests until the client closes the connection.
+			boost::asio::streambuf buffer;
+			while (boost::asio::read_until(socket, buffer, "\r\n\r\n", error) && !error)
+			{
+				std::string data(boost::asio::buffers_begin(buffer.data()), boost::asio::buffers_end(buffer.data()));
+				size_t header_size = data.find("\r\n\r\n") + 4;
+				size_t length_header = data.find("Content-Length: ");
+				size_t content_length = std::stoul(data.substr(length_header + 16));
+				if (buffer.size() < header_size + content_length) {
+					boost::asio::read(socket, buffer, boost::asio::transfer_exactly(header_size + content_length - buffer.size()));
+				}
+				data.assign(boost::asio::buffers_begin(buffer.data()), boost::asio::buffers_begin(buffer.data()) + header_size + content_length);
+				buffer.consume(header_size + content_length);
+				++_requests;
+
+				std::string resources = data.substr(data.find("resource=") + 9, std::string::npos);
+				std::vector<std::string> hashes;
+				boost::split(hashes, resources, boost::is_any_of(","));
+				std::stringstream body;
+				body << (hashes.size() > 1 ? "[" : "");
+				for (auto it = hashes.begin() ; it != hashes.end() ; ++it)
+				{
+					body << (it == hashes.begin() ? "" : ", ") << "{\"resource\": \"" << *it << "\", \"response_code\": 1, "
+						 << "\"total\": 10, \"positives\": 0, \"scan_date\": \"2016-01-01 00:00:00\", \"scans\": {}}";
+				}
+				body << (hashes.size() > 1 ? "]" : "");
+
+				std::stringstream response;
+				response << "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n";
+				if (_chunked) {
+					response << "Transfer-Encoding: chunked\r\n\r\n" << std::hex << body.str().size() << "\r\n" << body.str() << "\r\n0\r\n\r\n";
+				}
+				else {
+					response << "Content-Length: " << body.str().size() << "\r\n\r\n" << body.str();
+				}
+				boost::asio::write(socket, boost::asio::buffer(response.str()), error);
+			}
+		}
+	}
+
+	boost::asio::io_service	_io_service;
+	bai::tcp::acceptor		_acceptor;
+	bool					_chunked;
+	unsigned int			_connections;
+	unsigned int			_requests;
+	volatile bool			_stopping;
+	boost::thread			_thread;
+};
+
+BOOST_FIXTURE_TEST_SUITE(virustotal, SetWorkingDirectory)
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(http_keep_alive)
+{
+	StandInServer server;
+	plugin::HttpClient client("127.0.0.1", server.get_port());
+	unsigned int status = 0;
+	std::string response;
+
+	BOOST_CHECK(client.post("/vtapi/v2/file/report", "apikey=key&resource=abcd", status, response));
+	BOOST_CHECK_EQUAL(status, 200);
+	BOOST_CHECK(boost::contains(response, "\"resource\": \"abcd\""));
+	BOOST_CHECK(client.post("/vtapi/v2/file/report", "apikey=key&resource=ab,cd", status, response));
+	BOOST_CHECK(boost::starts_with(response, "["));
+
+	// Both requests used the same connection.
+	BOOST_CHECK_EQUAL(client.get_connection_count(), 1);
+	BOOST_CHECK_EQUAL(server.get_connections(), 1);
+	BOOST_CHECK_EQUAL(server.get_requests(), 2);
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(http_chunked)
+{
+	StandInServer server(true);
+	plugin::HttpClient client("127.0.0.1", server.get_port());
+	unsigned int status = 0;
+	std::string response;
+
+	BOOST_CHECK(client.post("/vtapi/v2/file/report", "apikey=key&resource=abcd", status, response));
+	BOOST_CHECK(boost::starts_with(response, "{\"resource\": \"abcd\""));
+	BOOST_CHECK(boost::ends_with(response, "}"));
+	BOOST_CHECK(client.post("/vtapi/v2/file/report", "apikey=key&resource=abcd", status, response));
+	BOOST_CHECK_EQUAL(client.get_connection_count(), 1);
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(token_bucket)
+{
+	plugin::TokenBucket bucket(0.001, 2); // One token every 1000 seconds.
+	BOOST_CHECK(bucket.try_acquire());
+	BOOST_CHECK(bucket.try_acquire());
+	BOOST_CHECK(!bucket.try_acquire());
+
+	plugin::TokenBucket unlimited(0, 1);
+	for (int i = 0 ; i < 10 ; ++i) {
+		BOOST_CHECK(unlimited.try_acquire());
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(report_cache)
+{
+	plugin::ReportCache cache(3600);
+	cache.put("ABCD", "{\"response_code\": 1}");
+	cache.put("ef01", "{\"response_code\": 0}", time(nullptr) - 7200); // Expired
+	std::string report;
+	BOOST_CHECK(cache.get("abcd", report));
+	BOOST_CHECK_EQUAL(report, "{\"response_code\": 1}");
+	BOOST_CHECK(!cache.get("ef01", report));
+
+	// Expired reports are not saved.
+	BOOST_CHECK(cache.save("vt_cache_test.txt"));
+	plugin::ReportCache loaded(3600);
+	BOOST_CHECK(loaded.load("vt_cache_test.txt"));
+	BOOST_CHECK_EQUAL(loaded.size(), 1);
+	BOOST_CHECK(loaded.get("ABCD", report));
+	BOOST_CHECK_EQUAL(report, "{\"response_code\": 1}");
+	fs::remove("vt_cache_test.txt");
+
+	BOOST_CHECK(!loaded.load("nonexistent_cache.txt"));
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(virustotal_plugin)
+{
+	StandInServer server;
+	plugin::string_map config;
+	config["api_key"] = "0123456789";
+	config["host"] = "127.0.0.1";
+	config["port"] = server.get_port();
+	config["cache_file"] = "vt_cache_test.txt";
+
+	mana::PE pe("testfiles/manatest.exe");
+	mana::PE pe2("testfiles/manatest2.exe");
+	plugin::AnalysisContext context(pe);
+	plugin::AnalysisContext context2(pe2);
+	std::vector<plugin::IAnalysisContext*> samples;
+	samples.push_back(&context);
+	samples.push_back(&context2);
+
+	plugin::pIPlugin p(plugin::create(), plugin::destroy);
+	p->set_config(config);
+	p->on_load(config);
+	p->prepare_sample(context);
+	p->prepare_sample(context2);
+	plugin::shared_results results = p->analyze_batch(samples);
+	BOOST_ASSERT(results && results->size() == 2);
+	for (auto it = results->begin() ; it != results->end() ; ++it)
+	{
+		BOOST_CHECK_EQUAL((*it)->get_level(), plugin::SAFE);
+		BOOST_CHECK_EQUAL(*(*it)->get_summary(), "VirusTotal score: 0/10 (Scanned on 2016-01-01 00:00:00)");
+	}
+	p->on_run_end();
+	unsigned int requests = server.get_requests();
+	BOOST_CHECK_MESSAGE(requests >= 1 && requests <= 2, "requests=" << requests);
+	BOOST_CHECK_EQUAL(server.get_connections(), 1);
+
+	// The reports are cached: a new run doesn't send any request.
+	p.reset(plugin::create(), plugin::destroy);
+	p->set_config(config);
+	p->on_load(config);
+	results = p->analyze_batch(samples);
+	BOOST_ASSERT(results && results->size() == 2);
+	BOOST_CHECK_EQUAL(results->at(1)->get_level(), plugin::SAFE);
+	p->on_run_end();
+	BOOST_CHECK_EQUAL(server.get_requests(), requests);
+	fs::remove("vt_cache_test.txt");
+}
+
+// ----------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE_END()